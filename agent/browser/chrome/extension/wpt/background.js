@@ -61,6 +61,10 @@ var FAKE_TASK_INTERVAL = 6000;
 /** @const */
 var TASK_INTERVAL_SHORT = 0;
 
+// How long the hook may hold a task request waiting for the next task.
+/** @const */
+var TASK_WAIT = 5000;
+
 // Set this to true, and set FAKE_COMMAND_SEQUENCE below, to feed a sequence
 // of commands to run.  This makes testing new commands easy, because you do
 // not need to use wptdriver.exe while debugging.
@@ -223,7 +227,7 @@ function wptGetTask() {
     g_requesting_task = true;
     try {
       var xhr = new XMLHttpRequest();
-      xhr.open('GET', 'http://127.0.0.1:8888/task', true);
+      xhr.open('GET', 'http://127.0.0.1:8888/task?wait=' + TASK_WAIT, true);
       xhr.onreadystatechange = function() {
         if (xhr.readyState != 4)
           return;
@@ -239,7 +243,9 @@ function wptGetTask() {
           return;
         }
         if (!resp.data) {
+          // The request was held until the wait expired, ask again.
           g_requesting_task = false;
+          window.setTimeout(wptGetTask, TASK_INTERVAL_SHORT);
           return;
         }
         wptExecuteTask(resp.data);
@@ -71,6 +71,9 @@ CPagetestBase::CPagetestBase(void):
 	
 	winInetRequests.InitHashTable(257);
 	requestSocketIds.InitHashTable(257);
+	connects.InitHashTable(257);
+	requests.InitHashTable(257);
+	socketConnects.InitHashTable(257);
 	threadWindows.InitHashTable(257);
 	openSockets.InitHashTable(257);
   client_ports.InitHashTable(257);
@@ -163,6 +166,7 @@ void CPagetestBase::Reset(void)
 		winInetRequests.RemoveAll();
 		winInetRequestList.RemoveAll();
 		requestSocketIds.RemoveAll();
+		socketConnects.RemoveAll();
 
 		// delete all of the events we're tracking
 		while( !events.IsEmpty() )
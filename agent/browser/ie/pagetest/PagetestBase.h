@@ -156,8 +156,9 @@ public:
 
 	CAtlList<CTrackedEvent *>	events;			// all events
 	CAtlList<CDnsLookup *>		dns;			// DNS only events
-	CAtlList<CSocketConnect *>	connects;		// Socket connections
-	CAtlList<CSocketRequest *>	requests;		// Socket requests
+	CAtlMap<SOCKET, CSocketConnect *>	connects;		// hash of sockets to pending socket connections
+	CAtlMap<SOCKET, CSocketRequest *>	requests;		// hash of sockets to their active socket request
+	CAtlMap<DWORD, CSocketConnect *>	socketConnects;	// hash of socket ID's to socket connections
 	CAtlList<CWinInetRequest *>	winInetRequestList;				// reverse-order list of winInet requests
 	CAtlMap<SOCKET, CSocketInfo *>		openSockets;			// hash of the currently open sockets
 	CAtlMap<HINTERNET, CWinInetRequest *>	winInetRequests;	// hash of WinInet requests that are currently pending
@@ -35,8 +35,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <atlenc.h>
 #include "cdn.h"
 #include "zlib/zlib.h"
-#include "jsmin/JSMin.h"
+#include "../../../wpthook/minify_estimator.h"
 #include "PageSpeed/include/pagespeed/core/engine.h"
+#include "PageSpeed/include/pagespeed/core/image_attributes.h"
 #include "PageSpeed/include/pagespeed/core/pagespeed_init.h"
 #include "PageSpeed/include/pagespeed/core/pagespeed_input.h"
 #include "PageSpeed/include/pagespeed/core/pagespeed_version.h"
@@ -45,7 +46,6 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "PageSpeed/include/pagespeed/l10n/localizer.h"
 #include "PageSpeed/include/pagespeed/platform/ie/ie_dom.h"
 #include "PageSpeed/include/pagespeed/proto/formatted_results_to_json_converter.h"
-#include "PageSpeed/include/pagespeed/proto/formatted_results_to_text_converter.h"
 #include "PageSpeed/include/pagespeed/proto/pagespeed_output.pb.h"
 #include "PageSpeed/include/pagespeed/proto/pagespeed_proto_formatter.pb.h"
 #include "PageSpeed/include/pagespeed/rules/rule_provider.h"
@@ -53,6 +53,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <regex>
 #include <string>
 #include <sstream>
+#include <algorithm>
 using namespace std::tr1;
 #include "../urlblast/zip/zip.h"
 
@@ -255,6 +256,90 @@ bool PageSpeedFormatResults(pagespeed::Engine& engine, pagespeed::Results& pages
   return ret;
 }
 
+/*-----------------------------------------------------------------------------
+	The Page Speed engine (and the rules it owns) is only built once and
+	re-used for every run
+-----------------------------------------------------------------------------*/
+pagespeed::Engine * GetPageSpeedEngine(void)
+{
+	static pagespeed::Engine * engine = NULL;
+	if( !engine )
+	{
+		#ifndef DEBUG
+		logging::SetMinLogLevel(logging::LOG_NUM_SEVERITIES);
+		#endif
+		pagespeed::Init();
+
+		std::vector<pagespeed::Rule*> rules;
+		PopulatePageSpeedRules(&rules);
+
+		// Ownership of rules is transferred to the Engine instance.
+		engine = new pagespeed::Engine(&rules);
+		engine->Init();
+	}
+
+	return engine;
+}
+
+/*-----------------------------------------------------------------------------
+	Image attributes factory that remembers the dimensions of every image it
+	has decoded (by content) so identical images in repeat views and later
+	runs don't have to be decoded again.  The cache lives in the browser
+	process for as long as it runs, so it is flushed once it reaches
+	MAX_CACHED_IMAGE_SIZES entries.
+-----------------------------------------------------------------------------*/
+#define MAX_CACHED_IMAGE_SIZES 1000
+
+class CCachedImageAttributesFactory : public pagespeed::ImageAttributesFactory
+{
+public:
+	CCachedImageAttributesFactory(void){}
+	virtual ~CCachedImageAttributesFactory(void){}
+
+	virtual pagespeed::ImageAttributes* NewImageAttributes(const pagespeed::Resource* resource) const
+	{
+		pagespeed::ImageAttributes * attributes = NULL;
+		if( resource )
+		{
+			const std::string& body = resource->GetResponseBody();
+			ULONGLONG key = ((ULONGLONG)body.size() << 32) | 
+				crc32(0, (const Bytef *)body.data(), (uInt)body.size());
+			CImageSize size;
+			if( !sizes.Lookup(key, size) )
+			{
+				pagespeed::ImageAttributes * decoded = factory.NewImageAttributes(resource);
+				if( decoded )
+				{
+					size.width = decoded->GetImageWidth();
+					size.height = decoded->GetImageHeight();
+					delete decoded;
+				}
+				if( sizes.GetCount() >= MAX_CACHED_IMAGE_SIZES )
+					sizes.RemoveAll();
+				sizes.SetAt(key, size);
+			}
+			if( size.width >= 0 && size.height >= 0 )
+				attributes = new pagespeed::ConcreteImageAttributes(size.width, size.height);
+		}
+
+		return attributes;
+	}
+
+private:
+	class CImageSize
+	{
+	public:
+		CImageSize(void):width(-1),height(-1){}
+		int width;
+		int height;
+	};
+
+	pagespeed::image_compression::ImageAttributesFactory factory;
+	static CAtlMap<ULONGLONG, CImageSize> sizes;
+};
+
+CAtlMap<ULONGLONG, CCachedImageAttributesFactory::CImageSize> CCachedImageAttributesFactory::sizes;
+
 /*-----------------------------------------------------------------------------
 	OK, time to generate any results
 -----------------------------------------------------------------------------*/
@@ -359,22 +444,13 @@ void CPagetestReporting::FlushResults(void)
 						hFile = CreateFile(logFile+step+_T("_pagespeed.txt"), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, &nullDacl, CREATE_ALWAYS, 0, 0);
 						if( hFile != INVALID_HANDLE_VALUE )
 						{
-							std::vector<pagespeed::Rule*> rules;
-							PopulatePageSpeedRules(&rules);
-	
-							ATLTRACE(_T("[Pagetest] - ***** CPagetestReporting::FlushResults - Initializing Page Speed engine\n"));
-
-							// Ownership of rules is transferred to the Engine instance.
-							pagespeed::Engine engine(&rules);
-							engine.Init();
-
 							ATLTRACE(_T("[Pagetest] - ***** CPagetestReporting::FlushResults - Formatting Page Speed results\n"));
 
 							pagespeed::l10n::BasicLocalizer localizer;
 							pagespeed::FormattedResults formatted_results;
 							formatted_results.set_locale(localizer.GetLocale());
 							pagespeed::formatters::ProtoFormatter formatter(&localizer, &formatted_results);
-							if ( pagespeedResults && PageSpeedFormatResults(engine, *pagespeedResults, &formatter) )
+							if ( pagespeedResults && PageSpeedFormatResults(*GetPageSpeedEngine(), *pagespeedResults, &formatter) )
 							{
 								DWORD written;
 								std::string pagespeedReport;
@@ -1523,6 +1599,7 @@ void CPagetestReporting::CheckOptimization(void)
 {
 	if( checkOpt )
 	{
+		PrepareChecks();
 		CheckKeepAlive();
 		CheckGzip();
 		CheckImageCompression();
@@ -1545,6 +1622,55 @@ void CPagetestReporting::CheckOptimization(void)
 	}
 }
 
+/*-----------------------------------------------------------------------------
+	Calculate the per-request attributes that the optimization checks share
+	so each check doesn't have to re-parse the headers for every request
+-----------------------------------------------------------------------------*/
+void CPagetestReporting::PrepareChecks(void)
+{
+	CAtlMap<CString, DWORD> hostIds;
+	POSITION pos = events.GetHeadPosition();
+	while( pos )
+	{
+		CTrackedEvent * e = events.GetNext(pos);
+		if( e && e->type == CTrackedEvent::etWinInetRequest )
+		{
+			CWinInetRequest * w = (CWinInetRequest *)e;
+			w->mime = w->response.contentType;
+			w->mime.Trim().MakeLower();
+			CString exp = w->response.expires;
+			exp.Trim();
+			CString cache = w->response.cacheControl;
+			cache.MakeLower();
+			CString pragma = w->response.pragma;
+			pragma.MakeLower();
+			CString object = w->object;
+			object.MakeLower();
+			w->cacheable = exp != _T("0") && 
+				exp != _T("-1") && 
+				!(cache.Find(_T("no-store")) > -1) &&
+				!(cache.Find(_T("no-cache")) > -1) &&
+				!(pragma.Find(_T("no-cache")) > -1);
+			w->staticContent = w->cacheable &&
+				!(w->mime.Find(_T("/html")) > -1)	&&
+				!(w->mime.Find(_T("/xhtml")) > -1)	&&
+				(	w->mime.Find(_T("shockwave-flash")) >= 0 || 
+					object.Right(4) == _T(".swf") ||
+					w->mime.Find(_T("text/")) >= 0 || 
+					w->mime.Find(_T("javascript")) >= 0 || 
+					w->mime.Find(_T("image/")) >= 0);
+
+			CString host = w->host;
+			host.MakeLower();
+			if( !hostIds.Lookup(host, w->hostId) )
+			{
+				w->hostId = (DWORD)hostIds.GetCount();
+				hostIds.SetAt(host, w->hostId);
+			}
+		}
+	}
+}
+
 /*-----------------------------------------------------------------------------
 	Helper method that extracts the next HTTP header, and advances 
 	inout_headerPos to the index of the start of the next HTTP header.
@@ -1639,8 +1765,8 @@ void CPagetestReporting::PopulatePageSpeedInput(pagespeed::PagespeedInput* input
 		{
 			CWinInetRequest * w = (CWinInetRequest *)e;
 			pagespeed::Resource* resource = new pagespeed::Resource();
-			const std::string response_body(reinterpret_cast<char*>(w->body), w->bodyLen);
-			resource->SetResponseBody(response_body);
+			if( w->body && w->bodyLen )
+				resource->SetResponseBody(std::string(reinterpret_cast<char*>(w->body), w->bodyLen));
 
 			if ( w->start > 0 )
 			{
@@ -1771,36 +1897,17 @@ void CPagetestReporting::CheckPageSpeed()
 {
 	ATLTRACE(_T("[Pagetest] - CheckPageSpeed\n"));
 
-	// Instantiate an AtExitManager, which is required by some of the
-	// internals of the Page Speed ruleset.
 	if ( pagespeedResults != NULL ) 
 	{
 		delete pagespeedResults;
 	}
 	pagespeedResults = new pagespeed::Results();
 
-	// TODO(bmcquade): we should only do this once, and should ShutDown on exit.
-	// Ask Pat if there is a hook that gets invoked just once at startup.
-	static bool didInit = false;
-	if (!didInit) {
-		didInit = true;
-    #ifndef DEBUG
-    logging::SetMinLogLevel(logging::LOG_NUM_SEVERITIES);
-    #endif
-		pagespeed::Init();
-	}
-
-	std::vector<pagespeed::Rule*> rules;
-	PopulatePageSpeedRules(&rules);
-
-	// Ownership of rules is transferred to the Engine instance.
-	pagespeed::Engine engine(&rules);
-	engine.Init();
+	pagespeed::Engine * engine = GetPageSpeedEngine();
 
 	pagespeed::PagespeedInput input;
 	PopulatePageSpeedInput(&input);
-	input.AcquireImageAttributesFactory(
-		new pagespeed::image_compression::ImageAttributesFactory());
+	input.AcquireImageAttributesFactory(new CCachedImageAttributesFactory());
 	input.Freeze();
 
 	// NOTE: ComputeResults may return false in cases where it successfully
@@ -1808,19 +1915,8 @@ void CPagetestReporting::CheckPageSpeed()
 	// image response). Thus we need to ignore the return value. Future
 	// versions of Page Speed will return false on actual failures, at
 	// which point we should start looking at the return value.
-	engine.ComputeResults(input, pagespeedResults);
-
-	// Generate a plaintext version of the results to include with the text
-	// optimization report (appended to buff).
-	pagespeed::l10n::BasicLocalizer localizer;
-	pagespeed::FormattedResults formatted_results;
-	formatted_results.set_locale(localizer.GetLocale());
-	pagespeed::formatters::ProtoFormatter formatter(&localizer, &formatted_results);
-	if ( engine.FormatResults(*pagespeedResults, &formatter) )
-	{
-		std::string pagespeedReport;
-		pagespeed::proto::FormattedResultsToTextConverter::Convert(formatted_results, &pagespeedReport);
-	}
+	// The results are formatted when they are written out in FlushResults.
+	engine->ComputeResults(input, pagespeedResults);
 
 	ATLTRACE(_T("[Pagetest] - CheckPageSpeed complete\n"));
 }
@@ -1847,8 +1943,6 @@ void CPagetestReporting::CheckGzip()
         e->type == CTrackedEvent::etWinInetRequest && 
         (!e->ignore || !w->object.Right(11).CompareNoCase(_T("favicon.ico"))) )
 		{
-			CString mime = w->response.contentType;
-			mime.MakeLower();
 			if( w->result == 200
 				&& w->linkedRequest
 				&& w->fromNet )
@@ -1952,9 +2046,29 @@ void CPagetestReporting::CheckKeepAlive()
 	int total = 0;
 	
 	ATLTRACE(_T("[Pagetest] - CheckKeepAlive\n"));
-	
+
+	// count the requests to each host (and each connection to the host)
+	CAtlMap<DWORD, DWORD> hostCount;
+	CAtlMap<ULONGLONG, DWORD> connectionCount;
 	POSITION pos = events.GetHeadPosition();
 	while( pos )
+	{
+		CTrackedEvent * e = events.GetNext(pos);
+		if( e && e->type == CTrackedEvent::etWinInetRequest && !e->ignore )
+		{
+			CWinInetRequest * w = (CWinInetRequest *)e;
+			ULONGLONG connection = ((ULONGLONG)w->hostId << 32) | w->socketId;
+			DWORD requests = 0;
+			hostCount.Lookup(w->hostId, requests);
+			hostCount.SetAt(w->hostId, requests + 1);
+			requests = 0;
+			connectionCount.Lookup(connection, requests);
+			connectionCount.SetAt(connection, requests + 1);
+		}
+	}
+	
+	pos = events.GetHeadPosition();
+	while( pos )
 	{
 		CTrackedEvent * e = events.GetNext(pos);
 		if( e && e->type == CTrackedEvent::etWinInetRequest && !e->ignore )
@@ -1972,25 +2086,13 @@ void CPagetestReporting::CheckKeepAlive()
 				else
 				{
 					// see if there were any other requests from the same host
-					CString host = w->host;
-					bool needed = false;
-					bool reused = false;
-					
-					POSITION pos2 = events.GetHeadPosition();
-					while( pos2 )
-					{
-						CTrackedEvent * e2 = events.GetNext(pos2);
-						if( e2 && e != e2 && e2->type == CTrackedEvent::etWinInetRequest && !e2->ignore )
-						{
-							CWinInetRequest * w2 = (CWinInetRequest *)e2;
-							if( !w2->host.CompareNoCase(host) )
-							{
-								needed = true;
-								if( w2->socketId == w->socketId )
-									reused = true;
-							}
-						}
-					}
+					ULONGLONG connection = ((ULONGLONG)w->hostId << 32) | w->socketId;
+					DWORD hostRequests = 0;
+					DWORD connectionRequests = 0;
+					hostCount.Lookup(w->hostId, hostRequests);
+					connectionCount.Lookup(connection, connectionRequests);
+					bool needed = hostRequests > 1;
+					bool reused = connectionRequests > 1;
 					
 					if( reused )
 						w->keepAliveScore = 100;
@@ -2044,38 +2146,14 @@ void CPagetestReporting::CheckCDN()
 		{
       bool isStatic = false;
 			CWinInetRequest * w = (CWinInetRequest *)e;
-			CString mime = w->response.contentType;
-			mime.MakeLower();
-			CString exp = w->response.expires;
-			exp.Trim();
-			CString cache = w->response.cacheControl;
-			cache.MakeLower();
-			CString pragma = w->response.pragma;
-			pragma.MakeLower();
-			CString object = w->object;
-			object.MakeLower();
 			if( w->result == 200 &&
 				w->fromNet &&
-				exp != _T("0") && 
-				exp != _T("-1") && 
-				!(cache.Find(_T("no-store")) > -1) &&
-				!(cache.Find(_T("no-cache")) > -1) &&
-				!(pragma.Find(_T("no-cache")) > -1) &&
-				!(mime.Find(_T("/html")) > -1)	&&
-				!(mime.Find(_T("/xhtml")) > -1)	&&
-				(	mime.Find(_T("shockwave-flash")) >= 0 || 
-					object.Right(4) == _T(".swf") ||
-					mime.Find(_T("text/")) >= 0 || 
-					mime.Find(_T("javascript")) >= 0 || 
-					mime.Find(_T("image/")) >= 0) )
+				w->staticContent )
 			{
         isStatic = true;
 				w->staticCdnScore = 0;
 				count++;
       }
-				
-			CString host = w->host;
-			host.MakeLower();
 
 			if (IsCDN(w, w->cdnProvider) && isStatic) {
 			  w->staticCdnScore = 100;
@@ -2236,29 +2314,36 @@ void CPagetestReporting::CheckCombine()
 	int cssCount = 0;
 
 	ATLTRACE(_T("[Pagetest] - CheckCombine\n"));
-	
+
+	// count the cacheable requests of each mime type before start render
+	CAtlMap<CString, int> mimeCount;
 	POSITION pos = events.GetHeadPosition();
 	while( pos )
+	{
+		CTrackedEvent * e = events.GetNext(pos);
+		if( e && e->type == CTrackedEvent::etWinInetRequest && e->start <= startRender )
+		{
+			CWinInetRequest * w = (CWinInetRequest *)e;
+			if( w->cacheable )
+			{
+				int cnt = 0;
+				mimeCount.Lookup(w->mime, cnt);
+				mimeCount.SetAt(w->mime, cnt + 1);
+			}
+		}
+	}
+	
+	pos = events.GetHeadPosition();
+	while( pos )
 	{
 		CTrackedEvent * e = events.GetNext(pos);
 		if( e && e->type == CTrackedEvent::etWinInetRequest && !e->ignore && e->start <= startRender )
 		{
 			CWinInetRequest * w = (CWinInetRequest *)e;
-			CString mime = w->response.contentType;
-			mime.MakeLower();
-			CString exp = w->response.expires;
-			exp.Trim();
-			CString cache = w->response.cacheControl;
-			cache.MakeLower();
-			CString pragma = w->response.pragma;
-			pragma.MakeLower();
+			const CString& mime = w->mime;
 			if( w->result == 200 &&
 				w->fromNet &&
-				exp != _T("0") && 
-				exp != _T("-1") && 
-				!(cache.Find(_T("no-store")) > -1) &&
-				!(cache.Find(_T("no-cache")) > -1) &&
-				!(pragma.Find(_T("no-cache")) > -1) &&
+				w->cacheable &&
 				(	mime.Find(_T("/css")) >= 0 || 
 					mime.Find(_T("javascript")) >= 0 ) )
 			{
@@ -2271,36 +2356,7 @@ void CPagetestReporting::CheckCombine()
 					jsCount++;
 				
 				int cnt = 0;
-				
-				POSITION pos2 = events.GetHeadPosition();
-				while( pos2 )
-				{
-					CTrackedEvent * e2 = events.GetNext(pos2);
-					if( e2 && e2->type == CTrackedEvent::etWinInetRequest && e2->start <= startRender )
-					{
-						CWinInetRequest * w2 = (CWinInetRequest *)e2;
-						CString mime2 = w2->response.contentType;
-						mime2.MakeLower();
-						if( mime2 == mime )
-						{
-							exp = w2->response.expires;
-							exp.Trim();
-							cache = w2->response.cacheControl;
-							cache.MakeLower();
-							pragma = w2->response.pragma;
-							pragma.MakeLower();
-							if( exp != _T("0") && 
-								exp != _T("-1") && 
-								!(cache.Find(_T("no-store")) > -1) &&
-								!(cache.Find(_T("no-cache")) > -1) &&
-								!(pragma.Find(_T("no-cache")) > -1) )
-							{
-									cnt++;
-							}
-						}
-					}
-				}
-				
+				mimeCount.Lookup(mime, cnt);
 				if( cnt <= 1 )
 					w->combineScore = 100;
 
@@ -2337,16 +2393,6 @@ void CPagetestReporting::CheckCookie()
 		if( e && e->type == CTrackedEvent::etWinInetRequest && !e->ignore )
 		{
 			CWinInetRequest * w = (CWinInetRequest *)e;
-			CString mime = w->response.contentType;
-			mime.MakeLower();
-			CString exp = w->response.expires;
-			exp.Trim();
-			CString cache = w->response.cacheControl;
-			cache.MakeLower();
-			CString pragma = w->response.pragma;
-			pragma.MakeLower();
-			CString object = w->object;
-			object.MakeLower();
 			count++;
 			int cnt = 0;
 			CString failStr;
@@ -2362,18 +2408,7 @@ void CPagetestReporting::CheckCookie()
 				// if it is a static object then it fails outright
 				if( (w->result == 304 ||
 					w->result == 200) &&
-					exp != _T("0") && 
-					exp != _T("-1") && 
-					!(cache.Find(_T("no-store")) > -1) &&
-					!(cache.Find(_T("no-cache")) > -1) &&
-					!(pragma.Find(_T("no-cache")) > -1) &&
-					!(mime.Find(_T("/html")) > -1)	&&
-					!(mime.Find(_T("/xhtml")) > -1)	&&
-					(	mime.Find(_T("shockwave-flash")) >= 0 || 
-						object.Right(4) == _T(".swf") ||
-						mime.Find(_T("text/")) >= 0 || 
-						mime.Find(_T("javascript")) >= 0 || 
-						mime.Find(_T("image/")) >= 0) )
+					w->staticContent )
 				{
 					w->cookieScore = 0;
 				}
@@ -2416,14 +2451,14 @@ void CPagetestReporting::CheckMinify()
 		if( e && e->type == CTrackedEvent::etWinInetRequest && !e->ignore )
 		{
 			CWinInetRequest * w = (CWinInetRequest *)e;
-			CString mime = w->response.contentType;
-			mime.MakeLower();
+			const CString& mime = w->mime;
 
 			LPBYTE body = w->body;
 			DWORD bodyLen = w->bodyLen;
 			
+			bool css = mime.Find(_T("/css")) >= 0;
 			if( w->fromNet && w->result == 200 && 
-					((mime.Find(_T("javascript")) >= 0 || mime.Find(_T("json")) >= 0) && 
+					((mime.Find(_T("javascript")) >= 0 || mime.Find(_T("json")) >= 0 || css) && 
 					body && bodyLen))
 			{
 				count++;
@@ -2438,33 +2473,22 @@ void CPagetestReporting::CheckMinify()
 					w->minifyScore = 100;
 				else
 				{
-					// run JSMin on the file and see how much smaller it is
-					DWORD len = origLen + 1;
-					char * minified = new char [len];
-					JSMin jsmin;
-					if( jsmin.Minify((const char *)body, minified, len) && len )
+					// estimate how much smaller the file would be if it was minified
+					// (and gzipped if the original content was gzipped)
+					CString enc = w->response.contentEncoding;
+					enc.MakeLower();
+					bool gzip = enc.Find(_T("gzip")) >= 0;
+					MinifyEstimator minify(gzip);
+					bool ok = css ? minify.Css((const char *)body, origLen) :
+									minify.JavaScript((const char *)body, origLen);
+					if( ok && minify.minified_size_ )
 					{
-						// if the original content was gzipped, gzip the minified result as well
-						CString enc = w->response.contentEncoding;
-						enc.MakeLower();
-						if( enc.Find(_T("gzip")) >= 0 )
-						{
-							DWORD cLen = compressBound(len);
-							if( cLen )
-							{
-								LPBYTE buff = new BYTE[cLen];
-								if( compress2(buff, &cLen, (LPBYTE)minified, len, 9) == Z_OK )
-									target = cLen + headSize;
-									
-								delete [] buff;
-							}
-						}
-						else
-							target = len + headSize;
+						if( !gzip )
+							target = minify.minified_size_ + headSize;
+						else if( minify.gzip_size_ )
+							target = minify.gzip_size_ + headSize;
 					}
 
-					delete [] minified;
-
 					// if minification saves 10% or more then it fails
 					if( target > origSize )
 						target = origSize;
@@ -2532,8 +2556,7 @@ void CPagetestReporting::CheckImageCompression()
 		if( e && e->type == CTrackedEvent::etWinInetRequest && !e->ignore )
 		{
 			CWinInetRequest * w = (CWinInetRequest *)e;
-			CString mime = w->response.contentType;
-			mime.MakeLower();
+			const CString& mime = w->mime;
 			
 			LPBYTE body = w->body;
 			DWORD bodyLen = w->bodyLen;
@@ -3235,15 +3258,25 @@ void CPagetestReporting::Log404s()
 	}
 }
 
+/*-----------------------------------------------------------------------------
+	Comparison for sorting events by start time
+-----------------------------------------------------------------------------*/
+static bool EventStartsBefore(const CTrackedEvent * a, const CTrackedEvent * b)
+{
+	return a->start < b->start;
+}
+
 /*-----------------------------------------------------------------------------
 	Sort the events by start time since some events actually start well after
-	they were inserted into the list
+	they were inserted into the list (events that start at the same time
+	keep the order they were inserted in)
 -----------------------------------------------------------------------------*/
 void CPagetestReporting::SortEvents()
 {
-	CAtlList<CTrackedEvent *>	tmp;
+	CAtlArray<CTrackedEvent *>	tmp;
+	tmp.SetCount(0, (int)events.GetCount());
 
-	// move all of the events over to a temporary list, making sure the start times are set correctly
+	// move all of the events over to a temporary array, making sure the start times are set correctly
 	POSITION pos = events.GetHeadPosition();
 	while( pos )
 	{
@@ -3255,43 +3288,17 @@ void CPagetestReporting::SortEvents()
 				w->start = w->created;
 
 			if( e->start )
-				tmp.AddTail(e);
+				tmp.Add(e);
 		}
 	}
 
 	events.RemoveAll();
 
-	pos = tmp.GetHeadPosition();
-	while( pos )
+	if( !tmp.IsEmpty() )
 	{
-		CTrackedEvent * e = tmp.GetNext(pos);
-		if( e )
-		{
-			if( events.IsEmpty() )
-				events.AddTail(e);
-			else
-			{
-				// figure out where to insert it
-				bool inserted = false;
-				POSITION next = events.GetHeadPosition();
-				while( !inserted && next )
-				{
-					POSITION p = next;
-					CTrackedEvent * n = events.GetNext(next);
-					if( n )
-					{
-						if( e->start < n->start )
-						{
-							events.InsertBefore(p, e);
-							inserted = true;
-						}
-					}
-				}
-
-				if( !inserted )
-					events.AddTail(e);
-			}
-		}
+		std::stable_sort(tmp.GetData(), tmp.GetData() + tmp.GetCount(), EventStartsBefore);
+		for( size_t i = 0; i < tmp.GetCount(); i++ )
+			events.AddTail(tmp[i]);
 	}
 }
 
@@ -3539,8 +3546,7 @@ void CPagetestReporting::CheckProgressiveJpeg()
 		CTrackedEvent * e = events.GetNext(pos);
 		if( e && e->type == CTrackedEvent::etWinInetRequest && !e->ignore ) {
 			CWinInetRequest * w = (CWinInetRequest *)e;
-			CString mime = w->response.contentType;
-			mime.MakeLower();
+			const CString& mime = w->mime;
 			
 			LPBYTE body = w->body;
 			DWORD bodyLen = w->bodyLen;
@@ -167,6 +167,7 @@ protected:
 
 	// optimization checks
 	void CheckOptimization(void);
+	void PrepareChecks(void);
 	void CheckGzip();
 	void CheckKeepAlive();
 	void CheckCDN();
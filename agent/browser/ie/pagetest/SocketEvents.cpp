@@ -104,19 +104,9 @@ void CSocketEvents::CloseSocket(SOCKET s)
 	ATLTRACE(_T("[Pagetest] - (0x%08X) CWatchDlg::CloseSocket - %d\n"), GetCurrentThreadId(), s);
 
 	// close out any open requests on the socket
-	POSITION pos = requests.GetHeadPosition();
 	CSocketRequest * socketRequest = NULL;
-	while( pos )
-	{
-		POSITION old = pos;
-		CSocketRequest * r = requests.GetNext(pos);
-		if( r && r->s == s )
-		{
-			socketRequest = r;
-			requests.RemoveAt(old);
-			pos = 0;
-		}
-	}
+	if( requests.Lookup(s, socketRequest) )
+		requests.RemoveKey(s);
 	
 	// see if we can line up a winInet request with this socket
 	if( socketRequest )
@@ -165,36 +155,21 @@ void CSocketEvents::SocketSend(SOCKET s, DWORD len, LPBYTE buff)
 	        
 			// see if this socket had an existing connect.  If so, end that now
 			EnterCriticalSection(&cs);
-			POSITION pos = connects.GetHeadPosition();
-			while( pos )
+			CSocketConnect * c = NULL;
+			if( connects.Lookup(s, c) )
 			{
-				POSITION old = pos;
-				CSocketConnect * c = connects.GetNext(pos);
-				if( c && !c->end && c->s == s)
+				// remove it from the pending connections list (will still be in the tracked events)
+				connects.RemoveKey(s);
+				if( c && !c->end )
 				{
 					c->Done();
           UpdateRTT(c);
-					
-					// remove it from the pending connections list (will still be in the tracked events)
-					connects.RemoveAt(old);
-					pos = 0;
 				}
 			}
 				
 			// see if there is an existing request that this is part of
 			CSocketRequest * request = NULL;
-			pos = requests.GetHeadPosition();
-			POSITION requestPos = NULL;
-			while( pos && !request )
-			{
-				POSITION old = pos;
-				CSocketRequest * r = requests.GetNext(pos);
-				if( r && r->s == s )
-				{
-					request = r;
-					requestPos = old;
-				}
-			}
+			requests.Lookup(s, request);
 			
 			if( request )
 			{
@@ -212,9 +187,7 @@ void CSocketEvents::SocketSend(SOCKET s, DWORD len, LPBYTE buff)
 				}
 				else
 				{
-					if( requestPos )
-						requests.RemoveAt(requestPos);
-						
+					requests.RemoveKey(s);
 					request = NULL;
 				}
 			}
@@ -247,29 +220,21 @@ void CSocketEvents::SocketSend(SOCKET s, DWORD len, LPBYTE buff)
         }
 				
 				// find the connection this is tied to
-				POSITION pos = events.GetHeadPosition();
-				while( pos )
+				CSocketConnect * connect = NULL;
+				socketConnects.Lookup(request->socketId, connect);
+				if( connect )
 				{
-					CTrackedEvent * e = events.GetNext(pos);
-					if( e && e->type == CTrackedEvent::etSocketConnect )
+					request->host = connect->host;
+					
+					if( !connect->request )
 					{
-						CSocketConnect * c = (CSocketConnect *)e;
-						if( c->socketId == request->socketId )
-						{
-							request->host = c->host;
-							
-							if( !c->request )
-							{
-								c->request = request;
-								request->connect = c;
-							}
-							pos = 0;
-						}
+						connect->request = request;
+						request->connect = connect;
 					}
 				}
 				
 				// add the new request to the list
-				requests.AddHead(request);
+				requests.SetAt(s, request);
 				request->request.Process();
 				AddEvent(request);
 			}
@@ -286,20 +251,9 @@ void CSocketEvents::SocketSend(SOCKET s, DWORD len, LPBYTE buff)
 		}
 		else
 		{
-			// pull it out of the connection list
+			// pull it out of the connection list (will still be in the tracked events)
 			EnterCriticalSection(&cs);
-			POSITION pos = connects.GetHeadPosition();
-			while( pos )
-			{
-				POSITION old = pos;
-				CSocketConnect * c = connects.GetNext(pos);
-				if( c && !c->end && c->s == s)
-				{
-					// remove it from the pending connections list (will still be in the tracked events)
-					connects.RemoveAt(old);
-					pos = 0;
-				}
-			}
+			connects.RemoveKey(s);
 			LeaveCriticalSection(&cs);
 		}
 	}
@@ -330,34 +284,31 @@ void CSocketEvents::SocketRecv(SOCKET s, DWORD len, LPBYTE buff)
 			EnterCriticalSection(&cs);
 			
 			// update the start and end of response on the request object
-			POSITION pos = requests.GetHeadPosition();
-			while( pos )
+			CSocketRequest * r = NULL;
+			requests.Lookup(s, r);
+			if( r )
 			{
-				CSocketRequest * r = requests.GetNext(pos);
-				if( r && r->s == s )
-				{
-					requestSocketIds.SetAt(r->socketId, r);
-					
-					// see if we already recorded time to first byte on the response
-					if( !r->firstByte )
-						r->firstByte = now;
-						
-					// increment the amount of incoming data
-					r->in += len;
-					r->response.AddData(len, buff);
+				requestSocketIds.SetAt(r->socketId, r);
+				
+				// see if we already recorded time to first byte on the response
+				if( !r->firstByte )
+					r->firstByte = now;
 					
-					// update the end time of the linked request
-					if( r->linkedRequest )
-					{
-						r->linkedRequest->Done();
-						r->linkedRequest->in = r->in;
-						lastActivity = now;
-					}
-
-					// update the end time (this can be done multiple times)
-					r->Done();
-					now = r->end;
+				// increment the amount of incoming data
+				r->in += len;
+				r->response.AddData(len, buff);
+				
+				// update the end time of the linked request
+				if( r->linkedRequest )
+				{
+					r->linkedRequest->Done();
+					r->linkedRequest->in = r->in;
+					lastActivity = now;
 				}
+
+				// update the end time (this can be done multiple times)
+				r->Done();
+				now = r->end;
 			}
 			LeaveCriticalSection(&cs);
 			
@@ -427,7 +378,10 @@ void CSocketEvents::SocketConnect(SOCKET s, struct sockaddr_in * addr)
 			}
 		}
 		
-		connects.AddHead(c);
+		connects.SetAt(s, c);
+		CSocketConnect * existing = NULL;
+		if( !socketConnects.Lookup(c->socketId, existing) )
+			socketConnects.SetAt(c->socketId, c);
 		AddEvent(c);
 
 		// link this to the winInet request from the same thread
@@ -461,20 +415,16 @@ void CSocketEvents::SocketConnected(SOCKET s)
 {
     DWORD id = 0;
 		EnterCriticalSection(&cs);
-		POSITION pos = connects.GetHeadPosition();
-		while( pos )
+		CSocketConnect * c = NULL;
+		if( connects.Lookup(s, c) )
 		{
-			POSITION old = pos;
-			CSocketConnect * c = connects.GetNext(pos);
-			if( c && !c->end && c->s == s)
+			// remove it from the pending connections list (will still be in the tracked events)
+			connects.RemoveKey(s);
+			if( c && !c->end )
 			{
 			  id = c->socketId;
 				c->Done();
         UpdateRTT(c);
-				
-				// remove it from the pending connections list (will still be in the tracked events)
-				connects.RemoveAt(old);
-				pos = 0;
 			}
 		}
 		LeaveCriticalSection(&cs);
@@ -31,6 +31,10 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "stdafx.h"
 #include "TrackedEvent.h"
 
+// same cap that wpthook uses for the bodies it keeps
+const DWORD MAX_BODY_TO_RETAIN = 10485760;  // 10MB
+const DWORD MIN_BODY_ALLOC = 16384;
+
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
 void CSocketRequest::Done(void)
@@ -270,12 +274,16 @@ void CWinInetRequest::Decompress(void)
 				{
 					bodyLen = d_stream.total_out;
 					body = (LPBYTE)realloc(body, bodyLen + 1);
+					bodyAlloc = 0;
 					if( body )
 					{
 						// NULL-terminate it for convienience
 						memcpy(body, buff, bodyLen);
 						body[bodyLen] = 0;
+						bodyAlloc = bodyLen + 1;
 					}
+					else
+						bodyLen = 0;
 				}
 				
 				inflateEnd(&d_stream);
@@ -287,6 +295,56 @@ void CWinInetRequest::Decompress(void)
 }
 
 
+/*-----------------------------------------------------------------------------
+	Decide (once per request) if the body is a content type we care about.
+	The content type has to be known before this is called.
+-----------------------------------------------------------------------------*/
+bool CWinInetRequest::ShouldCaptureBody(void)
+{
+	if( captureBody < 0 )
+	{
+		CString mime(response.contentType);
+		mime.MakeLower();
+		if( (mime.Find(_T("text/")) >= 0)
+			|| (mime.Find(_T("javascript")) >= 0)
+			|| (mime.Find(_T("json")) >= 0)
+			|| (mime.Find(_T("image/")) >= 0)
+		  )
+			captureBody = 1;
+		else
+			captureBody = 0;
+	}
+
+	return captureBody == 1;
+}
+
+/*-----------------------------------------------------------------------------
+	Add data to the body, growing the buffer geometrically so large
+	responses that arrive in small reads aren't copied over and over.
+	Like wpthook, stop keeping data once MAX_BODY_TO_RETAIN is reached.
+-----------------------------------------------------------------------------*/
+void CWinInetRequest::AppendBody(LPBYTE data, DWORD len)
+{
+	if( data && len && bodyLen < MAX_BODY_TO_RETAIN )
+	{
+		DWORD needed = bodyLen + len + 1;	// leave room for a NULL terminator
+		if( needed > bodyAlloc )
+		{
+			DWORD size = max(bodyAlloc, MIN_BODY_ALLOC);
+			while( size < needed )
+				size *= 2;
+			LPBYTE newBody = (LPBYTE)realloc(body, size);
+			if( !newBody )
+				return;
+			body = newBody;
+			bodyAlloc = size;
+		}
+		memcpy( &body[bodyLen], data, len );
+		bodyLen += len;
+		body[bodyLen] = 0;	// NULL terminate it in case we're dealing with string data as a convenience
+	}
+}
+
 /*-----------------------------------------------------------------------------
 	Retrieve a specific header field
 -----------------------------------------------------------------------------*/
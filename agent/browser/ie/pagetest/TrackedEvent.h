@@ -211,6 +211,8 @@ public:
 		, tmLoad(0)
 		, body(0)
 		, bodyLen(0)
+		, bodyAlloc(0)
+		, captureBody(-1)
 		, flagged(false)
 		, valid(false)
 		, basePage(false)
@@ -235,6 +237,9 @@ public:
 		,ttl(-1)
 		,closed(0)
 		,fromNet(false)
+		,cacheable(false)
+		,staticContent(false)
+		,hostId(0)
 	{
 		memset(&peer, 0, sizeof(peer));
 
@@ -252,6 +257,8 @@ public:
 	virtual void CrackHeaders(void);
 	virtual void Decompress(void);
   CString GetResponseHeader(CString field);
+	bool ShouldCaptureBody(void);
+	void AppendBody(LPBYTE data, DWORD len);
 	
 	HINTERNET		hRequest;
 	CString			scheme;		// http, https, ftp, etc.
@@ -287,6 +294,8 @@ public:
 	DWORD			tmLoad;			// total load time
 	LPBYTE			body;			// response body
 	DWORD			bodyLen;		// length of the body
+	DWORD			bodyAlloc;		// allocated size of the body buffer
+	int				captureBody;	// -1 = not decided yet, 0 = no, 1 = yes
 	bool			flagged;		// is this connection to a flagged host?
 	bool			valid;			// is it a real request?
 	bool			basePage;		// is this the base page?
@@ -319,6 +328,12 @@ public:
 	DWORD	compressTarget;
 	
 	DWORD	ttl;	// cache time to live
+
+	// attributes shared by the optimization checks (see PrepareChecks)
+	CString	mime;			// lower-case content type
+	bool	cacheable;		// not marked as uncacheable by the response headers
+	bool	staticContent;	// cacheable static content (css, js, images, flash)
+	DWORD	hostId;			// index of the (case-insensitive) host name
 	
 	// header fields
 	CWinInetResponseHeader	response;
@@ -1099,8 +1099,8 @@ void CWinInetEvents::OnDataReceived(HINTERNET hFile, LPVOID buff, DWORD len)
 				w->Done(true);
 			}
 
-			// we only care for certain content types
-			if( w->response.contentType.IsEmpty() )
+			// we only care for certain content types (decided on the first data)
+			if( w->captureBody < 0 && w->response.contentType.IsEmpty() )
 			{
 				TCHAR type[1024];
 				DWORD typeLen = _countof(type);
@@ -1109,25 +1109,9 @@ void CWinInetEvents::OnDataReceived(HINTERNET hFile, LPVOID buff, DWORD len)
 					w->response.contentType = type;
 			}
 
-			CString mime(w->response.contentType);
-			mime.MakeLower();
-			if( (mime.Find(_T("text/")) >= 0)
-				|| (mime.Find(_T("javascript")) >= 0)
-				|| (mime.Find(_T("json")) >= 0)
-				|| (mime.Find(_T("image/")) >= 0)
-			  )
-			{
-				// add the content to our internal buffer
-				DWORD oldLen = w->bodyLen;
-				w->bodyLen += len;
-				DWORD copy = w->bodyLen - oldLen;
-				if( copy )
-				{
-					w->body = (LPBYTE)realloc(w->body, w->bodyLen + 1);
-					memcpy( &w->body[oldLen], buff, copy );
-					w->body[w->bodyLen] = 0;	// NULL terminate it in case we're dealing with string data as a convenience
-				}
-			}
+			// add the content to our internal buffer
+			if( w->ShouldCaptureBody() )
+				w->AppendBody((LPBYTE)buff, len);
 		}
 	}
 }
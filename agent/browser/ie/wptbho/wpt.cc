@@ -1132,11 +1132,17 @@ void Wpt::CheckBrowserState() {
 -----------------------------------------------------------------------------*/
 void Wpt::TaskThread(void) {
   while (!_must_exit) {
+    DWORD start = GetTickCount();
     if (!_active && !_processing_task && _wpt_interface.GetTask(_task)) {
       SendMessage(_message_window, UWM_TASK, 0, 0);
       if (_active)
         Sleep(TASK_INTERVAL);
-    } else
-      Sleep(TASK_INTERVAL);
+    } else {
+      // the task request is held by the hook until there is something to
+      // do so only wait if it came back right away (no test or an error)
+      DWORD elapsed = GetTickCount() - start;
+      if (elapsed < TASK_INTERVAL)
+        Sleep(TASK_INTERVAL - elapsed);
+    }
   }
 }
@@ -2,7 +2,8 @@
 #include "wpt_interface.h"
 #include "wpt_task.h"
 
-const TCHAR * TASK_REQUEST = _T("http://127.0.0.1:8888/task");
+// the hook holds the task request until the next task is ready (long-poll)
+const TCHAR * TASK_REQUEST = _T("http://127.0.0.1:8888/task?wait=5000");
 const TCHAR * EVENT_ON_NAVIGATE = _T("http://127.0.0.1:8888/event/navigate");
 const TCHAR * EVENT_ON_LOAD = _T("http://127.0.0.1:8888/event/load");
 const TCHAR * EVENT_ON_NAVIGATE_ERROR =
@@ -19,12 +20,41 @@ const TCHAR * EVENT_TIMED =
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-WptInterface::WptInterface(void) {
+WptInterface::WptInterface(void):
+  _internet(NULL) {
+  InitializeCriticalSection(&cs);
 }
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
 WptInterface::~WptInterface(void) {
+  if (_internet)
+    InternetCloseHandle(_internet);
+  DeleteCriticalSection(&cs);
+}
+
+/*-----------------------------------------------------------------------------
+  One WinInet session is shared by the task requests and the events so the
+  connections to the hook are kept alive instead of being set up each time
+-----------------------------------------------------------------------------*/
+HINTERNET WptInterface::GetInternet() {
+  EnterCriticalSection(&cs);
+  if (!_internet) {
+    _internet = InternetOpen(_T("WebPagetest BHO"),
+                             INTERNET_OPEN_TYPE_PRECONFIG, NULL, NULL, 0);
+    if (_internet) {
+      DWORD timeout = 30000;
+      InternetSetOption(_internet, INTERNET_OPTION_CONNECT_TIMEOUT,
+                        &timeout, sizeof(timeout));
+      InternetSetOption(_internet, INTERNET_OPTION_RECEIVE_TIMEOUT,
+                        &timeout, sizeof(timeout));
+      InternetSetOption(_internet, INTERNET_OPTION_SEND_TIMEOUT,
+                        &timeout, sizeof(timeout));
+    }
+  }
+  HINTERNET internet = _internet;
+  LeaveCriticalSection(&cs);
+  return internet;
 }
 
 /*-----------------------------------------------------------------------------
@@ -115,22 +145,14 @@ void  WptInterface::ReportUserTiming(CString events){
 bool WptInterface::HttpGet(CString url, CString& response) {
   bool result = false;
   response.Empty();
-  HINTERNET internet = InternetOpen(_T("WebPagetest BHO"), 
-                                    INTERNET_OPEN_TYPE_PRECONFIG,
-                                    NULL, NULL, 0);
+  HINTERNET internet = GetInternet();
   if (internet) {
-    DWORD timeout = 30000;
-    InternetSetOption(internet, INTERNET_OPTION_CONNECT_TIMEOUT,
-                      &timeout, sizeof(timeout));
-    InternetSetOption(internet, INTERNET_OPTION_RECEIVE_TIMEOUT,
-                      &timeout, sizeof(timeout));
-    InternetSetOption(internet, INTERNET_OPTION_SEND_TIMEOUT,
-                      &timeout, sizeof(timeout));
     HINTERNET http_request = InternetOpenUrl(internet, url, NULL, 0, 
                                 INTERNET_FLAG_NO_CACHE_WRITE | 
                                 INTERNET_FLAG_NO_UI | 
                                 INTERNET_FLAG_PRAGMA_NOCACHE | 
-                                INTERNET_FLAG_RELOAD, NULL);
+                                INTERNET_FLAG_RELOAD |
+                                INTERNET_FLAG_KEEP_CONNECTION, NULL);
     if (http_request) {
       char buff[4097];
       DWORD bytes_read;
@@ -143,7 +165,6 @@ bool WptInterface::HttpGet(CString url, CString& response) {
       }
       InternetCloseHandle(http_request);
     }
-    InternetCloseHandle(internet);
   }
 
   if (response.GetLength())
@@ -157,17 +178,8 @@ bool WptInterface::HttpGet(CString url, CString& response) {
 -----------------------------------------------------------------------------*/
 bool WptInterface::HttpPost(CString url, const char * body) {
   bool result = false;
-  HINTERNET internet = InternetOpen(_T("WebPagetest BHO"), 
-                                    INTERNET_OPEN_TYPE_PRECONFIG,
-                                    NULL, NULL, 0);
+  HINTERNET internet = GetInternet();
   if (internet) {
-    DWORD timeout = 30000;
-    InternetSetOption(internet, INTERNET_OPTION_CONNECT_TIMEOUT,
-                      &timeout, sizeof(timeout));
-    InternetSetOption(internet, INTERNET_OPTION_RECEIVE_TIMEOUT,
-                      &timeout, sizeof(timeout));
-    InternetSetOption(internet, INTERNET_OPTION_SEND_TIMEOUT,
-                      &timeout, sizeof(timeout));
     CString host, object;
     unsigned short port;
     DWORD secure_flag;
@@ -194,7 +206,6 @@ bool WptInterface::HttpPost(CString url, const char * body) {
         InternetCloseHandle(connect);
       }
     }
-    InternetCloseHandle(internet);
   }
 
   return result;
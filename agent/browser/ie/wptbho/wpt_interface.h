@@ -19,6 +19,10 @@ public:
   void  ReportUserTiming(CString events);
 
 private:
+  CRITICAL_SECTION  cs;
+  HINTERNET         _internet;
+
+  HINTERNET GetInternet();
   bool HttpGet(CString url, CString& response);
   bool HttpPost(CString url, const char * body = NULL);
   bool CrackUrl(CString url, CString &host, unsigned short &port, 
@@ -26,6 +26,7 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ******************************************************************************/
 
+
 #include "stdafx.h"
 #include "traceroute.h"
 #include <winsock2.h>
@@ -33,6 +34,87 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <iphlpapi.h>
 #include <icmpapi.h>
 
+static const int PROBES_PER_HOP = 3;
+static const int MAX_SEQUENTIAL_FAILURES = 4;
+static const DWORD CLEANUP_TIMEOUT = 1000;
+static const DWORD LOOKUP_TIMEOUT = 5000;   // for all of the reverse lookups
+static const char PROBE_DATA[32] = "Slow? Fast? Dunno.  Let's See.";
+
+// room for the reply, the echoed data, an ICMP error message (8 bytes) and
+// the IO_STATUS_BLOCK that IcmpSendEcho2 keeps in the reply buffer
+static const DWORD REPLY_SIZE = sizeof(ICMP_ECHO_REPLY) + sizeof(PROBE_DATA)
+                                + 8 + 32;
+
+class TraceRouteProbe {
+public:
+  TraceRouteProbe():hop(0),event(NULL),pending(false),replied(false),
+    address(0),status(0),rtt(0){}
+  int     hop;
+  HANDLE  event;
+  bool    pending;
+  bool    replied;
+  ULONG   address;
+  ULONG   status;
+  ULONG   rtt;
+  BYTE    reply[REPLY_SIZE];
+};
+
+class TraceRouteHop {
+public:
+  TraceRouteHop():hop(0),address(0),rtt(0),replies(0){}
+  int       hop;
+  ULONG     address;
+  ULONG     rtt;
+  int       replies;
+  CStringA  rtts;
+};
+
+// shared by the trace and its lookup thread, whichever is done last frees it
+class TraceRouteLookup {
+public:
+  TraceRouteLookup():address(0),thread(NULL),resolved(false),references(1){
+    hostname[0] = 0;
+  }
+  void Release() {
+    if (!InterlockedDecrement(&references))
+      delete this;
+  }
+  ULONG   address;
+  HANDLE  thread;
+  bool    resolved;     // hostname is only valid once the thread has exited
+  volatile LONG references;
+  char    hostname[NI_MAXHOST];
+};
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static unsigned __stdcall ReverseLookupThreadProc(void* arg) {
+  TraceRouteLookup * lookup = (TraceRouteLookup *)arg;
+  if (lookup) {
+    struct sockaddr_in saGNI;
+    memset(&saGNI, 0, sizeof(saGNI));
+    saGNI.sin_family = AF_INET;
+    saGNI.sin_addr.s_addr = lookup->address;
+    saGNI.sin_port = htons(80);
+    getnameinfo((struct sockaddr *) &saGNI, sizeof (struct sockaddr),
+                 lookup->hostname, NI_MAXHOST, NULL,  0, 0);
+    lookup->Release();
+  }
+  return 0;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static void ParseReply(TraceRouteProbe &probe) {
+  if (IcmpParseReplies(probe.reply, REPLY_SIZE)) {
+    ICMP_ECHO_REPLY * reply = (ICMP_ECHO_REPLY *)probe.reply;
+    probe.replied = true;
+    probe.address = reply->Address;
+    probe.status = reply->Status;
+    probe.rtt = reply->RoundTripTime;
+  }
+}
+
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
 CTraceRoute::CTraceRoute(WptTestDriver &test, int maxHops, DWORD timeout):
@@ -47,13 +129,15 @@ CTraceRoute::~CTraceRoute(void) {
 }
 
 /*-----------------------------------------------------------------------------
+  All of the probes (PROBES_PER_HOP for every TTL) are sent at once and the
+  replies collected together so the whole trace takes about one timeout
+  instead of one round trip (or timeout) per hop.  The probes are all
+  identical apart from the TTL so they follow the same path through load
+  balancers that hash on the packet contents.  The reverse DNS for the hops
+  is also resolved in parallel once the replies are in.
 -----------------------------------------------------------------------------*/
 void CTraceRoute::Run() {
-  __int64 freq, start, end;
-  QueryPerformanceFrequency((LARGE_INTEGER *)&freq);
-  freq = freq / 1000;
-
-  CStringA result = "Hop,IP,ms,FQDN\r\n-1,";
+  CStringA result = "Hop,IP,ms,FQDN,Replies,RTTs\r\n-1,";
   CStringA buff;
 
   HANDLE hIcmpFile = IcmpCreateFile();
@@ -71,60 +155,85 @@ void CTraceRoute::Run() {
       aiList[0].ai_addr) {
       ipaddr = ((struct sockaddr_in *)(aiList[0].ai_addr))->sin_addr.s_addr;
     }
+    if (aiList)
+      freeaddrinfo(aiList);
 
-    if (ipaddr) {
+    TraceRouteProbe * probes = NULL;
+    int probe_count = 0;
+    if (ipaddr && _maxHops > 1) {
       in_addr addr;
       addr.s_addr = ipaddr;
       result += CStringA(inet_ntoa(addr)) + CStringA(",0,") + 
                 CStringA(CT2A(_test._url)) + "\r\n";
 
-      char SendData[32] = "Slow? Fast? Dunno.  Let's See.";
-      DWORD ReplySize = sizeof(ICMP_ECHO_REPLY) + sizeof(SendData);
-      ICMP_ECHO_REPLY * reply = (ICMP_ECHO_REPLY *)malloc(ReplySize);
-      IP_OPTION_INFORMATION options;
-      DWORD count = 0;
+      int hops = _maxHops - 1;
+      probe_count = hops * PROBES_PER_HOP;
+      probes = new TraceRouteProbe[probe_count];
+      SendProbes(hIcmpFile, ipaddr, probes, probe_count);
+      CollectReplies(hIcmpFile, probes, probe_count);
+      hIcmpFile = INVALID_HANDLE_VALUE;
 
-      int hop = 1;
-      bool done = false;
+      // build the hop list the same way the serial trace did: stop at the
+      // destination or after a run of silent hops
+      CAtlArray<TraceRouteHop> trace;
+      CAtlArray<TraceRouteLookup *> lookups;
       int sequentialFailures = 0;
-      while (hop < _maxHops && sequentialFailures < 4 && !done) {
-        memset(&options, 0, sizeof(options));
-        options.Ttl = (UCHAR)hop;
-
-        // time the actual ping
-        QueryPerformanceCounter((LARGE_INTEGER *)&start);
-        count = IcmpSendEcho(hIcmpFile, ipaddr, SendData, sizeof(SendData), 
-                              &options, reply, ReplySize, _timeout);
-        QueryPerformanceCounter((LARGE_INTEGER *)&end);
-
-        double elapsed = (double)(end - start) / (double)freq;
-
-        if (count) {
+      bool done = false;
+      for (int hop = 1;
+           hop <= hops && sequentialFailures < MAX_SEQUENTIAL_FAILURES && !done;
+           hop++) {
+        TraceRouteHop entry;
+        entry.hop = hop;
+        for (int i = 0; i < probe_count; i++) {
+          TraceRouteProbe &probe = probes[i];
+          if (probe.hop == hop && probe.replied) {
+            if (!entry.replies || probe.rtt < entry.rtt)
+              entry.rtt = probe.rtt;
+            if (!entry.address || probe.status == IP_SUCCESS)
+              entry.address = probe.address;
+            if (probe.status == IP_SUCCESS)
+              done = true;
+            buff.Format("%s%lu", entry.rtts.IsEmpty() ? "" : " ", probe.rtt);
+            entry.rtts += buff;
+            entry.replies++;
+          }
+        }
+        if (entry.replies) {
           sequentialFailures = 0;
-          if( reply->Status == IP_SUCCESS )
-            done = true;
-
-          // figure out the host name
-          struct sockaddr_in saGNI;
-          char hostname[NI_MAXHOST] = {0};
-          saGNI.sin_family = AF_INET;
-          saGNI.sin_addr.s_addr = reply->Address;
-          saGNI.sin_port = htons(80);
-
-          getnameinfo((struct sockaddr *) &saGNI, sizeof (struct sockaddr),
-                       hostname, NI_MAXHOST, NULL,  0, 0);
-
-          addr.s_addr = reply->Address;
-          buff.Format("%d,%s,%0.3f,%s\r\n", hop, inet_ntoa(addr), elapsed, hostname);
-          result += buff;
+          bool found = false;
+          for (size_t i = 0; i < lookups.GetCount() && !found; i++)
+            if (lookups[i]->address == entry.address)
+              found = true;
+          if (!found) {
+            TraceRouteLookup * lookup = new TraceRouteLookup;
+            lookup->address = entry.address;
+            lookups.Add(lookup);
+          }
         } else {
           sequentialFailures++;
-          
-          buff.Format("%d,,,\r\n", hop);
-          result += buff;
         }
-        hop++;
+        trace.Add(entry);
+      }
+
+      ResolveNames(lookups);
+      for (size_t hop = 0; hop < trace.GetCount(); hop++) {
+        TraceRouteHop &entry = trace[hop];
+        if (entry.replies) {
+          const char * hostname = "";
+          for (size_t i = 0; i < lookups.GetCount(); i++)
+            if (lookups[i]->address == entry.address && lookups[i]->resolved)
+              hostname = lookups[i]->hostname;
+          addr.s_addr = entry.address;
+          buff.Format("%d,%s,%0.3f,%s,%d,%s\r\n", entry.hop, inet_ntoa(addr),
+                      (double)entry.rtt, hostname, entry.replies,
+                      (LPCSTR)entry.rtts);
+        } else {
+          buff.Format("%d,,,,0,\r\n", entry.hop);
+        }
+        result += buff;
       }
+      for (size_t i = 0; i < lookups.GetCount(); i++)
+        lookups[i]->Release();
     }
 
     // save out the result of the traceroute
@@ -138,6 +247,112 @@ void CTraceRoute::Run() {
       }
     }
 
-    IcmpCloseHandle(hIcmpFile);
+    if (hIcmpFile != INVALID_HANDLE_VALUE)
+      IcmpCloseHandle(hIcmpFile);
+    FreeProbes(probes, probe_count);
+  }
+}
+
+/*-----------------------------------------------------------------------------
+  Fire off all of the probes without waiting for any of them.  They go out
+  in rounds (every hop once, then again) so a burst doesn't hit one router
+  with all of its probes back-to-back.
+-----------------------------------------------------------------------------*/
+void CTraceRoute::SendProbes(HANDLE icmp, unsigned long ipaddr,
+                             TraceRouteProbe * probes, int count) {
+  int hops = count / PROBES_PER_HOP;
+  for (int i = 0; i < count; i++) {
+    TraceRouteProbe &probe = probes[i];
+    probe.hop = (i % hops) + 1;
+    probe.event = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (probe.event) {
+      IP_OPTION_INFORMATION options;
+      memset(&options, 0, sizeof(options));
+      options.Ttl = (UCHAR)probe.hop;
+      DWORD replies = IcmpSendEcho2(icmp, probe.event, NULL, NULL, ipaddr,
+                                    (LPVOID)PROBE_DATA, sizeof(PROBE_DATA),
+                                    &options, probe.reply, REPLY_SIZE,
+                                    _timeout);
+      if (replies)
+        ParseReply(probe);
+      else if (GetLastError() == ERROR_IO_PENDING)
+        probe.pending = true;
+    }
+  }
+}
+
+/*-----------------------------------------------------------------------------
+  Wait for the replies.  The ICMP driver times each probe out on its own so
+  this takes one timeout at most.  The ICMP handle is closed here (which
+  cancels anything still outstanding) before the reply buffers are released.
+-----------------------------------------------------------------------------*/
+void CTraceRoute::CollectReplies(HANDLE icmp, TraceRouteProbe * probes,
+                                 int count) {
+  DWORD start = GetTickCount();
+  DWORD limit = _timeout + CLEANUP_TIMEOUT;
+  for (int i = 0; i < count; i++) {
+    TraceRouteProbe &probe = probes[i];
+    if (probe.pending) {
+      DWORD elapsed = GetTickCount() - start;
+      DWORD wait = elapsed < limit ? limit - elapsed : 0;
+      if (WaitForSingleObject(probe.event, wait) == WAIT_OBJECT_0) {
+        probe.pending = false;
+        ParseReply(probe);
+      }
+    }
+  }
+
+  IcmpCloseHandle(icmp);
+  for (int i = 0; i < count; i++) {
+    TraceRouteProbe &probe = probes[i];
+    if (probe.pending &&
+        WaitForSingleObject(probe.event, CLEANUP_TIMEOUT) == WAIT_OBJECT_0)
+      probe.pending = false;
+  }
+}
+
+/*-----------------------------------------------------------------------------
+  Reverse-resolve all of the hop addresses at the same time.  Lookups that
+  take longer than LOOKUP_TIMEOUT (all together) are left running and get
+  an empty hostname, the thread frees the lookup when it finally returns.
+-----------------------------------------------------------------------------*/
+void CTraceRoute::ResolveNames(CAtlArray<TraceRouteLookup *> &lookups) {
+  for (size_t i = 0; i < lookups.GetCount(); i++) {
+    TraceRouteLookup * lookup = lookups[i];
+    InterlockedIncrement(&lookup->references);
+    lookup->thread = (HANDLE)_beginthreadex(0, 0, ::ReverseLookupThreadProc,
+                                            lookup, 0, 0);
+    if (!lookup->thread)
+      InterlockedDecrement(&lookup->references);
+  }
+  DWORD start = GetTickCount();
+  for (size_t i = 0; i < lookups.GetCount(); i++) {
+    TraceRouteLookup * lookup = lookups[i];
+    if (lookup->thread) {
+      DWORD elapsed = GetTickCount() - start;
+      DWORD wait = elapsed < LOOKUP_TIMEOUT ? LOOKUP_TIMEOUT - elapsed : 0;
+      if (WaitForSingleObject(lookup->thread, wait) == WAIT_OBJECT_0)
+        lookup->resolved = true;
+      CloseHandle(lookup->thread);
+      lookup->thread = NULL;
+    }
+  }
+}
+
+/*-----------------------------------------------------------------------------
+  Anything the ICMP driver still hasn't let go of is leaked on purpose
+  since the driver can still write into the reply buffer.
+-----------------------------------------------------------------------------*/
+void CTraceRoute::FreeProbes(TraceRouteProbe * probes, int count) {
+  if (probes) {
+    bool in_use = false;
+    for (int i = 0; i < count; i++) {
+      if (probes[i].pending)
+        in_use = true;
+      else if (probes[i].event)
+        CloseHandle(probes[i].event);
+    }
+    if (!in_use)
+      delete [] probes;
   }
 }
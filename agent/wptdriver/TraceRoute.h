@@ -28,6 +28,9 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #pragma once
 
+class TraceRouteProbe;
+class TraceRouteLookup;
+
 class CTraceRoute {
 public:
   CTraceRoute(WptTestDriver &test, int maxHops = 30, DWORD timeout = 1000);
@@ -35,6 +38,12 @@ public:
   void Run();
 
 private:
+  void SendProbes(HANDLE icmp, unsigned long ipaddr, TraceRouteProbe * probes,
+                  int count);
+  void CollectReplies(HANDLE icmp, TraceRouteProbe * probes, int count);
+  void ResolveNames(CAtlArray<TraceRouteLookup *> &lookups);
+  void FreeProbes(TraceRouteProbe * probes, int count);
+
   WptTestDriver& _test;
   int _maxHops;
   DWORD _timeout;
@@ -0,0 +1,241 @@
+/******************************************************************************
+Copyright (c) 2014, Google Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+    * Neither the name of the <ORGANIZATION> nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+#include "StdAfx.h"
+#include "profile_manager.h"
+#include "util.h"
+
+static const TCHAR * NEXT_PROFILE_SUFFIX = _T(".wpt-next");
+static const TCHAR * TRASH_SUFFIX = _T(".wpt-trash");
+
+// Vista+ background processing mode (low I/O and memory priority)
+#ifndef THREAD_MODE_BACKGROUND_BEGIN
+#define THREAD_MODE_BACKGROUND_BEGIN 0x00010000
+#define THREAD_MODE_BACKGROUND_END   0x00020000
+#endif
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static unsigned __stdcall ProfileManagerThreadProc(void* arg) {
+  ProfileManager * manager = (ProfileManager *)arg;
+  if (manager)
+    manager->BackgroundThread();
+  return 0;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+ProfileManager::ProfileManager(void):
+  thread_(NULL)
+  ,exit_(0)
+  ,prepare_(false)
+  ,prepared_(false) {
+  InitializeCriticalSection(&cs_);
+  InitializeCriticalSection(&prepare_cs_);
+  work_available_ = CreateEvent(NULL, FALSE, FALSE, NULL);
+}
+
+/*-----------------------------------------------------------------------------
+  Anything still queued for deletion is picked up again by the next
+  instance (the trash directories are found by name) and a part-copied
+  next profile is re-copied.
+-----------------------------------------------------------------------------*/
+ProfileManager::~ProfileManager(void) {
+  InterlockedExchange(&exit_, 1);
+  if (thread_) {
+    // the delete/copy in progress checks exit_ between files
+    SetEvent(work_available_);
+    WaitForSingleObject(thread_, INFINITE);
+    CloseHandle(thread_);
+  }
+  CloseHandle(work_available_);
+  DeleteCriticalSection(&prepare_cs_);
+  DeleteCriticalSection(&cs_);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void ProfileManager::Start(void) {
+  if (!thread_)
+    thread_ = (HANDLE)_beginthreadex(0, 0, ::ProfileManagerThreadProc, this,
+                                     0, 0);
+}
+
+/*-----------------------------------------------------------------------------
+  Replace the profile with a pristine copy of the template and get the
+  copy for the next run started in the background.
+-----------------------------------------------------------------------------*/
+void ProfileManager::RestoreProfile(CString template_directory,
+                                    CString profile_directory) {
+  profile_directory.TrimRight(_T("\\"));
+  CString next = profile_directory + NEXT_PROFILE_SUFFIX;
+
+  // wait for a copy that is still in progress
+  EnterCriticalSection(&prepare_cs_);
+  EnterCriticalSection(&cs_);
+  bool ready = prepared_ &&
+               !prepared_template_.CompareNoCase(template_directory) &&
+               !prepared_profile_.CompareNoCase(profile_directory);
+  prepared_ = false;
+  LeaveCriticalSection(&cs_);
+
+  if (!MoveToTrash(profile_directory))
+    DeleteDirectory(profile_directory, false);
+  bool restored = false;
+  if (ready) {
+    restored = MoveFileEx(next, profile_directory, 0) != FALSE;
+    if (!restored)
+      DeleteDirectory(next, true);
+  }
+  if (!restored) {
+    SHCreateDirectoryEx(NULL, profile_directory, NULL);
+    CopyDirectoryTree(template_directory, profile_directory);
+  }
+  LeaveCriticalSection(&prepare_cs_);
+
+  QueueOldTrash(profile_directory);
+  EnterCriticalSection(&cs_);
+  template_directory_ = template_directory;
+  profile_directory_ = profile_directory;
+  prepare_ = true;
+  LeaveCriticalSection(&cs_);
+  Start();
+  SetEvent(work_available_);
+}
+
+/*-----------------------------------------------------------------------------
+  Empty a directory, deleting the old contents in the background
+-----------------------------------------------------------------------------*/
+void ProfileManager::ClearDirectory(CString directory) {
+  if (MoveToTrash(directory)) {
+    SHCreateDirectoryEx(NULL, directory, NULL);
+    Start();
+    SetEvent(work_available_);
+  } else {
+    DeleteDirectory(directory, false);
+  }
+}
+
+/*-----------------------------------------------------------------------------
+  Rename the directory to a unique trash name and queue it for deletion
+-----------------------------------------------------------------------------*/
+bool ProfileManager::MoveToTrash(CString directory) {
+  bool ret = false;
+  directory.TrimRight(_T("\\"));
+  if (!directory.IsEmpty()) {
+    if (GetFileAttributes(directory) == INVALID_FILE_ATTRIBUTES) {
+      ret = true;
+    } else {
+      CString trash;
+      trash.Format(_T("%s%s%u"), (LPCTSTR)directory, TRASH_SUFFIX,
+                   GetTickCount());
+      if (MoveFileEx(directory, trash, 0)) {
+        EnterCriticalSection(&cs_);
+        trash_.AddTail(trash);
+        LeaveCriticalSection(&cs_);
+        ret = true;
+      }
+    }
+  }
+  return ret;
+}
+
+/*-----------------------------------------------------------------------------
+  Pick up trash directories left behind by an earlier instance
+-----------------------------------------------------------------------------*/
+void ProfileManager::QueueOldTrash(CString directory) {
+  directory.TrimRight(_T("\\"));
+  CString parent = directory.Left(directory.ReverseFind(_T('\\')) + 1);
+  WIN32_FIND_DATA fd;
+  HANDLE find = FindFirstFile(directory + TRASH_SUFFIX + _T("*"), &fd);
+  if (find != INVALID_HANDLE_VALUE) {
+    EnterCriticalSection(&cs_);
+    do {
+      if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+        CString trash = parent + fd.cFileName;
+        if (!trash_.Find(trash))
+          trash_.AddTail(trash);
+      }
+    } while (FindNextFile(find, &fd));
+    LeaveCriticalSection(&cs_);
+    FindClose(find);
+  }
+}
+
+/*-----------------------------------------------------------------------------
+  Delete the trash and prepare the next profile at background priority so
+  it stays out of the way of the browser under test.
+-----------------------------------------------------------------------------*/
+void ProfileManager::BackgroundThread(void) {
+  bool background_mode = SetThreadPriority(GetCurrentThread(),
+                                          THREAD_MODE_BACKGROUND_BEGIN) != 0;
+  if (!background_mode)
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_IDLE);
+  while (!exit_) {
+    WaitForSingleObject(work_available_, INFINITE);
+    bool working = true;
+    while (working && !exit_) {
+      working = false;
+      CString trash;
+      EnterCriticalSection(&cs_);
+      if (!trash_.IsEmpty()) {
+        trash = trash_.RemoveHead();
+        working = true;
+      }
+      LeaveCriticalSection(&cs_);
+      if (!trash.IsEmpty()) {
+        DeleteDirectory(trash, true, &exit_);
+      } else {
+        EnterCriticalSection(&prepare_cs_);
+        EnterCriticalSection(&cs_);
+        bool prepare = prepare_;
+        CString template_directory = template_directory_;
+        CString profile_directory = profile_directory_;
+        prepare_ = false;
+        LeaveCriticalSection(&cs_);
+        if (prepare) {
+          CString next = profile_directory + NEXT_PROFILE_SUFFIX;
+          DeleteDirectory(next, true, &exit_);
+          CopyDirectoryTree(template_directory, next, &exit_);
+          if (!exit_) {
+            if (GetFileAttributes(next) == INVALID_FILE_ATTRIBUTES)
+              SHCreateDirectoryEx(NULL, next, NULL);
+            EnterCriticalSection(&cs_);
+            prepared_ = true;
+            prepared_template_ = template_directory;
+            prepared_profile_ = profile_directory;
+            LeaveCriticalSection(&cs_);
+            working = true;
+          }
+        }
+        LeaveCriticalSection(&prepare_cs_);
+      }
+    }
+  }
+  if (background_mode)
+    SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_END);
+}
@@ -0,0 +1,66 @@
+/******************************************************************************
+Copyright (c) 2014, Google Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+    * Neither the name of the <ORGANIZATION> nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+#pragma once
+
+/*-----------------------------------------------------------------------------
+  Keeps browser profile resets off of the critical path between runs.
+
+  A fresh copy of the profile template is prepared in the background while
+  the current run is going so restoring it is just a pair of directory
+  renames.  The old profile (and any other directory being cleared) is
+  renamed out of the way and deleted by the background thread at low
+  (background-mode) I/O priority.  Everything falls back to the synchronous
+  delete/copy if a rename fails (locked files, different volumes, etc).
+-----------------------------------------------------------------------------*/
+class ProfileManager {
+public:
+  ProfileManager(void);
+  ~ProfileManager(void);
+
+  void RestoreProfile(CString template_directory, CString profile_directory);
+  void ClearDirectory(CString directory);
+  void BackgroundThread(void);
+
+private:
+  void Start(void);
+  bool MoveToTrash(CString directory);
+  void QueueOldTrash(CString directory);
+
+  CRITICAL_SECTION  cs_;          // protects the queued work
+  CRITICAL_SECTION  prepare_cs_;  // held while the next profile is copied
+  HANDLE            thread_;
+  HANDLE            work_available_;
+  volatile LONG     exit_;
+  CAtlList<CString> trash_;
+  CString           template_directory_;
+  CString           profile_directory_;
+  bool              prepare_;
+  bool              prepared_;
+  CString           prepared_template_;
+  CString           prepared_profile_;
+};
@@ -0,0 +1,88 @@
+/******************************************************************************
+Copyright (c) 2014, Google Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+    * Neither the name of the <ORGANIZATION> nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+#include "StdAfx.h"
+#include "script_ops.h"
+
+static const struct {
+  const TCHAR * name;
+  ScriptOp      op;
+} SCRIPT_OPS[] = {
+  {_T("navigate"),              SCRIPT_NAVIGATE},
+  {_T("combinesteps"),          SCRIPT_COMBINE_STEPS},
+  {_T("logdata"),               SCRIPT_LOG_DATA},
+  {_T("sleep"),                 SCRIPT_SLEEP},
+  {_T("settimeout"),            SCRIPT_SET_TIMEOUT},
+  {_T("setactivitytimeout"),    SCRIPT_SET_ACTIVITY_TIMEOUT},
+  {_T("setuseragent"),          SCRIPT_SET_USER_AGENT},
+  {_T("addheader"),             SCRIPT_ADD_HEADER},
+  {_T("setheader"),             SCRIPT_SET_HEADER},
+  {_T("resetheaders"),          SCRIPT_RESET_HEADERS},
+  {_T("overridehost"),          SCRIPT_OVERRIDE_HOST},
+  {_T("block"),                 SCRIPT_BLOCK},
+  {_T("setdomelement"),         SCRIPT_SET_DOM_ELEMENT},
+  {_T("addcustomrule"),         SCRIPT_ADD_CUSTOM_RULE},
+  {_T("reportdata"),            SCRIPT_REPORT_DATA},
+  {_T("collectstats"),          SCRIPT_COLLECT_STATS},
+  {_T("checkresponsive"),       SCRIPT_CHECK_RESPONSIVE},
+  {_T("resizeresponsive"),      SCRIPT_RESIZE_RESPONSIVE},
+  {_T("if"),                    SCRIPT_IF},
+  {_T("else"),                  SCRIPT_ELSE},
+  {_T("endif"),                 SCRIPT_ENDIF},
+  {_T("setdns"),                SCRIPT_SET_DNS},
+  {_T("setport"),               SCRIPT_SET_PORT},
+  {_T("setdnsname"),            SCRIPT_SET_DNS_NAME},
+  {_T("setbrowsersize"),        SCRIPT_SET_BROWSER_SIZE},
+  {_T("setviewportsize"),       SCRIPT_SET_VIEWPORT_SIZE},
+  {_T("setdevicescalefactor"),  SCRIPT_SET_DEVICE_SCALE_FACTOR},
+  {_T("firefoxpref"),           SCRIPT_FIREFOX_PREF}
+};
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+ScriptOps::ScriptOps(void) {
+  _ops.InitHashTable(61);
+  for (size_t i = 0; i < _countof(SCRIPT_OPS); i++)
+    _ops.SetAt(SCRIPT_OPS[i].name, SCRIPT_OPS[i].op);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+ScriptOps::~ScriptOps(void) {
+}
+
+/*-----------------------------------------------------------------------------
+  Resolve the command name to the opcode that runs it
+-----------------------------------------------------------------------------*/
+ScriptOp ScriptOps::Lookup(CString command) {
+  ScriptOp op = SCRIPT_BROWSER;
+  command.MakeLower();
+  const CAtlMap<CString, ScriptOp>::CPair * entry = _ops.Lookup(command);
+  if (entry)
+    op = entry->m_value;
+  return op;
+}
@@ -0,0 +1,76 @@
+/******************************************************************************
+Copyright (c) 2014, Google Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+    * Neither the name of the <ORGANIZATION> nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+#pragma once
+
+// Script commands the agent handles itself (everything else is passed
+// through to the browser as SCRIPT_BROWSER)
+enum ScriptOp {
+  SCRIPT_UNKNOWN = 0,
+  SCRIPT_BROWSER,
+  SCRIPT_NAVIGATE,
+  SCRIPT_COMBINE_STEPS,
+  SCRIPT_LOG_DATA,
+  SCRIPT_SLEEP,
+  SCRIPT_SET_TIMEOUT,
+  SCRIPT_SET_ACTIVITY_TIMEOUT,
+  SCRIPT_SET_USER_AGENT,
+  SCRIPT_ADD_HEADER,
+  SCRIPT_SET_HEADER,
+  SCRIPT_RESET_HEADERS,
+  SCRIPT_OVERRIDE_HOST,
+  SCRIPT_BLOCK,
+  SCRIPT_SET_DOM_ELEMENT,
+  SCRIPT_ADD_CUSTOM_RULE,
+  SCRIPT_REPORT_DATA,
+  SCRIPT_COLLECT_STATS,
+  SCRIPT_CHECK_RESPONSIVE,
+  SCRIPT_RESIZE_RESPONSIVE,
+  SCRIPT_IF,
+  SCRIPT_ELSE,
+  SCRIPT_ENDIF,
+  SCRIPT_SET_DNS,
+  SCRIPT_SET_PORT,
+  SCRIPT_SET_DNS_NAME,
+  SCRIPT_SET_BROWSER_SIZE,
+  SCRIPT_SET_VIEWPORT_SIZE,
+  SCRIPT_SET_DEVICE_SCALE_FACTOR,
+  SCRIPT_FIREFOX_PREF
+};
+
+/*-----------------------------------------------------------------------------
+  Script command name to opcode table (command names are case-insensitive)
+-----------------------------------------------------------------------------*/
+class ScriptOps {
+public:
+  ScriptOps(void);
+  ~ScriptOps(void);
+  ScriptOp Lookup(CString command);
+
+private:
+  CAtlMap<CString, ScriptOp> _ops;
+};
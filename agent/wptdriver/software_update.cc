@@ -2,16 +2,73 @@
 #include "software_update.h"
 #include "wpt_status.h"
 #include <Shellapi.h>
+#include <WinInet.h>
 
 static const DWORD SOFTWARE_UPDATE_INTERVAL_MINUTES = 60;  // hourly
+// check in the test loop if the background checks keep getting interrupted
+static const DWORD SOFTWARE_UPDATE_OVERDUE_MINUTES = 240;
+static const DWORD SOFTWARE_UPDATE_POLL = 60000;           // 1 minute
 static const DWORD SOFTWARE_INSTALL_TIMEOUT = 600000;  // 10 minutes
-static const TCHAR * SOFTWARE_REG_ROOT = 
+static const DWORD MAX_CONCURRENT_DOWNLOADS = 4;
+static const int   INSTALLER_CACHE_SECONDS = 7 * 86400;   // a week unused
+static const DWORD HTTP_CONNECT_TIMEOUT = 300000;
+static const DWORD HTTP_RECEIVE_TIMEOUT = 360000;
+static const TCHAR * SOFTWARE_REG_ROOT =
                             _T("Software\\WebPagetest\\wptdriver\\Software");
+static const TCHAR * PARTIAL_DOWNLOAD_SUFFIX = _T(".part");
+
+// Vista+ background processing mode (low I/O and memory priority)
+#ifndef THREAD_MODE_BACKGROUND_BEGIN
+#define THREAD_MODE_BACKGROUND_BEGIN 0x00010000
+#define THREAD_MODE_BACKGROUND_END   0x00020000
+#endif
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static unsigned __stdcall SoftwareUpdateThreadProc(void* arg) {
+  SoftwareUpdate * update = (SoftwareUpdate *)arg;
+  if (update)
+    update->UpdateThread();
+  return 0;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static unsigned __stdcall SoftwareDownloadThreadProc(void* arg) {
+  SoftwareUpdate * update = (SoftwareUpdate *)arg;
+  if (update)
+    update->DownloadThread();
+  return 0;
+}
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
 SoftwareUpdate::SoftwareUpdate(WptStatus &status):
-  _status(status) {
+  _status(status)
+  ,_thread(NULL)
+  ,_exit(false)
+  ,_testing(false)
+  ,_background_check(false)
+  ,_interrupt(false)
+  ,_checked(false)
+  ,_deferred(false)
+  ,_internet(NULL) {
+  InitializeCriticalSection(&_cs);
+  InitializeCriticalSection(&_check_cs);
+  _wake = CreateEvent(NULL, FALSE, FALSE, NULL);
+  _last_update_check.QuadPart = 0;
+  _internet = InternetOpen(_T("WebPagetest Driver"),
+                           INTERNET_OPEN_TYPE_PRECONFIG, NULL, NULL, 0);
+  if (_internet) {
+    DWORD timeout = HTTP_CONNECT_TIMEOUT;
+    DWORD fetch_timeout = HTTP_RECEIVE_TIMEOUT;
+    InternetSetOption(_internet, INTERNET_OPTION_CONNECT_TIMEOUT,
+                      &timeout, sizeof(timeout));
+    InternetSetOption(_internet, INTERNET_OPTION_RECEIVE_TIMEOUT,
+                      &fetch_timeout, sizeof(fetch_timeout));
+    InternetSetOption(_internet, INTERNET_OPTION_SEND_TIMEOUT,
+                      &timeout, sizeof(timeout));
+  }
   // figure out what our working diriectory is
   TCHAR path[MAX_PATH];
   if( SUCCEEDED(SHGetFolderPath(NULL, CSIDL_APPDATA | CSIDL_FLAG_CREATE,
@@ -20,18 +77,39 @@ SoftwareUpdate::SoftwareUpdate(WptStatus &status):
     CreateDirectory(path, NULL);
     lstrcat(path, _T("_data"));
     CreateDirectory(path, NULL);
+    // the installers are kept out of the (emptied) install directory
+    _cache_directory = CString(path) + _T("\\installers");
+    CreateDirectory(_cache_directory, NULL);
     lstrcat(path, _T("\\updates"));
     CreateDirectory(path, NULL);
     _directory = path;
-    _last_update_check.QuadPart = 0;
   }
   QueryPerformanceFrequency(&_perf_frequency_minutes);
   _perf_frequency_minutes.QuadPart = _perf_frequency_minutes.QuadPart * 60;
 }
 
 /*-----------------------------------------------------------------------------
+  Interrupted downloads are resumed by the next instance.  Closing the
+  WinInet session cancels whatever the check and download threads are
+  blocked on so they can be waited for before everything they use goes
+  away.
 -----------------------------------------------------------------------------*/
 SoftwareUpdate::~SoftwareUpdate(void) {
+  EnterCriticalSection(&_cs);
+  _exit = true;
+  _interrupt = true;
+  LeaveCriticalSection(&_cs);
+  if (_internet)
+    InternetCloseHandle(_internet);
+  if (_thread) {
+    SetEvent(_wake);
+    WaitForSingleObject(_thread, INFINITE);
+    CloseHandle(_thread);
+  }
+  _internet = NULL;
+  CloseHandle(_wake);
+  DeleteCriticalSection(&_check_cs);
+  DeleteCriticalSection(&_cs);
 }
 
 /*-----------------------------------------------------------------------------
@@ -39,7 +117,7 @@ SoftwareUpdate::~SoftwareUpdate(void) {
 void SoftwareUpdate::LoadSettings(CString settings_ini) {
   TCHAR sections[10000];
   TCHAR buff[1024];
-  if (GetPrivateProfileString(_T("WebPagetest"), _T("Software"), NULL, 
+  if (GetPrivateProfileString(_T("WebPagetest"), _T("Software"), NULL,
         buff, _countof(buff), settings_ini)) {
     _software_url = buff;
   }
@@ -48,15 +126,15 @@ void SoftwareUpdate::LoadSettings(CString settings_ini) {
   if (SUCCEEDED(SHGetFolderPath(NULL, CSIDL_PROGRAM_FILES,
                                 NULL, SHGFP_TYPE_CURRENT, path)))
     program_files_dir = path;
-  if (GetPrivateProfileSectionNames(sections, _countof(sections), 
+  if (GetPrivateProfileSectionNames(sections, _countof(sections),
       settings_ini)) {
     TCHAR * section = sections;
     while(lstrlen(section)) {
-      if (GetPrivateProfileString(section, _T("Installer"), NULL, buff, 
+      if (GetPrivateProfileString(section, _T("Installer"), NULL, buff,
           _countof(buff), settings_ini)) {
         BrowserInfo info;
         info._installer = buff;
-        if (GetPrivateProfileString(section, _T("exe"), NULL, buff, 
+        if (GetPrivateProfileString(section, _T("exe"), NULL, buff,
             _countof(buff), settings_ini)) {
           info._exe = buff;
           if (program_files_dir.GetLength())
@@ -70,76 +148,135 @@ void SoftwareUpdate::LoadSettings(CString settings_ini) {
 }
 
 /*-----------------------------------------------------------------------------
+  Called from the test loop.  The first call (or a forced one) checks,
+  downloads and installs everything before returning.  After that it only
+  installs what the background checks have already downloaded.
 -----------------------------------------------------------------------------*/
 bool SoftwareUpdate::UpdateSoftware(bool force) {
   bool ok = true;
-  if (force || TimeToCheck()) {
-    ok = UpdateBrowsers();
-    if (ok && _software_url.GetLength()) {
-      CString info = HttpGetText(_software_url);
-      if (info.GetLength()) {
-        CString app, version, command, file_url, md5;
-        int token_position = 0;
-        CString line = info.Tokenize(_T("\r\n"), token_position).Trim();
-        while (ok && token_position >= 0) {
-          if (line.Left(1) == _T('[')) {
-            if (app.GetLength()) {
-              ok = InstallSoftware(app, file_url, md5, version, command, 1, 
-                                    _T(""));
-            }
-            app = line.Trim(_T("[] \t"));
-            version.Empty();
-            command.Empty();
-            file_url.Empty();
-            md5.Empty();
-          } else if (app.GetLength()) {
-            int separator = line.Find(_T('='));
-            if (separator > 0) {
-              CString tag = line.Left(separator).Trim().MakeLower();
-              CString value = line.Mid(separator + 1).Trim();
-              if (tag == _T("url"))
-                file_url = value;
-              else if (tag == _T("md5"))
-                md5 = value;
-              else if (tag == _T("version"))
-                version = value;
-              else if (tag == _T("command"))
-                command = value;
-            }
-          }
-          line = info.Tokenize(_T("\r\n"), token_position).Trim();
-        }
-        if (ok && app.GetLength()) {
-          ok = InstallSoftware(app, file_url, md5, version, command, 1, 
-                                _T(""));
+  if (force || !_checked) {
+    ok = CheckForUpdates(false);
+    if (InstallReady() && ok) {
+      _checked = true;
+      if (!_thread)
+        _thread = (HANDLE)_beginthreadex(0, 0, ::SoftwareUpdateThreadProc,
+                                         this, 0, 0);
+    } else {
+      ok = false;
+    }
+  } else {
+    // agents that test back to back never give the background check a
+    // chance to finish, check here once in a while instead
+    if (_deferred && TimeToCheck(SOFTWARE_UPDATE_OVERDUE_MINUTES)) {
+      WptTrace(loglevel::kWarning,
+        _T("[wptdriver] SoftwareUpdate - background checks overdue\n"));
+      CheckForUpdates(false);
+    }
+    ok = InstallReady();
+  }
+  return ok;
+}
+
+/*-----------------------------------------------------------------------------
+  Pause the background downloads while a test is running (the interrupted
+  downloads are resumed by the next check)
+-----------------------------------------------------------------------------*/
+void SoftwareUpdate::SetTesting(bool testing) {
+  EnterCriticalSection(&_cs);
+  _testing = testing;
+  if (testing && _background_check)
+    _interrupt = true;
+  LeaveCriticalSection(&_cs);
+  if (!testing)
+    SetEvent(_wake);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void SoftwareUpdate::UpdateThread(void) {
+  bool background_mode = SetThreadPriority(GetCurrentThread(),
+                                          THREAD_MODE_BACKGROUND_BEGIN) != 0;
+  if (!background_mode)
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+  while (!_exit) {
+    WaitForSingleObject(_wake, SOFTWARE_UPDATE_POLL);
+    if (!_exit && TimeToCheck(SOFTWARE_UPDATE_INTERVAL_MINUTES)) {
+      if (_testing)
+        _deferred = true;
+      else
+        CheckForUpdates(true);
+    }
+  }
+}
+
+/*-----------------------------------------------------------------------------
+  Check the manifests and download any installers that are needed.  The
+  downloaded packages are queued for InstallReady().  Fails if something
+  that isn't installed at all couldn't be downloaded.
+-----------------------------------------------------------------------------*/
+bool SoftwareUpdate::CheckForUpdates(bool background) {
+  bool ok = false;
+  EnterCriticalSection(&_check_cs);
+  EnterCriticalSection(&_cs);
+  _background_check = background;
+  _interrupt = _exit || (background && _testing);
+  if (_interrupt && !_exit)
+    _deferred = true;
+  LeaveCriticalSection(&_cs);
+  if (!_interrupt) {
+    WptTrace(loglevel::kFunction,
+              _T("[wptdriver] SoftwareUpdate::CheckForUpdates%s\n"),
+              background ? _T(" (background)") : _T(""));
+    CAtlList<SoftwarePackage> packages;
+    GetBrowserUpdates(packages);
+    GetSoftwareUpdates(packages);
+    ok = DownloadPackages(packages);
+
+    EnterCriticalSection(&_cs);
+    POSITION pos = packages.GetHeadPosition();
+    while (pos) {
+      SoftwarePackage& package = packages.GetNext(pos);
+      if (package._installer.GetLength()) {
+        POSITION ready_pos = _ready.GetHeadPosition();
+        while (ready_pos) {
+          POSITION current_pos = ready_pos;
+          if (!_ready.GetNext(ready_pos)._app.CompareNoCase(package._app))
+            _ready.RemoveAt(current_pos);
         }
+        _ready.AddTail(package);
       }
     }
-    if (ok) {
+    // an interrupted check didn't look at (or download) everything
+    if (ok && !_interrupt)
       QueryPerformanceCounter(&_last_update_check);
-    }
+    _deferred = _interrupt && !_exit;
+    _background_check = false;
+    LeaveCriticalSection(&_cs);
+
+    PruneCache();
+    WptTrace(loglevel::kFunction,
+              _T("[wptdriver] SoftwareUpdate::CheckForUpdates complete: %s\n"),
+              ok ? _T("Succeeded") : _T("FAILED!"));
   }
+  LeaveCriticalSection(&_check_cs);
   return ok;
 }
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-bool SoftwareUpdate::UpdateBrowsers(void) {
-  bool ok = true;
-  WptTrace(loglevel::kFunction,
-            _T("[wptdriver] SoftwareUpdate::UpdateBrowsers\n"));
+void SoftwareUpdate::GetBrowserUpdates(CAtlList<SoftwarePackage>& packages) {
   POSITION pos = _browsers.GetHeadPosition();
-  while (ok && pos) {
-    DWORD update = 1;
+  while (pos && !_interrupt) {
     POSITION current_pos = pos;
     BrowserInfo browser_info = _browsers.GetNext(pos);
     CString url = browser_info._installer.Trim();
     if (url.GetLength()) {
       WptTrace(loglevel::kFunction,
                 _T("[wptdriver] Checking browser - %s\n"), (LPCTSTR)url);
-      CString info = HttpGetText(url);
+      CString info = HttpGetText(url, _internet);
       if (info.GetLength()) {
-        CString browser, version, command, file_url, md5;
+        SoftwarePackage package;
+        package._check_file = browser_info._exe;
         int token_position = 0;
         CString line = info.Tokenize(_T("\r\n"), token_position);
         while (token_position >= 0) {
@@ -148,141 +285,357 @@ bool SoftwareUpdate::UpdateBrowsers(void) {
             CString tag = line.Left(separator).Trim().MakeLower();
             CString value = line.Mid(separator + 1).Trim();
             if (tag == _T("browser"))
-              browser = value;
+              package._app = value;
             else if (tag == _T("url"))
-              file_url = value;
+              package._file_url = value;
             else if (tag == _T("md5"))
-              md5 = value;
+              package._md5 = value;
             else if (tag == _T("version"))
-              version = value;
+              package._version = value;
             else if (tag == _T("command"))
-              command = value;
+              package._command = value;
             else if (tag == _T("update"))
-              update = _ttoi(value);
+              package._update = _ttoi(value);
           }
           line = info.Tokenize(_T("\r\n"), token_position);
         }
 
-        ok = InstallSoftware(browser, file_url, md5, version, command, update,
-                              browser_info._exe);
+        if (NeedsInstall(package)) {
+          packages.AddTail(package);
+        } else if (!package._update) {
+          // we don't need to automatically update the browser so
+          // remove it from the list
+          _browsers.RemoveAt(current_pos);
+        }
       }
     }
+  }
+}
 
-    // if we don't need to automatically update the browser then 
-    // remove it from the list
-    if (ok && !update) {
-      _browsers.RemoveAt(current_pos);
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void SoftwareUpdate::GetSoftwareUpdates(CAtlList<SoftwarePackage>& packages) {
+  if (_software_url.GetLength() && !_interrupt) {
+    CString info = HttpGetText(_software_url, _internet);
+    if (info.GetLength()) {
+      SoftwarePackage package;
+      int token_position = 0;
+      CString line = info.Tokenize(_T("\r\n"), token_position).Trim();
+      while (token_position >= 0) {
+        if (line.Left(1) == _T('[')) {
+          if (package._app.GetLength() && NeedsInstall(package))
+            packages.AddTail(package);
+          package = SoftwarePackage();
+          package._app = line.Trim(_T("[] \t"));
+        } else if (package._app.GetLength()) {
+          int separator = line.Find(_T('='));
+          if (separator > 0) {
+            CString tag = line.Left(separator).Trim().MakeLower();
+            CString value = line.Mid(separator + 1).Trim();
+            if (tag == _T("url"))
+              package._file_url = value;
+            else if (tag == _T("md5"))
+              package._md5 = value;
+            else if (tag == _T("version"))
+              package._version = value;
+            else if (tag == _T("command"))
+              package._command = value;
+          }
+        }
+        line = info.Tokenize(_T("\r\n"), token_position).Trim();
+      }
+      if (package._app.GetLength() && NeedsInstall(package))
+        packages.AddTail(package);
     }
   }
-  WptTrace(loglevel::kFunction,
-            _T("[wptdriver] SoftwareUpdate::UpdateBrowsers complete: %s\n"),
-            ok ? _T("Succeeded") : _T("FAILED!"));
-  return ok;
 }
 
 /*-----------------------------------------------------------------------------
-  Download and install the software if necessary
+  See if the package's version is different from what is currently
+  installed (and keep the cached installer for the current one around)
 -----------------------------------------------------------------------------*/
-bool SoftwareUpdate::InstallSoftware(CString app, CString file_url,CString md5,
-          CString version, CString command, DWORD update, CString check_file) {
-  bool ok = true;
-  bool already_installed = false;
-
-  WptTrace(loglevel::kFunction,
-            _T("[wptdriver] SoftwareUpdate::InstallSoftware - %s\n"),
-            (LPCTSTR)app);
-
-  if (app.GetLength() && file_url.GetLength() && version.GetLength() &&
-      command.GetLength() ) {
-    // make sure the version is different from what is currently installed
+bool SoftwareUpdate::NeedsInstall(SoftwarePackage& package) {
+  bool install = false;
+  if (package._app.GetLength() && package._file_url.GetLength() &&
+      package._version.GetLength() && package._command.GetLength()) {
+    install = true;
     HKEY key;
-    if (RegCreateKeyEx(HKEY_CURRENT_USER, SOFTWARE_REG_ROOT, 0, 0, 0, 
-          KEY_READ | KEY_WRITE, 0, &key, 0) == ERROR_SUCCESS) {
-      bool install = true;
+    if (RegCreateKeyEx(HKEY_CURRENT_USER, SOFTWARE_REG_ROOT, 0, 0, 0,
+          KEY_READ, 0, &key, 0) == ERROR_SUCCESS) {
       TCHAR buff[1024];
       DWORD len = sizeof(buff);
-      if (RegQueryValueEx(key, app, 0, 0, (LPBYTE)buff, &len) 
+      if (RegQueryValueEx(key, package._app, 0, 0, (LPBYTE)buff, &len)
           == ERROR_SUCCESS) {
-        already_installed = true;
-        if (!version.Compare(buff) || !update)
+        package._installed = true;
+        if (!package._version.Compare(buff) || !package._update)
           install = false;
       }
+      RegCloseKey(key);
+    }
+    if (!install && package._md5.GetLength()) {
+      // touch the installer so re-installs don't have to download it again
+      HANDLE file = CreateFile(CachedInstaller(package), FILE_WRITE_ATTRIBUTES,
+          FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING, 0, 0);
+      if (file != INVALID_HANDLE_VALUE) {
+        FILETIME ft;
+        GetSystemTimeAsFileTime(&ft);
+        SetFileTime(file, NULL, NULL, &ft);
+        CloseHandle(file);
+      }
+    }
+  }
+  return install;
+}
+
+/*-----------------------------------------------------------------------------
+  Download the installers on parallel threads (packages that share an
+  installer only download it once)
+-----------------------------------------------------------------------------*/
+bool SoftwareUpdate::DownloadPackages(CAtlList<SoftwarePackage>& packages) {
+  bool ok = true;
+  EnterCriticalSection(&_cs);
+  POSITION pos = packages.GetHeadPosition();
+  while (pos) {
+    SoftwarePackage * package = &packages.GetNext(pos);
+    bool duplicate = false;
+    POSITION queued_pos = _downloads.GetHeadPosition();
+    while (queued_pos && !duplicate) {
+      SoftwarePackage * queued = _downloads.GetNext(queued_pos);
+      if (package->_md5.GetLength() &&
+          !package->_md5.CompareNoCase(queued->_md5))
+        duplicate = true;
+    }
+    if (!duplicate)
+      _downloads.AddTail(package);
+  }
+  size_t count = min(_downloads.GetCount(), (size_t)MAX_CONCURRENT_DOWNLOADS);
+  LeaveCriticalSection(&_cs);
+
+  CAtlArray<HANDLE> threads;
+  for (size_t i = 0; i < count; i++) {
+    HANDLE thread = (HANDLE)_beginthreadex(0, 0, ::SoftwareDownloadThreadProc,
+                                           this, 0, 0);
+    if (thread)
+      threads.Add(thread);
+  }
+  for (size_t i = 0; i < threads.GetCount(); i++) {
+    WaitForSingleObject(threads[i], INFINITE);
+    CloseHandle(threads[i]);
+  }
+  EnterCriticalSection(&_cs);
+  _downloads.RemoveAll();
+  LeaveCriticalSection(&_cs);
+
+  // fill in the duplicates and make sure everything we need is there
+  pos = packages.GetHeadPosition();
+  while (pos) {
+    SoftwarePackage& package = packages.GetNext(pos);
+    if (package._installer.IsEmpty() && package._md5.GetLength()) {
+      CString installer = CachedInstaller(package);
+      if (FileExists(installer))
+        package._installer = installer;
+    }
+    if (package._installer.IsEmpty() && !package._installed)
+      ok = false;
+  }
+  return ok;
+}
 
-      // download and install it
-      if (install) {
-        ok = false;
-        DeleteDirectory(_directory, false);
-        int file_pos = file_url.ReverseFind(_T('/'));
-        if (file_pos > 0) {
-          CString file_path = _directory + CString(_T("\\")) 
-                                + file_url.Mid(file_pos + 1);
-          _status.Set(_T("Downloading installer for %s"), (LPCTSTR)app);
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void SoftwareUpdate::DownloadThread(void) {
+  bool working = true;
+  while (working) {
+    SoftwarePackage * package = NULL;
+    EnterCriticalSection(&_cs);
+    if (!_downloads.IsEmpty() && !_interrupt)
+      package = _downloads.RemoveHead();
+    LeaveCriticalSection(&_cs);
+    if (package)
+      DownloadPackage(*package);
+    else
+      working = false;
+  }
+}
+
+/*-----------------------------------------------------------------------------
+  Get the installer into the cache, resuming a previous partial download.
+  Installers without a MD5 can't be verified so they are always downloaded
+  from scratch.
+-----------------------------------------------------------------------------*/
+bool SoftwareUpdate::DownloadPackage(SoftwarePackage& package) {
+  bool ok = false;
+  CString installer = CachedInstaller(package);
+  if (installer.GetLength()) {
+    if (package._md5.GetLength() && FileExists(installer)) {
+      ok = true;
+    } else {
+      CString partial = installer + PARTIAL_DOWNLOAD_SUFFIX;
+      if (package._md5.IsEmpty())
+        DeleteFile(partial);
+      WptTrace(loglevel::kTrace, _T("[wptdriver] Downloading - %s\n"),
+                (LPCTSTR)package._file_url);
+      for (int attempt = 0; attempt < 2 && !ok && !_interrupt; attempt++) {
+        CString hash = HttpDownloadFile(package._file_url, partial,
+                                        &_interrupt, _internet);
+        if (hash.IsEmpty())
+          break;  // keep what we have for the next check
+        if (package._md5.GetLength() && hash.CompareNoCase(package._md5)) {
+          // corrupt, start over
           WptTrace(loglevel::kTrace,
-                    _T("[wptdriver] Downloading - %s\n"), (LPCTSTR)file_url);
-          if (HttpSaveFile(file_url, file_path)) {
-            if (md5.GetLength()) {
-              if (HashFileMD5(file_path) != md5) {
-                install = false;
-              }
-            }
-            if (install) {
-              // run the install command from the download directory
-              SHELLEXECUTEINFO shell_info;
-              memset(&shell_info, 0, sizeof(shell_info));
-              shell_info.cbSize = sizeof(shell_info);
-              shell_info.fMask = SEE_MASK_NOCLOSEPROCESS | SEE_MASK_NOASYNC;
-              TCHAR exe[MAX_PATH];
-              TCHAR parameters[MAX_PATH];
-              int separator = command.Find(_T(' '));
-              if (separator > 0) {
-                lstrcpy(exe, command.Left(separator).Trim());
-                lstrcpy(parameters, command.Mid(separator + 1).Trim());
-                if (lstrlen(parameters)) {
-                  shell_info.lpParameters = parameters;
-                }
-              } else {
-                lstrcpy(exe, command);
-                lstrcpy(parameters, _T(''));
-              }
-              shell_info.lpFile = exe;
-              TCHAR directory[MAX_PATH];
-              lstrcpy(directory, _directory);
-              shell_info.lpDirectory = directory;
-              shell_info.nShow = SW_SHOWNORMAL;
-              _status.Set(_T("Installing %s"), (LPCTSTR)app);
-              WptTrace(loglevel::kTrace,
-                 _T("[wptdriver] Running '%s' with parameters '%s' in '%s'\n"),
-                 exe, parameters, directory);
-              if (ShellExecuteEx(&shell_info) && shell_info.hProcess) {
-                if (WaitForSingleObject(shell_info.hProcess, 
-                      SOFTWARE_INSTALL_TIMEOUT) == WAIT_OBJECT_0) {
-                  ok = true;
-                }
-                CloseHandle(shell_info.hProcess);
-              } else {
-                _status.Set(_T("Error installing %s"), (LPCTSTR)app);
-                WptTrace(loglevel::kTrace,
-                          _T("[wptdriver] Error Running Installer\n"));
-              }
-            } else {
-              _status.Set(_T("Error downloading installer for %s"),
-                          (LPCTSTR)app);
-              WptTrace(loglevel::kTrace,
-                        _T("[wptdriver] File download corrupt\n"));
-            }
-            DeleteFile(file_path);
+                    _T("[wptdriver] File download corrupt\n"));
+          DeleteFile(partial);
+        } else if (MoveFileEx(partial, installer,
+                              MOVEFILE_REPLACE_EXISTING)) {
+          ok = true;
+        }
+      }
+    }
+  }
+  if (ok)
+    package._installer = installer;
+  WptTrace(loglevel::kFunction,
+            _T("[wptdriver] SoftwareUpdate::DownloadPackage %s: %s\n"),
+            (LPCTSTR)package._app, ok ? _T("Succeeded") : _T("FAILED!"));
+  return ok;
+}
+
+/*-----------------------------------------------------------------------------
+  Installers are cached by their MD5 so anything that uses the same file
+  shares it
+-----------------------------------------------------------------------------*/
+CString SoftwareUpdate::CachedInstaller(SoftwarePackage& package) {
+  CString installer;
+  int file_pos = package._file_url.ReverseFind(_T('/'));
+  if (file_pos > 0 && _cache_directory.GetLength()) {
+    if (package._md5.GetLength()) {
+      CString md5 = package._md5;
+      installer = _cache_directory + _T("\\") + md5.MakeUpper();
+    } else {
+      installer = _cache_directory + _T("\\") + package._app + _T("-") +
+                  package._file_url.Mid(file_pos + 1);
+    }
+  }
+  return installer;
+}
+
+/*-----------------------------------------------------------------------------
+  Delete installers (and abandoned partial downloads) that haven't been
+  used in a while
+-----------------------------------------------------------------------------*/
+void SoftwareUpdate::PruneCache(void) {
+  WIN32_FIND_DATA fd;
+  HANDLE find = FindFirstFile(_cache_directory + _T("\\*.*"), &fd);
+  if (find != INVALID_HANDLE_VALUE) {
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    do {
+      if (!(fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) &&
+          ElapsedFileTimeSeconds(fd.ftLastWriteTime, now) >
+          INSTALLER_CACHE_SECONDS)
+        DeleteFile(_cache_directory + _T("\\") + fd.cFileName);
+    } while (FindNextFile(find, &fd));
+    FindClose(find);
+  }
+}
+
+/*-----------------------------------------------------------------------------
+  Install the packages that have been downloaded.  Fails if something that
+  wasn't installed at all failed to install.
+-----------------------------------------------------------------------------*/
+bool SoftwareUpdate::InstallReady(void) {
+  bool ok = true;
+  bool working = true;
+  while (working) {
+    SoftwarePackage package;
+    working = false;
+    EnterCriticalSection(&_cs);
+    if (!_ready.IsEmpty()) {
+      package = _ready.RemoveHead();
+      working = true;
+    }
+    LeaveCriticalSection(&_cs);
+    if (working && !InstallSoftware(package))
+      ok = false;
+  }
+  return ok;
+}
+
+/*-----------------------------------------------------------------------------
+  Install the software from the downloaded installer if necessary
+-----------------------------------------------------------------------------*/
+bool SoftwareUpdate::InstallSoftware(SoftwarePackage& package) {
+  bool ok = true;
+  CString app = package._app;
+
+  WptTrace(loglevel::kFunction,
+            _T("[wptdriver] SoftwareUpdate::InstallSoftware - %s\n"),
+            (LPCTSTR)app);
+
+  // it may have been installed since the package was downloaded
+  if (NeedsInstall(package)) {
+    ok = false;
+    DeleteDirectory(_directory, false);
+    int file_pos = package._file_url.ReverseFind(_T('/'));
+    if (file_pos > 0) {
+      // the install command expects the installer's original name
+      CString file_path = _directory + CString(_T("\\"))
+                            + package._file_url.Mid(file_pos + 1);
+      if (CreateHardLink(file_path, package._installer, NULL) ||
+          CopyFile(package._installer, file_path, FALSE)) {
+        CString command = package._command;
+        // run the install command from the download directory
+        SHELLEXECUTEINFO shell_info;
+        memset(&shell_info, 0, sizeof(shell_info));
+        shell_info.cbSize = sizeof(shell_info);
+        shell_info.fMask = SEE_MASK_NOCLOSEPROCESS | SEE_MASK_NOASYNC;
+        TCHAR exe[MAX_PATH];
+        TCHAR parameters[MAX_PATH];
+        int separator = command.Find(_T(' '));
+        if (separator > 0) {
+          lstrcpy(exe, command.Left(separator).Trim());
+          lstrcpy(parameters, command.Mid(separator + 1).Trim());
+          if (lstrlen(parameters)) {
+            shell_info.lpParameters = parameters;
           }
+        } else {
+          lstrcpy(exe, command);
+          lstrcpy(parameters, _T(''));
         }
-        if (ok) {
-          if (check_file.GetLength())
-            ok = FileExists(check_file);
-          if (ok)
-            RegSetValueEx(key, app, 0, REG_SZ, (const LPBYTE)(LPCTSTR)version, 
-                          (version.GetLength() + 1) * sizeof(TCHAR));
+        shell_info.lpFile = exe;
+        TCHAR directory[MAX_PATH];
+        lstrcpy(directory, _directory);
+        shell_info.lpDirectory = directory;
+        shell_info.nShow = SW_SHOWNORMAL;
+        _status.Set(_T("Installing %s"), (LPCTSTR)app);
+        WptTrace(loglevel::kTrace,
+           _T("[wptdriver] Running '%s' with parameters '%s' in '%s'\n"),
+           exe, parameters, directory);
+        if (ShellExecuteEx(&shell_info) && shell_info.hProcess) {
+          if (WaitForSingleObject(shell_info.hProcess,
+                SOFTWARE_INSTALL_TIMEOUT) == WAIT_OBJECT_0) {
+            ok = true;
+          }
+          CloseHandle(shell_info.hProcess);
+        } else {
+          _status.Set(_T("Error installing %s"), (LPCTSTR)app);
+          WptTrace(loglevel::kTrace,
+                    _T("[wptdriver] Error Running Installer\n"));
         }
+        DeleteFile(file_path);
+      }
+    }
+    if (ok) {
+      if (package._check_file.GetLength())
+        ok = FileExists(package._check_file);
+      HKEY key;
+      if (ok && RegCreateKeyEx(HKEY_CURRENT_USER, SOFTWARE_REG_ROOT, 0, 0, 0,
+            KEY_READ | KEY_WRITE, 0, &key, 0) == ERROR_SUCCESS) {
+        RegSetValueEx(key, app, 0, REG_SZ,
+                      (const LPBYTE)(LPCTSTR)package._version,
+                      (package._version.GetLength() + 1) * sizeof(TCHAR));
+        RegCloseKey(key);
       }
-
-      RegCloseKey(key);
     }
   }
 
@@ -292,30 +645,33 @@ bool SoftwareUpdate::InstallSoftware(CString app, CString file_url,CString md5,
 
   // don't fail if we already have the package installed and we are just doing
   // an update.
-  if (already_installed)
+  if (package._installed)
     ok = true;
 
   return ok;
 }
 
 /*-----------------------------------------------------------------------------
-  See if it is time to check for an update
+  See if it has been the given number of minutes since the last successful
+  check
 -----------------------------------------------------------------------------*/
-bool SoftwareUpdate::TimeToCheck(void) {
+bool SoftwareUpdate::TimeToCheck(DWORD minutes) {
   bool should_check = false;
   LARGE_INTEGER now;
   QueryPerformanceCounter(&now);
 
-  if (!_last_update_check.QuadPart || 
+  EnterCriticalSection(&_cs);
+  if (!_last_update_check.QuadPart ||
     now.QuadPart < _last_update_check.QuadPart) {
     should_check = true;
   } else {
-    DWORD elapsed = (DWORD)((now.QuadPart - _last_update_check.QuadPart) 
+    DWORD elapsed = (DWORD)((now.QuadPart - _last_update_check.QuadPart)
                       / _perf_frequency_minutes.QuadPart);
-    if (elapsed >= SOFTWARE_UPDATE_INTERVAL_MINUTES) {
+    if (elapsed >= minutes) {
       should_check = true;
     }
   }
+  LeaveCriticalSection(&_cs);
 
   return should_check;
 }
@@ -325,7 +681,7 @@ bool SoftwareUpdate::TimeToCheck(void) {
 -----------------------------------------------------------------------------*/
 bool SoftwareUpdate::ReInstallBrowser(CString browser) {
   HKEY key;
-  if (RegCreateKeyEx(HKEY_CURRENT_USER, SOFTWARE_REG_ROOT, 0, 0, 0, 
+  if (RegCreateKeyEx(HKEY_CURRENT_USER, SOFTWARE_REG_ROOT, 0, 0, 0,
         KEY_READ | KEY_WRITE, 0, &key, 0) == ERROR_SUCCESS) {
     RegDeleteValue(key, browser);
     RegCloseKey(key);
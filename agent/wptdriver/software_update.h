@@ -12,11 +12,56 @@ public:
     _exe = src._exe;
     return src;
   }
-  
+
   CString _installer;
   CString _exe;
 };
 
+// one package from an update manifest
+class SoftwarePackage {
+public:
+  SoftwarePackage(void):_update(1),_installed(false){}
+  SoftwarePackage(const SoftwarePackage& src){ *this = src; }
+  ~SoftwarePackage(void){}
+  const SoftwarePackage& operator =(const SoftwarePackage& src) {
+    _app = src._app;
+    _file_url = src._file_url;
+    _md5 = src._md5;
+    _version = src._version;
+    _command = src._command;
+    _check_file = src._check_file;
+    _update = src._update;
+    _installed = src._installed;
+    _installer = src._installer;
+    return src;
+  }
+
+  CString _app;
+  CString _file_url;
+  CString _md5;
+  CString _version;
+  CString _command;
+  CString _check_file;
+  DWORD   _update;
+  bool    _installed;   // some version is already installed
+  CString _installer;   // downloaded installer in the cache
+};
+
+/*-----------------------------------------------------------------------------
+  Keeps the browsers and other software up to date.
+
+  The first check (and any forced re-install) runs in the caller since the
+  software is needed before testing can start.  After that the manifests
+  are checked hourly by a background thread which downloads the installers
+  that changed concurrently.  UpdateSoftware() in the test loop only runs
+  the installers that are already downloaded.  Downloads stop while a test
+  is running (they would share the shaped connection with it) and resume
+  between tests.
+
+  Installers are kept in a cache named by their MD5 so packages that share
+  an installer and re-installs don't download it again.  Downloads are
+  hashed as they stream in and interrupted ones are resumed.
+-----------------------------------------------------------------------------*/
 class SoftwareUpdate
 {
 public:
@@ -25,18 +70,41 @@ public:
   void LoadSettings(CString settings_ini);
   bool UpdateSoftware(bool force = false);
   bool ReInstallBrowser(CString browser);
+  void SetTesting(bool testing);
+  void UpdateThread(void);
+  void DownloadThread(void);
 
 protected:
   CAtlList<BrowserInfo> _browsers;
   CString           _software_url;
   CString           _directory;
+  CString           _cache_directory;
   LARGE_INTEGER     _last_update_check;
   LARGE_INTEGER     _perf_frequency_minutes;
   WptStatus         &_status;
+  CRITICAL_SECTION  _cs;
+  CRITICAL_SECTION  _check_cs;      // held for a whole check and download
+  HANDLE            _thread;
+  HANDLE            _wake;
+  bool              _exit;
+  bool              _testing;
+  bool              _background_check;
+  bool              _interrupt;     // stop the downloads in progress
+  bool              _checked;       // the first check has succeeded
+  bool              _deferred;      // a background check couldn't finish
+  LPVOID            _internet;      // WinInet session for the checks
+  CAtlList<SoftwarePackage>   _ready;       // downloaded, not installed
+  CAtlList<SoftwarePackage *> _downloads;   // queue for the download threads
 
-  bool UpdateBrowsers(void);
-  bool InstallSoftware(CString browser, CString file_url, CString md5,
-           CString version, CString command, DWORD update, CString check_file);
-  bool TimeToCheck(void);
+  bool CheckForUpdates(bool background);
+  void GetBrowserUpdates(CAtlList<SoftwarePackage>& packages);
+  void GetSoftwareUpdates(CAtlList<SoftwarePackage>& packages);
+  bool NeedsInstall(SoftwarePackage& package);
+  bool DownloadPackages(CAtlList<SoftwarePackage>& packages);
+  bool DownloadPackage(SoftwarePackage& package);
+  CString CachedInstaller(SoftwarePackage& package);
+  void PruneCache(void);
+  bool InstallReady(void);
+  bool InstallSoftware(SoftwarePackage& package);
+  bool TimeToCheck(DWORD minutes);
 };
-
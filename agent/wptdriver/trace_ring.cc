@@ -0,0 +1,206 @@
+/******************************************************************************
+Copyright (c) 2014, Google Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+    * Neither the name of the <ORGANIZATION> nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+#include "StdAfx.h"
+#include "trace_ring.h"
+#include <intrin.h>
+
+static const DWORD TRACE_RING_VERSION = 1;
+static const DWORD TRACE_RING_EVENTS = 2048;  // per thread, power of 2
+static const DWORD TRACE_RING_ARGS = 6;
+
+class TraceEvent {
+public:
+  unsigned __int64  counter;
+  LPCTSTR           format;
+  DWORD             level;
+  DWORD_PTR         args[TRACE_RING_ARGS];
+};
+
+class TraceRing {
+public:
+  TraceRing *       next;
+  DWORD             thread_id;
+  volatile LONG     count;   // only ever written by the owning thread
+  TraceEvent        events[TRACE_RING_EVENTS];
+};
+
+int trace_ring_level = 0;
+static DWORD trace_ring_tls = TLS_OUT_OF_INDEXES;
+static TraceRing * volatile trace_rings = NULL;
+static volatile LONG trace_ring_flushing = 0;
+static TCHAR trace_ring_file[MAX_PATH] = {0};
+static unsigned __int64 trace_ring_start_counter = 0;
+static LARGE_INTEGER trace_ring_start_time = {0};
+static LPTOP_LEVEL_EXCEPTION_FILTER trace_ring_previous_filter = NULL;
+static bool trace_ring_filter_installed = false;
+
+/*-----------------------------------------------------------------------------
+  Write out what was recorded before the process goes away
+-----------------------------------------------------------------------------*/
+static LONG WINAPI TraceRingExceptionFilter(EXCEPTION_POINTERS * exception) {
+  TraceRingFlush();
+  LONG ret = EXCEPTION_CONTINUE_SEARCH;
+  if (trace_ring_previous_filter)
+    ret = trace_ring_previous_filter(exception);
+  return ret;
+}
+
+/*-----------------------------------------------------------------------------
+  Start recording the events at or below the given level (the file is
+  where the flushes go)
+-----------------------------------------------------------------------------*/
+void TraceRingEnable(int level, LPCTSTR file) {
+  if (level > 0 && file && lstrlen(file) < MAX_PATH) {
+    if (trace_ring_tls == TLS_OUT_OF_INDEXES)
+      trace_ring_tls = TlsAlloc();
+    if (trace_ring_tls != TLS_OUT_OF_INDEXES) {
+      lstrcpy(trace_ring_file, file);
+      if (!trace_ring_start_counter) {
+        QueryPerformanceCounter(&trace_ring_start_time);
+        trace_ring_start_counter = __rdtsc();
+      }
+      if (!trace_ring_filter_installed) {
+        trace_ring_previous_filter =
+            SetUnhandledExceptionFilter(TraceRingExceptionFilter);
+        trace_ring_filter_installed = true;
+      }
+      trace_ring_level = level;
+    }
+  } else {
+    trace_ring_level = 0;
+  }
+}
+
+/*-----------------------------------------------------------------------------
+  Record an event into the calling thread's ring.  The argument words are
+  copied blindly (they are decoded against the format string later).
+-----------------------------------------------------------------------------*/
+void TraceRingEvent(int level, LPCTSTR format, va_list args) {
+  TraceRing * ring = (TraceRing *)TlsGetValue(trace_ring_tls);
+  if (!ring) {
+    // rings are never freed so the events from exited threads get flushed
+    ring = (TraceRing *)VirtualAlloc(NULL, sizeof(TraceRing),
+                                     MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (ring) {
+      ring->thread_id = GetCurrentThreadId();
+      TraceRing * head;
+      do {
+        head = trace_rings;
+        ring->next = head;
+      } while (InterlockedCompareExchangePointer(
+                  (PVOID volatile *)&trace_rings, ring, head) != head);
+      TlsSetValue(trace_ring_tls, ring);
+    }
+  }
+  if (ring) {
+    TraceEvent& event = ring->events[ring->count & (TRACE_RING_EVENTS - 1)];
+    event.counter = __rdtsc();
+    event.format = format;
+    event.level = (DWORD)level;
+    memcpy(event.args, args, sizeof(event.args));
+    ring->count++;
+  }
+}
+
+/*-----------------------------------------------------------------------------
+  Write all of the rings out.  Threads keep recording while this runs so
+  the newest events in a ring can be torn, everything else is intact.
+-----------------------------------------------------------------------------*/
+bool TraceRingFlush(void) {
+  bool ret = false;
+  if (trace_ring_level && trace_ring_file[0] &&
+      !InterlockedExchange(&trace_ring_flushing, 1)) {
+    // calibrate the counter against the performance counter
+    LARGE_INTEGER now, frequency;
+    QueryPerformanceCounter(&now);
+    QueryPerformanceFrequency(&frequency);
+    unsigned __int64 counter = __rdtsc();
+    double ticks_per_ms = 0;
+    double elapsed_ms = (double)(now.QuadPart - trace_ring_start_time.QuadPart)
+                        * 1000.0 / (double)frequency.QuadPart;
+    if (elapsed_ms > 0)
+      ticks_per_ms = (double)(counter - trace_ring_start_counter) / elapsed_ms;
+
+    // collect the distinct format strings
+    CAtlMap<LPCTSTR, DWORD> formats;
+    CAtlArray<LPCTSTR> format_list;
+    DWORD thread_count = 0;
+    for (TraceRing * ring = trace_rings; ring; ring = ring->next) {
+      thread_count++;
+      DWORD count = min((DWORD)ring->count, TRACE_RING_EVENTS);
+      for (DWORD i = 0; i < count; i++) {
+        LPCTSTR format = ring->events[i].format;
+        if (format && !formats.Lookup(format)) {
+          formats.SetAt(format, (DWORD)format_list.GetCount());
+          format_list.Add(format);
+        }
+      }
+    }
+
+    CStringA data("WPTT");
+    DWORD header[] = {TRACE_RING_VERSION, sizeof(DWORD_PTR), TRACE_RING_ARGS};
+    data.Append((LPCSTR)header, sizeof(header));
+    data.Append((LPCSTR)&ticks_per_ms, sizeof(ticks_per_ms));
+    DWORD value = (DWORD)format_list.GetCount();
+    data.Append((LPCSTR)&value, sizeof(value));
+    for (DWORD id = 0; id < format_list.GetCount(); id++) {
+      CStringA text = (LPCSTR)CT2A(format_list[id], CP_UTF8);
+      data.Append((LPCSTR)&id, sizeof(id));
+      value = text.GetLength();
+      data.Append((LPCSTR)&value, sizeof(value));
+      data += text;
+    }
+    data.Append((LPCSTR)&thread_count, sizeof(thread_count));
+    for (TraceRing * ring = trace_rings; ring; ring = ring->next) {
+      DWORD total = (DWORD)ring->count;
+      DWORD count = min(total, TRACE_RING_EVENTS);
+      data.Append((LPCSTR)&ring->thread_id, sizeof(ring->thread_id));
+      data.Append((LPCSTR)&count, sizeof(count));
+      for (DWORD i = total - count; i != total; i++) {
+        const TraceEvent& event = ring->events[i & (TRACE_RING_EVENTS - 1)];
+        DWORD id = 0;
+        formats.Lookup(event.format, id);
+        data.Append((LPCSTR)&event.counter, sizeof(event.counter));
+        data.Append((LPCSTR)&id, sizeof(id));
+        data.Append((LPCSTR)&event.level, sizeof(event.level));
+        data.Append((LPCSTR)event.args, sizeof(event.args));
+      }
+    }
+
+    HANDLE file = CreateFile(trace_ring_file, GENERIC_WRITE, 0, 0,
+                             CREATE_ALWAYS, 0, 0);
+    if (file != INVALID_HANDLE_VALUE) {
+      DWORD written = 0;
+      ret = WriteFile(file, (LPCSTR)data, data.GetLength(), &written, 0) &&
+            written == (DWORD)data.GetLength();
+      CloseHandle(file);
+    }
+    InterlockedExchange(&trace_ring_flushing, 0);
+  }
+  return ret;
+}
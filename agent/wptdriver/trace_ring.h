@@ -0,0 +1,60 @@
+/******************************************************************************
+Copyright (c) 2014, Google Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+    * Neither the name of the <ORGANIZATION> nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+#pragma once
+
+/*-----------------------------------------------------------------------------
+  Binary trace ring that WptTrace() records into so release agents can
+  trace what they are doing without formatting anything while the test
+  runs.
+
+  Each thread gets its own ring (nothing is shared or locked on the
+  recording path) and an event is just the format string pointer, the
+  time stamp counter, the level and the first few raw argument words.
+  The format string literals are the interned ids: they are only read
+  (and written out once each) when the rings are flushed, either at the
+  end of the test or from the unhandled exception filter on a crash.
+
+  File layout (all little-endian):
+
+    "WPTT" DWORD(version) DWORD(pointer size) DWORD(argument words)
+    double(counter ticks per ms)
+    DWORD(format count) then per format: DWORD(id) DWORD(len) UTF-8 text
+    DWORD(thread count) then per thread: DWORD(thread id) DWORD(events)
+      events (oldest first): unsigned __int64(counter) DWORD(format id)
+                             DWORD(level) pointer-sized argument words
+
+  www/cli/decode_trace.php turns it back into text.  String arguments are
+  recorded as pointers only (they can't be resolved after the fact).
+-----------------------------------------------------------------------------*/
+
+// the recording threshold (0 = off), checked inline by WptTrace()
+extern int trace_ring_level;
+
+void TraceRingEnable(int level, LPCTSTR file);
+void TraceRingEvent(int level, LPCTSTR format, va_list args);
+bool TraceRingFlush(void);
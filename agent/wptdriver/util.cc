@@ -28,6 +28,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "StdAfx.h"
 #include "util.h"
+#include "trace_ring.h"
 #include <Wincrypt.h>
 #include <TlHelp32.h>
 #include "dbghelp/dbghelp.h"
@@ -81,9 +82,11 @@ bool LaunchProcess(CString command_line, HANDLE * process_handle,
 }
 
 /*-----------------------------------------------------------------------------
-  recursively delete the given directory
+  recursively delete the given directory (stopping part-way if the optional
+  cancel flag gets set)
 -----------------------------------------------------------------------------*/
-void DeleteDirectory( LPCTSTR directory, bool remove ) {
+void DeleteDirectory( LPCTSTR directory, bool remove,
+                      const volatile LONG * cancel ) {
   if (lstrlen(directory)) {
     // allocate off of the heap so we don't blow the stack
     TCHAR * path = new TCHAR[MAX_PATH];	
@@ -98,11 +101,11 @@ void DeleteDirectory( LPCTSTR directory, bool remove ) {
           lstrcpy( path, directory );
           PathAppend( path, fd.cFileName );
           if( fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY )
-            DeleteDirectory(path, true);
+            DeleteDirectory(path, true, cancel);
           else
             DeleteFile(path);
         }
-      }while(FindNextFile(hFind, &fd));
+      }while(!(cancel && *cancel) && FindNextFile(hFind, &fd));
       
       FindClose(hFind);
     }
@@ -114,9 +117,11 @@ void DeleteDirectory( LPCTSTR directory, bool remove ) {
 }
 
 /*-----------------------------------------------------------------------------
-  recursively copy a directory and it's files
+  recursively copy a directory and it's files (see DeleteDirectory for the
+  cancel flag)
 -----------------------------------------------------------------------------*/
-void CopyDirectoryTree(CString source, CString destination) {
+void CopyDirectoryTree(CString source, CString destination,
+                       const volatile LONG * cancel) {
   if (source.GetLength() && destination.GetLength()) {
     WIN32_FIND_DATA fd;
     HANDLE hFind = FindFirstFile(source + _T("\\*.*"), &fd);
@@ -127,13 +132,13 @@ void CopyDirectoryTree(CString source, CString destination) {
           CString src = source + CString(_T("\\")) + fd.cFileName;
           CString dest = destination + CString(_T("\\")) + fd.cFileName;
           if( fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) {
-            CopyDirectoryTree(src, dest);
+            CopyDirectoryTree(src, dest, cancel);
           } else {
             CopyFile(src, dest, FALSE);
             SetFileAttributes(dest, FILE_ATTRIBUTE_NORMAL);
           }
         }
-      }while(FindNextFile(hFind, &fd));
+      }while(!(cancel && *cancel) && FindNextFile(hFind, &fd));
       FindClose(hFind);
     }
   }
@@ -245,12 +250,16 @@ bool FindBrowserWindow( DWORD process_id, HWND& frame_window,
 }
 
 /*-----------------------------------------------------------------------------
+  Debug builds format the message for the debugger, release builds only
+  record it into the trace ring (when the debug level asks for it).
 -----------------------------------------------------------------------------*/
 void WptTrace(int level, LPCTSTR format, ...) {
-  #ifdef DEBUG
   va_list args;
   va_start( args, format );
+  if (level <= trace_ring_level)
+    TraceRingEvent(level, format, args);
 
+  #ifdef DEBUG
   int len = _vsctprintf( format, args ) + 1;
   if (len) {
     TCHAR * msg = (TCHAR *)malloc( len * sizeof(TCHAR) );
@@ -265,6 +274,7 @@ void WptTrace(int level, LPCTSTR format, ...) {
     }
   }
   #endif
+  va_end( args );
 }
 
 /*-----------------------------------------------------------------------------
@@ -379,21 +389,27 @@ void TerminateProcessAndChildren(DWORD pid) {
 }
 
 /*-----------------------------------------------------------------------------
-  Fetch an URL and return the response as a string
+  Fetch an URL and return the response as a string.  The request can go
+  through the caller's WinInet session (so the caller can cancel it by
+  closing the session), otherwise one is opened for it.
 -----------------------------------------------------------------------------*/
-CString HttpGetText(CString url) {
+CString HttpGetText(CString url, LPVOID session) {
   CString response;
-  HINTERNET internet = InternetOpen(_T("WebPagetest Driver"), 
-                                    INTERNET_OPEN_TYPE_PRECONFIG,
-                                    NULL, NULL, 0);
+  HINTERNET internet = (HINTERNET)session;
+  if (!internet) {
+    internet = InternetOpen(_T("WebPagetest Driver"), 
+                            INTERNET_OPEN_TYPE_PRECONFIG, NULL, NULL, 0);
+    if (internet) {
+      DWORD timeout = 300000;
+      InternetSetOption(internet, INTERNET_OPTION_CONNECT_TIMEOUT, 
+                        &timeout, sizeof(timeout));
+      InternetSetOption(internet, INTERNET_OPTION_RECEIVE_TIMEOUT, 
+                        &timeout, sizeof(timeout));
+      InternetSetOption(internet, INTERNET_OPTION_SEND_TIMEOUT, 
+                        &timeout, sizeof(timeout));
+    }
+  }
   if (internet) {
-    DWORD timeout = 300000;
-    InternetSetOption(internet, INTERNET_OPTION_CONNECT_TIMEOUT, 
-                      &timeout, sizeof(timeout));
-    InternetSetOption(internet, INTERNET_OPTION_RECEIVE_TIMEOUT, 
-                      &timeout, sizeof(timeout));
-    InternetSetOption(internet, INTERNET_OPTION_SEND_TIMEOUT, 
-                      &timeout, sizeof(timeout));
     HINTERNET http_request = InternetOpenUrl(internet, url, NULL, 0, 
                                 INTERNET_FLAG_NO_CACHE_WRITE | 
                                 INTERNET_FLAG_NO_UI | 
@@ -409,7 +425,8 @@ CString HttpGetText(CString url) {
       }
       InternetCloseHandle(http_request);
     }
-    InternetCloseHandle(internet);
+    if (!session)
+      InternetCloseHandle(internet);
   }
 
   return response;
@@ -465,6 +482,144 @@ DWORD HttpSaveFile(CString url, CString file) {
   return len;
 }
 
+/*-----------------------------------------------------------------------------
+  Format a finished MD5 hash as hex (the same way HashFileMD5 does)
+-----------------------------------------------------------------------------*/
+static CString FormatHashMD5(HCRYPTHASH crypto_hash) {
+  CString hash_result;
+  BYTE hash[16];
+  DWORD len = 16;
+  if (CryptGetHashParam(crypto_hash, HP_HASHVAL, hash, &len, 0)) {
+    for (DWORD i = 0; i < len; i++) {
+      CString hex;
+      hex.Format(_T("%02X"), hash[i]);
+      hash_result += hex;
+    }
+  }
+  return hash_result;
+}
+
+/*-----------------------------------------------------------------------------
+  Fetch an URL to a file and return the MD5 of the complete file (empty if
+  the download failed).  The hash is calculated as the data streams in and
+  whatever a previous, interrupted download left in the file is resumed
+  with a range request.  If the server doesn't honor the range the file is
+  downloaded again from the start.  A failed download leaves the partial
+  file in place for the next attempt.  The session works the same way as
+  for HttpGetText().
+-----------------------------------------------------------------------------*/
+CString HttpDownloadFile(CString url, CString file, const bool * cancel,
+                         LPVOID session) {
+  CString hash_result;
+
+  TCHAR directory[MAX_PATH];
+  lstrcpy(directory, file);
+  *PathFindFileName(directory) = NULL;
+  if (lstrlen(directory) > 3) {
+    SHCreateDirectoryEx(NULL, directory, NULL);
+  }
+
+  HCRYPTPROV crypto = 0;
+  HCRYPTHASH crypto_hash = 0;
+  if (CryptAcquireContext(&crypto, NULL, NULL, PROV_RSA_FULL, 
+                          CRYPT_VERIFYCONTEXT)) {
+    HANDLE file_handle = CreateFile(file, GENERIC_READ | GENERIC_WRITE, 0, 0,
+                                    OPEN_ALWAYS, 0, NULL);
+    if (file_handle != INVALID_HANDLE_VALUE &&
+        CryptCreateHash(crypto, CALG_MD5, 0, 0, &crypto_hash)) {
+      // allocate off of the heap so we don't blow the stack
+      const DWORD buff_size = 65536;
+      BYTE * buff = new BYTE[buff_size];
+      bool ok = true;
+      LONGLONG existing = 0;
+      DWORD bytes = 0;
+      while (ok && ReadFile(file_handle, buff, buff_size, &bytes, 0) && bytes) {
+        ok = CryptHashData(crypto_hash, buff, bytes, 0) != FALSE;
+        existing += bytes;
+      }
+      HINTERNET internet = NULL;
+      if (ok && session) {
+        internet = (HINTERNET)session;
+      } else if (ok) {
+        internet = InternetOpen(_T("WebPagetest Driver"), 
+                                INTERNET_OPEN_TYPE_PRECONFIG, NULL, NULL, 0);
+        if (internet) {
+          DWORD timeout = 300000;
+          DWORD fetch_timeout = 360000;
+          InternetSetOption(internet, INTERNET_OPTION_CONNECT_TIMEOUT, 
+                            &timeout, sizeof(timeout));
+          InternetSetOption(internet, INTERNET_OPTION_RECEIVE_TIMEOUT, 
+                            &fetch_timeout, sizeof(fetch_timeout));
+          InternetSetOption(internet, INTERNET_OPTION_SEND_TIMEOUT, 
+                            &timeout, sizeof(timeout));
+        }
+      }
+      if (internet) {
+        CString headers;
+        if (existing)
+          headers.Format(_T("Range: bytes=%I64d-\r\n"), existing);
+        HINTERNET http_request = InternetOpenUrl(internet, url,
+                                  existing ? (LPCTSTR)headers : NULL,
+                                  headers.GetLength(),
+                                  INTERNET_FLAG_NO_CACHE_WRITE | 
+                                  INTERNET_FLAG_NO_UI | 
+                                  INTERNET_FLAG_PRAGMA_NOCACHE | 
+                                  INTERNET_FLAG_RELOAD, NULL);
+        if (http_request) {
+          // non-http URLs don't have a status code
+          DWORD status = 200;
+          DWORD len = sizeof(status);
+          HttpQueryInfo(http_request,
+                        HTTP_QUERY_STATUS_CODE | HTTP_QUERY_FLAG_NUMBER,
+                        &status, &len, NULL);
+          bool complete = false;
+          if (existing && status == 416) {
+            // nothing left past what we already have
+            complete = true;
+          } else if (status == 200 || status == 206) {
+            if (existing && status != 206) {
+              // the server sent the whole file, start over
+              CryptDestroyHash(crypto_hash);
+              crypto_hash = 0;
+              ok = CryptCreateHash(crypto, CALG_MD5, 0, 0, &crypto_hash) &&
+                   SetFilePointer(file_handle, 0, 0, FILE_BEGIN) == 0 &&
+                   SetEndOfFile(file_handle);
+            }
+            DWORD bytes_written;
+            while (ok) {
+              if (cancel && *cancel) {
+                ok = false;
+              } else if (!InternetReadFile(http_request, buff, buff_size,
+                                           &bytes)) {
+                ok = false;
+              } else if (!bytes) {
+                complete = true;
+                break;
+              } else {
+                ok = WriteFile(file_handle, buff, bytes, &bytes_written, 0) &&
+                     bytes_written == bytes &&
+                     CryptHashData(crypto_hash, buff, bytes, 0);
+              }
+            }
+          }
+          if (ok && complete)
+            hash_result = FormatHashMD5(crypto_hash);
+          InternetCloseHandle(http_request);
+        }
+        if (!session)
+          InternetCloseHandle(internet);
+      }
+      delete [] buff;
+    }
+    if (crypto_hash)
+      CryptDestroyHash(crypto_hash);
+    if (file_handle != INVALID_HANDLE_VALUE)
+      CloseHandle(file_handle);
+    CryptReleaseContext(crypto,0);
+  }
+  return hash_result;
+}
+
 /*-----------------------------------------------------------------------------
   Generate a MD5 hash of the given file
 -----------------------------------------------------------------------------*/
@@ -45,9 +45,11 @@ namespace loglevel {
 
 bool LaunchProcess(CString command_line, HANDLE * process_handle = NULL,
                    const TCHAR *dir = NULL);
-void DeleteDirectory(LPCTSTR directory, bool remove = true);
+void DeleteDirectory(LPCTSTR directory, bool remove = true,
+                     const volatile LONG * cancel = NULL);
 void DeleteRegKey(HKEY hParent, LPCTSTR key, bool remove = true);
-void CopyDirectoryTree(CString source, CString destination);
+void CopyDirectoryTree(CString source, CString destination,
+                       const volatile LONG * cancel = NULL);
 bool FindBrowserWindow(DWORD process_id, HWND& frame_window, 
                        HWND& document_window);
 void WptTrace(int level, LPCTSTR format, ...);
@@ -62,8 +64,10 @@ DWORD GetParentProcessId(DWORD pid);
 void TerminateProcessAndChildren(DWORD pid);
 void TerminateProcessById(DWORD pid);
 bool IsBrowserDocument(HWND wnd, bool recurse = true);
-CString HttpGetText(CString url);
+CString HttpGetText(CString url, LPVOID session = NULL);
 DWORD   HttpSaveFile(CString url, CString file);
+CString HttpDownloadFile(CString url, CString file, const bool * cancel = NULL,
+                         LPVOID session = NULL);
 CString HashFileMD5(CString file);
 bool FileExists(CString file);
 bool  RegexMatch(CStringA str, CStringA regex);
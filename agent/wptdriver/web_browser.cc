@@ -29,6 +29,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "dbghelp/dbghelp.h"
 #include "util.h"
 #include "web_browser.h"
+#include "../wpthook/replay_archive.h"
 
 typedef void(__stdcall * LPINSTALLHOOK)(DWORD thread_id);
 const int PIPE_IN = 1;
@@ -206,6 +207,19 @@ bool WebBrowser::RunAndWait(bool &critical_error) {
       si.dwFlags = STARTF_USEPOSITION | STARTF_USESIZE | STARTF_USESHOWWINDOW;
 
       InstallGlobalHook();
+      // have the hook hand the result files off to us while it runs (the
+      // stream is named for this launch so a browser left over from an
+      // earlier one can't write into it)
+      static LONG result_stream_count = 0;
+      CString result_stream_id;
+      result_stream_id.Format(_T("%d_%d"), GetCurrentProcessId(),
+                              InterlockedIncrement(&result_stream_count));
+      if (hook && _result_stream.Create(&null_dacl, result_stream_id)) {
+        SetResultStream(result_stream_id);
+        _result_stream.StartDrain(_test._directory);
+      } else {
+        SetResultStream(L"");
+      }
       EnterCriticalSection(&cs);
       _browser_process = NULL;
       HANDLE additional_process = NULL;
@@ -334,6 +348,8 @@ bool WebBrowser::RunAndWait(bool &critical_error) {
         CloseHandle(additional_process);
       }
       LeaveCriticalSection(&cs);
+      _result_stream.StopDrain();
+      _result_stream.Close();
       ResetIpfw();
       RemoveGlobalHook();
     } else {
@@ -380,7 +396,15 @@ void WebBrowser::ClearUserData() {
 -----------------------------------------------------------------------------*/
 bool WebBrowser::ConfigureIpfw(WptTestDriver& test) {
   bool ret = false;
-  if (test._bwIn && test._bwOut) {
+  bool shaped = test._bwIn && test._bwOut;
+  test.shape_traffic_ = false;
+  if (shaped && test.replay_mode_ == REPLAY_PLAY) {
+    // the replayed traffic is all on the loopback interface which dummynet
+    // doesn't see so it can only be shaped in the hook
+    if (_settings._browser_shaping)
+      test.shape_traffic_ = true;
+    ret = test.shape_traffic_;
+  } else if (shaped) {
     // split the latency across directions
     DWORD latency = test._latency / 2;
 
@@ -404,9 +428,17 @@ bool WebBrowser::ConfigureIpfw(WptTestDriver& test) {
   else
     ret = true;
 
-  if (!ret) {
+  // the hook shapes by holding the browser's network threads so it is only
+  // used when the agent is explicitly configured for it (browser_shaping)
+  if (!ret && shaped && _settings._browser_shaping) {
+    AtlTrace(_T("[wptdriver] - Error Configuring dummynet, ")
+             _T("shaping in the browser instead"));
+    test.shape_traffic_ = true;
+    ret = true;
+  } else if (!ret) {
     AtlTrace(_T("[wptdriver] - Error Configuring dummynet"));
   }
+  SetShapeTraffic(test.shape_traffic_);
 
   return ret;
 }
@@ -507,7 +539,7 @@ void WebBrowser::ConfigureFirefoxPrefs() {
         POSITION pos = _test._script_commands.GetHeadPosition();
         while (pos) {
           ScriptCommand cmd = _test._script_commands.GetNext(pos);
-          if (!cmd.command.CompareNoCase(_T("firefoxPref")) && 
+          if (cmd.op == SCRIPT_FIREFOX_PREF && 
               cmd.target.GetLength() && cmd.value.GetLength()) {
             CStringA pref;
             pref.Format("user_pref(\"%S\", %S);\r\n", 
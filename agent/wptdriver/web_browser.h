@@ -28,6 +28,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #pragma once
 #include "ipfw.h"
+#include "../wpthook/result_stream.h"
 
 class BrowserSettings;
 
@@ -57,6 +58,7 @@ private:
   CIpfw&          _ipfw;
 
   HANDLE        _browser_process;
+  ResultStream  _result_stream;
 
   CRITICAL_SECTION  cs;
   SECURITY_ATTRIBUTES null_dacl;
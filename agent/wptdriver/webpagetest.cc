@@ -37,6 +37,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "util.h"
 
 static const TCHAR * NO_FILE = _T("");
+static const DWORD FREE_DISK_CHECK_INTERVAL = 60000;
+static const DWORD MAX_POLLING_BACKOFF = 300;
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
@@ -48,8 +50,13 @@ WebPagetest::WebPagetest(WptSettings &settings, WptStatus &status):
   ,_buildNo(0)
   ,_revisionNo(0)
   ,_exit(false)
-  ,has_gpu_(false) {
+  ,has_gpu_(false)
+  ,free_disk_(0)
+  ,free_disk_checked_(0)
+  ,poll_failures_(0)
+  ,poll_was_held_(false) {
   SetErrorMode(SEM_FAILCRITICALERRORS);
+  srand(GetTickCount() ^ GetCurrentProcessId());
   // get the version number of the binary (for software updates)
   TCHAR file[MAX_PATH];
   if (GetModuleFileName(NULL, file, _countof(file))) {
@@ -117,16 +124,36 @@ bool WebPagetest::GetTest(WptTestDriver& test) {
     url += CString(_T("&ec2=")) + _settings._ec2_instance;
   if (_dns_servers.GetLength())
     url += CString(_T("&dns=")) + _dns_servers;
-  ULARGE_INTEGER fd;
-  if (GetDiskFreeSpaceEx(_T("C:\\"), NULL, NULL, &fd)) {
-    double freeDisk = (double)(fd.QuadPart / (1024 * 1024)) / 1024.0;
-    buff.Format(_T("&freedisk=%0.3f"), freeDisk);
+  // the free disk space doesn't change between idle polls
+  DWORD now = GetTickCount();
+  if (!free_disk_checked_ ||
+      now - free_disk_checked_ > FREE_DISK_CHECK_INTERVAL) {
+    ULARGE_INTEGER fd;
+    if (GetDiskFreeSpaceEx(_T("C:\\"), NULL, NULL, &fd)) {
+      free_disk_ = (double)(fd.QuadPart / (1024 * 1024)) / 1024.0;
+      free_disk_checked_ = now;
+    }
+  }
+  if (free_disk_checked_) {
+    buff.Format(_T("&freedisk=%0.3f"), free_disk_);
     url += buff;
   }
   url += has_gpu_ ? _T("&GPU=1") : _T("&GPU=0");
 
+  // let the server hold the request until a job arrives (servers that don't
+  // support it ignore the parameter and answer right away)
+  if (_settings._long_poll) {
+    buff.Format(_T("&wait=%d"), _settings._long_poll);
+    url += buff;
+  }
+
   CString test_string, zip_file;
-  if (HttpGet(url, test, test_string, zip_file)) {
+  DWORD start = GetTickCount();
+  bool responded = HttpGet(url, test, test_string, zip_file);
+  poll_failures_ = responded ? 0 : poll_failures_ + 1;
+  poll_was_held_ = responded && _settings._long_poll &&
+      GetTickCount() - start >= (_settings._long_poll - 1) * SECONDS_TO_MS;
+  if (responded) {
     if (test_string.GetLength()) {
       if (test.Load(test_string)) {
         if (!test._client.IsEmpty())
@@ -142,6 +169,25 @@ bool WebPagetest::GetTest(WptTestDriver& test) {
   return ret;
 }
 
+/*-----------------------------------------------------------------------------
+  How long to wait (in ms) before asking for work again after a poll came
+  back empty.  A long-poll the server held open can be re-issued right away,
+  server errors back off exponentially and everything is jittered so a
+  location full of agents doesn't poll in lock-step.
+-----------------------------------------------------------------------------*/
+DWORD WebPagetest::GetPollingDelay(void) {
+  DWORD delay = _settings._polling_delay;
+  if (poll_failures_) {
+    for (DWORD i = 1; i < poll_failures_ && delay < MAX_POLLING_BACKOFF; i++)
+      delay *= 2;
+    delay = min(delay, MAX_POLLING_BACKOFF);
+  } else if (poll_was_held_) {
+    delay = 1;
+  }
+  delay *= SECONDS_TO_MS;
+  return delay - delay / 4 + (DWORD)rand() % (delay / 2 + 1);
+}
+
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
 bool WebPagetest::DeleteIncrementalResults(WptTestDriver& test) {
@@ -32,6 +32,7 @@ public:
   WebPagetest(WptSettings &settings, WptStatus &status);
   ~WebPagetest(void);
   bool GetTest(WptTestDriver& test);
+  DWORD GetPollingDelay(void);
   bool DeleteIncrementalResults(WptTestDriver& test);
   bool UploadIncrementalResults(WptTestDriver& test);
   bool TestDone(WptTestDriver& test);
@@ -48,6 +49,10 @@ private:
   DWORD         _revisionNo;
   CString       _computer_name;
   CString       _dns_servers;
+  double        free_disk_;
+  DWORD         free_disk_checked_;
+  DWORD         poll_failures_;
+  bool          poll_was_held_;
 
   bool HttpGet(CString url, WptTestDriver& test, CString& test_string, 
                CString& zip_file);
@@ -29,6 +29,9 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "StdAfx.h"
 #include "web_page_replay.h"
 #include "wpt_driver_core.h"
+#include "../wpthook/analysis_cache.h"
+#include "../wpthook/replay_archive.h"
+#include "trace_ring.h"
 #include "zlib/contrib/minizip/unzip.h"
 #include <Wtsapi32.h>
 #include <D3D9.h>
@@ -156,6 +159,7 @@ void WptDriverCore::WorkThread(void) {
     _status.Set(_T("Checking for work..."));
     WptTestDriver test(_settings._timeout * SECONDS_TO_MS, has_gpu_);
     if (_webpagetest.GetTest(test)) {
+      _settings._software_update.SetTesting(true);
       PreTest();
       test._run = test._specific_run ? test._specific_run : 1;
       _status.Set(_T("Starting test..."));
@@ -195,11 +199,16 @@ void WptDriverCore::WorkThread(void) {
         if( !uploaded )
           Sleep(UPLOAD_RETRY_DELAY * SECONDS_TO_MS);
       }
+      // the optimization check results are only shared within the job
+      DeleteDirectory(test._directory + _T("\\") + ANALYSIS_CACHE_DIRECTORY);
+      DeleteDirectory(test._directory + _T("\\") + REPLAY_DIRECTORY);
+      TraceRingFlush();
+      _settings._software_update.SetTesting(false);
       ReleaseMutex(_testing_mutex);
     } else {
       ReleaseMutex(_testing_mutex);
       _status.Set(_T("Waiting for work..."));
-      int delay = _settings._polling_delay * SECONDS_TO_MS;
+      int delay = _webpagetest.GetPollingDelay();
       while (!_exit && delay > 0) {
         Sleep(100);
         delay -= 100;
@@ -408,6 +417,8 @@ void WptDriverCore::FlushDNS(void) {
 
 /*-----------------------------------------------------------------------------
   Set up Web Page Replay (Record the page then start playback for it.)
+  Without a WPR host the agent can record and replay the plain-HTTP
+  responses itself (local_replay in the ini file).
 -----------------------------------------------------------------------------*/
 bool WptDriverCore::SetupWebPageReplay(
     WptTestDriver& test, WebBrowser &browser) {
@@ -425,6 +436,15 @@ bool WptDriverCore::SetupWebPageReplay(
       _status.Set(_T("Web Page Replay Record FAILED"));
       ret = false;
     }
+  } else if (_settings._local_replay) {
+    test.replay_mode_ = REPLAY_RECORD;
+    test._clear_cache = true;
+    ret = BrowserTest(test, browser);
+    if (!test._fv_only) {
+      test._clear_cache = false;
+      ret = BrowserTest(test, browser);
+    }
+    test.replay_mode_ = REPLAY_PLAY;
   }
   return ret;
 }
@@ -29,6 +29,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "StdAfx.h"
 #include "wpt_settings.h"
 #include "wpt_status.h"
+#include "trace_ring.h"
 #include <WinInet.h>
 #include "zlib/contrib/minizip/unzip.h"
 
@@ -40,7 +41,10 @@ WptSettings::WptSettings(WptStatus &status):
   _timeout(DEFAULT_TEST_TIMEOUT)
   ,_startup_delay(DEFAULT_STARTUP_DELAY)
   ,_polling_delay(DEFAULT_POLLING_DELAY)
+  ,_long_poll(DEFAULT_LONG_POLL)
   ,_debug(0)
+  ,_local_replay(false)
+  ,_browser_shaping(false)
   ,_status(status)
   ,_software_update(status) {
 }
@@ -99,10 +103,20 @@ bool WptSettings::Load(void) {
   _debug = GetPrivateProfileInt(_T("WebPagetest"), _T("Debug"),_debug,iniFile);
   #endif
   SetDebugLevel(_debug, logFile);
+  TCHAR traceFile[MAX_PATH];
+  lstrcpy(traceFile, iniFile);
+  lstrcpy( PathFindFileName(traceFile), _T("wptdriver_trace.dat") );
+  TraceRingEnable(_debug, traceFile);
 
   // load the test parameters
   _timeout = GetPrivateProfileInt(_T("WebPagetest"), _T("Time Limit"),
                                   _timeout, iniFile);
+  _polling_delay = GetPrivateProfileInt(_T("WebPagetest"), _T("Polling Delay"),
+                                        _polling_delay, iniFile);
+  if (!_polling_delay)
+    _polling_delay = DEFAULT_POLLING_DELAY;
+  _long_poll = min(GetPrivateProfileInt(_T("WebPagetest"), _T("Long Poll"),
+                                        _long_poll, iniFile), MAX_LONG_POLL);
 
   // load the Web Page Replay host
   if (GetPrivateProfileString(
@@ -110,6 +124,11 @@ bool WptSettings::Load(void) {
       _countof(buff), iniFile )) {
     _web_page_replay_host = buff;
   }
+  _local_replay = GetPrivateProfileInt(_T("WebPagetest"), _T("local_replay"),
+                                       0, iniFile) != 0;
+  _browser_shaping = GetPrivateProfileInt(_T("WebPagetest"),
+                                          _T("browser_shaping"), 0,
+                                          iniFile) != 0;
 
   // see if we need to load settings from EC2 (server and location)
   if (GetPrivateProfileInt(_T("WebPagetest"), _T("ec2"), 0, iniFile)) {
@@ -395,8 +414,7 @@ bool BrowserSettings::Install(CString browser, CString url, CString md5) {
     ret = true;
   } else {
     CString browser_zip = _exe_directory + _T(".zip");
-    if (HttpSaveFile(url, browser_zip) &&
-        !HashFileMD5(browser_zip).CompareNoCase(md5) &&
+    if (!HttpDownloadFile(url, browser_zip).CompareNoCase(md5) &&
         Unzip(browser_zip, (LPCSTR)CT2A(_exe_directory)) &&
         FileExists(_exe))
       ret = true;
@@ -446,13 +464,12 @@ void BrowserSettings::CleanupCustomBrowsers(CString browser) {
 void BrowserSettings::ResetProfile(bool clear_certs) {
   // clear the browser-specific profile directory
   if (_cache_directory.GetLength()) {
-    DeleteDirectory(_cache_directory, false);
+    profile_manager_.ClearDirectory(_cache_directory);
   }
   if (_profile_directory.GetLength() ) {
-    SHCreateDirectoryEx(NULL, _profile_directory, NULL);
-    DeleteDirectory(_profile_directory, false);
-    CopyDirectoryTree(_wpt_directory + CString(_T("\\templates\\"))+_template,
-                      _profile_directory);
+    profile_manager_.RestoreProfile(
+        _wpt_directory + CString(_T("\\templates\\")) + _template,
+        _profile_directory);
   }
 
   // flush the certificate revocation caches
@@ -29,6 +29,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #pragma once
 
 #include "software_update.h"
+#include "profile_manager.h"
 
 // constants
 const DWORD EXIT_TIMEOUT = 120000;
@@ -38,6 +39,8 @@ const DWORD DEFAULT_TEST_TIMEOUT = 120;
 const DWORD DEFAULT_ACTIVITY_TIMEOUT = 2000;
 const DWORD DEFAULT_STARTUP_DELAY = 10;
 const DWORD DEFAULT_POLLING_DELAY = 5;
+const DWORD DEFAULT_LONG_POLL = 30;
+const DWORD MAX_LONG_POLL = 30;
 const DWORD UPLOAD_RETRY_COUNT = 5;
 const DWORD UPLOAD_RETRY_DELAY = 10;
 
@@ -83,6 +86,8 @@ public:
   CString recovery_dir_;
   CString flash_dir_;
   CString webcache_dir_;
+
+  ProfileManager profile_manager_;
 };
 
 // dynamic settings loaded from file
@@ -104,8 +109,11 @@ public:
   DWORD   _timeout;
   DWORD   _startup_delay;
   DWORD   _polling_delay;
+  DWORD   _long_poll;      // seconds the server may hold getwork (0 = off)
   int     _debug;
   CString _web_page_replay_host;
+  bool    _local_replay;   // record/replay in the agent (no WPR host)
+  bool    _browser_shaping; // shape in the hook when dummynet can't be used
   CString _ini_file;
   CString _ec2_instance;
   CString _clients_directory;
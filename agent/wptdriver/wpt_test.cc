@@ -46,6 +46,9 @@ static const DWORD DEFAULT_MOBILE_WIDTH = 540;
 static const DWORD DEFAULT_MOBILE_HEIGHT = 900;
 static const DWORD CHROME_PADDING_HEIGHT = 115;
 static const DWORD CHROME_PADDING_WIDTH = 4;
+static const DWORD DEFAULT_RESOURCE_INTERVAL = 100;
+static const DWORD MIN_RESOURCE_INTERVAL = 10;
+static const DWORD MAX_RESOURCE_INTERVAL = 1000;
 static const char * DEFAULT_MOBILE_USER_AGENT =
     "Mozilla/5.0 (Linux; Android 4.0.4; DROID RAZR "
     "Build/6.7.2-180_DHD-16_M4-31) AppleWebKit/537.36 (KHTML, like Gecko) "
@@ -59,6 +62,8 @@ WptTest::WptTest(void):
   ,_activity_timeout(DEFAULT_ACTIVITY_TIMEOUT)
   ,_measurement_timeout(DEFAULT_TEST_TIMEOUT)
   ,has_gpu_(false)
+  ,shape_traffic_(false)
+  ,replay_mode_(0)
   ,lock_count_(0) {
   QueryPerformanceFrequency(&_perf_frequency);
 
@@ -132,6 +137,7 @@ void WptTest::Reset(void) {
   _image_quality = JPEG_DEFAULT_QUALITY;
   _png_screen_shot = false;
   _minimum_duration = 0;
+  _resource_interval = DEFAULT_RESOURCE_INTERVAL;
   _upload_incremental_results = true;
   _user_agent.Empty();
   _add_headers.RemoveAll();
@@ -246,6 +252,10 @@ bool WptTest::Load(CString& test) {
         else if (!key.CompareNoCase(_T("time")))
           _minimum_duration = MS_IN_SEC * max(_minimum_duration, 
                                min(DEFAULT_TEST_TIMEOUT, _ttoi(value.Trim())));
+        else if (!key.CompareNoCase(_T("resourceInterval")))
+          _resource_interval = max(MIN_RESOURCE_INTERVAL,
+                                   min(MAX_RESOURCE_INTERVAL,
+                                       (DWORD)_ttoi(value.Trim())));
         else if (!key.CompareNoCase(_T("bodies")) && _ttoi(value.Trim()))
           _save_response_bodies = true;
         else if (!key.CompareNoCase(_T("htmlbody")) && _ttoi(value.Trim()))
@@ -265,13 +275,8 @@ bool WptTest::Load(CString& test) {
             if (separator > 0) {
               CString mime = rule.Left(separator).Trim();
               rule = rule.Mid(separator + 1).Trim();
-              if (name.GetLength() && mime.GetLength() && rule.GetLength()) {
-                CustomRule new_rule;
-                new_rule._name = name;
-                new_rule._mime = mime;
-                new_rule._regex = rule;
-                _custom_rules.AddTail(new_rule);
-              }
+              if (name.GetLength() && mime.GetLength() && rule.GetLength())
+                AddCustomRule(name, mime, rule);
             }
           }
         } else if (!key.CompareNoCase(_T("cmdLine")))
@@ -322,11 +327,12 @@ bool WptTest::GetNextTask(CStringA& task, bool& record) {
       bool keep_processing = true;
       while (keep_processing && !_script_commands.IsEmpty()) {
         ScriptCommand command = _script_commands.RemoveHead();
+        if (command.op == SCRIPT_UNKNOWN)
+          CompileCommand(command);
         bool consumed = false;
         keep_processing = ProcessCommand(command, consumed);
         if (!consumed) {
-          FixURL(command);
-          task = EncodeTask(command);
+          task = command.task;
           record = command.record;
           if (record) {
             _active = true;
@@ -419,9 +425,10 @@ void WptTest::BuildScript() {
             script_command.record = NavigationCommand(command);
             script_command.command = command;
             script_command.target = line.Tokenize(_T("\t"),command_pos).Trim();
+            script_command.op = _script_ops.Lookup(command);
             if (!_no_run && command_pos > 0 && 
                 script_command.target.GetLength()) {
-              if (script_command.command == _T("block")) {
+              if (script_command.op == SCRIPT_BLOCK) {
                 ParseBlockCommand(script_command.target, false);
               }
               else {
@@ -431,12 +438,14 @@ void WptTest::BuildScript() {
             }
 
             // Don't process the block commands again
-            if (script_command.command != _T("block")) {
+            if (script_command.op != SCRIPT_BLOCK) {
               if (script_command.record)
                 has_measurement = true;
               
-              if (!PreProcessScriptCommand(script_command))
+              if (!PreProcessScriptCommand(script_command)) {
+                CompileCommand(script_command);
                 _script_commands.AddTail(script_command);
+              }
             }
           }
         }
@@ -454,6 +463,7 @@ void WptTest::BuildScript() {
     command.command = _T("navigate");
     command.target = _url;
     command.record = true;
+    CompileCommand(command);
     _script_commands.AddTail(command);
   }
 
@@ -465,6 +475,7 @@ void WptTest::BuildScript() {
     ScriptCommand command;
     command.command = _T("captureTimeline");
     command.record = false;
+    CompileCommand(command);
     _script_commands.AddHead(command);
   }
 
@@ -472,6 +483,7 @@ void WptTest::BuildScript() {
     ScriptCommand command;
     command.command = _T("captureTrace");
     command.record = false;
+    CompileCommand(command);
     _script_commands.AddHead(command);
   }
 
@@ -479,6 +491,7 @@ void WptTest::BuildScript() {
     ScriptCommand command;
     command.command = _T("noscript");
     command.record = false;
+    CompileCommand(command);
     _script_commands.AddHead(command);
   }
 
@@ -517,6 +530,17 @@ void WptTest::BuildScript() {
   }
 }
 
+/*-----------------------------------------------------------------------------
+  Resolve the opcode and build the task that is sent to the browser once,
+  when the command is queued, instead of for every step
+-----------------------------------------------------------------------------*/
+void WptTest::CompileCommand(ScriptCommand& command) {
+  command.op = _script_ops.Lookup(command.command);
+  ScriptCommand browser_command(command);
+  FixURL(browser_command);
+  command.task = EncodeTask(browser_command);
+}
+
 /*-----------------------------------------------------------------------------
   See if the supplied command is one that initiates a measurement
   (even if that measurement needs to be ignored)
@@ -545,8 +569,7 @@ bool WptTest::NavigationCommand(CString& command) {
   Make sure the URL has a protocol for navigation commands
 -----------------------------------------------------------------------------*/
 void  WptTest::FixURL(ScriptCommand& command) {
-  if (!command.command.CompareNoCase(_T("navigate")) && 
-      command.target.GetLength()) {
+  if (command.op == SCRIPT_NAVIGATE && command.target.GetLength()) {
     if (!command.target.CompareNoCase(_T("about:blank"))) {
       command.target = _T("http://127.0.0.1:8888/blank.html");
     } else if (command.target.Left(4) != _T("http")) {
@@ -565,131 +588,151 @@ bool WptTest::ProcessCommand(ScriptCommand& command, bool &consumed) {
 
   WptTrace(loglevel::kFunction, _T("[wpthook] Processing Command '%s'\n"), 
                                                               command.command);
-  CString cmd = command.command;
-  cmd.MakeLower();
-
-  if (cmd == _T("combinesteps")) {
-    _combine_steps = -1;
-    int count = _ttoi(command.target);
-    if (count > 0)
-      _combine_steps = count;
-  } else if (cmd == _T("logdata")) {
-    if (_ttoi(command.target))
-      _log_data = true;
-    else
-      _log_data = false;
-  } else if (cmd == _T("navigate")) {
-    _navigated_url = command.target;
-    continue_processing = false;
-    consumed = false;
-  } else if (cmd == _T("sleep")) {
-    int seconds = _ttoi(command.target);
-    if (seconds > 0) {
-      QueryPerformanceCounter(&_sleep_end);
-      _sleep_end.QuadPart += seconds * _perf_frequency.QuadPart;
+  switch (command.op) {
+    case SCRIPT_COMBINE_STEPS: {
+        _combine_steps = -1;
+        int count = _ttoi(command.target);
+        if (count > 0)
+          _combine_steps = count;
+      }
+      break;
+    case SCRIPT_LOG_DATA:
+      if (_ttoi(command.target))
+        _log_data = true;
+      else
+        _log_data = false;
+      break;
+    case SCRIPT_NAVIGATE:
+      _navigated_url = command.target;
       continue_processing = false;
-    }
-  } else if (cmd == _T("settimeout")) {
-    int seconds = _ttoi(command.target);
-    if (seconds > 0 && seconds < 600)
-      _measurement_timeout = seconds * 1000;
-  } else if (cmd == _T("setactivitytimeout")) {
-    _activity_timeout = __min(__max(_ttoi(command.target), 0), 30000);
-  } else if (cmd == _T("setuseragent")) {
-    _user_agent = CT2A(command.target);
-  } else if (cmd == _T("addheader")) {
-    int pos = command.target.Find(_T(':'));
-    if (pos > 0) {
-      CStringA tag = CT2A(command.target.Left(pos).Trim());
-      CStringA value = CT2A(command.target.Mid(pos + 1).Trim());
-      HttpHeaderValue header(tag, value, (LPCSTR)CT2A(command.value.Trim()));
-      _add_headers.AddTail(header);
-    }
-    continue_processing = false;
-    consumed = false;
-  } else if (cmd == _T("setheader")) {
-    int pos = command.target.Find(_T(':'));
-    if (pos > 0) {
-      CStringA tag = CT2A(command.target.Left(pos).Trim());
-      CStringA value = CT2A(command.target.Mid(pos + 1).Trim());
-      CStringA filter = CT2A(command.value.Trim());
-      bool repeat = false;
-      if (!_set_headers.IsEmpty()) {
-        POSITION pos = _set_headers.GetHeadPosition();
-        while (pos && !repeat) {
-          HttpHeaderValue &header = _set_headers.GetNext(pos);
-          if (!header._tag.CompareNoCase(tag) &&
-              header._filter == filter) {
-            repeat = true;
-            header._value = value;
-          }
+      consumed = false;
+      break;
+    case SCRIPT_SLEEP: {
+        int seconds = _ttoi(command.target);
+        if (seconds > 0) {
+          QueryPerformanceCounter(&_sleep_end);
+          _sleep_end.QuadPart += seconds * _perf_frequency.QuadPart;
+          continue_processing = false;
         }
       }
-      if (!repeat) {
-        HttpHeaderValue header(tag, value, filter);
-        _set_headers.AddTail(header);
+      break;
+    case SCRIPT_SET_TIMEOUT: {
+        int seconds = _ttoi(command.target);
+        if (seconds > 0 && seconds < 600)
+          _measurement_timeout = seconds * 1000;
       }
-    }
-    continue_processing = false;
-    consumed = false;
-  } else if (cmd == _T("resetheaders")) {
-    _add_headers.RemoveAll();
-    _set_headers.RemoveAll();
-    continue_processing = false;
-    consumed = false;
-  } else if (cmd == _T("overridehost")) {
-    CStringA host = CT2A(command.target.Trim());
-    CStringA new_host = CT2A(command.value.Trim());
-    if (host.GetLength() && new_host.GetLength()) {
-      POSITION pos = _override_hosts.GetHeadPosition();
-      bool duplicate = false;
-      while (pos && !duplicate) {
-        HttpHeaderValue &existing = _override_hosts.GetNext(pos);
-        if (!existing._tag.CompareNoCase(host)) {
-          duplicate = true;
+      break;
+    case SCRIPT_SET_ACTIVITY_TIMEOUT:
+      _activity_timeout = __min(__max(_ttoi(command.target), 0), 30000);
+      break;
+    case SCRIPT_SET_USER_AGENT:
+      _user_agent = CT2A(command.target);
+      break;
+    case SCRIPT_ADD_HEADER: {
+        int pos = command.target.Find(_T(':'));
+        if (pos > 0) {
+          CStringA tag = CT2A(command.target.Left(pos).Trim());
+          CStringA value = CT2A(command.target.Mid(pos + 1).Trim());
+          HttpHeaderValue header(tag, value,
+                                 (LPCSTR)CT2A(command.value.Trim()));
+          _add_headers.AddTail(header);
         }
+        continue_processing = false;
+        consumed = false;
       }
-      if (!duplicate) {
-        HttpHeaderValue host_override(host, new_host, "");
-        _override_hosts.AddTail(host_override);
+      break;
+    case SCRIPT_SET_HEADER: {
+        int pos = command.target.Find(_T(':'));
+        if (pos > 0) {
+          CStringA tag = CT2A(command.target.Left(pos).Trim());
+          CStringA value = CT2A(command.target.Mid(pos + 1).Trim());
+          CStringA filter = CT2A(command.value.Trim());
+          bool repeat = false;
+          if (!_set_headers.IsEmpty()) {
+            POSITION pos = _set_headers.GetHeadPosition();
+            while (pos && !repeat) {
+              HttpHeaderValue &header = _set_headers.GetNext(pos);
+              if (!header._tag.CompareNoCase(tag) &&
+                  header._filter == filter) {
+                repeat = true;
+                header._value = value;
+              }
+            }
+          }
+          if (!repeat) {
+            HttpHeaderValue header(tag, value, filter);
+            _set_headers.AddTail(header);
+          }
+        }
+        continue_processing = false;
+        consumed = false;
       }
-    }
-    // pass the host override command on to the browser extension as well
-    // (needed for SSL override on Chrome)
-    // include a bail-out if we have more than 3 hosts in the list
-    // because we were causing aborts to Chrome's navigations with long lists
-    if (_override_hosts.GetCount() <= 3) {
+      break;
+    case SCRIPT_RESET_HEADERS:
+      _add_headers.RemoveAll();
+      _set_headers.RemoveAll();
       continue_processing = false;
       consumed = false;
-    }
-  } else if (cmd == _T("block")) {
-    _block_requests.AddTail(command.target);
-    continue_processing = false;
-    consumed = false;
-  } else if (cmd == _T("setdomelement")) {
-    if (command.target.Trim().GetLength()) {
-      _dom_element_check = true;
-      WptTrace(loglevel::kFrequentEvent, 
-        _T("[wpthook] - WptTest::BuildScript() Setting dom element check."));
-    }
-    continue_processing = false;
-    consumed = false;
-  } else if(cmd == _T("addcustomrule")) {
-    int separator = command.target.Find(_T('='));
-    if (separator > 0)  {
-      CustomRule new_rule;
-      new_rule._name = command.target.Left(separator).Trim();
-      new_rule._mime = command.target.Mid(separator + 1).Trim();
-      new_rule._regex = command.value.Trim();
-      _custom_rules.AddTail(new_rule);
-    }
-  } else if(cmd == _T("reportdata")) {
-    ReportData();
-    continue_processing = false;
-    consumed = false;
-  } else {
-    continue_processing = false;
-    consumed = false;
+      break;
+    case SCRIPT_OVERRIDE_HOST: {
+        CStringA host = CT2A(command.target.Trim());
+        CStringA new_host = CT2A(command.value.Trim());
+        if (host.GetLength() && new_host.GetLength()) {
+          POSITION pos = _override_hosts.GetHeadPosition();
+          bool duplicate = false;
+          while (pos && !duplicate) {
+            HttpHeaderValue &existing = _override_hosts.GetNext(pos);
+            if (!existing._tag.CompareNoCase(host)) {
+              duplicate = true;
+            }
+          }
+          if (!duplicate) {
+            HttpHeaderValue host_override(host, new_host, "");
+            _override_hosts.AddTail(host_override);
+          }
+        }
+        // pass the host override command on to the browser extension as well
+        // (needed for SSL override on Chrome)
+        // include a bail-out if we have more than 3 hosts in the list
+        // because we were causing aborts to Chrome's navigations with long
+        // lists
+        if (_override_hosts.GetCount() <= 3) {
+          continue_processing = false;
+          consumed = false;
+        }
+      }
+      break;
+    case SCRIPT_BLOCK:
+      _block_requests.AddTail(command.target);
+      continue_processing = false;
+      consumed = false;
+      break;
+    case SCRIPT_SET_DOM_ELEMENT:
+      if (command.target.Trim().GetLength()) {
+        _dom_element_check = true;
+        WptTrace(loglevel::kFrequentEvent, 
+          _T("[wpthook] - WptTest::BuildScript() Setting dom element check."));
+      }
+      continue_processing = false;
+      consumed = false;
+      break;
+    case SCRIPT_ADD_CUSTOM_RULE: {
+        int separator = command.target.Find(_T('='));
+        if (separator > 0)
+          AddCustomRule(command.target.Left(separator).Trim(),
+                        command.target.Mid(separator + 1).Trim(),
+                        command.value.Trim());
+      }
+      break;
+    case SCRIPT_REPORT_DATA:
+      ReportData();
+      continue_processing = false;
+      consumed = false;
+      break;
+    default:
+      continue_processing = false;
+      consumed = false;
+      break;
   }
 
   return continue_processing;
@@ -702,68 +745,82 @@ bool WptTest::ProcessCommand(ScriptCommand& command, bool &consumed) {
 bool WptTest::PreProcessScriptCommand(ScriptCommand& command) {
   bool processed = true;
 
-  CString cmd = command.command;
-  cmd.MakeLower();
-
   if (_no_run > 0) {
-    if (cmd == _T("if")) {
+    if (command.op == SCRIPT_IF) {
       _no_run++;
-    } else if (cmd == _T("else")) {
+    } else if (command.op == SCRIPT_ELSE) {
       if (_no_run == 1) {
         _no_run = 0;
       }
-    } else if (cmd == _T("endif")) {
+    } else if (command.op == SCRIPT_ENDIF) {
       _no_run = max(0, _no_run - 1);
     }
   } else {
-    if (cmd == _T("if")) {
-      if (!ConditionMatches(command)) {
+    switch (command.op) {
+      case SCRIPT_IF:
+        if (!ConditionMatches(command)) {
+          _no_run = 1;
+        }
+        break;
+      case SCRIPT_ELSE:
         _no_run = 1;
-      }
-    } else if (cmd == _T("else")) {
-      _no_run = 1;
-    } else if (cmd == _T("endif")) {
-    } else if (cmd == _T("setdns")) {
-      CDNSEntry entry(command.target, command.value);
-      _dns_override.AddTail(entry);
-    } else if (cmd == _T("setport")) {
-      USHORT original = (USHORT)_ttoi(command.target);
-      USHORT replacement = (USHORT)_ttoi(command.value);
-      if (original && replacement)
-        _tcp_port_override.SetAt(original, replacement);
-    } else if (cmd == _T("setdnsname")) {
-      CDNSName entry(command.target, command.value);
-      if (entry.name.GetLength() && entry.realName.GetLength())
-        _dns_name_override.AddTail(entry);
-    } else if (cmd == _T("setbrowsersize")) {
-      int width = _ttoi(command.target);
-      int height = _ttoi(command.value);
-      if (width > 0 && height > 0) {
-        _browser_width = (DWORD)width;
-        _browser_height = (DWORD)height;
-      }
-    } else if (cmd == _T("setviewportsize")) {
-      int width = _ttoi(command.target);
-      int height = _ttoi(command.value);
-      if (width > 0 && height > 0) {
-        _viewport_width = (DWORD)width;
-        _viewport_height = (DWORD)height;
-      }
-    } else if (cmd == _T("setdevicescalefactor")) {
-      _device_scale_factor = _T("");
-      for (int i = 0; i < command.target.GetLength(); i++) {
-        TCHAR ch = command.target.GetAt(i);
-        if (ch == _T('0') || ch == _T('1') || ch == _T('2') || ch == _T('3') ||
-            ch == _T('4') || ch == _T('5') || ch == _T('6') || ch == _T('7') ||
-            ch == _T('8') || ch == _T('9') || ch == _T('.'))
-          _device_scale_factor += ch;
-        else
-          break;
-      }
-      if (!_device_scale_factor.GetLength())
-        _device_scale_factor.Empty();
-    } else {
-      processed = false;
+        break;
+      case SCRIPT_ENDIF:
+        break;
+      case SCRIPT_SET_DNS: {
+          CDNSEntry entry(command.target, command.value);
+          _dns_override.AddTail(entry);
+        }
+        break;
+      case SCRIPT_SET_PORT: {
+          USHORT original = (USHORT)_ttoi(command.target);
+          USHORT replacement = (USHORT)_ttoi(command.value);
+          if (original && replacement)
+            _tcp_port_override.SetAt(original, replacement);
+        }
+        break;
+      case SCRIPT_SET_DNS_NAME: {
+          CDNSName entry(command.target, command.value);
+          if (entry.name.GetLength() && entry.realName.GetLength())
+            _dns_name_override.AddTail(entry);
+        }
+        break;
+      case SCRIPT_SET_BROWSER_SIZE: {
+          int width = _ttoi(command.target);
+          int height = _ttoi(command.value);
+          if (width > 0 && height > 0) {
+            _browser_width = (DWORD)width;
+            _browser_height = (DWORD)height;
+          }
+        }
+        break;
+      case SCRIPT_SET_VIEWPORT_SIZE: {
+          int width = _ttoi(command.target);
+          int height = _ttoi(command.value);
+          if (width > 0 && height > 0) {
+            _viewport_width = (DWORD)width;
+            _viewport_height = (DWORD)height;
+          }
+        }
+        break;
+      case SCRIPT_SET_DEVICE_SCALE_FACTOR:
+        _device_scale_factor = _T("");
+        for (int i = 0; i < command.target.GetLength(); i++) {
+          TCHAR ch = command.target.GetAt(i);
+          if (ch == _T('0') || ch == _T('1') || ch == _T('2') ||
+              ch == _T('3') || ch == _T('4') || ch == _T('5') ||
+              ch == _T('6') || ch == _T('7') || ch == _T('8') ||
+              ch == _T('9') || ch == _T('.'))
+            _device_scale_factor += ch;
+          else
+            break;
+        }
+        if (!_device_scale_factor.GetLength())
+          _device_scale_factor.Empty();
+        break;
+      default:
+        processed = false;
+        break;
     }
   }
 
@@ -954,6 +1011,7 @@ void WptTest::ParseBlockCommand(CString block_list, bool add_head) {
       ScriptCommand block_script_command;
       block_script_command.command = _T("block");
       block_script_command.target = pattern;
+      CompileCommand(block_script_command);
       if (add_head) {
         _script_commands.AddHead(block_script_command);
       } else {
@@ -963,6 +1021,35 @@ void WptTest::ParseBlockCommand(CString block_list, bool add_head) {
   }
 }
 
+/*-----------------------------------------------------------------------------
+  Compile the rule's regexes (rules that don't compile are dropped)
+-----------------------------------------------------------------------------*/
+bool CustomRule::Compile(void) {
+  bool ok = false;
+  try {
+    std::tr1::regex_constants::syntax_option_type flags =
+        std::tr1::regex_constants::icase |
+        std::tr1::regex_constants::ECMAScript;
+    _mime_regex.assign((LPCSTR)CT2A(_mime), flags);
+    _body_regex.assign((LPCSTR)CT2A(_regex), flags);
+    ok = true;
+  } catch (std::tr1::regex_error&) {
+  }
+  return ok;
+}
+
+/*-----------------------------------------------------------------------------
+  Add a custom rule from the test settings or the script
+-----------------------------------------------------------------------------*/
+void WptTest::AddCustomRule(CString name, CString mime, CString regex) {
+  CustomRule new_rule;
+  new_rule._name = name;
+  new_rule._mime = mime;
+  new_rule._regex = regex;
+  if (new_rule.Compile())
+    _custom_rules.AddTail(new_rule);
+}
+
 /*-----------------------------------------------------------------------------
   The test is finished, insert the 2 dummy commands into the top of the
   script to collect data (these are added to the head so they are in reverse
@@ -974,20 +1061,24 @@ void  WptTest::CollectData() {
   // Add the command that lets us know we have collected all of the data and it
   // is time to report back
   cmd.command = _T("reportdata");
+  CompileCommand(cmd);
   _script_commands.AddHead(cmd);
 
   // If we are at the end of the script, run the responsive site check
   if (_check_responsive && _script_commands.GetCount() == 1) {
     cmd.command = _T("checkresponsive");
+    CompileCommand(cmd);
     _script_commands.AddHead(cmd);
 
     cmd.command = _T("resizeresponsive");
+    CompileCommand(cmd);
     _script_commands.AddHead(cmd);
   }
 
   // Add the command to trigger the browser to collect in-page stats
   // (before doing a responsive check where we resize the window)
   cmd.command = _T("collectstats");
+  CompileCommand(cmd);
   _script_commands.AddHead(cmd);
 }
 
@@ -1007,8 +1098,7 @@ void WptTest::CollectDataDone() {
     removed = false;
     if (!_script_commands.IsEmpty()) {
       ScriptCommand &cmd = _script_commands.GetHead();
-      if (cmd.command == _T("reportdata") ||
-          cmd.command == _T("collectstats")) {
+      if (cmd.op == SCRIPT_REPORT_DATA || cmd.op == SCRIPT_COLLECT_STATS) {
         _script_commands.RemoveHead();
         removed = true;
       }
@@ -28,9 +28,17 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #pragma once
 
+#include <regex>
+#include "script_ops.h"
+
+/*-----------------------------------------------------------------------------
+  One step of the test script.  CompileCommand() resolves the opcode and
+  encodes the task for the browser when the command is queued so running
+  the step doesn't have to look at the strings again.
+-----------------------------------------------------------------------------*/
 class ScriptCommand{
 public:
-  ScriptCommand(void):record(false){}
+  ScriptCommand(void):record(false),op(SCRIPT_UNKNOWN){}
   ScriptCommand(const ScriptCommand& src){*this = src;}
   ~ScriptCommand(void){}
   const ScriptCommand& operator =(const ScriptCommand& src){
@@ -38,6 +46,8 @@ public:
     target = src.target;
     value = src.value;
     record = src.record;
+    op = src.op;
+    task = src.task;
 
     return src;
   }
@@ -46,6 +56,8 @@ public:
   CString target;
   CString value;
   bool    record;
+  ScriptOp  op;
+  CStringA  task;   // JSON-encoded command for the browser
 };
 
 class CDNSEntry {
@@ -99,6 +111,8 @@ public:
   CStringA  _filter;
 };
 
+// The mime and body regexes are compiled once, when the rule is added,
+// instead of for every request the rule is checked against
 class CustomRule {
 public:
   CustomRule(void){}
@@ -108,12 +122,17 @@ public:
     _name = src._name;
     _mime = src._mime;
     _regex = src._regex;
+    _mime_regex = src._mime_regex;
+    _body_regex = src._body_regex;
     return src;
   }
+  bool Compile(void);
 
   CString _name;
   CString _mime;
   CString _regex;
+  std::tr1::regex _mime_regex;
+  std::tr1::regex _body_regex;
 };
 
 class WptTest {
@@ -176,6 +195,7 @@ public:
   BYTE    _image_quality;
   bool    _png_screen_shot;
   DWORD   _minimum_duration;
+  DWORD   _resource_interval;  // ms between resource samples
   bool    _save_response_bodies;
   bool    _save_html_body;
   bool    _preserve_user_agent;
@@ -215,8 +235,11 @@ public:
 
   // system information
   bool      has_gpu_;
+  bool      shape_traffic_;   // dummynet unavailable, shape in the hook
+  int       replay_mode_;     // local record/replay (REPLAY_*)
 
   void      BuildScript();
+  void      CompileCommand(ScriptCommand& command);
   CAtlList<ScriptCommand> _script_commands;
 
 protected:
@@ -226,6 +249,7 @@ protected:
   bool      PreProcessScriptCommand(ScriptCommand& command);
   bool      ConditionMatches(ScriptCommand& command);
   void      ParseBlockCommand(CString block_list, bool add_head);
+  void      AddCustomRule(CString name, CString mime, CString regex);
   int       lock_count_;
   virtual bool ProcessCommand(ScriptCommand& command, bool &consumed);
 
@@ -244,4 +268,6 @@ protected:
   CAtlList<HttpHeaderValue> _override_hosts;
 
   CAtlMap<USHORT, USHORT> _tcp_port_override;
+
+  ScriptOps _script_ops;
 };
@@ -33,6 +33,7 @@ bool WptTestDriver::Start() {
       SetCurrentRun(_run);
       SetCPUUtilization(0);
       SetHasGPU(has_gpu_);
+      SetReplayMode(replay_mode_);
       ret = true;
     }
   }
@@ -15,11 +15,14 @@ unsigned int __stdcall eglPostSubBufferNV_Hook(void * dpy, void * surface,
 
 typedef FARPROC (__stdcall * LPEGLGETPROCADDRESS)(const char *procname);
 
+static const int EGL_HEIGHT = 0x3056;
+
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
 AngleHook::AngleHook(void):
   eglSwapBuffers_(NULL)
   ,eglPostSubBufferNV_(NULL)
+  ,eglQuerySurface_(NULL)
   ,hook_(NULL) {
   paint_msg_ = RegisterWindowMessage(_T("WPT Browser Paint"));
 }
@@ -56,6 +59,8 @@ void AngleHook::Init() {
   // Hook the not-exported functions
   HMODULE hAngle = LoadLibrary(_T("libegl.dll"));
   if (hAngle) {
+    eglQuerySurface_ =
+        (LPEGLQUERYSURFACE)GetProcAddress(hAngle, "eglQuerySurface");
     LPEGLGETPROCADDRESS eglGetProcAddress =
         (LPEGLGETPROCADDRESS)GetProcAddress(hAngle, "eglGetProcAddress");
     if (eglGetProcAddress) {
@@ -102,8 +107,16 @@ unsigned int AngleHook::eglPostSubBufferNV(void * dpy, void * surface,
     //TCHAR buff[1024];
     //wsprintf(buff, _T("eglPostSubBufferNV - %d,%d - %d x %d"), x, y, width, height);
     //OutputDebugString(buff);
-    // the dimensions don't match the actual screen dimensions so don't use them
-    NotifyPaint();
+    // the rect is in GL coordinates (origin at the bottom-left of the
+    // surface) so flip it if we can get the surface height, otherwise
+    // report the whole window as painted
+    int surface_height = 0;
+    if (eglQuerySurface_ &&
+        eglQuerySurface_(dpy, surface, EGL_HEIGHT, &surface_height) &&
+        surface_height >= y + height)
+      NotifyPaint(x, surface_height - (y + height), width, height);
+    else
+      NotifyPaint();
   }
   return ret;
 }
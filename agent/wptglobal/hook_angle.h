@@ -4,6 +4,8 @@
 typedef unsigned int(__stdcall * LPEGLSWAPBUFFERS)(void * dpy, void * surface);
 typedef unsigned int(__stdcall * LPEGLPOSTSUBBUFFERNV)(void * dpy,
     void * surface, int x, int y, int width, int height);
+typedef unsigned int(__stdcall * LPEGLQUERYSURFACE)(void * dpy,
+    void * surface, int attribute, int * value);
 
 class AngleHook {
 public:
@@ -22,6 +24,7 @@ private:
   UINT                  paint_msg_;
   LPEGLSWAPBUFFERS      eglSwapBuffers_;
   LPEGLPOSTSUBBUFFERNV  eglPostSubBufferNV_;
+  LPEGLQUERYSURFACE     eglQuerySurface_;
 
   void NotifyPaint(int x = 0, int y = 0, int width = 0, int height = 0);
 };
@@ -0,0 +1,163 @@
+/******************************************************************************
+Copyright (c) 2014, Google Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+    * Neither the name of the <ORGANIZATION> nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+#include "StdAfx.h"
+#include "analysis_cache.h"
+#include <zlib.h>
+
+static const TCHAR * ANALYSIS_CACHE_FILE = _T("\\analysis.dat");
+static const DWORD MAX_RECORD_LEN = 10000000;
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+AnalysisCache::AnalysisCache(void) {
+  InitializeCriticalSection(&cs_);
+  entries_.InitHashTable(257);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+AnalysisCache::~AnalysisCache(void) {
+  DeleteCriticalSection(&cs_);
+}
+
+/*-----------------------------------------------------------------------------
+  Pick up the results saved by the earlier runs of the test
+-----------------------------------------------------------------------------*/
+void AnalysisCache::Load(CString directory) {
+  EnterCriticalSection(&cs_);
+  entries_.RemoveAll();
+  pending_.Empty();
+  file_.Empty();
+  if (!directory.IsEmpty()) {
+    CreateDirectory(directory, NULL);
+    file_ = directory + ANALYSIS_CACHE_FILE;
+  }
+
+  HANDLE file = INVALID_HANDLE_VALUE;
+  if (!file_.IsEmpty())
+    file = CreateFile(file_, GENERIC_READ, FILE_SHARE_READ, 0,
+                      OPEN_EXISTING, 0, 0);
+  if (file != INVALID_HANDLE_VALUE) {
+    DWORD size = GetFileSize(file, NULL);
+    if (size && size != INVALID_FILE_SIZE) {
+      BYTE * data = (BYTE *)malloc(size);
+      DWORD bytes = 0;
+      if (data) {
+        if (ReadFile(file, data, size, &bytes, 0) && bytes == size) {
+          DWORD pos = 0;
+          bool ok = true;
+          while (ok && pos < size) {
+            CStringA fields[2];
+            for (int i = 0; i < 2 && ok; i++) {
+              DWORD len = 0;
+              ok = false;
+              if (pos + sizeof(len) <= size) {
+                memcpy(&len, &data[pos], sizeof(len));
+                pos += sizeof(len);
+                if (len <= MAX_RECORD_LEN && pos + len <= size) {
+                  fields[i] = CStringA((const char *)&data[pos], len);
+                  pos += len;
+                  ok = true;
+                }
+              }
+            }
+            if (ok)
+              entries_.SetAt(fields[0], fields[1]);
+          }
+        }
+        free(data);
+      }
+    }
+    CloseHandle(file);
+  }
+  WptTrace(loglevel::kFunction,
+    _T("[wpthook] - AnalysisCache::Load() %d cached results\n"),
+    (int)entries_.GetCount());
+  LeaveCriticalSection(&cs_);
+}
+
+/*-----------------------------------------------------------------------------
+  Build the key for a check on the given (decoded) body.  crc32 and adler32
+  together with the length are plenty to tell the bodies within a job apart.
+  Checks that take parameters append them to the key.
+-----------------------------------------------------------------------------*/
+CStringA AnalysisCache::Key(const char * check, const char * data, DWORD len) {
+  uLong crc = crc32(0L, Z_NULL, 0);
+  uLong adler = adler32(0L, Z_NULL, 0);
+  if (data && len) {
+    crc = crc32(crc, (const Bytef *)data, len);
+    adler = adler32(adler, (const Bytef *)data, len);
+  }
+  CStringA key;
+  key.Format("%s:%08lX%08lX:%lu", check, crc, adler, len);
+  return key;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+bool AnalysisCache::Get(const CStringA& key, CStringA& value) {
+  EnterCriticalSection(&cs_);
+  bool found = entries_.Lookup(key, value);
+  LeaveCriticalSection(&cs_);
+  return found;
+}
+
+/*-----------------------------------------------------------------------------
+  Remember the result and queue it up for the file
+-----------------------------------------------------------------------------*/
+void AnalysisCache::Set(const CStringA& key, const CStringA& value) {
+  EnterCriticalSection(&cs_);
+  entries_.SetAt(key, value);
+  if (!file_.IsEmpty()) {
+    DWORD key_len = key.GetLength();
+    DWORD value_len = value.GetLength();
+    pending_.Append((LPCSTR)&key_len, sizeof(key_len));
+    pending_ += key;
+    pending_.Append((LPCSTR)&value_len, sizeof(value_len));
+    pending_ += value;
+  }
+  LeaveCriticalSection(&cs_);
+}
+
+/*-----------------------------------------------------------------------------
+  Append the new results to the file for the later runs
+-----------------------------------------------------------------------------*/
+void AnalysisCache::Save(void) {
+  EnterCriticalSection(&cs_);
+  if (!file_.IsEmpty() && !pending_.IsEmpty()) {
+    HANDLE file = CreateFile(file_, GENERIC_WRITE, 0, 0, OPEN_ALWAYS, 0, 0);
+    if (file != INVALID_HANDLE_VALUE) {
+      SetFilePointer(file, 0, 0, FILE_END);
+      DWORD written = 0;
+      WriteFile(file, (LPCSTR)pending_, pending_.GetLength(), &written, 0);
+      CloseHandle(file);
+    }
+  }
+  pending_.Empty();
+  LeaveCriticalSection(&cs_);
+}
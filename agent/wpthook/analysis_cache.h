@@ -0,0 +1,67 @@
+/******************************************************************************
+Copyright (c) 2014, Google Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+    * Neither the name of the <ORGANIZATION> nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+#pragma once
+
+// sub-directory of the test results directory that holds the cache.  The
+// per-run cleanup only removes files so it survives across browser launches
+// and wptdriver deletes it when the job is done.
+const TCHAR * const ANALYSIS_CACHE_DIRECTORY = _T("analysis_cache");
+
+/*-----------------------------------------------------------------------------
+  Content-addressed cache of the expensive optimization check results
+  (gzip target size, JPEG re-encode size, scan count, custom rule matches).
+
+  Most resources are downloaded again for every run of a test so the
+  results are keyed by a hash of the decoded body (and whatever parameters
+  the check used) and persisted to an append-only file that the next
+  browser launch picks up.  New records are batched up and appended by
+  Save() once the checks are done.  Most of the results are filled in by
+  the ResponseAnalyzer thread while the test is still running so access
+  is serialized.  Records are:
+
+    DWORD(key length) key DWORD(value length) value
+
+  A truncated record at the end of the file (a crash mid-write) is ignored.
+-----------------------------------------------------------------------------*/
+class AnalysisCache {
+public:
+  AnalysisCache(void);
+  ~AnalysisCache(void);
+
+  void Load(CString directory);
+  CStringA Key(const char * check, const char * data, DWORD len);
+  bool Get(const CStringA& key, CStringA& value);
+  void Set(const CStringA& key, const CStringA& value);
+  void Save(void);
+
+private:
+  CRITICAL_SECTION            cs_;
+  CString                     file_;
+  CStringA                    pending_;   // records not written yet
+  CAtlMap<CStringA, CStringA> entries_;
+};
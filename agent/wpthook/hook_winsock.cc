@@ -34,6 +34,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "track_dns.h"
 #include "track_sockets.h"
 #include "test_state.h"
+#include "traffic_shaper.h"
+#include "replay_server.h"
 
 static CWsHook * pHook = NULL;
 
@@ -240,11 +242,14 @@ int WSAAPI WSAIoctl_Hook(SOCKET s, DWORD dwIoControlCode, LPVOID lpvInBuffer,
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-CWsHook::CWsHook(TrackDns& dns, TrackSockets& sockets, TestState& test_state):
+CWsHook::CWsHook(TrackDns& dns, TrackSockets& sockets, TestState& test_state,
+                 TrafficShaper& shaper, ReplayServer& replay_server):
   _getaddrinfo(NULL)
   , _dns(dns)
   , _sockets(sockets)
-  , _test_state(test_state) {
+  , _test_state(test_state)
+  , _shaper(shaper)
+  , _replay_server(replay_server) {
   _recv_buffers.InitHashTable(257);
   _send_buffers.InitHashTable(257);
   _send_buffer_original_length.InitHashTable(257);
@@ -353,6 +358,7 @@ int CWsHook::closesocket(SOCKET s) {
   LeaveCriticalSection(&cs);
   if (!_test_state._exit)
     _sockets.Close(s);
+  _shaper.Close(s);
   if (_closesocket)
     ret = _closesocket(s);
   return ret;
@@ -375,11 +381,15 @@ int CWsHook::connect(IN SOCKET s, const struct sockaddr FAR * name,
   }
 #endif
   int ret = SOCKET_ERROR;
+  struct sockaddr_storage replay_name;
   _sockets.ResetSslFd();
   if (!_test_state._exit)
     _sockets.Connect(s, name, namelen);
+  _shaper.Connect(s, name, namelen);
+  const struct sockaddr FAR * connect_name =
+      _replay_server.Redirect(s, name, namelen, replay_name);
   if (_connect)
-    ret = _connect(s, name, namelen);
+    ret = _connect(s, connect_name, namelen);
   if (!ret) {
     _sockets.Connected(s);
 #ifdef TRACE_WINSOCK
@@ -414,16 +424,20 @@ BOOL CWsHook::ConnectEx(SOCKET s, const struct sockaddr FAR *name, int namelen,
   }
 #endif
   BOOL ret = FALSE;
+  struct sockaddr_storage replay_name;
   _sockets.ResetSslFd();
   if (!_test_state._exit)
     _sockets.Connect(s, name, namelen);
+  _shaper.Connect(s, name, namelen);
+  const struct sockaddr FAR * connect_name =
+      _replay_server.Redirect(s, name, namelen, replay_name);
   LPFN_CONNECTEX_WPT connect_ex = NULL;
   EnterCriticalSection(&cs);
   _connectex_functions.Lookup(s, connect_ex);
   LeaveCriticalSection(&cs);
   if (connect_ex)
-    ret = connect_ex(s, name, namelen, lpSendBuffer, dwSendDataLength,
-                     lpdwBytesSent, lpOverlapped);
+    ret = connect_ex(s, connect_name, namelen, lpSendBuffer,
+                     dwSendDataLength, lpdwBytesSent, lpOverlapped);
   if (ret) {
     _sockets.Connected(s);
 #ifdef TRACE_WINSOCK
@@ -446,6 +460,8 @@ int	CWsHook::recv(SOCKET s, char FAR * buf, int len, int flags) {
   int ret = SOCKET_ERROR;
   if (_recv)
     ret = _recv(s, buf, len, flags);
+  if (ret > 0 && !(flags & MSG_PEEK))
+    _shaper.Receive(s, ret);
   if (!_test_state._exit) {
     if (ret == SOCKET_ERROR && len == 1) {
       _sockets.SetSslSocket(s);
@@ -470,6 +486,8 @@ int	CWsHook::WSARecv(SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
   if (_WSARecv)
     ret = _WSARecv(s, lpBuffers, dwBufferCount, lpNumberOfBytesRecvd, lpFlags, 
                                             lpOverlapped, lpCompletionRoutine);
+  if (ret == 0 && lpNumberOfBytesRecvd && *lpNumberOfBytesRecvd)
+    _shaper.Receive(s, *lpNumberOfBytesRecvd);
 
   if (!_test_state._exit && lpBuffers && dwBufferCount) {
     if (ret == 0 && lpNumberOfBytesRecvd && *lpNumberOfBytesRecvd) {
@@ -511,6 +529,7 @@ int CWsHook::send(SOCKET s, const char FAR * buf, int len, int flags) {
       _sockets.ModifyDataOut(s, chunk, false);
       _sockets.DataOut(s, chunk, false);
     }
+    _shaper.Send(s, chunk.GetLength());
     ret = _send(s, chunk.GetData(), chunk.GetLength(), flags);
     ret = original_len;
   }
@@ -548,6 +567,12 @@ int CWsHook::WSASend(SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
       is_modified = _sockets.ModifyDataOut(s, chunk, false);
       _sockets.DataOut(s, chunk, false);
     }
+    if (_shaper.Enabled()) {
+      DWORD bytes = 0;
+      for (DWORD i = 0; i < dwBufferCount; i++)
+        bytes += lpBuffers[i].len;
+      _shaper.Send(s, is_modified ? chunk.GetLength() : bytes);
+    }
     if (is_modified) {
       WSABUF out;
       out.buf = (char *)chunk.GetData();
@@ -718,6 +743,7 @@ void CWsHook::ProcessOverlappedIo(SOCKET s, LPOVERLAPPED lpOverlapped,
   // handle a receive
   if (_recv_buffers.Lookup(lpOverlapped, buff)) {
     DWORD bytes = *lpNumberOfBytesTransferred;
+    _shaper.Receive(s, bytes);
     for (DWORD i = 0; i < buff._buffer_count && bytes; i++) {
       DWORD data_bytes = min(bytes, buff._buffers[i].len);
       if (data_bytes && buff._buffers[i].buf) {
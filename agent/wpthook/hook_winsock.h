@@ -33,6 +33,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 class TrackDns;
 class TrackSockets;
 class TestState;
+class TrafficShaper;
+class ReplayServer;
 class DataChunk;
 
 class WsaBuffTracker {
@@ -86,7 +88,8 @@ typedef BOOL(PASCAL FAR * LPFN_CONNECTEX_WPT) (SOCKET s,
 
 class CWsHook {
 public:
-  CWsHook(TrackDns& dns, TrackSockets& sockets, TestState& test_state);
+  CWsHook(TrackDns& dns, TrackSockets& sockets, TestState& test_state,
+          TrafficShaper& shaper, ReplayServer& replay_server);
   virtual ~CWsHook(void);
   void Init();
 
@@ -167,6 +170,8 @@ private:
   // winsock event tracking
   TrackDns&      _dns;
   TrackSockets&  _sockets;
+  TrafficShaper& _shaper;
+  ReplayServer& _replay_server;
 
   // pointers to the original implementations
   LPFN_WSASOCKETW		  _WSASocketW;
@@ -0,0 +1,316 @@
+/******************************************************************************
+Copyright (c) 2014, Google Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+    * Neither the name of the <ORGANIZATION> nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+#include "StdAfx.h"
+#include "json_stream.h"
+
+static const DWORD TOKEN_INITIAL_SIZE = 256;
+static const DWORD TOKEN_MAX_SIZE = 65536;    // longer strings get truncated
+static const DWORD NUMBER_MAX_SIZE = 64;
+static const BYTE CONTAINER_ARRAY = 0;
+static const BYTE CONTAINER_OBJECT = 1;
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+JsonStream::JsonStream(JsonStreamHandler& handler):
+  handler_(handler)
+  ,token_(NULL)
+  ,token_size_(0) {
+  Reset();
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+JsonStream::~JsonStream(void) {
+  if (token_)
+    free(token_);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void JsonStream::Reset(void) {
+  state_ = TOKEN_NONE;
+  failed_ = false;
+  token_len_ = 0;
+  unicode_value_ = 0;
+  unicode_digits_ = 0;
+  high_surrogate_ = 0;
+  expect_key_ = false;
+  is_key_ = false;
+  depth_ = 0;
+}
+
+/*-----------------------------------------------------------------------------
+  Feed the next chunk of the document through the parser.  Returns false
+  once the stream is found to be malformed (and ignores everything after).
+-----------------------------------------------------------------------------*/
+bool JsonStream::Parse(const char * data, DWORD len) {
+  const char * end = data + len;
+  const char * p = data;
+  while (p < end && !failed_) {
+    char c = *p;
+    switch (state_) {
+      case TOKEN_STRING: {
+          // copy runs of plain characters in one shot
+          const char * run = p;
+          while (p < end && *p != '"' && *p != '\\')
+            p++;
+          while (run < p)
+            Append(*run++);
+          if (p < end) {
+            if (*p == '"')
+              EndString();
+            else
+              state_ = TOKEN_STRING_ESCAPE;
+            p++;
+          }
+          continue;
+        }
+      case TOKEN_STRING_ESCAPE:
+        state_ = TOKEN_STRING;
+        switch (c) {
+          case 'b': Append('\b'); break;
+          case 'f': Append('\f'); break;
+          case 'n': Append('\n'); break;
+          case 'r': Append('\r'); break;
+          case 't': Append('\t'); break;
+          case 'u':
+            state_ = TOKEN_STRING_UNICODE;
+            unicode_value_ = 0;
+            unicode_digits_ = 0;
+            break;
+          default: Append(c); break;
+        }
+        p++;
+        continue;
+      case TOKEN_STRING_UNICODE: {
+          DWORD digit = 0;
+          if (c >= '0' && c <= '9')
+            digit = c - '0';
+          else if (c >= 'a' && c <= 'f')
+            digit = c - 'a' + 10;
+          else if (c >= 'A' && c <= 'F')
+            digit = c - 'A' + 10;
+          else
+            failed_ = true;
+          unicode_value_ = (unicode_value_ << 4) | digit;
+          unicode_digits_++;
+          if (unicode_digits_ == 4) {
+            AppendCodePoint(unicode_value_);
+            state_ = TOKEN_STRING;
+          }
+          p++;
+          continue;
+        }
+      case TOKEN_NUMBER:
+        if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' ||
+            c == 'e' || c == 'E') {
+          Append(c);
+          p++;
+        } else {
+          EndNumber();  // re-process the terminating character
+        }
+        continue;
+      case TOKEN_LITERAL:
+        if (c >= 'a' && c <= 'z') {
+          Append(c);
+          p++;
+        } else {
+          EndLiteral();
+        }
+        continue;
+    }
+
+    // structural characters
+    switch (c) {
+      case '{':
+        if (depth_ >= _countof(containers_)) {
+          failed_ = true;
+        } else {
+          containers_[depth_++] = CONTAINER_OBJECT;
+          expect_key_ = true;
+          handler_.OnStartObject();
+        }
+        break;
+      case '[':
+        if (depth_ >= _countof(containers_)) {
+          failed_ = true;
+        } else {
+          containers_[depth_++] = CONTAINER_ARRAY;
+          expect_key_ = false;
+          handler_.OnStartArray();
+        }
+        break;
+      case '}':
+      case ']':
+        if (!depth_ ||
+            containers_[depth_ - 1] != (c == '}' ? CONTAINER_OBJECT :
+                                                   CONTAINER_ARRAY)) {
+          failed_ = true;
+        } else {
+          depth_--;
+          if (c == '}')
+            handler_.OnEndObject();
+          else
+            handler_.OnEndArray();
+          ValueDone();
+        }
+        break;
+      case '"':
+        state_ = TOKEN_STRING;
+        token_len_ = 0;
+        high_surrogate_ = 0;
+        is_key_ = expect_key_;
+        break;
+      case ',':
+        if (depth_ && containers_[depth_ - 1] == CONTAINER_OBJECT)
+          expect_key_ = true;
+        break;
+      case ':':
+        expect_key_ = false;
+        break;
+      case ' ':
+      case '\t':
+      case '\r':
+      case '\n':
+        break;
+      default:
+        if ((c >= '0' && c <= '9') || c == '-') {
+          state_ = TOKEN_NUMBER;
+          token_len_ = 0;
+          Append(c);
+        } else if (c == 't' || c == 'f' || c == 'n') {
+          state_ = TOKEN_LITERAL;
+          token_len_ = 0;
+          Append(c);
+        } else {
+          failed_ = true;
+        }
+        break;
+    }
+    p++;
+  }
+  return !failed_;
+}
+
+/*-----------------------------------------------------------------------------
+  Add a character to the current token, growing the buffer geometrically
+  up to the maximum token size (anything past that is dropped).
+-----------------------------------------------------------------------------*/
+void JsonStream::Append(char c) {
+  if (token_len_ + 1 >= token_size_) {
+    if (token_size_ >= TOKEN_MAX_SIZE)
+      return;
+    DWORD new_size = token_size_ ? token_size_ * 2 : TOKEN_INITIAL_SIZE;
+    char * new_token = (char *)realloc(token_, new_size);
+    if (!new_token)
+      return;
+    token_ = new_token;
+    token_size_ = new_size;
+  }
+  token_[token_len_++] = c;
+}
+
+/*-----------------------------------------------------------------------------
+  UTF-8 encode an escaped code point (combining surrogate pairs)
+-----------------------------------------------------------------------------*/
+void JsonStream::AppendCodePoint(DWORD code_point) {
+  if (code_point >= 0xD800 && code_point <= 0xDBFF) {
+    high_surrogate_ = code_point;
+    return;
+  }
+  if (code_point >= 0xDC00 && code_point <= 0xDFFF && high_surrogate_) {
+    code_point = 0x10000 + ((high_surrogate_ - 0xD800) << 10) +
+                 (code_point - 0xDC00);
+  }
+  high_surrogate_ = 0;
+  if (code_point < 0x80) {
+    Append((char)code_point);
+  } else if (code_point < 0x800) {
+    Append((char)(0xC0 | (code_point >> 6)));
+    Append((char)(0x80 | (code_point & 0x3F)));
+  } else if (code_point < 0x10000) {
+    Append((char)(0xE0 | (code_point >> 12)));
+    Append((char)(0x80 | ((code_point >> 6) & 0x3F)));
+    Append((char)(0x80 | (code_point & 0x3F)));
+  } else {
+    Append((char)(0xF0 | (code_point >> 18)));
+    Append((char)(0x80 | ((code_point >> 12) & 0x3F)));
+    Append((char)(0x80 | ((code_point >> 6) & 0x3F)));
+    Append((char)(0x80 | (code_point & 0x3F)));
+  }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void JsonStream::EndString(void) {
+  state_ = TOKEN_NONE;
+  const char * value = token_ ? token_ : "";
+  if (is_key_) {
+    expect_key_ = false;
+    handler_.OnKey(value, token_len_);
+  } else {
+    handler_.OnString(value, token_len_);
+    ValueDone();
+  }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void JsonStream::EndNumber(void) {
+  state_ = TOKEN_NONE;
+  if (token_len_ && token_len_ < NUMBER_MAX_SIZE) {
+    char number[NUMBER_MAX_SIZE];
+    memcpy(number, token_, token_len_);
+    number[token_len_] = 0;
+    handler_.OnNumber(atof(number));
+    ValueDone();
+  } else {
+    failed_ = true;
+  }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void JsonStream::EndLiteral(void) {
+  state_ = TOKEN_NONE;
+  if (token_len_ == 4 && !memcmp(token_, "true", 4))
+    handler_.OnBool(true);
+  else if (token_len_ == 5 && !memcmp(token_, "false", 5))
+    handler_.OnBool(false);
+  else if (token_len_ == 4 && !memcmp(token_, "null", 4))
+    handler_.OnNull();
+  else
+    failed_ = true;
+  ValueDone();
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void JsonStream::ValueDone(void) {
+  expect_key_ = false;
+}
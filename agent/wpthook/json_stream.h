@@ -0,0 +1,94 @@
+/******************************************************************************
+Copyright (c) 2014, Google Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+    * Neither the name of the <ORGANIZATION> nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+#pragma once
+
+/*-----------------------------------------------------------------------------
+  Callback interface for the streaming JSON parser.  Strings and keys are
+  handed over as UTF-8 that is only valid for the duration of the call.
+-----------------------------------------------------------------------------*/
+class JsonStreamHandler {
+public:
+  virtual ~JsonStreamHandler(void){}
+  virtual void OnStartObject(void){}
+  virtual void OnEndObject(void){}
+  virtual void OnStartArray(void){}
+  virtual void OnEndArray(void){}
+  virtual void OnKey(const char * key, DWORD len){}
+  virtual void OnString(const char * value, DWORD len){}
+  virtual void OnNumber(double value){}
+  virtual void OnBool(bool value){}
+  virtual void OnNull(void){}
+};
+
+/*-----------------------------------------------------------------------------
+  Incremental (SAX-style) JSON parser.  Data can be fed in arbitrary chunks
+  as it arrives and only the token currently being parsed is buffered so
+  memory use is bounded regardless of the size of the document.  Top-level
+  values may be concatenated (with or without separating commas) which
+  matches the way trace fragments are posted by the browser extensions.
+-----------------------------------------------------------------------------*/
+class JsonStream {
+public:
+  JsonStream(JsonStreamHandler& handler);
+  ~JsonStream(void);
+
+  void Reset(void);
+  bool Parse(const char * data, DWORD len);
+  bool Failed(void) const { return failed_; }
+
+private:
+  enum TokenState {
+    TOKEN_NONE,
+    TOKEN_STRING,
+    TOKEN_STRING_ESCAPE,
+    TOKEN_STRING_UNICODE,
+    TOKEN_NUMBER,
+    TOKEN_LITERAL
+  };
+
+  void Append(char c);
+  void AppendCodePoint(DWORD code_point);
+  void EndString(void);
+  void EndNumber(void);
+  void EndLiteral(void);
+  void ValueDone(void);
+
+  JsonStreamHandler& handler_;
+  TokenState  state_;
+  bool        failed_;
+  char *      token_;
+  DWORD       token_len_;
+  DWORD       token_size_;
+  DWORD       unicode_value_;
+  DWORD       unicode_digits_;
+  DWORD       high_surrogate_;
+  bool        expect_key_;
+  bool        is_key_;
+  DWORD       depth_;
+  BYTE        containers_[64];  // 1 = object, 0 = array
+};
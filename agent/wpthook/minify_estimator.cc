@@ -0,0 +1,491 @@
+/******************************************************************************
+Copyright (c) 2014, Google Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+    * Neither the name of the <ORGANIZATION> nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+/*-----------------------------------------------------------------------------
+  The JavaScript rules are ported from jsmin.c:
+
+  Copyright (c) 2002 Douglas Crockford  (www.crockford.com)
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to
+  deal in the Software without restriction, including without limitation the
+  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+  sell copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  The Software shall be used for Good, not Evil.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+-----------------------------------------------------------------------------*/
+#include "StdAfx.h"
+#include "minify_estimator.h"
+#include <zlib.h>
+
+// same compression level as the wpthook gzip check
+static const int GZIP_LEVEL = 7;
+static const unsigned long ZLIB_OUT_SIZE = 16384;
+
+/*-----------------------------------------------------------------------------
+  Letters, digits, underscore, dollar sign, backslash or non-ASCII
+-----------------------------------------------------------------------------*/
+static inline bool IsAlphanum(int c) {
+  return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+         (c >= 'A' && c <= 'Z') || c == '_' || c == '$' || c == '\\' ||
+         c > 126;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+MinifyEstimator::MinifyEstimator(bool gzip):
+  minified_size_(0)
+  ,gzip_size_(0)
+  ,gzip_(gzip)
+  ,ok_(true)
+  ,in_(NULL)
+  ,end_(NULL)
+  ,a_(EOF)
+  ,b_(EOF)
+  ,lookahead_(EOF)
+  ,buffered_(0)
+  ,zlib_(NULL)
+  ,zlib_out_(NULL) {
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+MinifyEstimator::~MinifyEstimator(void) {
+  if (zlib_) {
+    deflateEnd(zlib_);
+    delete zlib_;
+  }
+  if (zlib_out_)
+    delete [] zlib_out_;
+}
+
+/*-----------------------------------------------------------------------------
+  Estimate the size of the JavaScript after running it through JSMin.
+  Returns false if the script could not be parsed (unterminated comment,
+  string or regular expression).
+-----------------------------------------------------------------------------*/
+bool MinifyEstimator::JavaScript(const char * data, unsigned long len) {
+  Start(data, len);
+  a_ = '\n';
+  Action(3);
+  while (ok_ && a_ != EOF) {
+    switch (a_) {
+      case ' ':
+        if (IsAlphanum(b_))
+          Action(1);
+        else
+          Action(2);
+        break;
+      case '\n':
+        switch (b_) {
+          case '{':
+          case '[':
+          case '(':
+          case '+':
+          case '-':
+            Action(1);
+            break;
+          case ' ':
+            Action(3);
+            break;
+          default:
+            if (IsAlphanum(b_))
+              Action(1);
+            else
+              Action(2);
+        }
+        break;
+      default:
+        switch (b_) {
+          case ' ':
+            if (IsAlphanum(a_)) {
+              Action(1);
+              break;
+            }
+            Action(3);
+            break;
+          case '\n':
+            switch (a_) {
+              case '}':
+              case ']':
+              case ')':
+              case '+':
+              case '-':
+              case '"':
+              case '\'':
+                Action(1);
+                break;
+              default:
+                if (IsAlphanum(a_))
+                  Action(1);
+                else
+                  Action(3);
+            }
+            break;
+          default:
+            Action(1);
+            break;
+        }
+    }
+  }
+  return Finish();
+}
+
+/*-----------------------------------------------------------------------------
+  Estimate the size of a style sheet with the comments and insignificant
+  whitespace removed (and the last semicolon in each block dropped).
+-----------------------------------------------------------------------------*/
+bool MinifyEstimator::Css(const char * data, unsigned long len) {
+  Start(data, len);
+  int last = 0;
+  int depth = 0;
+  bool space = false;
+  bool semicolon = false;
+  const char * p = in_;
+  while (ok_ && p < end_ && *p) {
+    int c = (unsigned char)*p;
+    if (c == '/' && p + 1 < end_ && p[1] == '*') {
+      const char * close = p + 2;
+      p = NULL;
+      while (!p && close < end_) {
+        close = (const char *)memchr(close, '*', end_ - close);
+        if (close && close + 1 < end_) {
+          if (close[1] == '/')
+            p = close + 2;
+          else
+            close++;
+        } else {
+          close = end_;
+        }
+      }
+      if (!p) {
+        ok_ = false;
+        p = end_;
+      }
+      space = true;
+    } else if (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f') {
+      space = true;
+      p++;
+    } else if (c == ';') {
+      semicolon = true;
+      space = false;
+      p++;
+    } else {
+      if (semicolon) {
+        semicolon = false;
+        if (c != '}') {
+          Put(';');
+          last = ';';
+          space = false;
+        }
+      }
+      if (space) {
+        space = false;
+        // spaces before a colon only matter in selectors (a :hover)
+        if (last && !strchr("{};,>:", last) && !strchr("{};,>", c) &&
+            (c != ':' || !depth))
+          Put(' ');
+      }
+      if (c == '"' || c == '\'') {
+        // copy the string through the closing quote
+        const char * start = p++;
+        while (p < end_ && *p != c && *p != '\n') {
+          if (*p == '\\' && p + 1 < end_)
+            p++;
+          p++;
+        }
+        if (p < end_ && *p == c)
+          p++;
+        PutRun(start, (unsigned long)(p - start));
+      } else {
+        if (c == '{')
+          depth++;
+        else if (c == '}' && depth)
+          depth--;
+        Put(c);
+        p++;
+      }
+      last = c;
+    }
+  }
+  return Finish();
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void MinifyEstimator::Start(const char * data, unsigned long len) {
+  ok_ = data != NULL;
+  in_ = data;
+  end_ = data ? data + len : NULL;
+  a_ = EOF;
+  b_ = EOF;
+  lookahead_ = EOF;
+  buffered_ = 0;
+  minified_size_ = 0;
+  gzip_size_ = 0;
+  if (gzip_) {
+    if (zlib_) {
+      deflateReset(zlib_);
+    } else {
+      zlib_ = new z_stream;
+      memset(zlib_, 0, sizeof(z_stream));
+      if (deflateInit(zlib_, GZIP_LEVEL) == Z_OK) {
+        zlib_out_ = new char[ZLIB_OUT_SIZE];
+      } else {
+        delete zlib_;
+        zlib_ = NULL;
+      }
+    }
+  }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+bool MinifyEstimator::Finish(void) {
+  if (zlib_) {
+    Compress(true);
+    gzip_size_ = zlib_->total_out;
+  }
+  return ok_;
+}
+
+/*-----------------------------------------------------------------------------
+  Count a byte of minified output (only buffered when we need to gzip it)
+-----------------------------------------------------------------------------*/
+void MinifyEstimator::Put(int c) {
+  if (c != EOF) {
+    minified_size_++;
+    if (zlib_) {
+      if (buffered_ >= sizeof(buffer_))
+        Compress(false);
+      buffer_[buffered_++] = (char)c;
+    }
+  }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void MinifyEstimator::PutRun(const char * data, unsigned long len) {
+  minified_size_ += len;
+  while (zlib_ && len) {
+    if (buffered_ >= sizeof(buffer_))
+      Compress(false);
+    unsigned long count = sizeof(buffer_) - buffered_;
+    if (count > len)
+      count = len;
+    memcpy(&buffer_[buffered_], data, count);
+    buffered_ += count;
+    data += count;
+    len -= count;
+  }
+}
+
+/*-----------------------------------------------------------------------------
+  Feed the buffered output to zlib (the compressed data is thrown away,
+  we only need the size)
+-----------------------------------------------------------------------------*/
+void MinifyEstimator::Compress(bool finish) {
+  if (zlib_) {
+    int flush = finish ? Z_FINISH : Z_NO_FLUSH;
+    int err = Z_OK;
+    zlib_->next_in = (Bytef *)buffer_;
+    zlib_->avail_in = buffered_;
+    do {
+      zlib_->next_out = (Bytef *)zlib_out_;
+      zlib_->avail_out = ZLIB_OUT_SIZE;
+      err = deflate(zlib_, flush);
+    } while (err == Z_OK &&
+             (finish || zlib_->avail_in || !zlib_->avail_out));
+    buffered_ = 0;
+  }
+}
+
+/*-----------------------------------------------------------------------------
+  Return the next character, translating control characters to a space or
+  linefeed.  A NULL is treated as the end of the data (like JSMin).
+-----------------------------------------------------------------------------*/
+int MinifyEstimator::Get(void) {
+  int c = lookahead_;
+  lookahead_ = EOF;
+  if (c == EOF && in_ < end_) {
+    c = (unsigned char)*in_;
+    in_++;
+    if (!c) {
+      c = EOF;
+      in_ = end_;
+    }
+  }
+  if (c >= ' ' || c == '\n' || c == EOF)
+    return c;
+  if (c == '\r')
+    return '\n';
+  return ' ';
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+int MinifyEstimator::Peek(void) {
+  lookahead_ = Get();
+  return lookahead_;
+}
+
+/*-----------------------------------------------------------------------------
+  Get the next character, excluding comments
+-----------------------------------------------------------------------------*/
+int MinifyEstimator::Next(void) {
+  int c = Get();
+  if (c == '/') {
+    int p = Peek();
+    if (p == '/') {
+      lookahead_ = EOF;
+      SkipLineComment();
+      c = Get();
+    } else if (p == '*') {
+      lookahead_ = EOF;
+      c = SkipBlockComment() ? ' ' : EOF;
+    }
+  }
+  return c;
+}
+
+/*-----------------------------------------------------------------------------
+  Skip to the end of a // comment (scanning the raw data directly instead of
+  going through Get() a character at a time)
+-----------------------------------------------------------------------------*/
+void MinifyEstimator::SkipLineComment(void) {
+  while (in_ < end_) {
+    char c = *in_;
+    if (c == '\n' || c == '\r' || !c)
+      break;
+    in_++;
+  }
+}
+
+/*-----------------------------------------------------------------------------
+  Skip past the end of a block comment
+-----------------------------------------------------------------------------*/
+bool MinifyEstimator::SkipBlockComment(void) {
+  while (in_ < end_) {
+    const char * star = (const char *)memchr(in_, '*', end_ - in_);
+    if (!star || star + 1 >= end_)
+      break;
+    in_ = star + 1;
+    if (*in_ == '/') {
+      in_++;
+      return true;
+    }
+  }
+  in_ = end_;
+  ok_ = false;
+  return false;
+}
+
+/*-----------------------------------------------------------------------------
+  Copy the plain part of a string literal in one go
+-----------------------------------------------------------------------------*/
+void MinifyEstimator::PutStringRun(int quote) {
+  if (lookahead_ == EOF) {
+    const char * start = in_;
+    while (in_ < end_) {
+      int c = (unsigned char)*in_;
+      if (c < ' ' || c == quote || c == '\\')
+        break;
+      in_++;
+    }
+    if (in_ > start)
+      PutRun(start, (unsigned long)(in_ - start));
+  }
+}
+
+/*-----------------------------------------------------------------------------
+  1   Output A. Copy B to A. Get the next B.
+  2   Copy B to A. Get the next B. (Delete A).
+  3   Get the next B. (Delete B).
+  Strings are treated as a single character and a regular expression is
+  recognized if it is preceded by an operator or punctuation.
+-----------------------------------------------------------------------------*/
+void MinifyEstimator::Action(int d) {
+  switch (d) {
+    case 1:
+      Put(a_);
+    case 2:
+      a_ = b_;
+      if (a_ == '\'' || a_ == '"') {
+        for (;;) {
+          Put(a_);
+          PutStringRun(b_);
+          a_ = Get();
+          if (a_ == b_)
+            break;
+          if (a_ <= '\n') {
+            ok_ = false;
+            break;
+          }
+          if (a_ == '\\') {
+            Put(a_);
+            a_ = Get();
+          }
+        }
+      }
+    case 3:
+      b_ = Next();
+      if (b_ == '/' && (a_ == '(' || a_ == ',' || a_ == '=' ||
+                        a_ == ':' || a_ == '[' || a_ == '!' ||
+                        a_ == '&' || a_ == '|' || a_ == '?' ||
+                        a_ == '{' || a_ == '}' || a_ == ';' ||
+                        a_ == '\n')) {
+        Put(a_);
+        Put(b_);
+        for (;;) {
+          a_ = Get();
+          if (a_ == '/') {
+            break;
+          } else if (a_ == '\\') {
+            Put(a_);
+            a_ = Get();
+          } else if (a_ <= '\n') {
+            ok_ = false;
+            break;
+          }
+          Put(a_);
+        }
+        b_ = Next();
+      }
+  }
+}
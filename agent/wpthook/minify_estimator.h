@@ -0,0 +1,82 @@
+/******************************************************************************
+Copyright (c) 2014, Google Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+    * Neither the name of the <ORGANIZATION> nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+#pragma once
+
+struct z_stream_s;
+
+/*-----------------------------------------------------------------------------
+  Estimates how large a JavaScript or CSS resource would be after
+  minification (and optionally gzip) without building the minified copy.
+
+  The minified bytes are streamed through a small fixed buffer that is only
+  used to feed zlib when a gzip estimate is requested.  The JavaScript rules
+  are the ones from JSMin and the CSS rules strip comments and whitespace
+  that is not significant.
+
+  This is also built into the IE pagetest hook so both agents score
+  minification the same way.
+-----------------------------------------------------------------------------*/
+class MinifyEstimator {
+public:
+  MinifyEstimator(bool gzip);
+  ~MinifyEstimator(void);
+
+  bool JavaScript(const char * data, unsigned long len);
+  bool Css(const char * data, unsigned long len);
+
+  unsigned long minified_size_;
+  unsigned long gzip_size_;
+
+private:
+  void Start(const char * data, unsigned long len);
+  bool Finish(void);
+  void Put(int c);
+  void PutRun(const char * data, unsigned long len);
+  void Compress(bool finish);
+
+  // JSMin
+  int  Get(void);
+  int  Peek(void);
+  int  Next(void);
+  void Action(int d);
+  void SkipLineComment(void);
+  bool SkipBlockComment(void);
+  void PutStringRun(int quote);
+
+  bool          gzip_;
+  bool          ok_;
+  const char *  in_;
+  const char *  end_;
+  int           a_;
+  int           b_;
+  int           lookahead_;
+  char          buffer_[16384];
+  unsigned long buffered_;
+  struct z_stream_s * zlib_;
+  char *        zlib_out_;
+};
@@ -0,0 +1,669 @@
+/******************************************************************************
+Copyright (c) 2014, Google Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+    * Neither the name of the <ORGANIZATION> nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+#include "StdAfx.h"
+#include "net_log.h"
+#include "requests.h"
+#include "request.h"
+#include "test_state.h"
+
+static const DWORD READ_BUFFER_SIZE = 65536;
+static const int PHASE_BEGIN = 1;
+static const int PHASE_END = 2;
+
+// the netlog event types we care about (mapped from the ids in the file)
+static const int NETLOG_REQUEST_ALIVE = 1;
+static const int NETLOG_URL_REQUEST_START_JOB = 2;
+static const int NETLOG_SEND_REQUEST = 3;
+static const int NETLOG_READ_HEADERS = 4;
+static const int NETLOG_BYTES_READ = 5;
+static const int NETLOG_BOUND_TO_SOCKET = 6;
+static const int NETLOG_TCP_CONNECT = 7;
+static const int NETLOG_SSL_CONNECT = 8;
+static const int NETLOG_HOST_RESOLVER_JOB = 9;
+static const int NETLOG_SOCKET_BYTES_RECEIVED = 10;
+static const int NETLOG_SOCKET_BYTES_SENT = 11;
+static const int NETLOG_SESSION_INITIALIZED = 12;
+static const int NETLOG_SESSION_SEND_HEADERS = 13;
+static const int NETLOG_REQUEST_BOUND_TO_JOB = 14;
+
+struct NetLogEventType {
+  const char * name;
+  int          type;
+};
+
+static const NetLogEventType NETLOG_EVENT_TYPES[] = {
+  {"REQUEST_ALIVE", NETLOG_REQUEST_ALIVE},
+  {"URL_REQUEST_START_JOB", NETLOG_URL_REQUEST_START_JOB},
+  {"HTTP_TRANSACTION_SEND_REQUEST", NETLOG_SEND_REQUEST},
+  {"HTTP_TRANSACTION_READ_HEADERS", NETLOG_READ_HEADERS},
+  {"URL_REQUEST_JOB_BYTES_READ", NETLOG_BYTES_READ},
+  {"SOCKET_POOL_BOUND_TO_SOCKET", NETLOG_BOUND_TO_SOCKET},
+  {"TCP_CONNECT", NETLOG_TCP_CONNECT},
+  {"SSL_CONNECT", NETLOG_SSL_CONNECT},
+  {"HOST_RESOLVER_IMPL_JOB", NETLOG_HOST_RESOLVER_JOB},
+  {"SOCKET_BYTES_RECEIVED", NETLOG_SOCKET_BYTES_RECEIVED},
+  {"SOCKET_BYTES_SENT", NETLOG_SOCKET_BYTES_SENT},
+  {"SPDY_SESSION_INITIALIZED", NETLOG_SESSION_INITIALIZED},
+  {"HTTP2_SESSION_INITIALIZED", NETLOG_SESSION_INITIALIZED},
+  {"SPDY_SESSION_SYN_STREAM", NETLOG_SESSION_SEND_HEADERS},
+  {"HTTP2_SESSION_SYN_STREAM", NETLOG_SESSION_SEND_HEADERS},
+  {"HTTP2_SESSION_SEND_HEADERS", NETLOG_SESSION_SEND_HEADERS},
+  {"HTTP_STREAM_REQUEST_BOUND_TO_JOB", NETLOG_REQUEST_BOUND_TO_JOB}
+};
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+NetLog::NetLog(void):
+  stream_(*this) {
+  Reset();
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+NetLog::~NetLog(void) {
+  Reset();
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void NetLog::Reset(void) {
+  stream_.Reset();
+  file_.Empty();
+  file_offset_ = 0;
+  depth_ = 0;
+  in_constants_ = false;
+  in_event_types_ = false;
+  in_events_ = false;
+  event_depth_ = 0;
+  type_ = 0;
+  for (int i = 0; i < KEY_DEPTH; i++)
+    keys_[i][0] = 0;
+  while (!all_requests_.IsEmpty())
+    delete all_requests_.RemoveHead();
+  POSITION pos = sockets_.GetStartPosition();
+  while (pos) {
+    DWORD id;
+    NetLogSocket * socket = NULL;
+    sockets_.GetNextAssoc(pos, id, socket);
+    if (socket)
+      delete socket;
+  }
+  event_types_.RemoveAll();
+  requests_.RemoveAll();
+  sockets_.RemoveAll();
+  sessions_.RemoveAll();
+  jobs_.RemoveAll();
+  job_sockets_.RemoveAll();
+  dns_jobs_.RemoveAll();
+  dns_.RemoveAll();
+  urls_.RemoveAll();
+  streams_.RemoveAll();
+}
+
+/*-----------------------------------------------------------------------------
+  Stream the netlog file through the parser in fixed-size chunks.  The
+  browser still has the file open for writing so share it and accept a
+  truncated document: the parser keeps its state at the truncation point
+  and the next call for the same file carries on from there.
+-----------------------------------------------------------------------------*/
+bool NetLog::Load(CString file) {
+  bool ret = false;
+  if (file.CompareNoCase(file_)) {
+    Reset();
+    file_ = file;
+  }
+  HANDLE file_handle = CreateFile(file, GENERIC_READ,
+                                  FILE_SHARE_READ | FILE_SHARE_WRITE, 0,
+                                  OPEN_EXISTING, 0, 0);
+  if (file_handle != INVALID_HANDLE_VALUE) {
+    char * buffer = (char *)malloc(READ_BUFFER_SIZE);
+    LARGE_INTEGER position;
+    position.QuadPart = file_offset_;
+    if (buffer && SetFilePointerEx(file_handle, position, NULL, FILE_BEGIN)) {
+      DWORD bytes = 0;
+      while (!stream_.Failed() &&
+             ReadFile(file_handle, buffer, READ_BUFFER_SIZE, &bytes, 0) &&
+             bytes) {
+        file_offset_ += bytes;
+        AddData(buffer, bytes);
+      }
+    }
+    if (buffer)
+      free(buffer);
+    ret = !all_requests_.IsEmpty();
+    CloseHandle(file_handle);
+  }
+  WptTrace(loglevel::kFunction,
+           _T("[wpthook] - NetLog::Load() %d requests from %s\n"),
+           all_requests_.GetCount(), (LPCTSTR)file);
+  return ret;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void NetLog::AddData(const char * data, DWORD len) {
+  if (data && len)
+    stream_.Parse(data, len);
+}
+
+/*-----------------------------------------------------------------------------
+  The URL the netlog records for a hooked request
+-----------------------------------------------------------------------------*/
+static CStringA RequestUrl(Request * request) {
+  CStringA url = request->_is_ssl ? "https://" : "http://";
+  url += request->GetHost();
+  url += request->_request_data.GetObject();
+  return url;
+}
+
+/*-----------------------------------------------------------------------------
+  Merge the netlog timings into the requests captured by the socket hooks.
+  Requests are matched by URL and method (in order for repeated URLs) and
+  the DNS and connection times are only attributed to the first request on
+  a socket.  Entries stay matched for the later steps.  Only complete netlog requests are used: the browser is still
+  running when the results are saved so the log can end part-way through
+  a request (or a line) and those keep the socket-level data.
+-----------------------------------------------------------------------------*/
+DWORD NetLog::Apply(Requests& requests, TestState& test_state) {
+  DWORD matched = 0;
+  if (all_requests_.IsEmpty() || !test_state._start.QuadPart ||
+      !test_state._ms_frequency.QuadPart)
+    return matched;
+
+  requests.Lock();
+  double offset = 0;
+  if (GetTickOffset(requests, test_state, offset)) {
+    POSITION pos = requests._requests.GetHeadPosition();
+    while (pos) {
+      Request * request = requests._requests.GetNext(pos);
+      if (!request || request->_from_browser)
+        continue;
+      CStringA url = RequestUrl(request);
+      NetLogRequest * entry = NULL;
+      if (!urls_.Lookup(url, entry))
+        continue;
+      // skip anything from before this step started (multi-step scripts)
+      CStringA method = request->_request_data.GetMethod();
+      while (entry && (entry->matched_ || !entry->IsComplete() ||
+                       entry->end_ - offset < 0 ||
+                       (!entry->method_.IsEmpty() && !method.IsEmpty() &&
+                        entry->method_.CompareNoCase(method))))
+        entry = entry->next_;
+      if (!entry)
+        continue;
+      entry->matched_ = true;
+      matched++;
+
+      SetTime(request->_start, entry->send_start_ ? entry->send_start_ :
+              entry->start_, offset, test_state);
+      SetTime(request->_first_byte, entry->first_byte_, offset, test_state);
+      SetTime(request->_end, entry->end_, offset, test_state);
+      if (!request->_bytes_in)
+        request->_bytes_in = entry->bytes_in_;
+
+      // HTTP/2 streams get their connection through the session
+      ULONGLONG stream = 0;
+      DWORD socket_id = entry->socket_id_;
+      if (!socket_id && streams_.Lookup(url, stream))
+        sessions_.Lookup((DWORD)(stream >> 32), socket_id);
+      NetLogSocket * socket = NULL;
+      if (socket_id && sockets_.Lookup(socket_id, socket) && socket) {
+        if (!socket->claimed_) {
+          socket->claimed_ = true;
+          SetTime(request->_connect_start, socket->connect_start_, offset,
+                  test_state);
+          SetTime(request->_connect_end, socket->connect_end_, offset,
+                  test_state);
+          SetTime(request->_ssl_start, socket->ssl_start_, offset,
+                  test_state);
+          SetTime(request->_ssl_end, socket->ssl_end_, offset, test_state);
+          CStringA host = request->GetHost();
+          host.MakeLower();
+          CAtlMap<CStringA, NetLogDns>::CPair * lookup = dns_.Lookup(host);
+          if (lookup && !lookup->m_value.claimed_) {
+            lookup->m_value.claimed_ = true;
+            SetTime(request->_dns_start, lookup->m_value.start_, offset,
+                    test_state);
+            SetTime(request->_dns_end, lookup->m_value.end_, offset,
+                    test_state);
+          }
+        }
+        // reused connection, don't let the socket hooks claim one
+        request->from_net_log_ = true;
+      }
+    }
+  }
+  requests.Unlock();
+
+  WptTrace(loglevel::kFunction,
+           _T("[wpthook] - NetLog::Apply() matched %d of %d requests\n"),
+           matched, all_requests_.GetCount());
+  return matched;
+}
+
+/*-----------------------------------------------------------------------------
+  Find the netlog tick that corresponds to the test start.  The log covers
+  the whole browser session (startup and the earlier steps included) so the
+  only anchor is the earliest hooked request of this step whose URL has
+  exactly one unmatched netlog request.  Without one the merge is skipped.
+-----------------------------------------------------------------------------*/
+bool NetLog::GetTickOffset(Requests& requests, TestState& test_state,
+                           double& offset) {
+  bool found = false;
+  LONGLONG hooked_start = 0;
+  double net_log_start = 0;
+  POSITION pos = requests._requests.GetHeadPosition();
+  while (pos) {
+    Request * request = requests._requests.GetNext(pos);
+    if (request && !request->_from_browser &&
+        request->_start.QuadPart > test_state._start.QuadPart &&
+        (!hooked_start || request->_start.QuadPart < hooked_start)) {
+      NetLogRequest * entry = UniqueUnmatched(RequestUrl(request));
+      if (entry && entry->IsComplete()) {
+        hooked_start = request->_start.QuadPart;
+        net_log_start = entry->send_start_ ? entry->send_start_ :
+                                             entry->start_;
+      }
+    }
+  }
+  if (hooked_start && net_log_start) {
+    LARGE_INTEGER start;
+    start.QuadPart = hooked_start;
+    offset = net_log_start - test_state.ElapsedMsFromStart(start);
+    found = true;
+  }
+  return found;
+}
+
+/*-----------------------------------------------------------------------------
+  The netlog request for the URL that no step has matched yet (NULL if
+  there are none or more than one)
+-----------------------------------------------------------------------------*/
+NetLogRequest * NetLog::UniqueUnmatched(const CStringA& url) {
+  NetLogRequest * ret = NULL;
+  NetLogRequest * entry = NULL;
+  if (urls_.Lookup(url, entry)) {
+    for (; entry; entry = entry->next_) {
+      if (!entry->matched_) {
+        if (ret) {
+          ret = NULL;
+          break;
+        }
+        ret = entry;
+      }
+    }
+  }
+  return ret;
+}
+
+/*-----------------------------------------------------------------------------
+  Convert a netlog tick into a performance counter time
+-----------------------------------------------------------------------------*/
+void NetLog::SetTime(LARGE_INTEGER& t, double tick, double offset,
+                     TestState& test_state) {
+  if (tick && tick >= offset)
+    t.QuadPart = test_state._start.QuadPart +
+        (LONGLONG)((tick - offset) * (double)test_state._ms_frequency.QuadPart);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void NetLog::OnStartObject(void) {
+  depth_++;
+  if (in_events_ && depth_ == 3) {
+    StartEvent();
+  } else if (event_depth_) {
+    int level = depth_ - event_depth_;
+    if (level < KEY_DEPTH)
+      keys_[level][0] = 0;
+  } else if (depth_ == 3 && in_constants_ && IsKey(1, "logEventTypes")) {
+    in_event_types_ = true;
+  }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void NetLog::OnEndObject(void) {
+  if (event_depth_ && depth_ == event_depth_) {
+    ProcessEvent();
+    event_depth_ = 0;
+  }
+  if (depth_ == 3)
+    in_event_types_ = false;
+  if (depth_ == 2)
+    in_constants_ = false;
+  depth_--;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void NetLog::OnStartArray(void) {
+  depth_++;
+  if (depth_ == 2 && IsKey(0, "events")) {
+    in_events_ = true;
+  } else if (event_depth_) {
+    int level = depth_ - event_depth_;
+    if (level < KEY_DEPTH)
+      keys_[level][0] = 0;
+  }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void NetLog::OnEndArray(void) {
+  if (depth_ == 2)
+    in_events_ = false;
+  depth_--;
+}
+
+/*-----------------------------------------------------------------------------
+  Keys are tracked relative to the event object while inside an event and
+  relative to the document root otherwise.
+-----------------------------------------------------------------------------*/
+void NetLog::OnKey(const char * key, DWORD len) {
+  int level = event_depth_ ? depth_ - event_depth_ : depth_ - 1;
+  if (in_event_types_ && depth_ == 3)
+    event_type_name_.SetString(key, len);
+  if (level >= 0 && level < KEY_DEPTH) {
+    len = min(len, (DWORD)KEY_LENGTH - 1);
+    memcpy(keys_[level], key, len);
+    keys_[level][len] = 0;
+    if (!event_depth_ && level == 0)
+      in_constants_ = !strcmp(keys_[0], "constants");
+  }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void NetLog::OnString(const char * value, DWORD len) {
+  if (!event_depth_)
+    return;
+  int level = depth_ - event_depth_;
+  if (level == 0) {
+    if (IsKey(0, "time")) {
+      CStringA time(value, len);
+      time_ = atof(time);
+    }
+  } else if (level == 1 && IsKey(0, "params")) {
+    if (IsKey(1, "url"))
+      url_.SetString(value, len);
+    else if (IsKey(1, "method"))
+      method_.SetString(value, len);
+    else if (IsKey(1, "host"))
+      host_.SetString(value, len);
+  } else if (level == 2 && IsKey(0, "params") && IsKey(1, "headers")) {
+    if (!keys_[2][0]) {
+      // array of "name: value" strings
+      ProcessHeader(value, len);
+    } else {
+      // object of name: value pairs
+      CStringA header(keys_[2]);
+      header += ": ";
+      header += CStringA(value, len);
+      ProcessHeader(header, header.GetLength());
+    }
+  }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void NetLog::OnNumber(double value) {
+  if (in_event_types_ && depth_ == 3) {
+    int count = _countof(NETLOG_EVENT_TYPES);
+    for (int i = 0; i < count; i++) {
+      if (event_type_name_ == NETLOG_EVENT_TYPES[i].name) {
+        event_types_.SetAt((int)value, NETLOG_EVENT_TYPES[i].type);
+        break;
+      }
+    }
+  } else if (event_depth_) {
+    int level = depth_ - event_depth_;
+    if (level == 0) {
+      if (IsKey(0, "phase"))
+        phase_ = (int)value;
+      else if (IsKey(0, "type"))
+        event_types_.Lookup((int)value, type_);
+      else if (IsKey(0, "time"))
+        time_ = value;
+    } else if (level == 1) {
+      if (IsKey(0, "source") && IsKey(1, "id"))
+        source_id_ = (DWORD)value;
+      else if (IsKey(0, "params") && IsKey(1, "byte_count"))
+        byte_count_ = (DWORD)value;
+      else if (IsKey(0, "params") && IsKey(1, "stream_id"))
+        stream_id_ = (DWORD)value;
+    } else if (level == 2 && IsKey(0, "params") &&
+               IsKey(1, "source_dependency") && IsKey(2, "id")) {
+      dependency_id_ = (DWORD)value;
+    }
+  }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+bool NetLog::IsKey(int level, const char * key) const {
+  return !strcmp(keys_[level], key);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void NetLog::StartEvent(void) {
+  event_depth_ = depth_;
+  for (int i = 0; i < KEY_DEPTH; i++)
+    keys_[i][0] = 0;
+  phase_ = 0;
+  type_ = 0;
+  time_ = 0;
+  source_id_ = 0;
+  dependency_id_ = 0;
+  byte_count_ = 0;
+  stream_id_ = 0;
+  url_.Empty();
+  method_.Empty();
+  host_.Empty();
+  header_scheme_.Empty();
+  header_host_.Empty();
+  header_path_.Empty();
+}
+
+/*-----------------------------------------------------------------------------
+  Pick the pseudo-headers that make up the URL out of a HTTP/2 stream
+-----------------------------------------------------------------------------*/
+void NetLog::ProcessHeader(const char * value, DWORD len) {
+  CStringA header(value, len);
+  int separator = header.Find(": ", 1);
+  if (separator > 0) {
+    CStringA name = header.Left(separator);
+    CStringA data = header.Mid(separator + 2);
+    if (name == ":scheme")
+      header_scheme_ = data;
+    else if (name == ":host" || name == ":authority")
+      header_host_ = data;
+    else if (name == ":path")
+      header_path_ = data;
+  }
+}
+
+/*-----------------------------------------------------------------------------
+  Fold a completed event into the request, socket and DNS state
+-----------------------------------------------------------------------------*/
+void NetLog::ProcessEvent(void) {
+  if (!type_ || !source_id_)
+    return;
+  switch (type_) {
+    case NETLOG_REQUEST_ALIVE: {
+        NetLogRequest * request = GetRequest(source_id_);
+        if (phase_ == PHASE_BEGIN && !request->start_)
+          request->start_ = time_;
+        else if (phase_ == PHASE_END && !request->end_)
+          request->end_ = time_;
+      }
+      break;
+    case NETLOG_URL_REQUEST_START_JOB:
+      if (phase_ == PHASE_BEGIN && !url_.IsEmpty()) {
+        NetLogRequest * request = GetRequest(source_id_);
+        if (!request->url_.IsEmpty()) {
+          // redirect, the URL request moves on to a new resource
+          if (!request->end_)
+            request->end_ = time_;
+          request = new NetLogRequest;
+          all_requests_.AddTail(request);
+          requests_.SetAt(source_id_, request);
+          request->start_ = time_;
+        }
+        request->url_ = url_;
+        request->method_ = method_;
+        NetLogRequest * previous = NULL;
+        if (urls_.Lookup(url_, previous) && previous) {
+          while (previous->next_)
+            previous = previous->next_;
+          previous->next_ = request;
+        } else {
+          urls_.SetAt(url_, request);
+        }
+      }
+      break;
+    case NETLOG_SEND_REQUEST: {
+        NetLogRequest * request = GetRequest(source_id_);
+        if (phase_ == PHASE_BEGIN && !request->send_start_)
+          request->send_start_ = time_;
+        else if (phase_ == PHASE_END && !request->send_end_)
+          request->send_end_ = time_;
+      }
+      break;
+    case NETLOG_READ_HEADERS:
+      if (phase_ == PHASE_END) {
+        NetLogRequest * request = GetRequest(source_id_);
+        if (!request->first_byte_)
+          request->first_byte_ = time_;
+      }
+      break;
+    case NETLOG_BYTES_READ: {
+        NetLogRequest * request = GetRequest(source_id_);
+        request->bytes_in_ += byte_count_;
+        request->end_ = time_;
+      }
+      break;
+    case NETLOG_REQUEST_BOUND_TO_JOB:
+      // logged on the URL request for the stream job that won
+      if (dependency_id_) {
+        jobs_.SetAt(dependency_id_, source_id_);
+        DWORD socket_id = 0;
+        if (job_sockets_.Lookup(dependency_id_, socket_id))
+          GetRequest(source_id_)->socket_id_ = socket_id;
+      }
+      break;
+    case NETLOG_BOUND_TO_SOCKET:
+      // logged on the HTTP stream job, not the URL request
+      if (dependency_id_) {
+        job_sockets_.SetAt(source_id_, dependency_id_);
+        DWORD request_id = 0;
+        NetLogRequest * request = NULL;
+        if (jobs_.Lookup(source_id_, request_id) &&
+            requests_.Lookup(request_id, request) && request)
+          request->socket_id_ = dependency_id_;
+      }
+      break;
+    case NETLOG_SESSION_INITIALIZED:
+      if (dependency_id_)
+        sessions_.SetAt(source_id_, dependency_id_);
+      break;
+    case NETLOG_SESSION_SEND_HEADERS:
+      if (!header_host_.IsEmpty() && !header_path_.IsEmpty()) {
+        CStringA url = header_scheme_.IsEmpty() ? "https" : header_scheme_;
+        url += "://";
+        url += header_host_;
+        url += header_path_;
+        if (!streams_.Lookup(url))
+          streams_.SetAt(url, ((ULONGLONG)source_id_ << 32) | stream_id_);
+      }
+      break;
+    case NETLOG_TCP_CONNECT: {
+        NetLogSocket * socket = GetSocket(source_id_);
+        if (phase_ == PHASE_BEGIN && !socket->connect_start_)
+          socket->connect_start_ = time_;
+        else if (phase_ == PHASE_END && !socket->connect_end_)
+          socket->connect_end_ = time_;
+      }
+      break;
+    case NETLOG_SSL_CONNECT: {
+        NetLogSocket * socket = GetSocket(source_id_);
+        if (phase_ == PHASE_BEGIN && !socket->ssl_start_)
+          socket->ssl_start_ = time_;
+        else if (phase_ == PHASE_END && !socket->ssl_end_)
+          socket->ssl_end_ = time_;
+      }
+      break;
+    case NETLOG_SOCKET_BYTES_RECEIVED:
+      GetSocket(source_id_)->bytes_in_ += byte_count_;
+      break;
+    case NETLOG_SOCKET_BYTES_SENT:
+      GetSocket(source_id_)->bytes_out_ += byte_count_;
+      break;
+    case NETLOG_HOST_RESOLVER_JOB:
+      if (phase_ == PHASE_BEGIN && !host_.IsEmpty()) {
+        NetLogDns lookup;
+        lookup.host_ = host_;
+        lookup.host_.MakeLower();
+        lookup.start_ = time_;
+        dns_jobs_.SetAt(source_id_, lookup);
+      } else if (phase_ == PHASE_END) {
+        CAtlMap<DWORD, NetLogDns>::CPair * job = dns_jobs_.Lookup(source_id_);
+        if (job) {
+          job->m_value.end_ = time_;
+          if (!dns_.Lookup(job->m_value.host_))
+            dns_.SetAt(job->m_value.host_, job->m_value);
+          dns_jobs_.RemoveKey(source_id_);
+        }
+      }
+      break;
+  }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+NetLogRequest * NetLog::GetRequest(DWORD id) {
+  NetLogRequest * request = NULL;
+  if (!requests_.Lookup(id, request) || !request) {
+    request = new NetLogRequest;
+    all_requests_.AddTail(request);
+    requests_.SetAt(id, request);
+  }
+  return request;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+NetLogSocket * NetLog::GetSocket(DWORD id) {
+  NetLogSocket * socket = NULL;
+  if (!sockets_.Lookup(id, socket) || !socket) {
+    socket = new NetLogSocket;
+    sockets_.SetAt(id, socket);
+  }
+  return socket;
+}
@@ -0,0 +1,184 @@
+/******************************************************************************
+Copyright (c) 2014, Google Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+    * Neither the name of the <ORGANIZATION> nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+#pragma once
+#include "json_stream.h"
+
+class Requests;
+class TestState;
+
+// Netlog times are in milliseconds on the browser's tick clock (0 = not set)
+class NetLogRequest {
+public:
+  NetLogRequest(void):
+    start_(0), dns_start_(0), dns_end_(0), connect_start_(0), connect_end_(0)
+    ,ssl_start_(0), ssl_end_(0), send_start_(0), send_end_(0)
+    ,first_byte_(0), end_(0), socket_id_(0), session_id_(0), stream_id_(0)
+    ,bytes_in_(0), matched_(false), next_(NULL) {}
+  ~NetLogRequest(void){}
+  bool IsComplete(void) const {
+    double start = send_start_ ? send_start_ : start_;
+    return start && first_byte_ >= start && end_ >= first_byte_;
+  }
+
+  CStringA  url_;
+  CStringA  method_;
+  double    start_;
+  double    dns_start_;
+  double    dns_end_;
+  double    connect_start_;
+  double    connect_end_;
+  double    ssl_start_;
+  double    ssl_end_;
+  double    send_start_;
+  double    send_end_;
+  double    first_byte_;
+  double    end_;
+  DWORD     socket_id_;
+  DWORD     session_id_;   // HTTP/2 (SPDY) session the stream ran on
+  DWORD     stream_id_;
+  DWORD     bytes_in_;
+  bool      matched_;
+  NetLogRequest * next_;   // next request for the same URL
+};
+
+class NetLogSocket {
+public:
+  NetLogSocket(void):
+    connect_start_(0), connect_end_(0), ssl_start_(0), ssl_end_(0)
+    ,bytes_in_(0), bytes_out_(0), claimed_(false) {}
+  ~NetLogSocket(void){}
+
+  double  connect_start_;
+  double  connect_end_;
+  double  ssl_start_;
+  double  ssl_end_;
+  DWORD   bytes_in_;
+  DWORD   bytes_out_;
+  bool    claimed_;
+};
+
+class NetLogDns {
+public:
+  NetLogDns(void):start_(0),end_(0),claimed_(false){}
+  NetLogDns(const NetLogDns& src){*this = src;}
+  ~NetLogDns(void){}
+  const NetLogDns& operator =(const NetLogDns& src) {
+    host_ = src.host_;
+    start_ = src.start_;
+    end_ = src.end_;
+    claimed_ = src.claimed_;
+    return src;
+  }
+
+  CStringA  host_;
+  double    start_;
+  double    end_;
+  bool      claimed_;
+};
+
+/*-----------------------------------------------------------------------------
+  Streaming reader for the Chrome netlog (--log-net-log).  Rebuilds the
+  per-request DNS, connect, SSL, send, first byte and end times (including
+  HTTP/2 stream mapping) and merges them into the socket-level requests,
+  which are then only used as a fallback for anything the netlog missed.
+  The log covers the whole browser session so one reader is kept for all
+  of the steps and each Load() only parses what was appended since.
+-----------------------------------------------------------------------------*/
+class NetLog : public JsonStreamHandler {
+public:
+  NetLog(void);
+  ~NetLog(void);
+
+  void Reset(void);
+  bool Load(CString file);
+  void AddData(const char * data, DWORD len);
+  DWORD Apply(Requests& requests, TestState& test_state);
+
+  // JsonStreamHandler
+  virtual void OnStartObject(void);
+  virtual void OnEndObject(void);
+  virtual void OnStartArray(void);
+  virtual void OnEndArray(void);
+  virtual void OnKey(const char * key, DWORD len);
+  virtual void OnString(const char * value, DWORD len);
+  virtual void OnNumber(double value);
+
+private:
+  static const int KEY_DEPTH = 5;
+  static const int KEY_LENGTH = 32;
+
+  void StartEvent(void);
+  void ProcessEvent(void);
+  void ProcessHeader(const char * value, DWORD len);
+  NetLogRequest * GetRequest(DWORD id);
+  NetLogSocket * GetSocket(DWORD id);
+  bool GetTickOffset(Requests& requests, TestState& test_state,
+                     double& offset);
+  NetLogRequest * UniqueUnmatched(const CStringA& url);
+  void SetTime(LARGE_INTEGER& t, double tick, double offset,
+               TestState& test_state);
+  bool IsKey(int level, const char * key) const;
+
+  JsonStream  stream_;
+  CString     file_;
+  LONGLONG    file_offset_;   // bytes of file_ already parsed
+  int         depth_;
+  bool        in_constants_;
+  bool        in_event_types_;
+  bool        in_events_;
+  int         event_depth_;
+  char        keys_[KEY_DEPTH][KEY_LENGTH];
+  CStringA    event_type_name_;
+
+  // fields of the event currently being parsed
+  int       phase_;
+  int       type_;
+  double    time_;
+  DWORD     source_id_;
+  DWORD     dependency_id_;
+  DWORD     byte_count_;
+  DWORD     stream_id_;
+  CStringA  url_;
+  CStringA  method_;
+  CStringA  host_;
+  CStringA  header_scheme_;
+  CStringA  header_host_;
+  CStringA  header_path_;
+
+  CAtlMap<int, int>                 event_types_;   // netlog id -> ours
+  CAtlMap<DWORD, NetLogRequest *>   requests_;      // by source id
+  CAtlMap<DWORD, NetLogSocket *>    sockets_;       // by source id
+  CAtlMap<DWORD, DWORD>             sessions_;      // session -> socket
+  CAtlMap<DWORD, DWORD>             jobs_;          // stream job -> request
+  CAtlMap<DWORD, DWORD>             job_sockets_;   // stream job -> socket
+  CAtlMap<DWORD, NetLogDns>         dns_jobs_;      // by source id
+  CAtlMap<CStringA, NetLogDns>      dns_;           // by host
+  CAtlMap<CStringA, NetLogRequest *> urls_;         // by URL
+  CAtlMap<CStringA, ULONGLONG>      streams_;       // URL -> session, stream
+  CAtlList<NetLogRequest *>         all_requests_;
+};
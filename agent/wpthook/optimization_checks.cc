@@ -36,7 +36,6 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "../wptdriver/wpt_test.h"
 
 #include "cximage/ximage.h"
-#include <zlib.h>
 #include <regex>
 #include <string>
 #include <sstream>
@@ -55,12 +54,17 @@ OptimizationChecks::OptimizationChecks(Requests& requests,
   , _gzip_score(-1)
   , _gzip_total(0)
   , _gzip_target(0)
+  , _minify_score(-1)
+  , _minify_total(0)
+  , _minify_target(0)
   , _image_compression_score(-1)
   , _cache_score(-1)
   , _combine_score(-1)
   , _static_cdn_score(-1)
   , _progressive_jpeg_score(-1)
-  , _checked(false) {
+  , _checked(false)
+  , _analyzer(requests.analyzer_)
+  , _analysis_cache(requests.analyzer_.cache_) {
   InitializeCriticalSection(&_cs_cdn);
 }
 
@@ -77,14 +81,19 @@ void OptimizationChecks::Check(void) {
   WptTrace(loglevel::kFunction,
     _T("[wpthook] - OptimizationChecks::Check()\n"));
 
+  // most of the expensive results were calculated during the test
+  _analyzer.LoadCache();
+
   CheckKeepAlive();
   CheckGzip();
   CheckImageCompression();
   CheckProgressiveJpeg();
   CheckCacheStatic();
   CheckCombine();
+  CheckMinify();
   CheckCDN();
   CheckCustomRules();
+  _analysis_cache.Save();
   _checked = true;
 
   WptTrace(loglevel::kFunction,
@@ -192,39 +201,14 @@ void OptimizationChecks::CheckGzip()
         LPBYTE bodyData = (LPBYTE)body.GetData();
         DWORD bodyLen = body.GetLength();
         // don't try gzip for known image formats that shouldn't be gzipped
-        if ((bodyLen > 3 &&             // JPEG FF D8 FF
-             bodyData[0] == 0xFF &&
-             bodyData[1] == 0xD8 &&
-             bodyData[2] == 0xFF) ||
-            (bodyLen > 8 &&             // PNG 89 50 4E 47 0D 0A 1A 0A
-             bodyData[0] == 0x89 &&
-             bodyData[1] == 0x50 &&
-             bodyData[2] == 0x4E &&
-             bodyData[3] == 0x47 &&
-             bodyData[4] == 0x0D &&
-             bodyData[5] == 0x0A &&
-             bodyData[6] == 0x1A &&
-             bodyData[7] == 0x0A) ||
-            (bodyLen > 6 &&             // Gif 47 49 46 38 37(9) 61
-             bodyData[0] == 0x47 &&
-             bodyData[1] == 0x49 &&
-             bodyData[2] == 0x46 &&
-             bodyData[3] == 0x38 &&
-             bodyData[5] == 0x61)) {
+        if (ResponseAnalyzer::IsCompressedImage(bodyData, bodyLen)) {
           request->_scores._gzip_score = -1;
         } else {
           DWORD headSize = request->_response_data.GetHeaders().GetLength();
           if (bodyLen && bodyData) {
-            DWORD len = compressBound(bodyLen);
-            if( len ) {
-              char* buff = (char*) malloc(len);
-              if( buff ) {
-                // Do the compression and check the target bytes to set for this.
-                if (compress2((LPBYTE)buff, &len, bodyData, bodyLen, 7) == Z_OK)
-                  targetRequestBytes = len + headSize;
-                free(buff);
-              }
-            }
+            DWORD compressed = _analyzer.GzipSize(bodyData, bodyLen);
+            if (compressed)
+              targetRequestBytes = compressed + headSize;
             // allow a pass if we don't get 10% savings or less than 1400 bytes
             if( targetRequestBytes >= (origSize * 0.9) || 
                 origSize - targetRequestBytes < 1400 ) {
@@ -259,20 +243,73 @@ void OptimizationChecks::CheckGzip()
 }
 
 /*-----------------------------------------------------------------------------
-  Protect against malformed images
+  Check each js and css response to make sure it has been minified.
 -----------------------------------------------------------------------------*/
-static bool DecodeImage(CxImage& img, BYTE * buffer, DWORD size,
-                        DWORD imagetype)
+void OptimizationChecks::CheckMinify()
 {
-  bool ret = false;
-  
-  __try{
-    ret = img.Decode(buffer, size, imagetype);
-  }__except(1){
-    WptTrace(loglevel::kError,
-      _T("[wpthook] - Exception when decoding image"));
+  int count = 0;
+  DWORD totalBytes = 0;
+  DWORD targetBytes = 0;
+
+  _requests.Lock();
+  POSITION pos = _requests._requests.GetHeadPosition();
+  while( pos ) {
+    Request *request = _requests._requests.GetNext(pos);
+    if (request && request->_processed && request->GetResult() == 200) {
+      int temp_pos = 0;
+      CStringA mime = request->GetResponseHeader("content-type").Tokenize(";",
+        temp_pos);
+      mime.MakeLower();
+      bool css = mime.Find("/css") >= 0;
+      DataChunk body = request->_response_data.GetBody(true);
+      if ((css || mime.Find("javascript") >= 0 || mime.Find("json") >= 0) &&
+          body.GetData() && body.GetLength()) {
+        count++;
+        DWORD size = request->_response_data.GetDataSize();
+        DWORD targetRequestBytes = size;
+        request->_scores._minify_score = 100;
+
+        // Spare small (<1 packet) responses.
+        if (size >= 1400) {
+          // if the original was gzipped, compare against the minified and
+          // gzipped size.
+          CStringA encoding = request->GetResponseHeader("content-encoding");
+          encoding.MakeLower();
+          bool gzip = encoding.Find("gzip") >= 0;
+          DWORD minified = _analyzer.MinifiedSize(body.GetData(),
+                                                  body.GetLength(), css, gzip);
+          if (minified) {
+            DWORD headSize = request->_response_data.GetHeaders().GetLength();
+            targetRequestBytes = min(minified + headSize, size);
+          }
+
+          // Fail if it saves more than 5KB or 10%, warn for more than 1KB.
+          DWORD savings = size - targetRequestBytes;
+          if (savings > 5120 || targetRequestBytes <= size * 0.9)
+            request->_scores._minify_score = 0;
+          else if (savings > 1024)
+            request->_scores._minify_score = 50;
+          else
+            targetRequestBytes = size;
+        }
+
+        request->_scores._minify_total = size;
+        request->_scores._minify_target = targetRequestBytes;
+        totalBytes += size;
+        targetBytes += targetRequestBytes;
+      }
+    }
   }
-  return ret;
+  _requests.Unlock();
+
+  _minify_total = totalBytes;
+  _minify_target = targetBytes;
+
+  if( count && totalBytes )
+    _minify_score = targetBytes * 100 / totalBytes;
+  WptTrace(loglevel::kFunction,
+    _T("[wpthook] - OptChecks::CheckMinify() minify score: %d\n"),
+    _minify_score);
 }
 
 /*-----------------------------------------------------------------------------
@@ -307,11 +344,11 @@ void OptimizationChecks::CheckImageCompression()
           DWORD size = targetRequestBytes;
           count++;
         
-          CxImage img;
-          // Decode the image with an exception protected function.
-          if (DecodeImage(img, (BYTE*)body.GetData(),
-                          body.GetLength(), CXIMAGE_FORMAT_UNKNOWN) ) {
-            DWORD type = img.GetType();
+          DWORD type = 0;
+          DWORD encoded = 0;
+          bool decoded = _analyzer.JpegSize(buffer, size, type, encoded);
+
+          if (decoded) {
             switch (type) {
             // TODO: Add appropriate scores for gif and png
             //       once they are available.
@@ -321,17 +358,8 @@ void OptimizationChecks::CheckImageCompression()
             //  request->_scores._imageCompressionScore = 100;
             //  break;
             case CXIMAGE_FORMAT_JPG:
-              {
-                img.SetCodecOption(8, CXIMAGE_FORMAT_JPG);  // optimized encoding
-                img.SetCodecOption(16, CXIMAGE_FORMAT_JPG); // progressive
-                img.SetJpegQuality(85);
-                BYTE* mem = NULL;
-                int len = 0;
-                if( img.Encode(mem, len, CXIMAGE_FORMAT_JPG) && len ) {
-                  img.FreeMemory(mem);
-                  targetRequestBytes = (DWORD) len < size ? (DWORD)len: size;
-                }
-              }
+              if (encoded)
+                targetRequestBytes = encoded < size ? encoded : size;
               break;
             default:
               request->_scores._image_compression_score = 0;
@@ -586,30 +614,39 @@ void OptimizationChecks::CheckCustomRules() {
       const char * body_data = body.GetData();
       DWORD body_len = body.GetLength();
       if (body_len && body_data) {
+        CStringA body_key = _analysis_cache.Key("rule", body_data, body_len);
+        std::string mime = (LPCSTR)request->GetMime();
         POSITION rule_pos = _test._custom_rules.GetHeadPosition();
         while (rule_pos) {
-          CustomRule rule = _test._custom_rules.GetNext(rule_pos);
-          std::string mime = (LPCSTR)request->GetMime();
-          std::tr1::regex mime_regex(CT2A(rule._mime), 
-                                      std::tr1::regex_constants::icase | 
-                                      std::tr1::regex_constants::ECMAScript);
-          if (regex_search(mime.begin(), mime.end(), mime_regex)) {
+          const CustomRule& rule = _test._custom_rules.GetNext(rule_pos);
+          if (regex_search(mime.begin(), mime.end(), rule._mime_regex)) {
             CustomRulesMatch match;
             match._name = rule._name;
-            std::string body(body_data, body_len);
-            std::tr1::regex match_regex(CT2A(rule._regex), 
-                                      std::tr1::regex_constants::icase | 
-                                      std::tr1::regex_constants::ECMAScript);
-            const std::tr1::sregex_token_iterator end;
-            std::tr1::sregex_token_iterator i(body.begin(), body.end(), 
-                                              match_regex);
-            while (i != end) {
-              match._count++;
-              if (match._value.IsEmpty()) {
-                std::string match_string = *i;
-                match._value = CA2T(match_string.c_str());
+            // cached as "count<tab>first match" keyed on the body and regex
+            CStringA key = body_key + ":" +
+                           CStringA(CT2A(rule._regex, CP_UTF8));
+            CStringA cached;
+            int separator = -1;
+            if (_analysis_cache.Get(key, cached) &&
+                (separator = cached.Find('\t')) > 0) {
+              match._count = atoi(cached.Left(separator));
+              match._value = CA2T(cached.Mid(separator + 1), CP_UTF8);
+            } else {
+              std::string body(body_data, body_len);
+              const std::tr1::sregex_token_iterator end;
+              std::tr1::sregex_token_iterator i(body.begin(), body.end(), 
+                                                rule._body_regex);
+              while (i != end) {
+                match._count++;
+                if (match._value.IsEmpty()) {
+                  std::string match_string = *i;
+                  match._value = CA2T(match_string.c_str());
+                }
+                i++;
               }
-              i++;
+              cached.Format("%d\t", match._count);
+              cached += CT2A(match._value, CP_UTF8);
+              _analysis_cache.Set(key, cached);
             }
             request->_custom_rules_matches.AddTail(match);
           }
@@ -647,15 +684,7 @@ void OptimizationChecks::CheckProgressiveJpeg() {
         if (buffer[0] == 0xFF && buffer[1] == 0xD8) {
           DWORD len = body.GetLength();
           request->_scores._jpeg_scans = 0;
-          DWORD pos = 0;
-          BYTE * marker;
-          DWORD marker_length;
-          while (FindJPEGMarker(buffer, len, pos, marker, marker_length) &&
-                 marker) {
-            if (marker[0] == 0xff && marker[1] == 0xda)
-              request->_scores._jpeg_scans++;
-            pos += marker_length;
-          }
+          request->_scores._jpeg_scans = _analyzer.JpegScans(buffer, len);
 
           if (len > 10240 && request->_scores._jpeg_scans > 0) {
             total_bytes += len;
@@ -677,56 +706,3 @@ void OptimizationChecks::CheckProgressiveJpeg() {
     _T("[wpthook] - OptChecks::CheckProgressiveJpeg() score: %d\n"),
     _progressive_jpeg_score);
 }
-
-/*-----------------------------------------------------------------------------
-  Given a JPEG byte stream, find the next marker
------------------------------------------------------------------------------*/
-bool OptimizationChecks::FindJPEGMarker(BYTE * buff, DWORD len, DWORD &pos,
-                                        BYTE * &marker, DWORD &marker_len) {
-  bool found = false;
-  marker = NULL;
-  marker_len = 0;
-  BYTE sos = 0xda;
-  if (pos < len) {
-    BYTE val = buff[pos];
-    if (val == 0xff) {
-      // ff can repeat, the actual marker comes from the first non-ff
-      while (val == 0xff && pos < len) {
-        pos++;
-        val = buff[pos];
-      }
-      marker = &buff[pos - 1];
-      pos++;
-      if ((val >= 0xd0 && val <= 0xd9) || val == 0x01) {
-        found = true;
-      } else if(val == sos) {
-        // image data
-        DWORD marker_end = pos + 1;
-        DWORD next_marker = len;
-        while (marker_end < len - 1 && !found) {
-          val = buff[marker_end];
-          if (val == 0xff) {
-            DWORD i = marker_end + 1;
-            val = buff[i];
-            if (val != 0x00) {   // escaping
-              while (i < len - 1 && val == 0xff) {
-                i++;
-                val = buff[i];
-              }
-              next_marker = marker_end;
-              found = true;
-            }
-          }
-          marker_end++;
-        }
-        marker_len = next_marker - pos;
-      } else if (pos + 1 < len) {
-        BYTE v1 = buff[pos];
-        BYTE v2 = buff[pos + 1];
-        marker_len = (DWORD)v1 * 256 + (DWORD)v2;
-        found = true;
-      }
-    }
-  }
-  return found;
-}
@@ -28,6 +28,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #pragma once
 
+#include "response_analyzer.h"
+
 class Requests;
 class TestState;
 class Request;
@@ -47,6 +49,9 @@ public:
   int   _gzip_score;
   DWORD _gzip_total;
   DWORD _gzip_target;
+  int   _minify_score;
+  DWORD _minify_total;
+  DWORD _minify_target;
   int   _image_compression_score;
   DWORD _image_compress_total;
   DWORD _image_compress_target;
@@ -70,11 +75,11 @@ private:
   void CheckGzip();
   void CheckImageCompression();
   void CheckKeepAlive();
+  void CheckMinify();
   void CheckProgressiveJpeg();
   bool IsCDN(Request * request, CStringA &provider);
 
-  bool FindJPEGMarker(BYTE * buff, DWORD len, DWORD &pos,
-                      BYTE * &marker, DWORD &marker_len);
-
-  CRITICAL_SECTION _cs_cdn;
+  CRITICAL_SECTION  _cs_cdn;
+  ResponseAnalyzer& _analyzer;
+  AnalysisCache&    _analysis_cache;
 };
@@ -0,0 +1,263 @@
+/******************************************************************************
+Copyright (c) 2014, Google Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+    * Neither the name of the <ORGANIZATION> nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+#include "StdAfx.h"
+#include "replay_archive.h"
+#include "requests.h"
+#include "request.h"
+
+static const char ARCHIVE_SIGNATURE[] = "WPTA";
+static const DWORD SIGNATURE_LEN = 4;
+static const TCHAR * ARCHIVE_FILE = _T("\\archive.dat");
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+ReplayArchive::ReplayArchive(void):
+  file_(INVALID_HANDLE_VALUE)
+  ,mapping_(NULL)
+  ,data_(NULL) {
+  index_.InitHashTable(1021);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+ReplayArchive::~ReplayArchive(void) {
+  Close();
+}
+
+/*-----------------------------------------------------------------------------
+  Build the lookup key for a request.  The path is URL-decoded the same way
+  the replay server sees it.
+-----------------------------------------------------------------------------*/
+CStringA ReplayArchive::Key(CStringA method, CStringA host, CStringA path,
+                            CStringA query) {
+  method.MakeUpper();
+  host.Trim();
+  host.MakeLower();
+  if (host.Right(3) == ":80")
+    host = host.Left(host.GetLength() - 3);
+  CStringA decoded;
+  int len = path.GetLength();
+  for (int i = 0; i < len; i++) {
+    char c = path[i];
+    if (c == '%' && i + 2 < len && isxdigit((BYTE)path[i + 1]) &&
+        isxdigit((BYTE)path[i + 2])) {
+      c = (char)strtoul(path.Mid(i + 1, 2), NULL, 16);
+      i += 2;
+    }
+    decoded.AppendChar(c);
+  }
+  CStringA key = method + " " + host + decoded;
+  if (!query.IsEmpty())
+    key += CStringA("?") + query;
+  return key;
+}
+
+/*-----------------------------------------------------------------------------
+  Add the responses from the run that aren't in the archive yet.  Only
+  complete responses are recorded: revalidations (304) and partial content
+  (206) would otherwise be served in place of the full response for the
+  URL (the first one recorded wins) and a body that is missing data (over
+  the hook's 10MB capture limit or short of its Content-Length) would
+  replay a broken resource.
+-----------------------------------------------------------------------------*/
+void ReplayArchive::Record(Requests& requests, CString directory) {
+  Close();
+  CreateDirectory(directory, NULL);
+  CString file_name = directory + ARCHIVE_FILE;
+
+  // index what is already there (the first view when recording the repeat)
+  HANDLE file = CreateFile(file_name, GENERIC_READ | GENERIC_WRITE, 0, 0,
+                           OPEN_ALWAYS, 0, 0);
+  if (file == INVALID_HANDLE_VALUE)
+    return;
+  DWORD size = GetFileSize(file, NULL);
+  if (size && size != INVALID_FILE_SIZE) {
+    BYTE * existing = (BYTE *)malloc(size);
+    DWORD bytes = 0;
+    if (existing) {
+      if (ReadFile(file, existing, size, &bytes, 0) && bytes == size)
+        Index(existing, size);
+      free(existing);
+    }
+  }
+  CStringA archive;
+  if (!size)
+    archive.Append(ARCHIVE_SIGNATURE, SIGNATURE_LEN);
+
+  int count = 0;
+  requests.Lock();
+  POSITION pos = requests._requests.GetHeadPosition();
+  while (pos) {
+    Request * request = requests._requests.GetNext(pos);
+    int result = request ? request->GetResult() : 0;
+    if (request && request->_processed && !request->_is_ssl &&
+        result > 0 && result != 304 && result != 206 &&
+        !request->_response_data.IsTruncated()) {
+      CStringA object = request->_request_data.GetObject();
+      int query_pos = object.Find('?');
+      CStringA key = Key(request->_request_data.GetMethod(),
+                         request->GetHost(),
+                         query_pos >= 0 ? object.Left(query_pos) : object,
+                         query_pos >= 0 ? object.Mid(query_pos + 1) : "");
+      if (!index_.Lookup(key)) {
+        CStringA response;
+        CStringA headers = request->_response_data.GetHeaders();
+        int line_pos = 0;
+        CStringA line = headers.Tokenize("\r\n", line_pos);
+        while (line_pos >= 0) {
+          CStringA field = line.Left(line.Find(':')).Trim();
+          if (field.CompareNoCase("Content-Length") &&
+              field.CompareNoCase("Transfer-Encoding") &&
+              field.CompareNoCase("Connection") &&
+              field.CompareNoCase("Keep-Alive") &&
+              field.CompareNoCase("Proxy-Connection"))
+            response += line + "\r\n";
+          line = headers.Tokenize("\r\n", line_pos);
+        }
+        DataChunk body = request->_response_data.GetBody();
+        CStringA content_length =
+            request->_response_data.GetHeader("content-length").Trim();
+        if (!content_length.IsEmpty() &&
+            strtoul(content_length, NULL, 10) != body.GetLength())
+          continue;
+        CStringA length;
+        length.Format("Content-Length: %d\r\n\r\n", body.GetLength());
+        response += length;
+        if (body.GetLength())
+          response.Append(body.GetData(), body.GetLength());
+
+        DWORD key_len = key.GetLength();
+        DWORD response_len = response.GetLength();
+        archive.Append((LPCSTR)&key_len, sizeof(key_len));
+        archive += key;
+        archive.Append((LPCSTR)&response_len, sizeof(response_len));
+        archive += response;
+        index_.SetAt(key, Entry());
+        count++;
+      }
+    }
+  }
+  requests.Unlock();
+
+  if (!archive.IsEmpty()) {
+    SetFilePointer(file, 0, 0, FILE_END);
+    DWORD written = 0;
+    WriteFile(file, (LPCSTR)archive, archive.GetLength(), &written, 0);
+  }
+  CloseHandle(file);
+  index_.RemoveAll();
+  WptTrace(loglevel::kFunction,
+    _T("[wpthook] - ReplayArchive::Record() %d responses added\n"), count);
+}
+
+/*-----------------------------------------------------------------------------
+  Map the archive for the replay runs
+-----------------------------------------------------------------------------*/
+bool ReplayArchive::Open(CString directory) {
+  Close();
+  file_ = CreateFile(directory + ARCHIVE_FILE, GENERIC_READ, FILE_SHARE_READ,
+                     0, OPEN_EXISTING, 0, 0);
+  if (file_ != INVALID_HANDLE_VALUE) {
+    DWORD size = GetFileSize(file_, NULL);
+    if (size && size != INVALID_FILE_SIZE) {
+      mapping_ = CreateFileMapping(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+      if (mapping_)
+        data_ = (const BYTE *)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+      if (data_)
+        Index(data_, size);
+    }
+  }
+  if (!data_)
+    Close();
+  WptTrace(loglevel::kFunction,
+    _T("[wpthook] - ReplayArchive::Open() %d responses\n"),
+    (int)index_.GetCount());
+  return data_ != NULL;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void ReplayArchive::Close(void) {
+  index_.RemoveAll();
+  if (data_)
+    UnmapViewOfFile(data_);
+  data_ = NULL;
+  if (mapping_)
+    CloseHandle(mapping_);
+  mapping_ = NULL;
+  if (file_ != INVALID_HANDLE_VALUE)
+    CloseHandle(file_);
+  file_ = INVALID_HANDLE_VALUE;
+}
+
+/*-----------------------------------------------------------------------------
+  Find the response for a request (points into the mapping)
+-----------------------------------------------------------------------------*/
+bool ReplayArchive::Find(const CStringA& key, const char *& response,
+                         DWORD& len) {
+  bool found = false;
+  Entry entry;
+  if (data_ && index_.Lookup(key, entry)) {
+    response = (const char *)&data_[entry.offset];
+    len = entry.len;
+    found = true;
+  }
+  return found;
+}
+
+/*-----------------------------------------------------------------------------
+  Index the records, stopping at anything that doesn't fit (a partial write)
+-----------------------------------------------------------------------------*/
+void ReplayArchive::Index(const BYTE * data, DWORD size) {
+  index_.RemoveAll();
+  if (size < SIGNATURE_LEN || memcmp(data, ARCHIVE_SIGNATURE, SIGNATURE_LEN))
+    return;
+  DWORD pos = SIGNATURE_LEN;
+  while (pos + sizeof(DWORD) <= size) {
+    DWORD key_len, response_len;
+    memcpy(&key_len, &data[pos], sizeof(key_len));
+    pos += sizeof(key_len);
+    if (key_len > size - pos)
+      break;
+    CStringA key((const char *)&data[pos], key_len);
+    pos += key_len;
+    if (pos + sizeof(response_len) > size)
+      break;
+    memcpy(&response_len, &data[pos], sizeof(response_len));
+    pos += sizeof(response_len);
+    if (response_len > size - pos)
+      break;
+    if (!index_.Lookup(key)) {
+      Entry entry;
+      entry.offset = pos;
+      entry.len = response_len;
+      index_.SetAt(key, entry);
+    }
+    pos += response_len;
+  }
+}
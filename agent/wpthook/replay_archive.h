@@ -0,0 +1,86 @@
+/******************************************************************************
+Copyright (c) 2014, Google Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+    * Neither the name of the <ORGANIZATION> nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+#pragma once
+
+class Requests;
+
+// sub-directory of the test results directory that holds the archive (it
+// lives for the whole job, like the analysis cache)
+const TCHAR * const REPLAY_DIRECTORY = _T("replay");
+
+// replay modes (passed from the driver to the hook)
+const int REPLAY_OFF = 0;
+const int REPLAY_RECORD = 1;
+const int REPLAY_PLAY = 2;
+
+/*-----------------------------------------------------------------------------
+  Archive of the plain-HTTP responses from the record run of a test that
+  the replay runs are served from.  Responses are keyed by the normalized
+  request (method, host without the default port, decoded path and the
+  raw query string) and stored ready to send: the original status line and
+  headers with the framing replaced by a Content-Length for the de-chunked
+  (still content-encoded) body.
+
+  The file is append-only:
+
+    "WPTA" then per response:
+      DWORD(key length) key DWORD(response length) response
+
+  and is memory-mapped read-only for replay so looking up a response is
+  just an index lookup into the mapping.  The first response recorded for
+  a key wins so only complete responses (no 304s, 206s or truncated
+  bodies) are recorded.
+-----------------------------------------------------------------------------*/
+class ReplayArchive {
+public:
+  ReplayArchive(void);
+  ~ReplayArchive(void);
+
+  static CStringA Key(CStringA method, CStringA host, CStringA path,
+                      CStringA query);
+
+  void Record(Requests& requests, CString directory);
+  bool Open(CString directory);
+  void Close(void);
+  bool Find(const CStringA& key, const char *& response, DWORD& len);
+
+private:
+  class Entry {
+  public:
+    Entry():offset(0),len(0){}
+    DWORD offset;
+    DWORD len;
+  };
+
+  void Index(const BYTE * data, DWORD size);
+
+  HANDLE                    file_;
+  HANDLE                    mapping_;
+  const BYTE *              data_;
+  CAtlMap<CStringA, Entry>  index_;
+};
@@ -0,0 +1,184 @@
+/******************************************************************************
+Copyright (c) 2014, Google Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+    * Neither the name of the <ORGANIZATION> nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+#include "StdAfx.h"
+#include "replay_server.h"
+#include "mongoose/mongoose.h"
+
+static ReplayServer * _global_replay_server = NULL;
+
+static const USHORT REPLAY_PORT = 8889;
+static const USHORT HTTP_PORT = 80;
+static const char * NOT_FOUND = "HTTP/1.1 404 Not Found\r\n"
+                                "Content-Length: 0\r\n\r\n";
+
+/*-----------------------------------------------------------------------------
+  Stub callback to trampoline into the class instance
+-----------------------------------------------------------------------------*/
+static void *ReplayCallbackStub(enum mg_event event,
+                           struct mg_connection *conn,
+                           const struct mg_request_info *request_info) {
+  void *processed = "yes";
+
+  if (_global_replay_server)
+    _global_replay_server->MongooseCallback(event, conn, request_info);
+
+  return processed;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+ReplayServer::ReplayServer(void):
+  mongoose_context_(NULL)
+  ,running_(false) {
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+ReplayServer::~ReplayServer(void) {
+  Stop();
+}
+
+/*-----------------------------------------------------------------------------
+  Map the archive and start serving it
+-----------------------------------------------------------------------------*/
+bool ReplayServer::Start(CString directory) {
+  if (!mongoose_context_ && archive_.Open(directory)) {
+    _global_replay_server = this;
+
+    static const char *options[] = {
+      "listening_ports", "127.0.0.1:8889",
+      "num_threads", "10",
+      "enable_keep_alive", "yes",
+      NULL
+    };
+
+    mongoose_context_ = mg_start(&ReplayCallbackStub, options);
+    if (mongoose_context_)
+      running_ = true;
+    else
+      archive_.Close();
+  }
+  WptTrace(loglevel::kProcess,
+    _T("[wpthook] - ReplayServer::Start() %s\n"),
+    running_ ? _T("serving") : _T("failed"));
+
+  return running_;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void ReplayServer::Stop(void) {
+  running_ = false;
+  if (mongoose_context_) {
+    mg_stop(mongoose_context_);
+    mongoose_context_ = NULL;
+  }
+  _global_replay_server = NULL;
+  archive_.Close();
+}
+
+/*-----------------------------------------------------------------------------
+  Point plain-HTTP connects at the replay server (called from the connect
+  hooks before the real connect).  The caller's address belongs to the
+  browser so the redirected one is built in replay_name and that is what
+  gets passed to the real connect.
+
+  The replay server only listens on IPv4 so IPv6 sockets are switched to
+  dual-stack and pointed at the v4-mapped loopback.  If that isn't
+  possible (the socket is already bound, as it is for ConnectEx) they are
+  sent to the IPv6 loopback where nothing listens so the connect is
+  refused and the browser falls back to IPv4 instead of going live.
+-----------------------------------------------------------------------------*/
+const struct sockaddr FAR * ReplayServer::Redirect(SOCKET s,
+                                 const struct sockaddr FAR * name,
+                                 int namelen,
+                                 struct sockaddr_storage& replay_name) {
+  const struct sockaddr FAR * ret = name;
+  if (running_ && name && namelen <= sizeof(replay_name)) {
+    if (namelen >= sizeof(struct sockaddr_in) && name->sa_family == AF_INET) {
+      const struct sockaddr_in * ip_name = (const struct sockaddr_in *)name;
+      if (ip_name->sin_port == htons(HTTP_PORT) &&
+          ip_name->sin_addr.s_addr != htonl(INADDR_LOOPBACK)) {
+        memcpy(&replay_name, name, namelen);
+        struct sockaddr_in * local = (struct sockaddr_in *)&replay_name;
+        local->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        local->sin_port = htons(REPLAY_PORT);
+        ret = (const struct sockaddr *)&replay_name;
+      }
+    } else if (namelen >= sizeof(struct sockaddr_in6) &&
+               name->sa_family == AF_INET6) {
+      const struct sockaddr_in6 * ip_name = (const struct sockaddr_in6 *)name;
+      if (ip_name->sin6_port == htons(HTTP_PORT) &&
+          !IN6_IS_ADDR_LOOPBACK(&ip_name->sin6_addr)) {
+        memcpy(&replay_name, name, namelen);
+        struct sockaddr_in6 * local = (struct sockaddr_in6 *)&replay_name;
+        memset(&local->sin6_addr, 0, sizeof(local->sin6_addr));
+        local->sin6_port = htons(REPLAY_PORT);
+        local->sin6_flowinfo = 0;
+        local->sin6_scope_id = 0;
+        DWORD v6_only = 0;
+        if (!setsockopt(s, IPPROTO_IPV6, IPV6_V6ONLY, (const char *)&v6_only,
+                        sizeof(v6_only))) {
+          local->sin6_addr.s6_addr[10] = 0xFF;   // ::ffff:127.0.0.1
+          local->sin6_addr.s6_addr[11] = 0xFF;
+          local->sin6_addr.s6_addr[12] = 127;
+          local->sin6_addr.s6_addr[15] = 1;
+        } else {
+          local->sin6_addr.s6_addr[15] = 1;      // ::1, refused
+        }
+        ret = (const struct sockaddr *)&replay_name;
+      }
+    }
+  }
+  return ret;
+}
+
+/*-----------------------------------------------------------------------------
+  Send the archived response for the request
+-----------------------------------------------------------------------------*/
+void ReplayServer::MongooseCallback(enum mg_event event,
+                      struct mg_connection *conn,
+                      const struct mg_request_info *request_info) {
+  if (event == MG_NEW_REQUEST) {
+    const char * host = mg_get_header(conn, "Host");
+    CStringA key = ReplayArchive::Key(request_info->request_method,
+                                      host ? host : "",
+                                      request_info->uri,
+                                      request_info->query_string ?
+                                        request_info->query_string : "");
+    const char * response = NULL;
+    DWORD len = 0;
+    if (archive_.Find(key, response, len)) {
+      mg_write(conn, response, len);
+    } else {
+      mg_write(conn, NOT_FOUND, lstrlenA(NOT_FOUND));
+      WptTrace(loglevel::kFunction,
+        _T("[wpthook] - ReplayServer - not in archive: %S\n"), (LPCSTR)key);
+    }
+  }
+}
@@ -0,0 +1,58 @@
+/******************************************************************************
+Copyright (c) 2014, Google Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+    * Neither the name of the <ORGANIZATION> nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+#pragma once
+#include "replay_archive.h"
+
+/*-----------------------------------------------------------------------------
+  Local HTTP server that serves the replay runs of a test out of the
+  archive from the record run.  Plain-HTTP connects from the browser are
+  redirected to it in the winsock hook so the page loads without touching
+  the network (HTTPS still goes out because the hooks sit below TLS).
+  Requests that aren't in the archive get a 404 so a replay never mixes in
+  live content.
+-----------------------------------------------------------------------------*/
+class ReplayServer {
+public:
+  ReplayServer(void);
+  ~ReplayServer(void);
+
+  bool Start(CString directory);
+  void Stop(void);
+  const struct sockaddr FAR * Redirect(SOCKET s,
+                                       const struct sockaddr FAR * name,
+                                       int namelen,
+                                       struct sockaddr_storage& replay_name);
+  void MongooseCallback(enum mg_event event,
+                        struct mg_connection *conn,
+                        const struct mg_request_info *request_info);
+
+private:
+  struct mg_context *mongoose_context_;
+  ReplayArchive     archive_;
+  bool              running_;
+};
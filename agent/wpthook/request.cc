@@ -95,9 +95,29 @@ void HttpData::AddChunk(DataChunk& chunk) {
     chunk.CopyDataIfUnowned();
     _data_chunks.AddTail(chunk);
     _data_size += chunk.GetLength();
+  } else if (chunk.GetLength()) {
+    _truncated = true;
   }
 }
 
+/*-----------------------------------------------------------------------------
+  Copy the raw data into an empty HttpData that shares nothing with this one
+-----------------------------------------------------------------------------*/
+void HttpData::Duplicate(HttpData& copy) const {
+  if (_data) {
+    DataChunk chunk(_data, _data_size);
+    copy.AddChunk(chunk);
+  } else {
+    POSITION pos = _data_chunks.GetHeadPosition();
+    while (pos) {
+      const DataChunk& src = _data_chunks.GetNext(pos);
+      DataChunk chunk(src.GetData(), src.GetLength());
+      copy.AddChunk(chunk);
+    }
+  }
+  copy._truncated = _truncated;
+}
+
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
 CStringA HttpData::GetHeader(CStringA field_name) {
@@ -334,6 +354,7 @@ Request::Request(TestState& test_state, DWORD socket_id,
   , _are_headers_complete(false)
   , _data_sent(false)
   , _from_browser(false)
+  , from_net_log_(false)
   , _is_base_page(false)
   , requests_(requests)
   , _bytes_in(0)
@@ -443,7 +464,7 @@ void Request::SocketClosed() {
 -----------------------------------------------------------------------------*/
 void Request::MatchConnections() {
   EnterCriticalSection(&cs);
-  if (_is_active && !_from_browser) {
+  if (_is_active && !_from_browser && !from_net_log_) {
     if (!_dns_start.QuadPart) {
       CString host = CA2T(GetHost());
       _dns.Claim(host, _peer_address, _start, _dns_start, _dns_end);
@@ -537,6 +558,19 @@ CStringA Request::GetResponseHeader(CStringA field_name) {
   return _response_data.GetHeader(field_name);
 }
 
+/*-----------------------------------------------------------------------------
+  A private copy of the response for another thread (the parsing in
+  ResponseData allocates into the object on first use).  The caller
+  deletes it.
+-----------------------------------------------------------------------------*/
+ResponseData * Request::CopyResponse(void) {
+  ResponseData * response = new ResponseData;
+  EnterCriticalSection(&cs);
+  _response_data.Duplicate(*response);
+  LeaveCriticalSection(&cs);
+  return response;
+}
+
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
 bool Request::HasResponseHeaders() {
@@ -116,15 +116,17 @@ typedef CAtlList<HeaderField> Fields;
 
 class HttpData {
  public:
-  HttpData(): _data(NULL), _data_size(0) {}
+  HttpData(): _data(NULL), _data_size(0), _truncated(false) {}
   ~HttpData() { delete _data; }
 
   bool HasHeaders() { CopyData(); return _headers.GetLength() != 0; }
   CStringA GetHeaders() { CopyData(); return _headers; }
   DWORD GetDataSize() { return _data_size; }
+  bool IsTruncated() const { return _truncated; }
 
   void AddChunk(DataChunk& chunk);
   CStringA GetHeader(CStringA field_name);
+  void Duplicate(HttpData& copy) const;
 
 protected:
   void CopyData();
@@ -133,6 +135,7 @@ protected:
   CAtlList<DataChunk> _data_chunks;
   const char * _data;
   DWORD _data_size;
+  bool _truncated;    // data past MAX_DATA_TO_RETAIN was dropped
   CStringA _headers;
   Fields _header_fields;
 };
@@ -172,6 +175,9 @@ public:
     , _gzip_score(-1)
     , _gzip_total(0)
     , _gzip_target(0)
+    , _minify_score(-1)
+    , _minify_total(0)
+    , _minify_target(0)
     , _image_compression_score(-1)
     , _image_compress_total(0)
     , _image_compress_target(0)
@@ -186,6 +192,9 @@ public:
   int _gzip_score;
   DWORD _gzip_total;
   DWORD _gzip_target;
+  int _minify_score;
+  DWORD _minify_total;
+  DWORD _minify_target;
   int _image_compression_score;
   DWORD _image_compress_total;
   DWORD _image_compress_target;
@@ -231,6 +240,7 @@ public:
   CStringA GetRequestHeader(CStringA header);
   CStringA GetResponseHeader(CStringA header);
   bool HasResponseHeaders();
+  ResponseData * CopyResponse(void);
   bool IsStatic();
   bool IsText();
   bool IsIcon();
@@ -268,6 +278,7 @@ public:
   int _ms_ssl_end;
 
   bool _from_browser;
+  bool from_net_log_;     // connection timings came from the netlog
   bool _is_base_page;
   CStringA  rtt_;
 
@@ -0,0 +1,602 @@
+/******************************************************************************
+Copyright (c) 2014, Google Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+    * Neither the name of the <ORGANIZATION> nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+#include "StdAfx.h"
+#include "request_records.h"
+
+static const char * RECORDS_MAGIC = "WPTR";
+static const DWORD RECORDS_VERSION = 2;   // 2: minify columns, blocks
+static const BYTE ENCODING_VARINT = 0;
+static const BYTE ENCODING_DELTA = 1;
+static const BYTE ENCODING_DICTIONARY = 2;
+static const BYTE ENCODING_INLINE = 3;
+
+struct RecordColumn {
+  DWORD id;     // stable on-disk identifier
+  bool  is_string;
+  int   field;
+  BYTE  encoding;
+};
+
+static const RecordColumn RECORD_COLUMNS[] = {
+  {1, false, RECORD_IP_ADDRESS, ENCODING_VARINT},
+  {2, false, RECORD_RESULT, ENCODING_VARINT},
+  {3, false, RECORD_START, ENCODING_DELTA},
+  {4, false, RECORD_FIRST_BYTE, ENCODING_DELTA},
+  {5, false, RECORD_END, ENCODING_DELTA},
+  {6, false, RECORD_BYTES_OUT, ENCODING_VARINT},
+  {7, false, RECORD_BYTES_IN, ENCODING_VARINT},
+  {8, false, RECORD_OBJECT_SIZE, ENCODING_VARINT},
+  {9, false, RECORD_SOCKET_ID, ENCODING_DELTA},
+  {10, false, RECORD_INDEX, ENCODING_DELTA},
+  {11, false, RECORD_CACHE_SCORE, ENCODING_VARINT},
+  {12, false, RECORD_STATIC_CDN_SCORE, ENCODING_VARINT},
+  {13, false, RECORD_GZIP_SCORE, ENCODING_VARINT},
+  {14, false, RECORD_KEEP_ALIVE_SCORE, ENCODING_VARINT},
+  {15, false, RECORD_COMBINE_SCORE, ENCODING_VARINT},
+  {16, false, RECORD_IMAGE_COMPRESSION_SCORE, ENCODING_VARINT},
+  {17, false, RECORD_SECURE, ENCODING_VARINT},
+  {18, false, RECORD_GZIP_TOTAL, ENCODING_VARINT},
+  {19, false, RECORD_GZIP_SAVINGS, ENCODING_VARINT},
+  {20, false, RECORD_IMAGE_TOTAL, ENCODING_VARINT},
+  {21, false, RECORD_IMAGE_SAVINGS, ENCODING_VARINT},
+  {22, false, RECORD_CACHE_TIME, ENCODING_VARINT},
+  {23, false, RECORD_DNS_START, ENCODING_DELTA},
+  {24, false, RECORD_DNS_END, ENCODING_DELTA},
+  {25, false, RECORD_CONNECT_START, ENCODING_DELTA},
+  {26, false, RECORD_CONNECT_END, ENCODING_DELTA},
+  {27, false, RECORD_SSL_START, ENCODING_DELTA},
+  {28, false, RECORD_SSL_END, ENCODING_DELTA},
+  {29, false, RECORD_SERVER_COUNT, ENCODING_VARINT},
+  {30, false, RECORD_LOCAL_PORT, ENCODING_VARINT},
+  {31, false, RECORD_JPEG_SCANS, ENCODING_VARINT},
+  {32, false, RECORD_MINIFY_SCORE, ENCODING_VARINT},
+  {33, false, RECORD_MINIFY_TOTAL, ENCODING_VARINT},
+  {34, false, RECORD_MINIFY_SAVINGS, ENCODING_VARINT},
+  {64, true, RECORD_DATE, ENCODING_DICTIONARY},
+  {65, true, RECORD_TIME, ENCODING_DICTIONARY},
+  {66, true, RECORD_METHOD, ENCODING_DICTIONARY},
+  {67, true, RECORD_HOST, ENCODING_DICTIONARY},
+  {68, true, RECORD_URL, ENCODING_INLINE},
+  {69, true, RECORD_EXPIRES, ENCODING_DICTIONARY},
+  {70, true, RECORD_CACHE_CONTROL, ENCODING_DICTIONARY},
+  {71, true, RECORD_CONTENT_TYPE, ENCODING_DICTIONARY},
+  {72, true, RECORD_CONTENT_ENCODING, ENCODING_DICTIONARY},
+  {73, true, RECORD_CDN_PROVIDER, ENCODING_DICTIONARY},
+  {74, true, RECORD_INITIATOR, ENCODING_DICTIONARY},
+  {75, true, RECORD_INITIATOR_LINE, ENCODING_DICTIONARY},
+  {76, true, RECORD_INITIATOR_COLUMN, ENCODING_DICTIONARY},
+  {77, true, RECORD_RTT, ENCODING_DICTIONARY},
+  {78, true, RECORD_REQUEST_HEADERS, ENCODING_INLINE},
+  {79, true, RECORD_RESPONSE_HEADERS, ENCODING_INLINE}
+};
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static void AppendVarint(CAtlArray<BYTE>& buffer, ULONGLONG value) {
+  while (value >= 0x80) {
+    buffer.Add((BYTE)(value | 0x80));
+    value >>= 7;
+  }
+  buffer.Add((BYTE)value);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static void AppendInt(CAtlArray<BYTE>& buffer, LONGLONG value) {
+  AppendVarint(buffer, (ULONGLONG)((value << 1) ^ (value >> 63)));
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static void AppendBytes(CAtlArray<BYTE>& buffer, const void * data,
+                        size_t len) {
+  if (len) {
+    size_t offset = buffer.GetCount();
+    buffer.SetCount(offset + len);
+    memcpy(buffer.GetData() + offset, data, len);
+  }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static void AppendString(CAtlArray<BYTE>& buffer, const CStringA& value) {
+  AppendVarint(buffer, value.GetLength());
+  AppendBytes(buffer, (LPCSTR)value, value.GetLength());
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static bool ReadVarint(const BYTE *& p, const BYTE * end, ULONGLONG& value) {
+  value = 0;
+  int shift = 0;
+  while (p < end && shift < 64) {
+    BYTE b = *p++;
+    value |= (ULONGLONG)(b & 0x7F) << shift;
+    if (!(b & 0x80))
+      return true;
+    shift += 7;
+  }
+  return false;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static bool ReadInt(const BYTE *& p, const BYTE * end, LONGLONG& value) {
+  ULONGLONG encoded;
+  if (!ReadVarint(p, end, encoded))
+    return false;
+  value = (LONGLONG)(encoded >> 1) ^ -(LONGLONG)(encoded & 1);
+  return true;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static bool ReadString(const BYTE *& p, const BYTE * end, CStringA& value) {
+  ULONGLONG len;
+  if (!ReadVarint(p, end, len) || len > (ULONGLONG)(end - p))
+    return false;
+  value.SetString((LPCSTR)p, (int)len);
+  p += len;
+  return true;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static const RecordColumn * FindColumn(DWORD id) {
+  const RecordColumn * column = NULL;
+  for (int i = 0; i < _countof(RECORD_COLUMNS) && !column; i++)
+    if (RECORD_COLUMNS[i].id == id)
+      column = &RECORD_COLUMNS[i];
+  return column;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+RequestRecord::RequestRecord(void) {
+  for (int i = 0; i < RECORD_INT_FIELDS; i++)
+    values_[i] = 0;
+  values_[RECORD_MINIFY_SCORE] = -1;  // no minify columns before version 2
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+const RequestRecord& RequestRecord::operator =(const RequestRecord& src) {
+  for (int i = 0; i < RECORD_INT_FIELDS; i++)
+    values_[i] = src.values_[i];
+  for (int i = 0; i < RECORD_STRING_FIELDS; i++)
+    strings_[i] = src.strings_[i];
+  return src;
+}
+
+/*-----------------------------------------------------------------------------
+  Format the record as a line of the tab-separated request report
+-----------------------------------------------------------------------------*/
+CStringA RequestRecord::FormatText(void) const {
+  CStringA result;
+  CStringA buff;
+
+  // Date
+  result += strings_[RECORD_DATE] + "\t";
+  // Time
+  result += strings_[RECORD_TIME] + "\t";
+  // Event Name
+  result += "\t";
+  // IP Address
+  DWORD addr = (DWORD)values_[RECORD_IP_ADDRESS];
+  if (addr) {
+    buff.Format("%d.%d.%d.%d", addr & 0xFF, (addr >> 8) & 0xFF,
+                (addr >> 16) & 0xFF, (addr >> 24) & 0xFF);
+    result += buff;
+  }
+  result += "\t";
+  // Action
+  result += strings_[RECORD_METHOD] + "\t";
+  // Host
+  result += strings_[RECORD_HOST] + "\t";
+  // URL
+  result += strings_[RECORD_URL] + "\t";
+  // Response Code
+  buff.Format("%d\t", values_[RECORD_RESULT]);
+  result += buff;
+  // Time to Load (ms)
+  buff.Format("%d\t", values_[RECORD_END] - values_[RECORD_START]);
+  result += buff;
+  // Time to First Byte (ms)
+  if (values_[RECORD_FIRST_BYTE] >= values_[RECORD_START]) {
+    buff.Format("%d\t", values_[RECORD_FIRST_BYTE] - values_[RECORD_START]);
+  } else {
+    buff = "\t";
+  }
+  result += buff;
+  // Start Time (ms)
+  buff.Format("%d\t", values_[RECORD_START]);
+  result += buff;
+  // Bytes Out
+  buff.Format("%d\t", values_[RECORD_BYTES_OUT]);
+  result += buff;
+  // Bytes In
+  buff.Format("%d\t", values_[RECORD_BYTES_IN]);
+  result += buff;
+  // Object Size
+  buff.Format("%d\t", values_[RECORD_OBJECT_SIZE]);
+  result += buff;
+  // Cookie Size (out)
+  result += "\t";
+  // Cookie Count(out)
+  result += "\t";
+  // Expires
+  result += strings_[RECORD_EXPIRES] + "\t";
+  // Cache Control
+  result += strings_[RECORD_CACHE_CONTROL] + "\t";
+  // Content Type
+  result += strings_[RECORD_CONTENT_TYPE] + "\t";
+  // Content Encoding
+  result += strings_[RECORD_CONTENT_ENCODING] + "\t";
+  // Transaction Type (3 = request - legacy reasons)
+  result += "3\t";
+  // Socket ID
+  buff.Format("%d\t", values_[RECORD_SOCKET_ID]);
+  result += buff;
+  // Document ID
+  result += "\t";
+  // End Time (ms)
+  buff.Format("%d\t", values_[RECORD_END]);
+  result += buff;
+  // Descriptor, Lab ID, Dialer ID, Connection Type, Cached, Event URL,
+  // IEWatch Build, Measurement Type, Experimental, Event GUID
+  result += "\t\t\t\t\t\t\t\t\t\t";
+  // Sequence Number - Incremented for each record in the object data
+  buff.Format("%d\t", values_[RECORD_INDEX]);
+  result += buff;
+  // Cache Score
+  buff.Format("%d\t", values_[RECORD_CACHE_SCORE]);
+  result += buff;
+  // Static CDN Score
+  buff.Format("%d\t", values_[RECORD_STATIC_CDN_SCORE]);
+  result += buff;
+  // GZIP Score
+  buff.Format("%d\t", values_[RECORD_GZIP_SCORE]);
+  result += buff;
+  // Cookie Score
+  result += "-1\t";
+  // Keep-Alive Score
+  buff.Format("%d\t", values_[RECORD_KEEP_ALIVE_SCORE]);
+  result += buff;
+  // DOCTYPE Score
+  result += "-1\t";
+  // Minify Score
+  buff.Format("%d\t", values_[RECORD_MINIFY_SCORE]);
+  result += buff;
+  // Combine Score
+  buff.Format("%d\t", values_[RECORD_COMBINE_SCORE]);
+  result += buff;
+  // Image Compression Score
+  buff.Format("%d\t", values_[RECORD_IMAGE_COMPRESSION_SCORE]);
+  result += buff;
+  // ETag Score
+  result += "-1\t";
+  // Flagged
+  result += "0\t";
+  // Secure
+  result += values_[RECORD_SECURE] ? "1\t" : "0\t";
+  // DNS Time (ms)
+  result += "-1\t";
+  // Socket Connect time (ms)
+  result += "-1\t";
+  // SSL time (ms)
+  result += "-1\t";
+  // Gzip Total Bytes
+  buff.Format("%d\t", values_[RECORD_GZIP_TOTAL]);
+  result += buff;
+  // Gzip Savings
+  buff.Format("%d\t", values_[RECORD_GZIP_SAVINGS]);
+  result += buff;
+  // Minify Total Bytes
+  buff.Format("%d\t", values_[RECORD_MINIFY_TOTAL]);
+  result += buff;
+  // Minify Savings
+  buff.Format("%d\t", values_[RECORD_MINIFY_SAVINGS]);
+  result += buff;
+  // Image Compression Total Bytes
+  buff.Format("%d\t", values_[RECORD_IMAGE_TOTAL]);
+  result += buff;
+  // Image Compression Savings
+  buff.Format("%d\t", values_[RECORD_IMAGE_SAVINGS]);
+  result += buff;
+  // Cache Time (sec)
+  buff.Format("%d\t", values_[RECORD_CACHE_TIME]);
+  result += buff;
+  // Real Start Time (ms)
+  result += "\t";
+  // Full Time to Load (ms)
+  result += "\t";
+  // Optimization Checked
+  result += "1\t";
+  // CDN Provider
+  result += strings_[RECORD_CDN_PROVIDER] + "\t";
+  // DNS start/end, connect start/end, ssl negotiation start/end
+  buff.Format("%d\t%d\t%d\t%d\t%d\t%d\t", values_[RECORD_DNS_START],
+              values_[RECORD_DNS_END], values_[RECORD_CONNECT_START],
+              values_[RECORD_CONNECT_END], values_[RECORD_SSL_START],
+              values_[RECORD_SSL_END]);
+  result += buff;
+  // initiator
+  result += strings_[RECORD_INITIATOR] + "\t";
+  result += strings_[RECORD_INITIATOR_LINE] + "\t";
+  result += strings_[RECORD_INITIATOR_COLUMN] + "\t";
+  // Server Count
+  buff.Format("%d\t", values_[RECORD_SERVER_COUNT]);
+  result += buff;
+  // Server RTT
+  result += strings_[RECORD_RTT] + "\t";
+  // Local Port
+  buff.Format("%d\t", values_[RECORD_LOCAL_PORT]);
+  result += buff;
+  // JPEG scan count
+  buff.Format("%d\t", values_[RECORD_JPEG_SCANS]);
+  result += buff;
+
+  result += "\r\n";
+  return result;
+}
+
+/*-----------------------------------------------------------------------------
+  Format the raw headers the way they are written to the headers report
+-----------------------------------------------------------------------------*/
+CStringA RequestRecord::FormatHeaders(void) const {
+  CStringA buff;
+  buff.Format("Request details:\r\nRequest %d:\r\nRequest Headers:\r\n",
+              values_[RECORD_INDEX]);
+  buff += strings_[RECORD_REQUEST_HEADERS];
+  buff.Trim("\r\n");
+  buff += "\r\nResponse Headers:\r\n";
+  buff += strings_[RECORD_RESPONSE_HEADERS];
+  buff.Trim("\r\n");
+  buff += "\r\n";
+  return buff;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void RequestRecordsWriter::Reset(void) {
+  records_.RemoveAll();
+  string_table_.RemoveAll();
+  string_ids_.RemoveAll();
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void RequestRecordsWriter::Add(const RequestRecord& record) {
+  records_.Add(record);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+DWORD RequestRecordsWriter::GetStringId(const CStringA& value) {
+  DWORD id = 0;
+  if (!string_ids_.Lookup(value, id)) {
+    id = (DWORD)string_table_.Add(value);
+    string_ids_.SetAt(value, id);
+  }
+  return id;
+}
+
+/*-----------------------------------------------------------------------------
+  Encode the records column by column and append them to the file as one
+  block (the records of the earlier steps are left as they are)
+-----------------------------------------------------------------------------*/
+bool RequestRecordsWriter::Append(CString file) {
+  bool ret = false;
+  size_t rows = records_.GetCount();
+  CAtlArray<BYTE> columns;
+  CAtlArray<BYTE> payload;
+  int column_count = _countof(RECORD_COLUMNS);
+  AppendVarint(columns, column_count);
+  for (int i = 0; i < column_count; i++) {
+    const RecordColumn& column = RECORD_COLUMNS[i];
+    payload.RemoveAll();
+    LONGLONG previous = 0;
+    for (size_t row = 0; row < rows; row++) {
+      const RequestRecord& record = records_[row];
+      if (column.is_string) {
+        const CStringA& value = record.strings_[column.field];
+        if (column.encoding == ENCODING_DICTIONARY)
+          AppendVarint(payload, GetStringId(value));
+        else
+          AppendString(payload, value);
+      } else {
+        LONGLONG value = record.values_[column.field];
+        if (column.encoding == ENCODING_DELTA) {
+          AppendInt(payload, value - previous);
+          previous = value;
+        } else {
+          AppendInt(payload, value);
+        }
+      }
+    }
+    AppendVarint(columns, column.id);
+    columns.Add(column.encoding);
+    AppendVarint(columns, payload.GetCount());
+    AppendBytes(columns, payload.GetData(), payload.GetCount());
+  }
+
+  CAtlArray<BYTE> header;
+  AppendBytes(header, RECORDS_MAGIC, 4);
+  AppendVarint(header, RECORDS_VERSION);
+  AppendVarint(header, rows);
+  AppendVarint(header, string_table_.GetCount());
+  for (size_t i = 0; i < string_table_.GetCount(); i++)
+    AppendString(header, string_table_[i]);
+
+  HANDLE file_handle = CreateFile(file, GENERIC_WRITE, 0, 0,
+                                  OPEN_ALWAYS, 0, 0);
+  if (file_handle != INVALID_HANDLE_VALUE) {
+    DWORD written = 0;
+    SetFilePointer(file_handle, 0, 0, FILE_END);
+    ret = WriteFile(file_handle, header.GetData(), (DWORD)header.GetCount(),
+                    &written, 0) &&
+          WriteFile(file_handle, columns.GetData(), (DWORD)columns.GetCount(),
+                    &written, 0);
+    CloseHandle(file_handle);
+  }
+  return ret;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+bool RequestRecordsReader::Load(CString file) {
+  bool ret = false;
+  records_.RemoveAll();
+  HANDLE file_handle = CreateFile(file, GENERIC_READ, FILE_SHARE_READ, 0,
+                                  OPEN_EXISTING, 0, 0);
+  if (file_handle != INVALID_HANDLE_VALUE) {
+    DWORD len = GetFileSize(file_handle, NULL);
+    if (len && len != INVALID_FILE_SIZE) {
+      BYTE * data = (BYTE *)malloc(len);
+      if (data) {
+        DWORD bytes = 0;
+        if (ReadFile(file_handle, data, len, &bytes, 0) && bytes == len)
+          ret = Decode(data, len);
+        free(data);
+      }
+    }
+    CloseHandle(file_handle);
+  }
+  return ret;
+}
+
+/*-----------------------------------------------------------------------------
+  Decode an in-memory copy of the columnar file, all of its blocks in turn
+-----------------------------------------------------------------------------*/
+bool RequestRecordsReader::Decode(const BYTE * data, DWORD len) {
+  bool ret = len > 0;
+  records_.RemoveAll();
+  const BYTE * p = data;
+  const BYTE * end = data + len;
+  while (ret && p < end)
+    ret = DecodeBlock(p, end);
+  return ret;
+}
+
+/*-----------------------------------------------------------------------------
+  Decode one block and add its rows.  Columns that this build does not
+  know about are skipped and missing ones keep their defaults.
+-----------------------------------------------------------------------------*/
+bool RequestRecordsReader::DecodeBlock(const BYTE *& p, const BYTE * end) {
+  DWORD len = (DWORD)(end - p);
+  ULONGLONG version, rows, string_count, column_count;
+  if (len < 4 || memcmp(p, RECORDS_MAGIC, 4))
+    return false;
+  p += 4;
+  if (!ReadVarint(p, end, version) || version > RECORDS_VERSION ||
+      !ReadVarint(p, end, rows) || rows > len ||
+      !ReadVarint(p, end, string_count) || string_count > len)
+    return false;
+
+  CAtlArray<CStringA> string_table;
+  string_table.SetCount((size_t)string_count);
+  for (size_t i = 0; i < string_count; i++)
+    if (!ReadString(p, end, string_table[i]))
+      return false;
+
+  size_t first_row = records_.GetCount();
+  records_.SetCount(first_row + (size_t)rows);
+  if (!ReadVarint(p, end, column_count))
+    return false;
+  for (ULONGLONG i = 0; i < column_count; i++) {
+    ULONGLONG id, payload_len;
+    if (!ReadVarint(p, end, id) || p >= end)
+      return false;
+    BYTE encoding = *p++;
+    if (!ReadVarint(p, end, payload_len) || payload_len > (ULONGLONG)(end - p))
+      return false;
+    const BYTE * column_end = p + payload_len;
+    const RecordColumn * column = FindColumn((DWORD)id);
+    if (column && column->encoding == encoding) {
+      LONGLONG previous = 0;
+      for (size_t row = 0; row < rows; row++) {
+        RequestRecord& record = records_[first_row + row];
+        if (column->is_string) {
+          if (encoding == ENCODING_DICTIONARY) {
+            ULONGLONG string_id;
+            if (!ReadVarint(p, column_end, string_id) ||
+                string_id >= string_count)
+              return false;
+            record.strings_[column->field] = string_table[(size_t)string_id];
+          } else if (!ReadString(p, column_end,
+                                 record.strings_[column->field])) {
+            return false;
+          }
+        } else {
+          LONGLONG value;
+          if (!ReadInt(p, column_end, value))
+            return false;
+          if (encoding == ENCODING_DELTA) {
+            value += previous;
+            previous = value;
+          }
+          record.values_[column->field] = (int)value;
+        }
+      }
+    }
+    p = column_end;
+  }
+  return true;
+}
+
+/*-----------------------------------------------------------------------------
+  Re-create the tab-separated request report and headers file from the
+  decoded records (for consumers that still expect the text formats).
+-----------------------------------------------------------------------------*/
+bool RequestRecordsReader::ConvertToText(CString requests_file,
+                                         CString headers_file) {
+  bool ret = false;
+  HANDLE file = CreateFile(requests_file, GENERIC_WRITE, 0, 0,
+                           CREATE_ALWAYS, 0, 0);
+  if (file != INVALID_HANDLE_VALUE) {
+    HANDLE headers = INVALID_HANDLE_VALUE;
+    if (!headers_file.IsEmpty())
+      headers = CreateFile(headers_file, GENERIC_WRITE, 0, 0,
+                           CREATE_ALWAYS, 0, 0);
+    ret = true;
+    DWORD written;
+    for (size_t i = 0; i < records_.GetCount(); i++) {
+      CStringA line = records_[i].FormatText();
+      if (!WriteFile(file, (LPCSTR)line, line.GetLength(), &written, 0))
+        ret = false;
+      if (headers != INVALID_HANDLE_VALUE) {
+        CStringA buff = records_[i].FormatHeaders();
+        WriteFile(headers, (LPCSTR)buff, buff.GetLength(), &written, 0);
+      }
+    }
+    if (headers != INVALID_HANDLE_VALUE)
+      CloseHandle(headers);
+    CloseHandle(file);
+  }
+  return ret;
+}
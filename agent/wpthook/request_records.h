@@ -0,0 +1,150 @@
+/******************************************************************************
+Copyright (c) 2014, Google Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+    * Neither the name of the <ORGANIZATION> nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+#pragma once
+
+// integer fields of a request record (in report order)
+const int RECORD_IP_ADDRESS = 0;
+const int RECORD_RESULT = 1;
+const int RECORD_START = 2;
+const int RECORD_FIRST_BYTE = 3;
+const int RECORD_END = 4;
+const int RECORD_BYTES_OUT = 5;
+const int RECORD_BYTES_IN = 6;
+const int RECORD_OBJECT_SIZE = 7;
+const int RECORD_SOCKET_ID = 8;
+const int RECORD_INDEX = 9;
+const int RECORD_CACHE_SCORE = 10;
+const int RECORD_STATIC_CDN_SCORE = 11;
+const int RECORD_GZIP_SCORE = 12;
+const int RECORD_KEEP_ALIVE_SCORE = 13;
+const int RECORD_COMBINE_SCORE = 14;
+const int RECORD_IMAGE_COMPRESSION_SCORE = 15;
+const int RECORD_SECURE = 16;
+const int RECORD_GZIP_TOTAL = 17;
+const int RECORD_GZIP_SAVINGS = 18;
+const int RECORD_IMAGE_TOTAL = 19;
+const int RECORD_IMAGE_SAVINGS = 20;
+const int RECORD_CACHE_TIME = 21;
+const int RECORD_DNS_START = 22;
+const int RECORD_DNS_END = 23;
+const int RECORD_CONNECT_START = 24;
+const int RECORD_CONNECT_END = 25;
+const int RECORD_SSL_START = 26;
+const int RECORD_SSL_END = 27;
+const int RECORD_SERVER_COUNT = 28;
+const int RECORD_LOCAL_PORT = 29;
+const int RECORD_JPEG_SCANS = 30;
+const int RECORD_MINIFY_SCORE = 31;
+const int RECORD_MINIFY_TOTAL = 32;
+const int RECORD_MINIFY_SAVINGS = 33;
+const int RECORD_INT_FIELDS = 34;
+
+// string fields of a request record
+const int RECORD_DATE = 0;
+const int RECORD_TIME = 1;
+const int RECORD_METHOD = 2;
+const int RECORD_HOST = 3;
+const int RECORD_URL = 4;
+const int RECORD_EXPIRES = 5;
+const int RECORD_CACHE_CONTROL = 6;
+const int RECORD_CONTENT_TYPE = 7;
+const int RECORD_CONTENT_ENCODING = 8;
+const int RECORD_CDN_PROVIDER = 9;
+const int RECORD_INITIATOR = 10;
+const int RECORD_INITIATOR_LINE = 11;
+const int RECORD_INITIATOR_COLUMN = 12;
+const int RECORD_RTT = 13;
+const int RECORD_REQUEST_HEADERS = 14;
+const int RECORD_RESPONSE_HEADERS = 15;
+const int RECORD_STRING_FIELDS = 16;
+
+/*-----------------------------------------------------------------------------
+  One row of the request data.  This is the single source for both the
+  tab-separated report (and raw headers) and the binary columnar file so
+  the two can always be converted into each other.
+-----------------------------------------------------------------------------*/
+class RequestRecord {
+public:
+  RequestRecord(void);
+  RequestRecord(const RequestRecord& src){*this = src;}
+  ~RequestRecord(void){}
+  const RequestRecord& operator =(const RequestRecord& src);
+
+  CStringA FormatText(void) const;
+  CStringA FormatHeaders(void) const;
+
+  int       values_[RECORD_INT_FIELDS];
+  CStringA  strings_[RECORD_STRING_FIELDS];
+};
+
+/*-----------------------------------------------------------------------------
+  Versioned columnar encoding of the request records.  The file is one or
+  more blocks (one per step, each appended when the step is saved):
+
+    "WPTR" varint(version) varint(rows) varint(strings) strings...
+    varint(columns) then per column:
+      varint(column id) byte(encoding) varint(payload length) payload
+
+  Integers are zig-zag varints (delta encoded against the previous row
+  for the time columns), repetitive strings (hosts, mime types, cache
+  headers) are indexes into the block's string table and free-form
+  strings (URLs, raw headers) are stored inline.  Unknown columns are
+  skipped by the reader.  Version 2 added the minify columns (32-34) and
+  multiple blocks; version 1 files are a single block without them.
+-----------------------------------------------------------------------------*/
+class RequestRecordsWriter {
+public:
+  RequestRecordsWriter(void){}
+  ~RequestRecordsWriter(void){}
+
+  void Reset(void);
+  void Add(const RequestRecord& record);
+  bool Append(CString file);
+
+private:
+  DWORD GetStringId(const CStringA& value);
+
+  CAtlArray<RequestRecord>  records_;
+  CAtlArray<CStringA>       string_table_;
+  CAtlMap<CStringA, DWORD>  string_ids_;
+};
+
+class RequestRecordsReader {
+public:
+  RequestRecordsReader(void){}
+  ~RequestRecordsReader(void){}
+
+  bool Load(CString file);
+  bool Decode(const BYTE * data, DWORD len);
+  bool ConvertToText(CString requests_file, CString headers_file);
+
+  CAtlArray<RequestRecord>  records_;
+
+private:
+  bool DecodeBlock(const BYTE *& p, const BYTE * end);
+};
@@ -45,7 +45,8 @@ Requests::Requests(TestState& test_state, TrackSockets& sockets,
   _test_state(test_state)
   , _sockets(sockets)
   , _dns(dns)
-  , _test(test) {
+  , _test(test)
+  , analyzer_(test_state) {
   _active_requests.InitHashTable(257);
   connections_.InitHashTable(257);
   InitializeCriticalSection(&cs);
@@ -63,6 +64,7 @@ Requests::~Requests(void) {
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
 void Requests::Reset() {
+  analyzer_.Reset();
   EnterCriticalSection(&cs);
   _active_requests.RemoveAll();
   while (!_requests.IsEmpty())
@@ -93,6 +95,7 @@ void Requests::SocketClosed(DWORD socket_id) {
   if (_active_requests.Lookup(socket_id, request) && request) {
     request->SocketClosed();
     _active_requests.RemoveKey(socket_id);
+    analyzer_.Complete(request);
   }
   LeaveCriticalSection(&cs);
 }
@@ -212,6 +215,7 @@ Request * Requests::GetOrCreateRequest(DWORD socket_id,
     // received already, then this may be a new request.
     if (!request->_is_spdy && request->_response_data.GetDataSize() &&
         IsHttpRequest(chunk)) {
+      analyzer_.Complete(request);
       request = NewRequest(socket_id, false);
     }
   } else {
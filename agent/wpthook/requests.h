@@ -28,6 +28,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #pragma once
 #include "request.h"
+#include "response_analyzer.h"
 
 class TestState;
 class TrackSockets;
@@ -84,6 +85,7 @@ public:
   CAtlList<Request *>       _requests;        // all requests
   CAtlMap<DWORD, Request *> _active_requests; // requests indexed by socket
   CAtlMap<DWORD, bool>      connections_;     // Connection IDs
+  ResponseAnalyzer          analyzer_;        // finished response checks
 
 private:
   CRITICAL_SECTION  cs;
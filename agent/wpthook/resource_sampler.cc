@@ -0,0 +1,351 @@
+/******************************************************************************
+Copyright (c) 2014, Google Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+    * Neither the name of the <ORGANIZATION> nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+#include "StdAfx.h"
+#include "resource_sampler.h"
+#include "test_state.h"
+#include <TlHelp32.h>
+
+static const size_t RESOURCE_SAMPLE_ROWS = 32768;
+static const DWORD MIN_SAMPLE_INTERVAL = 10;
+static const DWORD PROCESS_SCAN_INTERVAL = 500;
+static const DWORD MS_IN_SEC = 1000;
+
+/*-----------------------------------------------------------------------------
+  Timer-queue callback
+-----------------------------------------------------------------------------*/
+static VOID CALLBACK SampleResources(PVOID lpParameter,
+                                     BOOLEAN TimerOrWaitFired) {
+  if (lpParameter)
+    ((ResourceSampler *)lpParameter)->Collect();
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static ULONGLONG FileTimeValue(const FILETIME& time) {
+  ULARGE_INTEGER value;
+  value.LowPart = time.dwLowDateTime;
+  value.HighPart = time.dwHighDateTime;
+  return value.QuadPart;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+ResourceSampler::ResourceSampler(TestState& test_state):
+  test_state_(test_state)
+  ,timer_(NULL)
+  ,processors_(1)
+  ,next_sample_(0)
+  ,wrapped_(false) {
+  InitializeCriticalSection(&cs_);
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  if (info.dwNumberOfProcessors)
+    processors_ = info.dwNumberOfProcessors;
+  QueryPerformanceFrequency(&frequency_);
+  samples_.SetCount(RESOURCE_SAMPLE_ROWS);
+  Reset();
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+ResourceSampler::~ResourceSampler(void) {
+  Stop();
+  CloseProcesses();
+  DeleteCriticalSection(&cs_);
+}
+
+/*-----------------------------------------------------------------------------
+  Start sampling every "interval" ms
+-----------------------------------------------------------------------------*/
+void ResourceSampler::Start(DWORD interval) {
+  interval = max(interval, MIN_SAMPLE_INTERVAL);
+  if (!timer_) {
+    Collect();
+    CreateTimerQueueTimer(&timer_, NULL, ::SampleResources, this,
+                          interval, interval, WT_EXECUTEDEFAULT);
+  }
+}
+
+/*-----------------------------------------------------------------------------
+  Stop sampling (waits for a sample that is in progress)
+-----------------------------------------------------------------------------*/
+void ResourceSampler::Stop(void) {
+  if (timer_) {
+    DeleteTimerQueueTimer(NULL, timer_, INVALID_HANDLE_VALUE);
+    timer_ = NULL;
+  }
+}
+
+/*-----------------------------------------------------------------------------
+  Throw away the collected samples (the process handles are kept)
+-----------------------------------------------------------------------------*/
+void ResourceSampler::Reset(void) {
+  EnterCriticalSection(&cs_);
+  next_sample_ = 0;
+  wrapped_ = false;
+  last_sample_.QuadPart = 0;
+  last_scan_.QuadPart = 0;
+  last_idle_ = 0;
+  last_busy_ = 0;
+  last_bytes_in_ = 0;
+  last_bytes_out_ = 0;
+  private_bytes_ = 0;
+  process_count_ = 0;
+  LeaveCriticalSection(&cs_);
+}
+
+/*-----------------------------------------------------------------------------
+  Take one sample of the system and every process in the browser's tree
+-----------------------------------------------------------------------------*/
+void ResourceSampler::Collect(void) {
+  EnterCriticalSection(&cs_);
+  LARGE_INTEGER now;
+  QueryPerformanceCounter(&now);
+  if (!last_scan_.QuadPart || now.QuadPart - last_scan_.QuadPart >=
+      (LONGLONG)PROCESS_SCAN_INTERVAL * frequency_.QuadPart / MS_IN_SEC) {
+    ScanProcesses();
+    last_scan_.QuadPart = now.QuadPart;
+  }
+  // elapsed time in 100ns units (the units of the process times)
+  double elapsed = 0;
+  if (last_sample_.QuadPart && now.QuadPart > last_sample_.QuadPart)
+    elapsed = (double)(now.QuadPart - last_sample_.QuadPart) * 10000000.0 /
+              (double)frequency_.QuadPart;
+  double capacity = elapsed * processors_;
+
+  // system-wide CPU and throughput
+  ResourceSample system;
+  system.time_.QuadPart = now.QuadPart;
+  FILETIME idle_time, kernel_time, user_time;
+  if (GetSystemTimes(&idle_time, &kernel_time, &user_time)) {
+    ULONGLONG idle = FileTimeValue(idle_time);
+    ULONGLONG busy = FileTimeValue(kernel_time) + FileTimeValue(user_time);
+    if (last_busy_ && busy > last_busy_) {
+      ULONGLONG total = busy - last_busy_;
+      ULONGLONG idle_delta = min(idle - last_idle_, total);
+      system.cpu_ = (DWORD)((total - idle_delta) * 10000 / total);
+    }
+    last_idle_ = idle;
+    last_busy_ = busy;
+  }
+  int bytes_in = test_state_._bytes_in_bandwidth;
+  int bytes_out = test_state_._bytes_out;
+  if (elapsed > 0) {
+    double seconds = elapsed / 10000000.0;
+    if (bytes_in >= last_bytes_in_)
+      system.bps_in_ = (DWORD)((bytes_in - last_bytes_in_) * 8 / seconds);
+    if (bytes_out >= last_bytes_out_)
+      system.bps_out_ = (DWORD)((bytes_out - last_bytes_out_) * 8 / seconds);
+  }
+  last_bytes_in_ = bytes_in;
+  last_bytes_out_ = bytes_out;
+
+  // the browser processes
+  DWORD private_bytes = 0;
+  DWORD process_count = 0;
+  POSITION pos = processes_.GetStartPosition();
+  while (pos) {
+    DWORD process_id = 0;
+    SampledProcess * process = NULL;
+    processes_.GetNextAssoc(pos, process_id, process);
+    ResourceSample sample;
+    sample.time_.QuadPart = now.QuadPart;
+    sample.process_id_ = process_id;
+    FILETIME create_time, exit_time, kernel, user;
+    if (GetProcessTimes(process->handle_, &create_time, &exit_time, &kernel,
+                        &user)) {
+      ULONGLONG cpu = FileTimeValue(kernel) + FileTimeValue(user);
+      if (capacity > 0 && process->last_cpu_ && cpu >= process->last_cpu_)
+        sample.cpu_ = (DWORD)min((double)(cpu - process->last_cpu_) * 10000.0
+                                 / capacity, 10000.0);
+      process->last_cpu_ = cpu;
+    }
+    PROCESS_MEMORY_COUNTERS_EX memory;
+    memset(&memory, 0, sizeof(memory));
+    if (GetProcessMemoryInfo(process->handle_,
+                             (PROCESS_MEMORY_COUNTERS *)&memory,
+                             sizeof(memory))) {
+      sample.working_set_ = (DWORD)(memory.WorkingSetSize / 1024);
+      sample.private_bytes_ = (DWORD)(memory.PrivateUsage / 1024);
+    }
+    GetProcessHandleCount(process->handle_, &sample.handles_);
+    IO_COUNTERS io;
+    if (GetProcessIoCounters(process->handle_, &io)) {
+      if (process->last_read_ || process->last_write_) {
+        sample.io_read_ = (DWORD)((io.ReadTransferCount -
+                                   process->last_read_) / 1024);
+        sample.io_write_ = (DWORD)((io.WriteTransferCount -
+                                    process->last_write_) / 1024);
+      }
+      process->last_read_ = io.ReadTransferCount;
+      process->last_write_ = io.WriteTransferCount;
+    }
+    private_bytes += sample.private_bytes_;
+    process_count++;
+    if (elapsed > 0)
+      Add(sample);
+  }
+  if (elapsed > 0)
+    Add(system);
+  private_bytes_ = private_bytes;
+  process_count_ = process_count;
+  last_sample_.QuadPart = now.QuadPart;
+  LeaveCriticalSection(&cs_);
+}
+
+/*-----------------------------------------------------------------------------
+  Total private memory and process count for the browser (latest sample)
+-----------------------------------------------------------------------------*/
+void ResourceSampler::GetTotals(DWORD& private_bytes, DWORD& process_count) {
+  EnterCriticalSection(&cs_);
+  private_bytes = private_bytes_;
+  process_count = process_count_;
+  LeaveCriticalSection(&cs_);
+}
+
+/*-----------------------------------------------------------------------------
+  Format the samples (oldest first) relative to the start of the test
+-----------------------------------------------------------------------------*/
+CStringA ResourceSampler::FormatCsv(void) {
+  CStringA csv;
+  EnterCriticalSection(&cs_);
+  size_t count = wrapped_ ? RESOURCE_SAMPLE_ROWS : next_sample_;
+  size_t index = wrapped_ ? next_sample_ : 0;
+  if (count)
+    csv = "Offset Time (ms),Process,CPU Utilization (%),Working Set (KB),"
+          "Private Memory (KB),Handles,Disk Read (KB),Disk Write (KB),"
+          "Bandwidth In (bps),Bandwidth Out (bps)\r\n";
+  for (size_t i = 0; i < count; i++) {
+    const ResourceSample& sample = samples_[index];
+    CStringA process("system");
+    CString exe;
+    if (sample.process_id_) {
+      process_names_.Lookup(sample.process_id_, exe);
+      process.Format("%s:%d", (LPCSTR)CT2A(exe), sample.process_id_);
+    }
+    CStringA buff;
+    buff.Format("%d,%s,%0.2f,%d,%d,%d,%d,%d,%d,%d\r\n",
+                test_state_.ElapsedMsFromStart(sample.time_),
+                (LPCSTR)process, (double)sample.cpu_ / 100.0,
+                sample.working_set_, sample.private_bytes_, sample.handles_,
+                sample.io_read_, sample.io_write_, sample.bps_in_,
+                sample.bps_out_);
+    csv += buff;
+    index = (index + 1) % RESOURCE_SAMPLE_ROWS;
+  }
+  LeaveCriticalSection(&cs_);
+  return csv;
+}
+
+/*-----------------------------------------------------------------------------
+  Find the processes in the tree under the browser process (this one) and
+  drop the ones that exited
+-----------------------------------------------------------------------------*/
+void ResourceSampler::ScanProcesses(void) {
+  CAtlMap<DWORD, DWORD> parents;
+  CAtlMap<DWORD, CString> names;
+  HANDLE snap = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+  if (snap != INVALID_HANDLE_VALUE) {
+    PROCESSENTRY32 entry;
+    entry.dwSize = sizeof(entry);
+    if (Process32First(snap, &entry)) {
+      do {
+        parents.SetAt(entry.th32ProcessID, entry.th32ParentProcessID);
+        names.SetAt(entry.th32ProcessID, entry.szExeFile);
+      } while (Process32Next(snap, &entry));
+    }
+    CloseHandle(snap);
+  }
+
+  // walk up from each process to see if it belongs to the browser
+  DWORD root = GetCurrentProcessId();
+  CAtlList<DWORD> tree;
+  POSITION pos = parents.GetStartPosition();
+  while (pos) {
+    DWORD process_id = parents.GetKeyAt(pos);
+    parents.GetNext(pos);
+    DWORD ancestor = process_id;
+    int depth = 0;
+    while (ancestor && ancestor != root && depth < 16 &&
+           parents.Lookup(ancestor, ancestor))
+      depth++;
+    if (ancestor == root)
+      tree.AddTail(process_id);
+  }
+
+  pos = processes_.GetStartPosition();
+  while (pos) {
+    POSITION current = pos;
+    DWORD process_id = 0;
+    SampledProcess * process = NULL;
+    processes_.GetNextAssoc(pos, process_id, process);
+    if (!tree.Find(process_id)) {
+      CloseHandle(process->handle_);
+      delete process;
+      processes_.RemoveAtPos(current);
+    }
+  }
+  pos = tree.GetHeadPosition();
+  while (pos) {
+    DWORD process_id = tree.GetNext(pos);
+    if (!processes_.Lookup(process_id)) {
+      HANDLE handle = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ,
+                                  FALSE, process_id);
+      if (handle) {
+        SampledProcess * process = new SampledProcess;
+        process->handle_ = handle;
+        names.Lookup(process_id, process->exe_);
+        processes_.SetAt(process_id, process);
+        process_names_.SetAt(process_id, process->exe_);
+      }
+    }
+  }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void ResourceSampler::Add(const ResourceSample& sample) {
+  samples_[next_sample_] = sample;
+  next_sample_++;
+  if (next_sample_ >= RESOURCE_SAMPLE_ROWS) {
+    next_sample_ = 0;
+    wrapped_ = true;
+  }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void ResourceSampler::CloseProcesses(void) {
+  POSITION pos = processes_.GetStartPosition();
+  while (pos) {
+    SampledProcess * process = processes_.GetNextValue(pos);
+    CloseHandle(process->handle_);
+    delete process;
+  }
+  processes_.RemoveAll();
+}
@@ -0,0 +1,114 @@
+/******************************************************************************
+Copyright (c) 2014, Google Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+    * Neither the name of the <ORGANIZATION> nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+#pragma once
+
+class TestState;
+
+/*-----------------------------------------------------------------------------
+  One row of resource data: either one process in the browser's process
+  tree or the system-wide totals (process_id_ 0, which also carries the
+  network throughput).
+-----------------------------------------------------------------------------*/
+class ResourceSample {
+public:
+  ResourceSample(void):process_id_(0),cpu_(0),working_set_(0),
+    private_bytes_(0),handles_(0),io_read_(0),io_write_(0),bps_in_(0),
+    bps_out_(0){time_.QuadPart = 0;}
+  ~ResourceSample(void){}
+
+  LARGE_INTEGER time_;
+  DWORD         process_id_;
+  DWORD         cpu_;           // hundredths of a percent of the machine
+  DWORD         working_set_;   // KB
+  DWORD         private_bytes_; // KB
+  DWORD         handles_;
+  DWORD         io_read_;       // KB since the previous sample
+  DWORD         io_write_;      // KB since the previous sample
+  DWORD         bps_in_;
+  DWORD         bps_out_;
+};
+
+/*-----------------------------------------------------------------------------
+  Samples CPU, memory, handles and disk I/O for every process in the
+  browser's process tree (renderers, GPU process, etc) along with the
+  system CPU and the network throughput in both directions.
+
+  Sampling runs on its own timer-queue timer (down to 10ms) and the rows
+  go into a fixed-size ring so the memory use is bounded no matter how
+  long the test runs (the oldest rows are dropped first).  The process
+  tree is only re-scanned every PROCESS_SCAN_INTERVAL since taking the
+  snapshot is much more expensive than sampling the open handles.
+-----------------------------------------------------------------------------*/
+class ResourceSampler {
+public:
+  ResourceSampler(TestState& test_state);
+  ~ResourceSampler(void);
+
+  void Start(DWORD interval);
+  void Stop(void);
+  void Reset(void);
+  void Collect(void);
+  void GetTotals(DWORD& private_bytes, DWORD& process_count);
+  CStringA FormatCsv(void);
+
+private:
+  class SampledProcess {
+  public:
+    SampledProcess(void):handle_(NULL),last_cpu_(0),last_read_(0),
+      last_write_(0){}
+    HANDLE    handle_;
+    CString   exe_;
+    ULONGLONG last_cpu_;    // 100ns units
+    ULONGLONG last_read_;   // bytes
+    ULONGLONG last_write_;  // bytes
+  };
+
+  void ScanProcesses(void);
+  void Add(const ResourceSample& sample);
+  void CloseProcesses(void);
+
+  TestState&        test_state_;
+  CRITICAL_SECTION  cs_;
+  HANDLE            timer_;
+  DWORD             processors_;
+  LARGE_INTEGER     frequency_;
+  LARGE_INTEGER     last_sample_;
+  LARGE_INTEGER     last_scan_;
+  ULONGLONG         last_idle_;
+  ULONGLONG         last_busy_;
+  int               last_bytes_in_;
+  int               last_bytes_out_;
+  DWORD             private_bytes_;
+  DWORD             process_count_;
+
+  CAtlMap<DWORD, SampledProcess *>  processes_;
+  CAtlMap<DWORD, CString>           process_names_;  // includes exited ones
+  CAtlArray<ResourceSample>         samples_;        // ring
+  size_t                            next_sample_;
+  bool                              wrapped_;
+};
@@ -0,0 +1,433 @@
+/******************************************************************************
+Copyright (c) 2014, Google Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+    * Neither the name of the <ORGANIZATION> nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+#include "StdAfx.h"
+#include "response_analyzer.h"
+#include "request.h"
+#include "shared_mem.h"
+#include "test_state.h"
+#include "minify_estimator.h"
+
+#include "cximage/ximage.h"
+#include <zlib.h>
+
+static const DWORD ACTIVE_ANALYSIS_DELAY = 50;  // ms between responses
+static const DWORD MIN_ANALYSIS_SIZE = 1400;    // spare small responses
+
+// Vista+ background processing mode (low I/O and memory priority)
+#ifndef THREAD_MODE_BACKGROUND_BEGIN
+#define THREAD_MODE_BACKGROUND_BEGIN 0x00010000
+#define THREAD_MODE_BACKGROUND_END   0x00020000
+#endif
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static unsigned __stdcall ResponseAnalyzerThreadProc(void* arg) {
+  ResponseAnalyzer * analyzer = (ResponseAnalyzer *)arg;
+  if (analyzer)
+    analyzer->BackgroundThread();
+  return 0;
+}
+
+/*-----------------------------------------------------------------------------
+  Protect against malformed images
+-----------------------------------------------------------------------------*/
+static bool DecodeImage(CxImage& img, BYTE * buffer, DWORD size,
+                        DWORD imagetype)
+{
+  bool ret = false;
+
+  __try{
+    ret = img.Decode(buffer, size, imagetype);
+  }__except(1){
+    WptTrace(loglevel::kError,
+      _T("[wpthook] - Exception when decoding image"));
+  }
+  return ret;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+ResponseAnalyzer::ResponseAnalyzer(TestState& test_state):
+  test_state_(test_state)
+  ,thread_(NULL)
+  ,exit_(0)
+  ,stopped_(false)
+  ,cache_loaded_(false) {
+  InitializeCriticalSection(&cs_);
+  InitializeCriticalSection(&work_cs_);
+  work_available_ = CreateEvent(NULL, FALSE, FALSE, NULL);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+ResponseAnalyzer::~ResponseAnalyzer(void) {
+  Stop();
+  InterlockedExchange(&exit_, 1);
+  if (thread_) {
+    // the response being analyzed checks exit_ between the checks
+    SetEvent(work_available_);
+    WaitForSingleObject(thread_, INFINITE);
+    CloseHandle(thread_);
+  }
+  CloseHandle(work_available_);
+  DeleteCriticalSection(&work_cs_);
+  DeleteCriticalSection(&cs_);
+}
+
+/*-----------------------------------------------------------------------------
+  Start over for a new run (the requests are about to be deleted)
+-----------------------------------------------------------------------------*/
+void ResponseAnalyzer::Reset(void) {
+  Stop();
+  EnterCriticalSection(&cs_);
+  stopped_ = false;
+  LeaveCriticalSection(&cs_);
+}
+
+/*-----------------------------------------------------------------------------
+  Queue up a copy of a finished response (called with the requests lock
+  held so this only copies the raw data)
+-----------------------------------------------------------------------------*/
+void ResponseAnalyzer::Complete(Request * request) {
+  if (request && !request->_is_spdy) {
+    EnterCriticalSection(&cs_);
+    if (!stopped_) {
+      queue_.AddTail(request->CopyResponse());
+      if (!thread_)
+        thread_ = (HANDLE)_beginthreadex(0, 0, ::ResponseAnalyzerThreadProc,
+                                         this, 0, 0);
+      SetEvent(work_available_);
+    }
+    LeaveCriticalSection(&cs_);
+  }
+}
+
+/*-----------------------------------------------------------------------------
+  Drop whatever is still queued and wait for the response that is being
+  analyzed so its results are in the cache before the checks run.
+-----------------------------------------------------------------------------*/
+void ResponseAnalyzer::Stop(void) {
+  EnterCriticalSection(&cs_);
+  stopped_ = true;
+  int remaining = (int)queue_.GetCount();
+  while (!queue_.IsEmpty())
+    delete queue_.RemoveHead();
+  LeaveCriticalSection(&cs_);
+  EnterCriticalSection(&work_cs_);
+  LeaveCriticalSection(&work_cs_);
+  if (remaining)
+    WptTrace(loglevel::kFunction,
+      _T("[wpthook] - ResponseAnalyzer::Stop() %d responses not analyzed\n"),
+      remaining);
+}
+
+/*-----------------------------------------------------------------------------
+  The results of the expensive checks are shared across runs of the test
+-----------------------------------------------------------------------------*/
+void ResponseAnalyzer::LoadCache(void) {
+  EnterCriticalSection(&cs_);
+  bool load = !cache_loaded_;
+  cache_loaded_ = true;
+  LeaveCriticalSection(&cs_);
+  if (load) {
+    CString directory = shared_results_file_base;
+    int separator = directory.ReverseFind(_T('\\'));
+    if (separator > 0)
+      directory = directory.Left(separator + 1) + ANALYSIS_CACHE_DIRECTORY;
+    else
+      directory.Empty();
+    cache_.Load(directory);
+  }
+}
+
+/*-----------------------------------------------------------------------------
+  Work through the finished responses at background priority, backing off
+  between them while the test is still running.
+-----------------------------------------------------------------------------*/
+void ResponseAnalyzer::BackgroundThread(void) {
+  bool background_mode = SetThreadPriority(GetCurrentThread(),
+                                          THREAD_MODE_BACKGROUND_BEGIN) != 0;
+  if (!background_mode)
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_IDLE);
+  while (!exit_) {
+    WaitForSingleObject(work_available_, INFINITE);
+    bool working = true;
+    while (working && !exit_) {
+      working = false;
+      EnterCriticalSection(&work_cs_);
+      ResponseData * response = NULL;
+      EnterCriticalSection(&cs_);
+      if (!queue_.IsEmpty())
+        response = queue_.RemoveHead();
+      LeaveCriticalSection(&cs_);
+      if (response) {
+        LoadCache();
+        Analyze(*response);
+        delete response;
+        working = true;
+      }
+      LeaveCriticalSection(&work_cs_);
+      if (working && test_state_._active)
+        Sleep(ACTIVE_ANALYSIS_DELAY);
+    }
+  }
+  if (background_mode)
+    SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_END);
+}
+
+/*-----------------------------------------------------------------------------
+  Run the expensive parts of the checks that will apply to the response.
+  This mirrors the filtering in OptimizationChecks (which has the final say).
+-----------------------------------------------------------------------------*/
+void ResponseAnalyzer::Analyze(ResponseData& response) {
+  if (response.GetResult() == 200) {
+    DWORD size = response.GetDataSize();
+    CStringA encoding = response.GetHeader("content-encoding");
+    encoding.MakeLower();
+    int temp_pos = 0;
+    CStringA mime = response.GetHeader("content-type").Tokenize(";",
+      temp_pos);
+    mime.MakeLower();
+    bool gzip = encoding.Find("gzip") >= 0;
+
+    // de-chunking here also saves doing it at the end of the test
+    DataChunk body = response.GetBody();
+    const BYTE * data = (const BYTE *)body.GetData();
+    DWORD len = body.GetLength();
+    if (data && len) {
+      if (!gzip && encoding.Find("deflate") < 0 && size >= MIN_ANALYSIS_SIZE &&
+          !IsCompressedImage(data, len))
+        GzipSize(data, len);
+      if (!exit_ && mime.Find("image/") >= 0 && len > 2 &&
+          data[0] == 0xFF && data[1] == 0xD8) {
+        DWORD type, encoded;
+        JpegSize(data, len, type, encoded);
+        JpegScans(data, len);
+      }
+      bool css = mime.Find("/css") >= 0;
+      if (!exit_ &&
+          (css || mime.Find("javascript") >= 0 || mime.Find("json") >= 0) &&
+          size >= MIN_ANALYSIS_SIZE) {
+        DataChunk decoded = response.GetBody(true);
+        if (decoded.GetData() && decoded.GetLength())
+          MinifiedSize(decoded.GetData(), decoded.GetLength(), css, gzip);
+      }
+    }
+  }
+}
+
+/*-----------------------------------------------------------------------------
+  Known image formats that shouldn't be gzipped
+-----------------------------------------------------------------------------*/
+bool ResponseAnalyzer::IsCompressedImage(const BYTE * data, DWORD len) {
+  return (len > 3 &&             // JPEG FF D8 FF
+          data[0] == 0xFF &&
+          data[1] == 0xD8 &&
+          data[2] == 0xFF) ||
+         (len > 8 &&             // PNG 89 50 4E 47 0D 0A 1A 0A
+          data[0] == 0x89 &&
+          data[1] == 0x50 &&
+          data[2] == 0x4E &&
+          data[3] == 0x47 &&
+          data[4] == 0x0D &&
+          data[5] == 0x0A &&
+          data[6] == 0x1A &&
+          data[7] == 0x0A) ||
+         (len > 6 &&             // Gif 47 49 46 38 37(9) 61
+          data[0] == 0x47 &&
+          data[1] == 0x49 &&
+          data[2] == 0x46 &&
+          data[3] == 0x38 &&
+          data[5] == 0x61);
+}
+
+/*-----------------------------------------------------------------------------
+  Size of the body gzipped at level 7 (0 if it couldn't be compressed)
+-----------------------------------------------------------------------------*/
+DWORD ResponseAnalyzer::GzipSize(const BYTE * data, DWORD len) {
+  CStringA key = cache_.Key("gzip7", (LPCSTR)data, len);
+  CStringA cached;
+  DWORD compressed = 0;
+  if (cache_.Get(key, cached)) {
+    compressed = strtoul(cached, NULL, 10);
+  } else {
+    uLongf buff_len = compressBound(len);
+    if (buff_len) {
+      BYTE * buff = (BYTE *)malloc(buff_len);
+      if (buff) {
+        if (compress2(buff, &buff_len, data, len, 7) == Z_OK)
+          compressed = buff_len;
+        free(buff);
+      }
+    }
+    cached.Format("%lu", compressed);
+    cache_.Set(key, cached);
+  }
+  return compressed;
+}
+
+/*-----------------------------------------------------------------------------
+  Decode the image and, for JPEGs, get the size when re-encoded at quality
+  85 (optimized and progressive).  Cached as "decoded type jpeg-size".
+-----------------------------------------------------------------------------*/
+bool ResponseAnalyzer::JpegSize(const BYTE * data, DWORD len, DWORD& type,
+                                DWORD& size) {
+  CStringA key = cache_.Key("jpeg85", (LPCSTR)data, len);
+  CStringA cached;
+  int decoded = 0;
+  type = 0;
+  size = 0;
+  if (!cache_.Get(key, cached) ||
+      sscanf(cached, "%d %lu %lu", &decoded, &type, &size) != 3) {
+    decoded = 0;
+    type = 0;
+    size = 0;
+    CxImage img;
+    // Decode the image with an exception protected function.
+    if (DecodeImage(img, (BYTE *)data, len, CXIMAGE_FORMAT_UNKNOWN)) {
+      decoded = 1;
+      type = img.GetType();
+      if (type == CXIMAGE_FORMAT_JPG) {
+        img.SetCodecOption(8, CXIMAGE_FORMAT_JPG);  // optimized
+        img.SetCodecOption(16, CXIMAGE_FORMAT_JPG); // progressive
+        img.SetJpegQuality(85);
+        BYTE* mem = NULL;
+        int mem_len = 0;
+        if (img.Encode(mem, mem_len, CXIMAGE_FORMAT_JPG) && mem_len) {
+          img.FreeMemory(mem);
+          size = (DWORD)mem_len;
+        }
+      }
+    }
+    cached.Format("%d %lu %lu", decoded, type, size);
+    cache_.Set(key, cached);
+  }
+  return decoded != 0;
+}
+
+/*-----------------------------------------------------------------------------
+  Number of scans in a JPEG (more than one means it is progressive)
+-----------------------------------------------------------------------------*/
+int ResponseAnalyzer::JpegScans(const BYTE * data, DWORD len) {
+  CStringA key = cache_.Key("scans", (LPCSTR)data, len);
+  CStringA cached;
+  int scans = 0;
+  if (cache_.Get(key, cached)) {
+    scans = atoi(cached);
+  } else {
+    DWORD pos = 0;
+    const BYTE * marker;
+    DWORD marker_length;
+    while (FindJPEGMarker(data, len, pos, marker, marker_length) && marker) {
+      if (marker[0] == 0xff && marker[1] == 0xda)
+        scans++;
+      pos += marker_length;
+    }
+    cached.Format("%d", scans);
+    cache_.Set(key, cached);
+  }
+  return scans;
+}
+
+/*-----------------------------------------------------------------------------
+  Estimated size of the (decoded) js/css body once minified, gzipped too
+  if the original was.  0 if it couldn't be estimated.
+-----------------------------------------------------------------------------*/
+DWORD ResponseAnalyzer::MinifiedSize(const char * data, DWORD len, bool css,
+                                     bool gzip) {
+  CStringA key = cache_.Key(css ? (gzip ? "minify-css-gz" : "minify-css") :
+                                  (gzip ? "minify-js-gz" : "minify-js"),
+                            data, len);
+  CStringA cached;
+  DWORD minified = 0;
+  if (cache_.Get(key, cached)) {
+    minified = strtoul(cached, NULL, 10);
+  } else {
+    MinifyEstimator minify(gzip);
+    bool ok = css ? minify.Css(data, len) : minify.JavaScript(data, len);
+    if (ok)
+      minified = gzip ? minify.gzip_size_ : minify.minified_size_;
+    cached.Format("%lu", minified);
+    cache_.Set(key, cached);
+  }
+  return minified;
+}
+
+/*-----------------------------------------------------------------------------
+  Given a JPEG byte stream, find the next marker
+-----------------------------------------------------------------------------*/
+bool ResponseAnalyzer::FindJPEGMarker(const BYTE * buff, DWORD len,
+                                      DWORD &pos, const BYTE * &marker,
+                                      DWORD &marker_len) {
+  bool found = false;
+  marker = NULL;
+  marker_len = 0;
+  BYTE sos = 0xda;
+  if (pos < len) {
+    BYTE val = buff[pos];
+    if (val == 0xff) {
+      // ff can repeat, the actual marker comes from the first non-ff
+      while (val == 0xff && pos < len) {
+        pos++;
+        val = buff[pos];
+      }
+      marker = &buff[pos - 1];
+      pos++;
+      if ((val >= 0xd0 && val <= 0xd9) || val == 0x01) {
+        found = true;
+      } else if(val == sos) {
+        // image data
+        DWORD marker_end = pos + 1;
+        DWORD next_marker = len;
+        while (marker_end < len - 1 && !found) {
+          val = buff[marker_end];
+          if (val == 0xff) {
+            DWORD i = marker_end + 1;
+            val = buff[i];
+            if (val != 0x00) {   // escaping
+              while (i < len - 1 && val == 0xff) {
+                i++;
+                val = buff[i];
+              }
+              next_marker = marker_end;
+              found = true;
+            }
+          }
+          marker_end++;
+        }
+        marker_len = next_marker - pos;
+      } else if (pos + 1 < len) {
+        BYTE v1 = buff[pos];
+        BYTE v2 = buff[pos + 1];
+        marker_len = (DWORD)v1 * 256 + (DWORD)v2;
+        found = true;
+      }
+    }
+  }
+  return found;
+}
@@ -0,0 +1,89 @@
+/******************************************************************************
+Copyright (c) 2014, Google Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+    * Neither the name of the <ORGANIZATION> nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+#pragma once
+
+#include "analysis_cache.h"
+
+class Request;
+class ResponseData;
+class TestState;
+
+/*-----------------------------------------------------------------------------
+  Runs the expensive per-response parts of the optimization checks (gzip
+  target size, JPEG re-encode and scan count, minified size) as soon as
+  each response is complete instead of all at once after the test.
+
+  Requests hands over responses when their socket closes or the next
+  request goes out on the same connection.  A single thread works through
+  them at background priority and stores the results in the analysis
+  cache so the checks in Results::Save() only look them up.  While the
+  test is active it also backs off between responses so it doesn't compete
+  with the page for the CPU.  Anything it didn't get to is calculated by
+  the checks themselves.
+
+  Complete() queues a private copy of the response so the thread never
+  touches the Request (parsing the headers and body allocates into it).
+  Stop() (before Save) and Reset() (before the requests are deleted) wait
+  for the response that is being analyzed so the checks see its results.
+-----------------------------------------------------------------------------*/
+class ResponseAnalyzer {
+public:
+  ResponseAnalyzer(TestState& test_state);
+  ~ResponseAnalyzer(void);
+
+  void Reset(void);
+  void Complete(Request * request);
+  void Stop(void);
+  void LoadCache(void);
+
+  DWORD GzipSize(const BYTE * data, DWORD len);
+  bool  JpegSize(const BYTE * data, DWORD len, DWORD& type, DWORD& size);
+  int   JpegScans(const BYTE * data, DWORD len);
+  DWORD MinifiedSize(const char * data, DWORD len, bool css, bool gzip);
+
+  static bool IsCompressedImage(const BYTE * data, DWORD len);
+
+  void BackgroundThread(void);
+
+  AnalysisCache cache_;
+
+private:
+  void Analyze(ResponseData& response);
+  bool FindJPEGMarker(const BYTE * buff, DWORD len, DWORD &pos,
+                      const BYTE * &marker, DWORD &marker_len);
+
+  TestState&          test_state_;
+  CRITICAL_SECTION    cs_;
+  CRITICAL_SECTION    work_cs_;       // held while a response is analyzed
+  HANDLE              thread_;
+  HANDLE              work_available_;
+  volatile LONG       exit_;
+  bool                stopped_;
+  bool                cache_loaded_;
+  CAtlList<ResponseData *> queue_;
+};
@@ -0,0 +1,406 @@
+/******************************************************************************
+Copyright (c) 2014, Google Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+    * Neither the name of the <ORGANIZATION> nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+#include "StdAfx.h"
+#include "result_stream.h"
+
+static const DWORD RESULT_STREAM_SIGNATURE = 0x53545057;  // "WPTS"
+static const DWORD RESULT_STREAM_SIZE = 4 * 1024 * 1024;
+static const DWORD RECORD_HEADER_LEN = sizeof(DWORD) * 3;
+static const DWORD RECORD_WRITE = 1;
+static const DWORD RECORD_APPEND = 2;
+static const DWORD WAIT_SLICE = 10;
+static const DWORD DRAIN_INTERVAL = 100;
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static unsigned __stdcall ResultStreamDrainThread(void* arg) {
+  ResultStream * stream = (ResultStream *)arg;
+  if (stream)
+    stream->DrainThread();
+  return 0;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+ResultStream::ResultStream(void):
+  mapping_(NULL)
+  ,data_available_(NULL)
+  ,header_(NULL)
+  ,data_(NULL)
+  ,drain_thread_(NULL)
+  ,stop_(false)
+  ,failed_(false) {
+  InitializeCriticalSection(&cs_);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+ResultStream::~ResultStream(void) {
+  StopDrain();
+  Close();
+  DeleteCriticalSection(&cs_);
+}
+
+/*-----------------------------------------------------------------------------
+  Create the ring (driver, before the browser is launched)
+-----------------------------------------------------------------------------*/
+bool ResultStream::Create(SECURITY_ATTRIBUTES * security, CString id) {
+  Close();
+  DWORD size = sizeof(Header) + RESULT_STREAM_SIZE;
+  mapping_ = CreateFileMapping(INVALID_HANDLE_VALUE, security, PAGE_READWRITE,
+                               0, size, RESULT_STREAM_NAME + id);
+  if (mapping_) {
+    header_ = (Header *)MapViewOfFile(mapping_, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    if (header_) {
+      memset(header_, 0, sizeof(Header));
+      header_->size_ = RESULT_STREAM_SIZE;
+      header_->signature_ = RESULT_STREAM_SIGNATURE;
+      data_ = (BYTE *)(header_ + 1);
+    }
+  }
+  data_available_ = CreateEvent(security, FALSE, FALSE,
+                                RESULT_STREAM_EVENT + id);
+  if (!header_ || !data_available_)
+    Close();
+  return header_ != NULL;
+}
+
+/*-----------------------------------------------------------------------------
+  Attach to the driver's ring (hook)
+-----------------------------------------------------------------------------*/
+bool ResultStream::Open(CString id) {
+  Close();
+  if (!id.IsEmpty())
+    mapping_ = OpenFileMapping(FILE_MAP_ALL_ACCESS, FALSE,
+                               RESULT_STREAM_NAME + id);
+  if (mapping_) {
+    header_ = (Header *)MapViewOfFile(mapping_, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    if (header_ && (header_->signature_ != RESULT_STREAM_SIGNATURE ||
+                    header_->size_ != RESULT_STREAM_SIZE)) {
+      UnmapViewOfFile(header_);
+      header_ = NULL;
+    }
+    if (header_)
+      data_ = (BYTE *)(header_ + 1);
+  }
+  if (header_)
+    data_available_ = OpenEvent(EVENT_MODIFY_STATE, FALSE,
+                                RESULT_STREAM_EVENT + id);
+  if (!header_ || !data_available_)
+    Close();
+  WptTrace(loglevel::kFunction,
+    _T("[wpthook] - ResultStream::Open() %s\n"),
+    header_ ? _T("streaming results to the driver") : _T("not available"));
+  return header_ != NULL;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void ResultStream::Close(void) {
+  EnterCriticalSection(&cs_);
+  if (header_)
+    UnmapViewOfFile(header_);
+  header_ = NULL;
+  data_ = NULL;
+  if (mapping_)
+    CloseHandle(mapping_);
+  mapping_ = NULL;
+  if (data_available_)
+    CloseHandle(data_available_);
+  data_available_ = NULL;
+  failed_ = false;
+  queued_.RemoveAll();
+  LeaveCriticalSection(&cs_);
+}
+
+/*-----------------------------------------------------------------------------
+  Hand a file off to the driver.  Incremental data can't wait (timeout 0)
+  but the end-of-test files can wait for the driver to make room.
+
+  When a whole file can't be streamed the caller writes it directly and
+  anything that is still queued for that file is superseded.  Records for
+  the other files are left for the driver to write.
+-----------------------------------------------------------------------------*/
+bool ResultStream::Write(CString file, LPCSTR data, DWORD len, bool append,
+                         DWORD timeout) {
+  bool ret = false;
+  EnterCriticalSection(&cs_);
+  if (header_) {
+    if (!failed_) {
+      ret = Put(append ? RECORD_APPEND : RECORD_WRITE, file, data, len,
+                timeout);
+      if (!ret && !WaitForDrain(timeout)) {
+        WptTrace(loglevel::kWarning,
+          _T("[wpthook] - ResultStream::Write() driver isn't keeping up, ")
+          _T("writing the results directly\n"));
+        failed_ = true;
+      }
+    }
+    CString key(file);
+    key.MakeLower();
+    DWORD end = 0;
+    if (ret)
+      queued_.SetAt(key, (DWORD)header_->write_);
+    else if (!append && queued_.Lookup(key, end) &&
+             (LONG)(end - (DWORD)header_->read_) > 0)
+      Supersede(key, timeout);
+  }
+  LeaveCriticalSection(&cs_);
+  return ret;
+}
+
+/*-----------------------------------------------------------------------------
+  Have the driver skip whatever is still queued for the file and wait for
+  it to finish a record that it may already be writing (called inside of
+  cs_ with the lower-case path)
+-----------------------------------------------------------------------------*/
+void ResultStream::Supersede(const CString& file, DWORD timeout) {
+  DWORD hash = PathHash(file);
+  LONG count = header_->superseded_count_;
+  bool found = false;
+  for (LONG i = 0; i < count && !found; i++)
+    if (header_->superseded_[i] == hash)
+      found = true;
+  if (!found && count < MAX_SUPERSEDED_FILES) {
+    header_->superseded_[count] = hash;
+    InterlockedExchange(&header_->superseded_count_, count + 1);
+  } else if (!found) {
+    WptTrace(loglevel::kWarning,
+      _T("[wpthook] - ResultStream::Supersede() too many files, %s may be ")
+      _T("overwritten by the driver\n"), (LPCTSTR)file);
+  }
+  LONG writing = header_->writing_;
+  DWORD waited = 0;
+  while ((writing & 1) && header_->writing_ == writing && waited < timeout) {
+    Sleep(WAIT_SLICE);
+    waited += WAIT_SLICE;
+  }
+}
+
+/*-----------------------------------------------------------------------------
+  Did the hook write the file directly (lower-case path)?
+-----------------------------------------------------------------------------*/
+bool ResultStream::Superseded(const CString& file) {
+  bool found = false;
+  LONG count = InterlockedCompareExchange(&header_->superseded_count_, 0, 0);
+  if (count > 0) {
+    DWORD hash = PathHash(file);
+    for (LONG i = 0; i < count && i < MAX_SUPERSEDED_FILES && !found; i++)
+      if (header_->superseded_[i] == hash)
+        found = true;
+  }
+  return found;
+}
+
+/*-----------------------------------------------------------------------------
+  FNV-1a of the path so both processes can match files in the header
+-----------------------------------------------------------------------------*/
+DWORD ResultStream::PathHash(const CString& file) const {
+  DWORD hash = 2166136261;
+  for (int i = 0; i < file.GetLength(); i++) {
+    hash ^= (DWORD)file.GetAt(i);
+    hash *= 16777619;
+  }
+  return hash;
+}
+
+/*-----------------------------------------------------------------------------
+  Wait for the driver to write everything that has been published
+  (called inside of cs_)
+-----------------------------------------------------------------------------*/
+bool ResultStream::WaitForDrain(DWORD timeout) {
+  DWORD waited = 0;
+  while (header_->read_ != header_->write_ && waited < timeout) {
+    SetEvent(data_available_);
+    Sleep(WAIT_SLICE);
+    waited += WAIT_SLICE;
+  }
+  return header_->read_ == header_->write_;
+}
+
+/*-----------------------------------------------------------------------------
+  Copy one record into the ring and publish it, waiting up to timeout for
+  the whole record to fit (called inside of cs_)
+-----------------------------------------------------------------------------*/
+bool ResultStream::Put(DWORD type, const CString& file, LPCSTR data,
+                       DWORD len, DWORD timeout) {
+  bool ret = false;
+  CStringW path(file);
+  DWORD path_chars = path.GetLength();
+  DWORD record_len = RECORD_HEADER_LEN + path_chars * sizeof(WCHAR) + len;
+  bool fits = len <= RESULT_STREAM_SIZE && record_len <= RESULT_STREAM_SIZE;
+  DWORD write = (DWORD)header_->write_;
+  DWORD waited = 0;
+  DWORD available = RESULT_STREAM_SIZE - (write - (DWORD)header_->read_);
+  while (fits && record_len > available && waited < timeout) {
+    SetEvent(data_available_);
+    Sleep(WAIT_SLICE);
+    waited += WAIT_SLICE;
+    available = RESULT_STREAM_SIZE - (write - (DWORD)header_->read_);
+  }
+  if (fits && record_len <= available) {
+    DWORD pos = write;
+    CopyIn(pos, &record_len, sizeof(record_len));
+    pos += sizeof(record_len);
+    CopyIn(pos, &type, sizeof(type));
+    pos += sizeof(type);
+    CopyIn(pos, &path_chars, sizeof(path_chars));
+    pos += sizeof(path_chars);
+    CopyIn(pos, (LPCWSTR)path, path_chars * sizeof(WCHAR));
+    pos += path_chars * sizeof(WCHAR);
+    CopyIn(pos, data, len);
+    MemoryBarrier();
+    InterlockedExchange(&header_->write_, (LONG)(write + record_len));
+    SetEvent(data_available_);
+    ret = true;
+  } else {
+    InterlockedIncrement(&header_->dropped_);
+  }
+  return ret;
+}
+
+/*-----------------------------------------------------------------------------
+  Start writing the streamed files (only into the test's directory)
+-----------------------------------------------------------------------------*/
+void ResultStream::StartDrain(CString directory) {
+  if (header_ && !drain_thread_) {
+    directory_ = directory;
+    directory_.TrimRight(_T("\\"));
+    directory_ += _T("\\");
+    stop_ = false;
+    drain_thread_ = (HANDLE)_beginthreadex(0, 0, ::ResultStreamDrainThread,
+                                           this, 0, 0);
+  }
+}
+
+/*-----------------------------------------------------------------------------
+  Stop the drain thread after writing everything that is in the ring
+-----------------------------------------------------------------------------*/
+void ResultStream::StopDrain(void) {
+  if (drain_thread_) {
+    stop_ = true;
+    SetEvent(data_available_);
+    WaitForSingleObject(drain_thread_, INFINITE);
+    CloseHandle(drain_thread_);
+    drain_thread_ = NULL;
+  }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void ResultStream::DrainThread(void) {
+  while (!stop_) {
+    WaitForSingleObject(data_available_, DRAIN_INTERVAL);
+    Drain();
+  }
+  Drain();
+  if (header_ && header_->dropped_)
+    WptTrace(loglevel::kWarning,
+      _T("[wptdriver] ResultStream - %d records were not streamed\n"),
+      header_->dropped_);
+}
+
+/*-----------------------------------------------------------------------------
+  Write out every published record except the ones for files that the hook
+  has since written directly
+-----------------------------------------------------------------------------*/
+bool ResultStream::Drain(void) {
+  bool ret = true;
+  DWORD write = (DWORD)InterlockedCompareExchange(&header_->write_, 0, 0);
+  DWORD read = (DWORD)header_->read_;
+  while (ret && read != write) {
+    DWORD record_len = 0, type = 0, path_chars = 0;
+    DWORD pos = read;
+    CopyOut(pos, &record_len, sizeof(record_len));
+    pos += sizeof(record_len);
+    CopyOut(pos, &type, sizeof(type));
+    pos += sizeof(type);
+    CopyOut(pos, &path_chars, sizeof(path_chars));
+    pos += sizeof(path_chars);
+    if (record_len < RECORD_HEADER_LEN || record_len > write - read ||
+        path_chars > MAX_PATH ||
+        path_chars * sizeof(WCHAR) > record_len - RECORD_HEADER_LEN) {
+      // corrupt, skip everything that is there
+      ret = false;
+    } else {
+      CStringW path;
+      CopyOut(pos, path.GetBufferSetLength(path_chars),
+              path_chars * sizeof(WCHAR));
+      path.ReleaseBuffer(path_chars);
+      pos += path_chars * sizeof(WCHAR);
+      DWORD len = record_len - RECORD_HEADER_LEN - path_chars * sizeof(WCHAR);
+      CString file(path);
+      CString key(file);
+      key.MakeLower();
+      InterlockedIncrement(&header_->writing_);
+      if (!Superseded(key) &&
+          !file.Left(directory_.GetLength()).CompareNoCase(directory_) &&
+          file.Find(_T("..")) == -1) {
+        HANDLE file_handle = CreateFile(file, GENERIC_WRITE, 0, 0,
+            type == RECORD_APPEND ? OPEN_ALWAYS : CREATE_ALWAYS, 0, 0);
+        if (file_handle != INVALID_HANDLE_VALUE) {
+          if (len) {
+            char * buff = (char *)malloc(len);
+            if (buff) {
+              CopyOut(pos, buff, len);
+              DWORD written = 0;
+              SetFilePointer(file_handle, 0, 0, FILE_END);
+              WriteFile(file_handle, buff, len, &written, 0);
+              free(buff);
+            }
+          }
+          CloseHandle(file_handle);
+        }
+      }
+      InterlockedIncrement(&header_->writing_);
+    }
+    read = ret ? read + record_len : write;
+    InterlockedExchange(&header_->read_, (LONG)read);
+  }
+  return ret;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void ResultStream::CopyIn(DWORD pos, const void * src, DWORD len) {
+  DWORD offset = pos % RESULT_STREAM_SIZE;
+  DWORD first = min(len, RESULT_STREAM_SIZE - offset);
+  memcpy(&data_[offset], src, first);
+  if (first < len)
+    memcpy(data_, (const BYTE *)src + first, len - first);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void ResultStream::CopyOut(DWORD pos, void * dst, DWORD len) {
+  DWORD offset = pos % RESULT_STREAM_SIZE;
+  DWORD first = min(len, RESULT_STREAM_SIZE - offset);
+  memcpy(dst, &data_[offset], first);
+  if (first < len)
+    memcpy((BYTE *)dst + first, data_, len - first);
+}
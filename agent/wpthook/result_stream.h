@@ -0,0 +1,111 @@
+/******************************************************************************
+Copyright (c) 2014, Google Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+    * Neither the name of the <ORGANIZATION> nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+#pragma once
+
+// named objects shared by the driver (which creates them) and the hook,
+// suffixed with an id that is unique to each browser launch
+const TCHAR * const RESULT_STREAM_NAME = _T("Local\\WptResultStream_");
+const TCHAR * const RESULT_STREAM_EVENT = _T("Local\\WptResultStreamData_");
+const DWORD MAX_SUPERSEDED_FILES = 64;
+
+/*-----------------------------------------------------------------------------
+  Shared-memory ring that the hook uses to hand result files off to the
+  driver so the file I/O happens outside of the browser being measured
+  (and whatever was streamed before a browser crash still gets written).
+
+  There is exactly one writer (the hook, serialized by a critical section
+  in the browser process) and one reader (the driver's drain thread) so
+  the only synchronization between the processes is the two running byte
+  counters in the header.  The writer fills in a record and then publishes
+  it by advancing the write counter; the reader consumes it and then
+  advances the read counter.  Records wrap around the end of the buffer.
+
+    DWORD(record length) DWORD(type) DWORD(path chars) WCHAR path[] data
+
+  A file is always a single record so it is either published whole or not
+  at all.  If it doesn't fit (too big, or the driver doesn't make room in
+  time) Write() returns false and the caller writes the file itself.  When
+  the driver can't catch up the stream stops taking new records but
+  everything that was published is still written.  Records that are still
+  queued for a file that the hook writes directly are superseded (listed
+  by path hash in the header) so the driver skips them instead of writing
+  them over the newer file.
+-----------------------------------------------------------------------------*/
+class ResultStream {
+public:
+  ResultStream(void);
+  ~ResultStream(void);
+
+  // driver
+  bool Create(SECURITY_ATTRIBUTES * security, CString id);
+  void StartDrain(CString directory);
+  void StopDrain(void);
+  void DrainThread(void);
+
+  // hook
+  bool Open(CString id);
+  bool Write(CString file, LPCSTR data, DWORD len, bool append = false,
+             DWORD timeout = 0);
+
+  void Close(void);
+  bool IsOpen(void) const {return header_ != NULL;}
+
+private:
+  class Header {
+  public:
+    DWORD           signature_;
+    DWORD           size_;
+    volatile LONG   write_;
+    volatile LONG   read_;
+    volatile LONG   dropped_;
+    volatile LONG   writing_;   // odd while the driver is writing a record
+    volatile LONG   superseded_count_;
+    DWORD           superseded_[MAX_SUPERSEDED_FILES];
+  };
+
+  bool Put(DWORD type, const CString& file, LPCSTR data, DWORD len,
+           DWORD timeout);
+  bool WaitForDrain(DWORD timeout);
+  void Supersede(const CString& file, DWORD timeout);
+  bool Superseded(const CString& file);
+  DWORD PathHash(const CString& file) const;
+  bool Drain(void);
+  void CopyIn(DWORD pos, const void * src, DWORD len);
+  void CopyOut(DWORD pos, void * dst, DWORD len);
+
+  HANDLE            mapping_;
+  HANDLE            data_available_;
+  Header *          header_;
+  BYTE *            data_;
+  CRITICAL_SECTION  cs_;
+  HANDLE            drain_thread_;
+  volatile bool     stop_;
+  bool              failed_;
+  CString           directory_;
+  CAtlMap<CString, DWORD> queued_;  // end of the last record for each file
+};
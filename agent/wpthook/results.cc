@@ -37,6 +37,9 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "screen_capture.h"
 #include "dev_tools.h"
 #include "trace.h"
+#include "net_log.h"
+#include "request_records.h"
+#include "replay_archive.h"
 #include "../wptdriver/wpt_test.h"
 #include "cximage/ximage.h"
 #include <zlib.h>
@@ -44,8 +47,10 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 static const TCHAR * PAGE_DATA_FILE = _T("_IEWPG.txt");
 static const TCHAR * REQUEST_DATA_FILE = _T("_IEWTR.txt");
+static const TCHAR * REQUEST_RECORDS_FILE = _T("_requests.bin");
 static const TCHAR * REQUEST_HEADERS_DATA_FILE = _T("_report.txt");
 static const TCHAR * PROGRESS_DATA_FILE = _T("_progress.csv");
+static const TCHAR * RESOURCES_DATA_FILE = _T("_resources.csv");
 static const TCHAR * STATUS_MESSAGE_DATA_FILE = _T("_status.txt");
 static const TCHAR * IMAGE_DOC_COMPLETE = _T("_screen_doc.jpg");
 static const TCHAR * IMAGE_FULLY_LOADED = _T("_screen.jpg");
@@ -54,10 +59,16 @@ static const TCHAR * IMAGE_START_RENDER = _T("_screen_render.jpg");
 static const TCHAR * IMAGE_RESPONSIVE_CHECK = _T("_screen_responsive.jpg");
 static const TCHAR * CONSOLE_LOG_FILE = _T("_console_log.json");
 static const TCHAR * TIMED_EVENTS_FILE = _T("_timed_events.json");
+static const char * PROGRESS_DATA_HEADER =
+    "Offset Time (ms),Bandwidth In (kbps),CPU Utilization (%),"
+    "Memory Use (KB)\r\n";
+static const DWORD RESULT_STREAM_TIMEOUT = 10000;
 static const TCHAR * TIMELINE_FILE = _T("_timeline.json");
 static const TCHAR * TRACE_FILE = _T("_trace.json");
+static const TCHAR * TRACE_SUMMARY_FILE = _T("_trace_summary.json");
 static const TCHAR * CUSTOM_RULES_DATA_FILE = _T("_custom_rules.json");
 static const TCHAR * DEV_TOOLS_FILE = _T("_devtools.json");
+static const TCHAR * NETLOG_FILE = _T("_netlog.txt");
 static const DWORD RIGHT_MARGIN = 25;
 static const DWORD BOTTOM_MARGIN = 25;
 
@@ -78,6 +89,7 @@ Results::Results(TestState& test_state, WptTest& test, Requests& requests,
   , _trace(trace) {
   _file_base = shared_results_file_base;
   _visually_complete.QuadPart = 0;
+  result_stream_.Open(shared_result_stream);
   WptTrace(loglevel::kFunction, _T("[wpthook] - Results base file: %s"), 
             (LPCTSTR)_file_base);
 }
@@ -128,7 +140,20 @@ void Results::Reset(void) {
 void Results::Save(void) {
   WptTrace(loglevel::kFunction, _T("[wpthook] - Results::Save()\n"));
   if (!_saved) {
+    // the checks pick up whatever was analyzed during the test
+    _requests.analyzer_.Stop();
+    if (_test._netlog && net_log_.Load(_file_base + NETLOG_FILE))
+      net_log_.Apply(_requests, _test_state);
     ProcessRequests();
+    if (_test.replay_mode_ == REPLAY_RECORD) {
+      CString directory = _file_base;
+      int separator = directory.ReverseFind(_T('\\'));
+      if (separator > 0) {
+        ReplayArchive archive;
+        archive.Record(_requests,
+                       directory.Left(separator + 1) + REPLAY_DIRECTORY);
+      }
+    }
     if (_test._log_data) {
       OptimizationChecks checks(_requests, _test_state, _test, _dns);
       checks.Check();
@@ -136,6 +161,7 @@ void Results::Save(void) {
       SaveRequests(checks);
       SaveImages();
       SaveProgressData();
+      SaveResources();
       SaveStatusMessages();
       SavePageData(checks);
       SaveResponseBodies();
@@ -145,8 +171,10 @@ void Results::Save(void) {
         _dev_tools.SetStartTime(_test_state._start);
         _dev_tools.Write(_file_base + DEV_TOOLS_FILE);
       }
-      if (_test._trace)
+      if (_test._trace) {
         _trace.Write(_file_base + TRACE_FILE);
+        _trace.WriteSummary(_file_base + TRACE_SUMMARY_FILE);
+      }
     }
     _saved = true;
   }
@@ -164,28 +192,81 @@ void Results::SaveProgressData(void) {
   peak_process_count_ = 0;
   while( pos ) {
     if (progress.IsEmpty())
-      progress = "Offset Time (ms),Bandwidth In (kbps),"
-                  "CPU Utilization (%),Memory Use (KB)\r\n";
+      progress = PROGRESS_DATA_HEADER;
     ProgressData data = _test_state._progress_data.GetNext(pos);
-    DWORD ms = _test_state.ElapsedMsFromStart(data._time);
-    CStringA buff;
-    buff.Format("%d,%d,%0.2f,%d\r\n", ms, data._bpsIn, data._cpu, data._mem );
-    progress += buff;
+    progress += FormatProgressData(data);
     if (data._mem > peak_memory_)
       peak_memory_ = data._mem;
     if (data._process_count > peak_process_count_)
       peak_process_count_ = data._process_count;
   }
   _test_state.UnLock();
-  HANDLE hFile = CreateFile(_file_base + PROGRESS_DATA_FILE, GENERIC_WRITE, 0, 
-                                NULL, CREATE_ALWAYS, 0, 0);
-  if (hFile != INVALID_HANDLE_VALUE) {
-    DWORD dwBytes;
-    WriteFile(hFile, (LPCSTR)progress, progress.GetLength(), &dwBytes, 0);
-    CloseHandle(hFile);
+  SaveFile(_file_base + PROGRESS_DATA_FILE, progress, progress.GetLength());
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+CStringA Results::FormatProgressData(ProgressData& data) {
+  CStringA buff;
+  buff.Format("%d,%d,%0.2f,%d\r\n", _test_state.ElapsedMsFromStart(data._time),
+              data._bpsIn, data._cpu, data._mem);
+  return buff;
+}
+
+/*-----------------------------------------------------------------------------
+  Stream a progress sample as it is collected so the data up to that point
+  survives a browser crash (the whole file is re-written when saving).
+-----------------------------------------------------------------------------*/
+void Results::StreamProgressData(ProgressData& data, bool first) {
+  if (result_stream_.IsOpen()) {
+    CStringA progress;
+    if (first)
+      progress = PROGRESS_DATA_HEADER;
+    progress += FormatProgressData(data);
+    result_stream_.Write(_file_base + PROGRESS_DATA_FILE, progress,
+                         progress.GetLength(), !first);
+  }
+}
+
+/*-----------------------------------------------------------------------------
+  Stream a status message as it is received (see StreamProgressData).
+-----------------------------------------------------------------------------*/
+void Results::StreamStatusMessage(StatusMessage& message) {
+  if (result_stream_.IsOpen()) {
+    CStringA status = FormatTime(message._time);
+    status += CT2A(message._status, CP_UTF8);
+    status += "\r\n";
+    result_stream_.Write(_file_base + STATUS_MESSAGE_DATA_FILE, status,
+                         status.GetLength(), true);
   }
 }
 
+/*-----------------------------------------------------------------------------
+  Hand the file off to the driver if it is streaming results, otherwise
+  (or if the driver isn't keeping up) write it directly.
+-----------------------------------------------------------------------------*/
+void Results::SaveFile(CString file, LPCSTR data, DWORD len) {
+  if (!result_stream_.Write(file, data, len, false, RESULT_STREAM_TIMEOUT)) {
+    HANDLE file_handle = CreateFile(file, GENERIC_WRITE, 0, 0,
+                                    CREATE_ALWAYS, 0, 0);
+    if (file_handle != INVALID_HANDLE_VALUE) {
+      DWORD written;
+      WriteFile(file_handle, data, len, &written, 0);
+      CloseHandle(file_handle);
+    }
+  }
+}
+
+/*-----------------------------------------------------------------------------
+  Save the per-process resource samples.
+-----------------------------------------------------------------------------*/
+void Results::SaveResources(void) {
+  CStringA resources = _test_state._resource_sampler.FormatCsv();
+  if (!resources.IsEmpty())
+    SaveFile(_file_base + RESOURCES_DATA_FILE, resources,
+             resources.GetLength());
+}
+
 /*-----------------------------------------------------------------------------
   Save the browser status messages
 -----------------------------------------------------------------------------*/
@@ -201,14 +282,7 @@ void Results::SaveStatusMessages(void) {
     status += "\r\n";
   }
   _test_state.UnLock();
-  HANDLE hFile = CreateFile(_file_base + STATUS_MESSAGE_DATA_FILE, 
-                            GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, 0);
-  if( hFile != INVALID_HANDLE_VALUE )
-  {
-    DWORD dwBytes;
-    WriteFile(hFile, (LPCSTR)status, status.GetLength(), &dwBytes, 0);
-    CloseHandle(hFile);
-  }
+  SaveFile(_file_base + STATUS_MESSAGE_DATA_FILE, status, status.GetLength());
 }
 
 /*-----------------------------------------------------------------------------
@@ -334,7 +408,12 @@ void Results::SaveImage(CxImage& image, CString file, BYTE quality,
     img.SetCodecOption(8, CXIMAGE_FORMAT_JPG);  // optimized encoding
     img.SetCodecOption(16, CXIMAGE_FORMAT_JPG); // progressive
     img.SetJpegQuality((BYTE)quality);
-    img.Save(file, CXIMAGE_FORMAT_JPG);
+    uint8_t * buffer = NULL;
+    int32_t size = 0;
+    if (img.Encode(buffer, size, CXIMAGE_FORMAT_JPG) && buffer) {
+      SaveFile(file, (LPCSTR)buffer, size);
+      img.FreeMemory(buffer);
+    }
   }
 }
 
@@ -384,14 +463,7 @@ void Results::SaveHistogram(CxImage& image, CString file) {
     CStringA histogram = CStringA("{") + red + 
                          CStringA(",") + green + 
                          CStringA(",") + blue + CStringA("}");
-
-    HANDLE file_handle = CreateFile(file, GENERIC_WRITE, 0, 0, 
-                                    CREATE_ALWAYS, 0, 0);
-    if (file_handle != INVALID_HANDLE_VALUE) {
-      DWORD bytes;
-      WriteFile(file_handle, (LPCSTR)histogram, histogram.GetLength(), &bytes, 0);
-      CloseHandle(file_handle);
-    }
+    SaveFile(file, histogram, histogram.GetLength());
   }
 }
 
@@ -532,7 +604,8 @@ void Results::SavePageData(OptimizationChecks& checks){
     // DOCTYPE Score
     result += "-1\t";
     // Minify Score
-    result += "-1\t";
+    buff.Format("%d\t", checks._minify_score);
+    result += buff;
     // Combine Score
     buff.Format("%d\t", checks._combine_score);
     result += buff;
@@ -593,9 +666,11 @@ void Results::SavePageData(OptimizationChecks& checks){
     buff.Format("%d\t", checks._gzip_total - checks._gzip_target);
     result += buff;
     // Minify Total Bytes
-    result += "\t";
+    buff.Format("%d\t", checks._minify_total);
+    result += buff;
     // Minify Savings
-    result += "\t";
+    buff.Format("%d\t", checks._minify_total - checks._minify_target);
+    result += buff;
     // Image Compression Total Bytes
     buff.Format("%d\t", checks._image_compress_total);
     result += buff;
@@ -709,6 +784,8 @@ void Results::SavePageData(OptimizationChecks& checks){
     // Is Responsive
     buff.Format("%d\t", _test_state._is_responsive);
     result += buff;
+    // Last Visual Change (ms) from the paint checks
+    result += FormatTime(_test_state._last_visual_change);
 
     result += "\r\n";
 
@@ -857,6 +934,8 @@ void Results::SaveRequests(OptimizationChecks& checks) {
     HANDLE headers_file = CreateFile(_file_base + REQUEST_HEADERS_DATA_FILE,
                             GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, 0);
 
+    // this step's records, appended as a block like the text report
+    RequestRecordsWriter records;
     HANDLE custom_rules_file = INVALID_HANDLE_VALUE;
     if (!_test._custom_rules.IsEmpty()) {
       custom_rules_file = CreateFile(_file_base +CUSTOM_RULES_DATA_FILE,
@@ -887,7 +966,7 @@ void Results::SaveRequests(OptimizationChecks& checks) {
         request->_reported = true;
         if (request->_processed) {
           i++;
-          SaveRequest(file, headers_file, request, i);
+          SaveRequest(file, headers_file, request, i, records);
           if (!request->_custom_rules_matches.IsEmpty() && 
               custom_rules_file != INVALID_HANDLE_VALUE) {
             if (first_custom_rule) {
@@ -932,233 +1011,94 @@ void Results::SaveRequests(OptimizationChecks& checks) {
     if (headers_file != INVALID_HANDLE_VALUE)
       CloseHandle(headers_file);
     CloseHandle(file);
+    records.Append(_file_base + REQUEST_RECORDS_FILE);
   }
 }
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
 void Results::SaveRequest(HANDLE file, HANDLE headers, Request * request, 
-                                                                   int index) {
-  CStringA result;
+                          int index, RequestRecordsWriter& records) {
+  RequestRecord record;
   CStringA buff;
+  int * values = record.values_;
+  CStringA * strings = record.strings_;
 
-  // Date
-  buff.Format("%02d/%02d/%02d\t", _test_state._start_time.wMonth,
+  buff.Format("%02d/%02d/%02d", _test_state._start_time.wMonth,
         _test_state._start_time.wDay, _test_state._start_time.wYear);
-  result += buff;
-  // Time
-  buff.Format("%02d:%02d:%02d\t", _test_state._start_time.wHour,
+  strings[RECORD_DATE] = buff;
+  buff.Format("%02d:%02d:%02d", _test_state._start_time.wHour,
         _test_state._start_time.wMinute, _test_state._start_time.wSecond);
-  result += buff;
-  // Event Name
-  result += "\t";
-  // IP Address
-  struct sockaddr_in addr;
-  addr.sin_addr.S_un.S_addr = request->_peer_address;
-  if (addr.sin_addr.S_un.S_addr) {
-    buff.Format("%d.%d.%d.%d", addr.sin_addr.S_un.S_un_b.s_b1, 
-      addr.sin_addr.S_un.S_un_b.s_b2, addr.sin_addr.S_un.S_un_b.s_b3, 
-      addr.sin_addr.S_un.S_un_b.s_b4);
-    result += buff;
-  }
-  result += "\t";
-  // Action
-  result += request->_request_data.GetMethod() + "\t";
-  // Host
-  result += request->GetHost() + "\t";
-  // URL
-  result += request->_request_data.GetObject() + "\t";
-  // Response Code
-  buff.Format("%d\t", request->_response_data.GetResult());
-  result += buff;
-  // Time to Load (ms)
-  buff.Format("%d\t", request->_ms_end - request->_ms_start);
-  result += buff;
-  // Time to First Byte (ms)
-  if (request->_ms_first_byte >= request->_ms_start) {
-    buff.Format("%d\t", request->_ms_first_byte - request->_ms_start);
-  } else {
-    buff = "\t";
-  }
-  result += buff;
-  // Start Time (ms)
-  buff.Format("%d\t", request->_ms_start);
-  result += buff;
-  // Bytes Out
-  buff.Format("%d\t", request->_request_data.GetDataSize());
-  result += buff;
-  // Bytes In
-  buff.Format("%d\t", request->_bytes_in ? request->_bytes_in :
-              request->_response_data.GetDataSize());
-  result += buff;
-  // Object Size
-  DWORD size = request->_response_data.GetBody().GetLength();
-  buff.Format("%d\t", size);
-  result += buff;
-  // Cookie Size (out)
-  result += "\t";
-  // Cookie Count(out)
-  result += "\t";
-  // Expires
-  result += request->GetResponseHeader("expires") + "\t";
-  // Cache Control
-  result += request->GetResponseHeader("cache-control") + "\t";
-  // Content Type
+  strings[RECORD_TIME] = buff;
+  values[RECORD_IP_ADDRESS] = (int)request->_peer_address;
+  strings[RECORD_METHOD] = request->_request_data.GetMethod();
+  strings[RECORD_HOST] = request->GetHost();
+  strings[RECORD_URL] = request->_request_data.GetObject();
+  values[RECORD_RESULT] = request->_response_data.GetResult();
+  values[RECORD_START] = request->_ms_start;
+  values[RECORD_FIRST_BYTE] = request->_ms_first_byte;
+  values[RECORD_END] = request->_ms_end;
+  values[RECORD_BYTES_OUT] = request->_request_data.GetDataSize();
+  values[RECORD_BYTES_IN] = request->_bytes_in ? request->_bytes_in :
+                            request->_response_data.GetDataSize();
+  values[RECORD_OBJECT_SIZE] = request->_response_data.GetBody().GetLength();
+  strings[RECORD_EXPIRES] = request->GetResponseHeader("expires");
+  strings[RECORD_CACHE_CONTROL] = request->GetResponseHeader("cache-control");
   int pos = 0;
-  result += request->GetResponseHeader("content-type").Tokenize(";", pos) 
-            + "\t";
-  // Content Encoding
-  result += request->GetResponseHeader("content-encoding") + "\t";
-  // Transaction Type (3 = request - legacy reasons)
-  result += "3\t";
-  // Socket ID
-  buff.Format("%d\t", request->_socket_id);
-  result += buff;
-  // Document ID
-  result += "\t";
-  // End Time (ms)
-  buff.Format("%d\t", request->_ms_end);
-  result += buff;
-  // Descriptor
-  result += "\t";
-  // Lab ID
-  result += "\t";
-  // Dialer ID
-  result += "\t";
-  // Connection Type
-  result += "\t";
-  // Cached
-  result += "\t";
-  // Event URL
-  result += "\t";
-  // IEWatch Build
-  result += "\t";
-  // Measurement Type - (DWORD - 1 for web 1.0, 2 for web 2.0)
-  result += "\t";
-  // Experimental (DWORD)
-  result += "\t";
-  // Event GUID - (matches with Event GUID in object data) - Added in build 42
-  result += "\t";
-  // Sequence Number - Incremented for each record in the object data
-  buff.Format("%d\t", index);
-  result += buff;
-  // Cache Score
-  buff.Format("%d\t", request->_scores._cache_score);
-  result += buff;
-  // Static CDN Score
-  buff.Format("%d\t", request->_scores._static_cdn_score);
-  result += buff;
-  // GZIP Score
-  buff.Format("%d\t", request->_scores._gzip_score);
-  result += buff;
-  // Cookie Score
-  result += "-1\t";
-  // Keep-Alive Score
-  buff.Format("%d\t", request->_scores._keep_alive_score);
-  result += buff;
-  // DOCTYPE Score
-  result += "-1\t";
-  // Minify Score
-  result += "-1\t";
-  // Combine Score
-  buff.Format("%d\t", request->_scores._combine_score);
-  result += buff;
-  // Image Compression Score
-  buff.Format("%d\t", request->_scores._image_compression_score);
-  result += buff;
-  // ETag Score
-  result += "-1\t";
-  // Flagged
-  result += "0\t";
-  // Secure
-  result += request->_is_ssl ? "1\t" : "0\t";
-  // DNS Time (ms)
-  result += "-1\t";
-  // Socket Connect time (ms)
-  result += "-1\t";
-  // SSL time (ms)
-  result += "-1\t";
-  // Gzip Total Bytes
-  buff.Format("%d\t", request->_scores._gzip_total);
-  result += buff;
-  // Gzip Savings
-  buff.Format("%d\t",
-    request->_scores._gzip_total - request->_scores._gzip_target);
-  result += buff;
-  // Minify Total Bytes
-  result += "0\t";
-  // Minify Savings
-  result += "0\t";
-  // Image Compression Total Bytes
-  buff.Format("%d\t", request->_scores._image_compress_total);
-  result += buff;
-  // Image Compression Savings
-  buff.Format("%d\t",
-    request->_scores._image_compress_total
-    - request->_scores._image_compress_target);
-  result += buff;
-  // Cache Time (sec)
-  buff.Format("%d\t", request->_scores._cache_time_secs);
-  result += buff;
-  // Real Start Time (ms)
-  result += "\t";
-  // Full Time to Load (ms)
-  result += "\t";
-  // Optimization Checked
-  result += "1\t";
-  // CDN Provider
-  result += request->_scores._cdn_provider + "\t";
-  // DNS start
-  buff.Format("%d\t", request->_ms_dns_start);
-  result += buff;
-  // DNS end
-  buff.Format("%d\t", request->_ms_dns_end);
-  result += buff;
-  // connect start
-  buff.Format("%d\t", request->_ms_connect_start);
-  result += buff;
-  // connect end
-  buff.Format("%d\t", request->_ms_connect_end);
-  result += buff;
-  // ssl negotiation start
-  buff.Format("%d\t", request->_ms_ssl_start);
-  result += buff;
-  // ssl negotiation end
-  buff.Format("%d\t", request->_ms_ssl_end);
-  result += buff;
-  // initiator
-  result += request->initiator_ + _T("\t");
-  result += request->initiator_line_ + _T("\t");
-  result += request->initiator_column_ + _T("\t");
-  // Server Count
-  buff.Format("%d\t", _dns.GetAddressCount((LPCTSTR)CA2T(request->GetHost())));
-  result += buff;
-  // Server RTT
-  result += request->rtt_ + "\t";
-  // Local Port
-  buff.Format("%d\t", request->_local_port);
-  result += buff;
-  // JPEG scan count
-  buff.Format("%d\t", request->_scores._jpeg_scans);
-  result += buff;
-
-  result += "\r\n";
+  strings[RECORD_CONTENT_TYPE] =
+      request->GetResponseHeader("content-type").Tokenize(";", pos);
+  strings[RECORD_CONTENT_ENCODING] =
+      request->GetResponseHeader("content-encoding");
+  values[RECORD_SOCKET_ID] = request->_socket_id;
+  values[RECORD_INDEX] = index;
+  values[RECORD_CACHE_SCORE] = request->_scores._cache_score;
+  values[RECORD_STATIC_CDN_SCORE] = request->_scores._static_cdn_score;
+  values[RECORD_GZIP_SCORE] = request->_scores._gzip_score;
+  values[RECORD_KEEP_ALIVE_SCORE] = request->_scores._keep_alive_score;
+  values[RECORD_COMBINE_SCORE] = request->_scores._combine_score;
+  values[RECORD_IMAGE_COMPRESSION_SCORE] =
+      request->_scores._image_compression_score;
+  values[RECORD_SECURE] = request->_is_ssl ? 1 : 0;
+  values[RECORD_GZIP_TOTAL] = request->_scores._gzip_total;
+  values[RECORD_GZIP_SAVINGS] =
+      request->_scores._gzip_total - request->_scores._gzip_target;
+  values[RECORD_MINIFY_SCORE] = request->_scores._minify_score;
+  values[RECORD_MINIFY_TOTAL] = request->_scores._minify_total;
+  values[RECORD_MINIFY_SAVINGS] =
+      request->_scores._minify_total - request->_scores._minify_target;
+  values[RECORD_IMAGE_TOTAL] = request->_scores._image_compress_total;
+  values[RECORD_IMAGE_SAVINGS] = request->_scores._image_compress_total
+                                 - request->_scores._image_compress_target;
+  values[RECORD_CACHE_TIME] = request->_scores._cache_time_secs;
+  strings[RECORD_CDN_PROVIDER] = request->_scores._cdn_provider;
+  values[RECORD_DNS_START] = request->_ms_dns_start;
+  values[RECORD_DNS_END] = request->_ms_dns_end;
+  values[RECORD_CONNECT_START] = request->_ms_connect_start;
+  values[RECORD_CONNECT_END] = request->_ms_connect_end;
+  values[RECORD_SSL_START] = request->_ms_ssl_start;
+  values[RECORD_SSL_END] = request->_ms_ssl_end;
+  strings[RECORD_INITIATOR] = request->initiator_;
+  strings[RECORD_INITIATOR_LINE] = request->initiator_line_;
+  strings[RECORD_INITIATOR_COLUMN] = request->initiator_column_;
+  values[RECORD_SERVER_COUNT] =
+      _dns.GetAddressCount((LPCTSTR)CA2T(request->GetHost()));
+  strings[RECORD_RTT] = request->rtt_;
+  values[RECORD_LOCAL_PORT] = request->_local_port;
+  values[RECORD_JPEG_SCANS] = request->_scores._jpeg_scans;
+  strings[RECORD_REQUEST_HEADERS] = request->_request_data.GetHeaders();
+  strings[RECORD_RESPONSE_HEADERS] = request->_response_data.GetHeaders();
 
+  CStringA result = record.FormatText();
   DWORD written;
   WriteFile(file, (LPCSTR)result, result.GetLength(), &written, 0);
 
   // write out the raw headers
   if (headers != INVALID_HANDLE_VALUE) {
-    buff.Format("Request details:\r\nRequest %d:\r\nRequest Headers:\r\n", 
-                  index);
-    buff += request->_request_data.GetHeaders();
-    buff.Trim("\r\n");
-    buff += "\r\nResponse Headers:\r\n";
-    buff += request->_response_data.GetHeaders();
-    buff.Trim("\r\n");
-    buff += "\r\n";
+    buff = record.FormatHeaders();
     WriteFile(headers, (LPCSTR)buff, buff.GetLength(), &written, 0);
   }
+
+  records.Add(record);
 }
 
 
@@ -1227,30 +1167,16 @@ void Results::SaveResponseBodies(void) {
 -----------------------------------------------------------------------------*/
 void Results::SaveConsoleLog(void) {
   CStringA log = CT2A(_test_state.GetConsoleLogJSON());
-  if (log.GetLength()) {
-    HANDLE file = CreateFile(_file_base + CONSOLE_LOG_FILE, GENERIC_WRITE, 0, 
-                              NULL, CREATE_ALWAYS, 0, 0);
-    if (file != INVALID_HANDLE_VALUE) {
-      DWORD written;
-      WriteFile(file, (LPCSTR)log, log.GetLength(), &written, 0);
-      CloseHandle(file);
-    }
-  }
+  if (log.GetLength())
+    SaveFile(_file_base + CONSOLE_LOG_FILE, log, log.GetLength());
 }
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
 void Results::SaveTimedEvents(void) {
   CStringA log = CT2A(_test_state.GetTimedEventsJSON());
-  if (log.GetLength()) {
-    HANDLE file = CreateFile(_file_base + TIMED_EVENTS_FILE, GENERIC_WRITE, 0, 
-                              NULL, CREATE_ALWAYS, 0, 0);
-    if (file != INVALID_HANDLE_VALUE) {
-      DWORD written;
-      WriteFile(file, (LPCSTR)log, log.GetLength(), &written, 0);
-      CloseHandle(file);
-    }
-  }
+  if (log.GetLength())
+    SaveFile(_file_base + TIMED_EVENTS_FILE, log, log.GetLength());
 }
 
 /*-----------------------------------------------------------------------------
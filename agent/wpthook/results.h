@@ -27,6 +27,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ******************************************************************************/
 
 #pragma once
+#include "result_stream.h"
+#include "net_log.h"
 
 class Requests;
 class Request;
@@ -39,6 +41,9 @@ class WptTest;
 class OptimizationChecks;
 class DevTools;
 class Trace;
+class RequestRecordsWriter;
+class StatusMessage;
+class ProgressData;
 
 class Results {
 public:
@@ -49,6 +54,8 @@ public:
 
   void Reset(void);
   void Save(void);
+  void StreamStatusMessage(StatusMessage& message);
+  void StreamProgressData(ProgressData& data, bool first);
 
   // test information
   CString _url;
@@ -65,6 +72,8 @@ private:
   Trace         &_trace;
   bool          _saved;
   LARGE_INTEGER _visually_complete;
+  ResultStream  result_stream_;
+  NetLog        net_log_;       // kept across steps, see NetLog
 
   CStringA      base_page_CDN_;
   int           base_page_redirects_;
@@ -95,15 +104,19 @@ private:
   void ProcessRequests(void);
   void SavePageData(OptimizationChecks&);
   void SaveRequests(OptimizationChecks&);
-  void SaveRequest(HANDLE file, HANDLE headers, Request * request, int index);
+  void SaveRequest(HANDLE file, HANDLE headers, Request * request, int index,
+                   RequestRecordsWriter& records);
   void SaveImages(void);
   void SaveVideo(void);
   void SaveProgressData(void);
+  void SaveResources(void);
   void SaveStatusMessages(void);
   void SaveImage(CxImage& image, CString file, BYTE quality,
                  bool force_small = false);
   bool ImagesAreDifferent(CxImage * img1, CxImage* img2);
   CStringA FormatTime(LARGE_INTEGER t);
+  CStringA FormatProgressData(ProgressData& data);
+  void SaveFile(CString file, LPCSTR data, DWORD len);
   void SaveResponseBodies(void);
   void SaveConsoleLog(void);
   void SaveTimedEvents(void);
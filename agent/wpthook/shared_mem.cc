@@ -41,6 +41,9 @@ WCHAR shared_log_file[MAX_PATH] = {NULL};
 int   shared_debug_level = 0;
 int   shared_cpu_utilization = 0;
 bool  shared_has_gpu = false;
+bool  shared_shape_traffic = false;
+int   shared_replay_mode = 0;
+WCHAR shared_result_stream[32] = {NULL};
 #pragma data_seg ()
 
 #pragma comment(linker,"/SECTION:.shared,RWS")
@@ -82,6 +85,27 @@ void WINAPI SetHasGPU(bool has_gpu) {
   shared_has_gpu = has_gpu;
 }
 
+/*-----------------------------------------------------------------------------
+  Shape the traffic in the hook (dummynet isn't available)
+-----------------------------------------------------------------------------*/
+void WINAPI SetShapeTraffic(bool shape_traffic) {
+  shared_shape_traffic = shape_traffic;
+}
+
+/*-----------------------------------------------------------------------------
+  Record the responses for (or replay them to) the run
+-----------------------------------------------------------------------------*/
+void WINAPI SetReplayMode(int mode) {
+  shared_replay_mode = mode;
+}
+
+/*-----------------------------------------------------------------------------
+  Id of the driver's result stream for this browser (empty for none)
+-----------------------------------------------------------------------------*/
+void WINAPI SetResultStream(const WCHAR * id) {
+  lstrcpynW(shared_result_stream, id, _countof(shared_result_stream));
+}
+
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
@@ -36,4 +36,8 @@ extern DWORD  shared_test_timeout;
 extern bool   shared_cleared_cache;
 extern DWORD  shared_current_run;
 extern int    shared_cpu_utilization;
+extern int    shared_debug_level;
 extern bool   shared_has_gpu;
+extern bool   shared_shape_traffic;
+extern int    shared_replay_mode;
+extern WCHAR  shared_result_stream[32];
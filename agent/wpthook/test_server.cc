@@ -46,6 +46,10 @@ static const char * RESPONSE_OK_STR = "OK";
 static const DWORD RESPONSE_ERROR_NOtest_ = 404;
 static const char * RESPONSE_ERROR_NOtest__STR = "ERROR: No Test";
 
+// long-polling for tasks (the browser passes how long to hold the request)
+static const DWORD MAX_TASK_WAIT = 30000;
+static const DWORD TASK_WAIT_SLICE = 100;  // re-check for sleeps and locks
+
 static const DWORD RESPONSE_ERROR_NOT_IMPLEMENTED = 403;
 static const char * RESPONSE_ERROR_NOT_IMPLEMENTED_STR = 
                                                       "ERROR: Not Implemented";
@@ -69,6 +73,7 @@ static const char * BLANK_HTML = "HTTP/1.1 200 OK\r\n"
 TestServer::TestServer(WptHook& hook, WptTestHook &test, TestState& test_state,
                         Requests& requests, DevTools &dev_tools, Trace &trace)
   :mongoose_context_(NULL)
+  ,stopping_(false)
   ,hook_(hook)
   ,test_(test)
   ,test_state_(test_state)
@@ -76,11 +81,13 @@ TestServer::TestServer(WptHook& hook, WptTestHook &test, TestState& test_state,
   ,dev_tools_(dev_tools)
   ,trace_(trace) {
   InitializeCriticalSection(&cs);
+  task_available_ = CreateEvent(NULL, FALSE, FALSE, NULL);
 }
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
 TestServer::~TestServer(void){
+  CloseHandle(task_available_);
   DeleteCriticalSection(&cs);
 }
 
@@ -105,6 +112,7 @@ bool TestServer::Start(void){
   bool ret = false;
 
   _globaltest__server = this;
+  stopping_ = false;
 
   static const char *options[] = {
     "listening_ports", "127.0.0.1:8888",
@@ -123,6 +131,9 @@ bool TestServer::Start(void){
   Stop the local HTTP server
 -----------------------------------------------------------------------------*/
 void TestServer::Stop(void){
+  // release any task requests that are waiting
+  stopping_ = true;
+  SetEvent(task_available_);
   if (mongoose_context_) {
     mg_stop(mongoose_context_);
     mongoose_context_ = NULL;
@@ -145,9 +156,16 @@ void TestServer::MongooseCallback(enum mg_event event,
     WptTrace(loglevel::kFrequentEvent, _T("[wpthook] HTTP Query String: %s\n"), 
                     (LPCTSTR)CA2T(request_info->query_string));
     if (strcmp(request_info->uri, "/task") == 0) {
+      // hold the request (up to "wait" ms) until there is a task so it goes
+      // out as soon as the previous step is done
+      DWORD wait = 0;
+      GetDwordParam(request_info->query_string, "wait", wait);
+      DWORD start = GetTickCount();
       CStringA task;
       bool record = false;
-      test_.GetNextTask(task, record);
+      bool has_task = test_.GetNextTask(task, record);
+      while (!has_task && WaitForTask(start, wait))
+        has_task = test_.GetNextTask(task, record);
       if (record)
         hook_.Start();
       SendResponse(conn, request_info, RESPONSE_OK, RESPONSE_OK_STR, task);
@@ -288,6 +306,31 @@ void TestServer::MongooseCallback(enum mg_event event,
   LeaveCriticalSection(&cs);
 }
 
+/*-----------------------------------------------------------------------------
+  The previous step finished, wake up a waiting task request
+-----------------------------------------------------------------------------*/
+void TestServer::TaskAvailable(void) {
+  SetEvent(task_available_);
+}
+
+/*-----------------------------------------------------------------------------
+  Wait for a task to become available (called with the lock held, it is
+  released while waiting so events keep flowing).  Returns false when
+  the request has waited long enough.
+-----------------------------------------------------------------------------*/
+bool TestServer::WaitForTask(DWORD start, DWORD wait) {
+  bool ret = false;
+  DWORD elapsed = GetTickCount() - start;
+  wait = min(wait, MAX_TASK_WAIT);
+  if (!stopping_ && elapsed < wait) {
+    LeaveCriticalSection(&cs);
+    WaitForSingleObject(task_available_, min(wait - elapsed, TASK_WAIT_SLICE));
+    EnterCriticalSection(&cs);
+    ret = !stopping_;
+  }
+  return ret;
+}
+
 /*-----------------------------------------------------------------------------
   Send a JSON/JSONP response back to the caller
 -----------------------------------------------------------------------------*/
@@ -43,6 +43,7 @@ public:
 
   bool Start(void);
   void Stop(void);
+  void TaskAvailable(void);
   void MongooseCallback(enum mg_event event,
                         struct mg_connection *conn,
                         const struct mg_request_info *request_info);
@@ -56,12 +57,15 @@ private:
   DevTools          &dev_tools_;
   Trace             &trace_;
   CRITICAL_SECTION  cs;
+  HANDLE            task_available_;
+  bool              stopping_;
 
   void SendResponse(struct mg_connection *conn,
                     const struct mg_request_info *request_info,
                     DWORD response_code,
                     CStringA response_code_string,
                     CStringA response_data);
+  bool WaitForTask(DWORD start, DWORD wait);
   CString GetParam(const CString query_string, const CString key) const;
   bool GetDwordParam(const CString query_string, const CString key,
                      DWORD& value) const;
@@ -43,6 +43,7 @@ static const DWORD ON_LOAD_GRACE_PERIOD = 100;
 static const DWORD SCREEN_CAPTURE_INCREMENTS = 20;
 static const DWORD DATA_COLLECTION_INTERVAL = 100;
 static const DWORD START_RENDER_MARGIN = 30;
+static const DWORD RENDER_BACKGROUND_DEFAULT = 0x00FFFFFF;
 static const DWORD MS_IN_SEC = 1000;
 static const DWORD SCRIPT_TIMEOUT_MULTIPLIER = 10;
 static const DWORD RESPONSIVE_BROWSER_WIDTH = 480;
@@ -65,11 +66,18 @@ TestState::TestState(Results& results, ScreenCapture& screen_capture,
   ,gdi_only_(false)
   ,navigated_(false)
   ,_started(false)
-  ,received_data_(false) {
+  ,received_data_(false)
+  ,_resource_sampler(*this) {
   QueryPerformanceFrequency(&_ms_frequency);
   _ms_frequency.QuadPart = _ms_frequency.QuadPart / 1000;
   _check_render_event = CreateEvent(NULL, TRUE, FALSE, NULL);
   InitializeCriticalSection(&_data_cs);
+  InitializeCriticalSection(&_paint_cs);
+  SetRectEmpty(&_dirty_rect);
+  SetRectEmpty(&_render_frame_rect);
+  _render_frame = NULL;
+  _render_frame_set = false;
+  _last_visual_change.QuadPart = 0;
   FindBrowserNameAndVersion();
   paint_msg_ = RegisterWindowMessage(_T("WPT Browser Paint"));
 }
@@ -78,6 +86,9 @@ TestState::TestState(Results& results, ScreenCapture& screen_capture,
 -----------------------------------------------------------------------------*/
 TestState::~TestState(void) {
   Done(true);
+  if (_render_frame)
+    free(_render_frame);
+  DeleteCriticalSection(&_paint_cs);
   DeleteCriticalSection(&_data_cs);
 }
 
@@ -119,6 +130,10 @@ void TestState::Reset(bool cascade) {
     _bytes_out = 0;
     _last_bytes_in = 0;
     _screen_updated = false;
+    EnterCriticalSection(&_paint_cs);
+    SetRectEmpty(&_dirty_rect);
+    _render_frame_set = false;
+    LeaveCriticalSection(&_paint_cs);
     _last_data.QuadPart = 0;
     _video_capture_count = 0;
     _start.QuadPart = 0;
@@ -131,6 +146,7 @@ void TestState::Reset(bool cascade) {
     _first_navigate.QuadPart = 0;
     _dom_elements_time.QuadPart = 0;
     _render_start.QuadPart = 0;
+    _last_visual_change.QuadPart = 0;
     _first_activity.QuadPart = 0;
     _last_activity.QuadPart = 0;
     _first_byte.QuadPart = 0;
@@ -144,6 +160,7 @@ void TestState::Reset(bool cascade) {
     _start_total_time.dwHighDateTime = _start_total_time.dwLowDateTime = 0;
     _end_total_time.dwHighDateTime = _end_total_time.dwLowDateTime = 0;
     _progress_data.RemoveAll();
+    _resource_sampler.Reset();
     _test_result = 0;
     _title_time.QuadPart = 0;
     _title.Empty();
@@ -205,6 +222,7 @@ void TestState::Start() {
     CreateTimerQueueTimer(&_data_timer, NULL, ::CollectData, this, 
         DATA_COLLECTION_INTERVAL, DATA_COLLECTION_INTERVAL, WT_EXECUTEDEFAULT);
   }
+  _resource_sampler.Start(_test._resource_interval);
   GrabVideoFrame(true);
   CollectData();
 }
@@ -395,6 +413,7 @@ void TestState::Done(bool force) {
         _data_timer = NULL;
         timeEndPeriod(1);
       }
+      _resource_sampler.Stop();
 
       // clean up the background thread that was doing the timer checks
       if (_render_check_thread) {
@@ -516,25 +535,23 @@ void TestState::GrabVideoFrame(bool force) {
 }
 
 /*-----------------------------------------------------------------------------
+  Add the painted area (window coordinates, 0 size if unknown) to the dirty
+  rect that the render check thread looks at.
 -----------------------------------------------------------------------------*/
 void TestState::PaintEvent(int x, int y, int width, int height) {
   if (received_data_) {
+    RECT paint;
+    if (width && height)
+      SetRect(&paint, x, y, x + width, y + height);
+    else
+      SetRect(&paint, 0, 0, MAXSHORT, MAXSHORT);
     bool valid = true;
-    if (width && height && _screen_capture.IsViewportSet()) {
-      int left = max(x - _screen_capture._viewport.left, 0);
-      int top = max(y - _screen_capture._viewport.top, 0);
-      int right = max(min(x + width, _screen_capture._viewport.right)
-                      - _screen_capture._viewport.left, 0);
-      int bottom = max(min(y + height, _screen_capture._viewport.bottom)
-                        - _screen_capture._viewport.top, 0);
-      x = left;
-      y = top;
-      width = right - left;
-      height = bottom - top;
-      if (width <= 0 || height <= 0)
-        valid = false;
-    }
+    if (_screen_capture.IsViewportSet())
+      valid = IntersectRect(&paint, &paint, &_screen_capture._viewport) != 0;
     if (valid) {
+      EnterCriticalSection(&_paint_cs);
+      UnionRect(&_dirty_rect, &_dirty_rect, &paint);
+      LeaveCriticalSection(&_paint_cs);
       _screen_updated = true;
       CheckStartRender();
     }
@@ -542,10 +559,10 @@ void TestState::PaintEvent(int x, int y, int width, int height) {
 }
 
 /*-----------------------------------------------------------------------------
-    See if anything has been rendered to the screen
+    Have the render check thread look at what was just painted
 -----------------------------------------------------------------------------*/
 void TestState::CheckStartRender() {
-  if (!_render_start.QuadPart && _screen_updated && _document_window) {
+  if (_active && _screen_updated && _document_window) {
     GdiFlush();
     SetEvent(_check_render_event);
   }
@@ -553,77 +570,200 @@ void TestState::CheckStartRender() {
 
 /*-----------------------------------------------------------------------------
     Background thread to check to see if rendering has started
-    (this way we don't block the browser itself)
+    (this way we don't block the browser itself).
+
+    Only the area that was painted since the last check is captured and
+    merged into a copy of the frame so each capture is proportional to the
+    size of the paint, not the window.  Paints that arrive while a check is
+    running are merged into a single region for the next one.  Start render
+    is still the first time a row differs from the first one (a solid fill
+    doesn't count).  After start render the same checks keep track of the
+    last paint that actually changed anything on the screen.
 -----------------------------------------------------------------------------*/
 void TestState::RenderCheckThread() {
-  while (!_render_start.QuadPart && !_exit) {
+  if (_document_window) {
+    _screen_capture.Lock();
+    SetRenderFrame(true);
+    _screen_capture.Unlock();
+  }
+  while (!_exit) {
     WaitForSingleObject(_check_render_event, INFINITE);
+    ResetEvent(_check_render_event);
     if (!_exit) {
+      EnterCriticalSection(&_paint_cs);
+      RECT dirty = _dirty_rect;
+      SetRectEmpty(&_dirty_rect);
+      LeaveCriticalSection(&_paint_cs);
+
       _screen_capture.Lock();
-      _screen_updated = false;
+      bool render_started = _render_start.QuadPart != 0;
+      if (!render_started)
+        _screen_updated = false;
       LARGE_INTEGER now;
       QueryPerformanceCounter((LARGE_INTEGER *)&now);
-
-      // grab a screen shot
-      bool found = false;
-      CapturedImage captured_img = _screen_capture.CaptureImage(
+      if (!_render_frame_set)
+        SetRenderFrame(false);
+      RECT region;
+      if (GetRenderCheckRegion(dirty, region) && UpdateRenderFrame(region))
+        _last_visual_change.QuadPart = now.QuadPart;
+      if (!render_started && FrameRendered()) {
+        _render_start.QuadPart = now.QuadPart;
+        CapturedImage captured_img = _screen_capture.CaptureImage(
                                 _document_window, CapturedImage::START_RENDER);
-      CxImage img;
-      if (captured_img.Get(img) && 
-          img.GetWidth() > START_RENDER_MARGIN * 2 &&
-          img.GetHeight() > START_RENDER_MARGIN * 2) {
-        int bpp = img.GetBpp();
-        if (bpp >= 15) {
-          int height = img.GetHeight();
-          int width = img.GetWidth();
-          // 24-bit gets a fast-path where we can just compare full rows
-          if (bpp <= 24 ) {
-            DWORD row_bytes = img.GetEffWidth();
-            DWORD compare_bytes = (bpp>>3) * (width-(START_RENDER_MARGIN * 2));
-            char * background = (char *)malloc(compare_bytes);
-            if (background) {
-              char * image_bytes = (char *)img.GetBits(START_RENDER_MARGIN)
-                                     + START_RENDER_MARGIN * (bpp >> 3);
-              memcpy(background, image_bytes, compare_bytes);
-              for (DWORD row = START_RENDER_MARGIN; 
-                    row < height - START_RENDER_MARGIN && !found; row++) {
-                if (memcmp(image_bytes, background, compare_bytes))
-                  found = true;
-                else
-                  image_bytes += row_bytes;
-              }
-              free (background);
-            }
-          } else {
-            for (DWORD row = START_RENDER_MARGIN; 
-                    row < height - START_RENDER_MARGIN && !found; row++) {
-              for (DWORD x = START_RENDER_MARGIN; 
-                    x < width - START_RENDER_MARGIN && !found; x++) {
-                RGBQUAD pixel = img.GetPixelColor(x, row, false);
-                if (pixel.rgbBlue != 255 || pixel.rgbRed != 255 || 
-                    pixel.rgbGreen != 255)
-                  found = true;
-              }
-            }
-          }
+        _screen_capture._captured_images.AddTail(captured_img);
+      }
+      _screen_capture.Unlock();
+    }
+  }
+}
+
+/*-----------------------------------------------------------------------------
+    The part of the dirty rect that counts for start render (the viewport
+    less a margin for scroll bars and borders), in window coordinates.
+-----------------------------------------------------------------------------*/
+bool TestState::GetRenderCheckRegion(const RECT& dirty, RECT& region) {
+  bool ret = false;
+  RECT bounds;
+  if (_screen_capture.IsViewportSet()) {
+    bounds = _screen_capture._viewport;
+  } else {
+    RECT window;
+    GetWindowRect(_document_window, &window);
+    SetRect(&bounds, 0, 0, window.right - window.left,
+            window.bottom - window.top);
+  }
+  InflateRect(&bounds, -(int)START_RENDER_MARGIN, -(int)START_RENDER_MARGIN);
+  if (!IsRectEmpty(&bounds) && IntersectRect(&region, &dirty, &bounds))
+    ret = true;
+  return ret;
+}
+
+/*-----------------------------------------------------------------------------
+    Capture just the given part of the window as 32-bit pixels (0x00RRGGBB).
+    The caller frees the pixels.
+-----------------------------------------------------------------------------*/
+bool TestState::GetRegionPixels(RECT& region, DWORD *& pixels, int& count) {
+  bool ret = false;
+  pixels = NULL;
+  count = 0;
+  int width = region.right - region.left;
+  int height = region.bottom - region.top;
+  CapturedImage captured(_document_window, CapturedImage::START_RENDER,
+                         &region);
+  if (captured._bitmap_handle && width > 0 && height > 0) {
+    pixels = (DWORD *)malloc(width * height * sizeof(DWORD));
+    if (pixels) {
+      BITMAPINFO info;
+      memset(&info, 0, sizeof(info));
+      info.bmiHeader.biSize = sizeof(info.bmiHeader);
+      info.bmiHeader.biWidth = width;
+      info.bmiHeader.biHeight = -height;
+      info.bmiHeader.biPlanes = 1;
+      info.bmiHeader.biBitCount = 32;
+      info.bmiHeader.biCompression = BI_RGB;
+      HDC dc = GetDC(NULL);
+      if (dc) {
+        if (GetDIBits(dc, captured._bitmap_handle, 0, height, pixels, &info,
+                      DIB_RGB_COLORS) == height) {
+          count = width * height;
+          ret = true;
         }
+        ReleaseDC(NULL, dc);
+      }
+      if (!ret) {
+        free(pixels);
+        pixels = NULL;
       }
+    }
+  }
+  captured.Free();
+  return ret;
+}
 
-      if (found) {
-        _render_start.QuadPart = now.QuadPart;
-        _screen_capture._captured_images.AddTail(captured_img);
-      } else {
-        captured_img.Free();
+/*-----------------------------------------------------------------------------
+    Keep a copy of the whole check region to compare the paints against.
+    When the test starts this is the frame from before the navigation.  If
+    the window wasn't available then (or the capture failed) a blank white
+    frame is used.
+-----------------------------------------------------------------------------*/
+void TestState::SetRenderFrame(bool capture) {
+  RECT all;
+  SetRect(&all, 0, 0, MAXSHORT, MAXSHORT);
+  RECT region;
+  if (GetRenderCheckRegion(all, region)) {
+    if (_render_frame) {
+      free(_render_frame);
+      _render_frame = NULL;
+    }
+    int count = 0;
+    if (capture && GetRegionPixels(region, _render_frame, count)) {
+      for (int i = 0; i < count; i++)
+        _render_frame[i] &= 0x00FFFFFF;
+    } else {
+      count = (region.right - region.left) * (region.bottom - region.top);
+      _render_frame = (DWORD *)malloc(count * sizeof(DWORD));
+      if (_render_frame) {
+        for (int i = 0; i < count; i++)
+          _render_frame[i] = RENDER_BACKGROUND_DEFAULT;
       }
+    }
+    if (_render_frame) {
+      _render_frame_rect = region;
+      _render_frame_set = true;
+    }
+  }
+}
 
-      _screen_capture.Unlock();
+/*-----------------------------------------------------------------------------
+    See if anything in the region differs from the last frame and bring the
+    frame up to date.  Anything outside of the frame (the window grew) is
+    compared against white.
+-----------------------------------------------------------------------------*/
+bool TestState::UpdateRenderFrame(RECT& region) {
+  bool changed = false;
+  DWORD * pixels = NULL;
+  int count = 0;
+  if (GetRegionPixels(region, pixels, count)) {
+    int frame_width = _render_frame_rect.right - _render_frame_rect.left;
+    DWORD * pixel = pixels;
+    for (int y = region.top; y < region.bottom; y++) {
+      for (int x = region.left; x < region.right; x++, pixel++) {
+        DWORD color = *pixel & 0x00FFFFFF;
+        if (_render_frame && x >= _render_frame_rect.left &&
+            x < _render_frame_rect.right && y >= _render_frame_rect.top &&
+            y < _render_frame_rect.bottom) {
+          DWORD& frame = _render_frame[(y - _render_frame_rect.top) *
+                                       frame_width +
+                                       (x - _render_frame_rect.left)];
+          if (color != (frame & 0x00FFFFFF)) {
+            changed = true;
+            frame = color;
+          }
+        } else if (color != RENDER_BACKGROUND_DEFAULT) {
+          changed = true;
+        }
+      }
     }
-    ResetEvent(_check_render_event);
+    free(pixels);
+  }
+  return changed;
+}
 
-    // prevent a tight loop
-    if (!_render_start.QuadPart && !_exit)
-      Sleep(20);
+/*-----------------------------------------------------------------------------
+    The start render rule: something has rendered once any row of the frame
+    differs from the first row (a solid background fill doesn't count).
+-----------------------------------------------------------------------------*/
+bool TestState::FrameRendered(void) {
+  bool found = false;
+  if (_render_frame) {
+    int width = _render_frame_rect.right - _render_frame_rect.left;
+    int height = _render_frame_rect.bottom - _render_frame_rect.top;
+    const DWORD * row = _render_frame + width;
+    for (int y = 1; y < height && !found; y++, row += width)
+      if (memcmp(row, _render_frame, width * sizeof(DWORD)))
+        found = true;
   }
+  return found;
 }
 
 /*-----------------------------------------------------------------------------
@@ -672,8 +812,13 @@ void TestState::CollectSystemStats(LARGE_INTEGER &now) {
     _last_cpu_user.QuadPart = u.QuadPart;
   }
 
-  if (msElapsed)
+  // memory and process count for the browser's process tree
+  _resource_sampler.GetTotals(data._mem, data._process_count);
+
+  if (msElapsed) {
+    _results.StreamProgressData(data, _progress_data.IsEmpty());
     _progress_data.AddTail(data);
+  }
 }
 
 /*-----------------------------------------------------------------------------
@@ -775,6 +920,7 @@ void TestState::FindViewport(bool force) {
 void TestState::OnStatusMessage(CString status) {
   StatusMessage stat(status);
   EnterCriticalSection(&_data_cs);
+  _results.StreamStatusMessage(stat);
   _status_messages.AddTail(stat);
   LeaveCriticalSection(&_data_cs);
 }
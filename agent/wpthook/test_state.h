@@ -27,6 +27,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ******************************************************************************/
 
 #pragma once
+#include "resource_sampler.h"
 
 class Results;
 class ScreenCapture;
@@ -131,6 +132,7 @@ public:
   DWORD _load_event_end;
   DWORD _first_paint;
   LARGE_INTEGER _render_start;
+  LARGE_INTEGER _last_visual_change;
   LARGE_INTEGER _first_activity;
   LARGE_INTEGER _last_activity;
   LARGE_INTEGER _ms_frequency;
@@ -174,6 +176,7 @@ public:
   
   CAtlList<ProgressData>   _progress_data;     // CPU, memory and Bandwidth
   CAtlList<StatusMessage>  _status_messages;   // Browser status
+  ResourceSampler          _resource_sampler;  // per-process resource use
 
 private:
   bool  _started;
@@ -184,6 +187,11 @@ private:
   Trace &_trace;
   HANDLE  _render_check_thread;
   HANDLE  _check_render_event;
+  RECT    _dirty_rect;              // painted since the last render check
+  DWORD * _render_frame;            // check region as of the last check
+  RECT    _render_frame_rect;       // (window coordinates)
+  bool    _render_frame_set;
+  CRITICAL_SECTION  _paint_cs;
   HANDLE  _data_timer;
   CAtlList<CString>        _console_log_messages; // messages to the console
   CAtlList<CString>        _timed_events; // any supported timed events
@@ -209,6 +217,11 @@ private:
 
   void Done(bool force = false);
   void CollectSystemStats(LARGE_INTEGER &now);
+  bool GetRenderCheckRegion(const RECT& dirty, RECT& region);
+  bool GetRegionPixels(RECT& region, DWORD *& pixels, int& count);
+  void SetRenderFrame(bool capture);
+  bool UpdateRenderFrame(RECT& region);
+  bool FrameRendered(void);
   void FindViewport(bool force = false);
   void RecordTime(CString time_name, DWORD time, LARGE_INTEGER * out_time);
   DWORD ElapsedMs(LARGE_INTEGER start, LARGE_INTEGER end) const;
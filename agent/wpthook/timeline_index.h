@@ -0,0 +1,99 @@
+/******************************************************************************
+Copyright (c) 2014, Google Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+    * Neither the name of the <ORGANIZATION> nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+#pragma once
+
+/*-----------------------------------------------------------------------------
+  Network activity (DNS lookups, connects) ordered by start time so the
+  request matching can binary-search for "the latest X before T" and "the
+  earliest X after T" instead of walking every event of the test.
+
+  The index only holds pointers, the owner keeps the items (and their
+  claimed state) and must hold its lock around any use of the index.
+  Events almost always arrive in start order so Add() is an append in
+  practice.
+-----------------------------------------------------------------------------*/
+template <class T>
+class TimelineIndex {
+public:
+  TimelineIndex(void){}
+  ~TimelineIndex(void){}
+
+  void Add(LONGLONG start, T * item) {
+    Entry entry;
+    entry.start_ = start;
+    entry.item_ = item;
+    size_t pos = UpperBound(start);
+    if (pos == entries_.GetCount())
+      entries_.Add(entry);
+    else
+      entries_.InsertAt(pos, entry);
+  }
+
+  // index of the first event that starts at or after the given time
+  size_t LowerBound(LONGLONG time) const {
+    size_t low = 0;
+    size_t high = entries_.GetCount();
+    while (low < high) {
+      size_t mid = low + (high - low) / 2;
+      if (entries_[mid].start_ < time)
+        low = mid + 1;
+      else
+        high = mid;
+    }
+    return low;
+  }
+
+  // index of the first event that starts after the given time
+  size_t UpperBound(LONGLONG time) const {
+    size_t low = 0;
+    size_t high = entries_.GetCount();
+    while (low < high) {
+      size_t mid = low + (high - low) / 2;
+      if (entries_[mid].start_ <= time)
+        low = mid + 1;
+      else
+        high = mid;
+    }
+    return low;
+  }
+
+  size_t GetCount(void) const { return entries_.GetCount(); }
+  LONGLONG GetStart(size_t index) const { return entries_[index].start_; }
+  T * GetAt(size_t index) const { return entries_[index].item_; }
+  void RemoveAll(void) { entries_.RemoveAll(); }
+
+private:
+  class Entry {
+  public:
+    Entry():start_(0),item_(NULL){}
+    LONGLONG  start_;
+    T *       item_;
+  };
+
+  CAtlArray<Entry>  entries_;
+};
@@ -28,15 +28,22 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "StdAfx.h"
 #include "trace.h"
 
+// events are written out to a temporary file once this much is buffered
+static const DWORD TRACE_BUFFER_LIMIT = 1024 * 1024;
+
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
-Trace::Trace(void) {
+Trace::Trace(void):
+  buffered_(0)
+  ,spill_file_(INVALID_HANDLE_VALUE)
+  ,first_event_(true) {
   InitializeCriticalSection(&cs_);
 }
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
 Trace::~Trace(void) {
+  CloseSpillFile();
   DeleteCriticalSection(&cs_);
 }
 
@@ -45,39 +52,52 @@ Trace::~Trace(void) {
 void Trace::Reset() {
   EnterCriticalSection(&cs_);
   events_.RemoveAll();
+  buffered_ = 0;
+  CloseSpillFile();
+  analyzer_.Reset();
   LeaveCriticalSection(&cs_);
 }
 
 /*-----------------------------------------------------------------------------
+  Finish the JSON array in the spill file and move it into place
 -----------------------------------------------------------------------------*/
 bool Trace::Write(CString file) {
   bool ok = false;
   EnterCriticalSection(&cs_);
-  if (!events_.IsEmpty()) {
+  if ((!events_.IsEmpty() || spill_file_ != INVALID_HANDLE_VALUE) &&
+      Flush()) {
+    DWORD bytes_written;
+    ok = WriteFile(spill_file_, "]", 1, &bytes_written, 0) != FALSE;
+    CloseHandle(spill_file_);
+    spill_file_ = INVALID_HANDLE_VALUE;
+    if (ok)
+      ok = MoveFileEx(spill_path_, file,
+                      MOVEFILE_REPLACE_EXISTING | MOVEFILE_COPY_ALLOWED) != 0;
+    CloseSpillFile();
+  }
+  LeaveCriticalSection(&cs_);
+  return ok;
+}
+
+/*-----------------------------------------------------------------------------
+  Write out the main-thread summary that was built up as the events arrived
+-----------------------------------------------------------------------------*/
+bool Trace::WriteSummary(CString file) {
+  bool ok = false;
+  EnterCriticalSection(&cs_);
+  CStringA summary = analyzer_.GetSummaryJSON();
+  LeaveCriticalSection(&cs_);
+  if (!summary.IsEmpty()) {
     HANDLE file_handle = CreateFile(file, GENERIC_WRITE, 0, 0,
                                     CREATE_ALWAYS, 0, 0);
     if (file_handle != INVALID_HANDLE_VALUE) {
       DWORD bytes_written;
       ok = true;
-      bool first = true;
-      WriteFile(file_handle, "[", 1, &bytes_written, 0);
-      POSITION pos = events_.GetHeadPosition();
-      while (pos) {
-        CStringA event_string = events_.GetNext(pos);
-        if (event_string.GetLength()) {
-          if (first)
-            first = false;
-          else
-            event_string = CStringA(",") + event_string;
-          WriteFile(file_handle, (LPCSTR)event_string,
-                    event_string.GetLength(), &bytes_written, 0);
-        }
-      }
-      WriteFile(file_handle, "]", 1, &bytes_written, 0);
+      WriteFile(file_handle, (LPCSTR)summary, summary.GetLength(),
+                &bytes_written, 0);
       CloseHandle(file_handle);
     }
   }
-  LeaveCriticalSection(&cs_);
   return ok;
 }
 
@@ -86,5 +106,67 @@ bool Trace::Write(CString file) {
 void Trace::AddEvents(CStringA data) {
   EnterCriticalSection(&cs_);
   events_.AddTail(data);
+  buffered_ += data.GetLength();
+  analyzer_.AddData((LPCSTR)data, data.GetLength());
+  if (buffered_ > TRACE_BUFFER_LIMIT)
+    Flush();
   LeaveCriticalSection(&cs_);
 }
+
+/*-----------------------------------------------------------------------------
+  Append the buffered events to the spill file (in the temp directory so a
+  multi-hundred-MB trace doesn't have to be held in the browser process).
+  Called with cs_ held.
+-----------------------------------------------------------------------------*/
+bool Trace::Flush(void) {
+  if (spill_file_ == INVALID_HANDLE_VALUE && spill_path_.IsEmpty()) {
+    TCHAR directory[MAX_PATH];
+    TCHAR path[MAX_PATH];
+    if (GetTempPath(_countof(directory), directory) &&
+        GetTempFileName(directory, _T("wpt"), 0, path)) {
+      spill_file_ = CreateFile(path, GENERIC_WRITE, 0, 0, CREATE_ALWAYS,
+                               FILE_ATTRIBUTE_TEMPORARY, 0);
+      spill_path_ = path;
+      first_event_ = true;
+      DWORD bytes_written;
+      if (spill_file_ == INVALID_HANDLE_VALUE ||
+          !WriteFile(spill_file_, "[", 1, &bytes_written, 0))
+        CloseSpillFile();
+    }
+    if (spill_file_ == INVALID_HANDLE_VALUE)
+      WptTrace(loglevel::kError,
+               _T("[wpthook] - Trace::Flush failed to create the spill file, ")
+               _T("dropping trace events\n"));
+  }
+  bool ok = spill_file_ != INVALID_HANDLE_VALUE;
+  while (!events_.IsEmpty()) {
+    CStringA event_string = events_.RemoveHead();
+    if (ok && event_string.GetLength()) {
+      if (first_event_)
+        first_event_ = false;
+      else
+        event_string = CStringA(",") + event_string;
+      DWORD bytes_written;
+      if (!WriteFile(spill_file_, (LPCSTR)event_string,
+                     event_string.GetLength(), &bytes_written, 0))
+        ok = false;
+    }
+  }
+  buffered_ = 0;
+  return ok;
+}
+
+/*-----------------------------------------------------------------------------
+  Throw away the spill file (if it wasn't moved into place)
+-----------------------------------------------------------------------------*/
+void Trace::CloseSpillFile(void) {
+  if (spill_file_ != INVALID_HANDLE_VALUE) {
+    CloseHandle(spill_file_);
+    spill_file_ = INVALID_HANDLE_VALUE;
+  }
+  if (!spill_path_.IsEmpty()) {
+    DeleteFile(spill_path_);
+    spill_path_.Empty();
+  }
+  first_event_ = true;
+}
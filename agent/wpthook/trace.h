@@ -26,6 +26,8 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ******************************************************************************/
 #pragma once
+#include "trace_analyzer.h"
+
 class Trace {
 public:
   Trace(void);
@@ -33,9 +35,18 @@ public:
 
   void Reset();
   bool Write(CString file);
+  bool WriteSummary(CString file);
   void AddEvents(CStringA data);
 
 private:
+  bool Flush(void);
+  void CloseSpillFile(void);
+
   CRITICAL_SECTION cs_;
-  CAtlList<CStringA> events_;
+  CAtlList<CStringA> events_;     // not yet written to the spill file
+  DWORD     buffered_;            // bytes in events_
+  HANDLE    spill_file_;          // events so far, as a JSON array
+  CString   spill_path_;
+  bool      first_event_;
+  TraceAnalyzer analyzer_;
 };
@@ -0,0 +1,496 @@
+/******************************************************************************
+Copyright (c) 2014, Google Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+    * Neither the name of the <ORGANIZATION> nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+#include "StdAfx.h"
+#include "trace_analyzer.h"
+
+static const double LONG_TASK_THRESHOLD = 50000;      // 50ms in microseconds
+static const double INTERACTIVE_WINDOW = 5000000;     // 5 seconds
+static const size_t MAX_STACK_DEPTH = 64;
+static const size_t MAX_LONG_TASKS = 10000;
+static const char * MAIN_THREAD_NAME = "CrRendererMain";
+
+struct TraceEventCategory {
+  const char * name;
+  int          category;
+};
+
+static const TraceEventCategory TRACE_EVENT_CATEGORIES[] = {
+  {"EvaluateScript", TRACE_CATEGORY_SCRIPTING},
+  {"FunctionCall", TRACE_CATEGORY_SCRIPTING},
+  {"TimerFire", TRACE_CATEGORY_SCRIPTING},
+  {"EventDispatch", TRACE_CATEGORY_SCRIPTING},
+  {"FireAnimationFrame", TRACE_CATEGORY_SCRIPTING},
+  {"XHRReadyStateChange", TRACE_CATEGORY_SCRIPTING},
+  {"XHRLoad", TRACE_CATEGORY_SCRIPTING},
+  {"v8.compile", TRACE_CATEGORY_SCRIPTING},
+  {"v8.run", TRACE_CATEGORY_SCRIPTING},
+  {"V8.Execute", TRACE_CATEGORY_SCRIPTING},
+  {"ParseHTML", TRACE_CATEGORY_PARSE_HTML},
+  {"ParseAuthorStyleSheet", TRACE_CATEGORY_PARSE_CSS},
+  {"Layout", TRACE_CATEGORY_LAYOUT},
+  {"RecalculateStyles", TRACE_CATEGORY_LAYOUT},
+  {"UpdateLayoutTree", TRACE_CATEGORY_LAYOUT},
+  {"UpdateLayerTree", TRACE_CATEGORY_LAYOUT},
+  {"Paint", TRACE_CATEGORY_PAINT},
+  {"PaintImage", TRACE_CATEGORY_PAINT},
+  {"CompositeLayers", TRACE_CATEGORY_PAINT},
+  {"DecodeImage", TRACE_CATEGORY_PAINT},
+  {"ResizeImage", TRACE_CATEGORY_PAINT},
+  {"MajorGC", TRACE_CATEGORY_GC},
+  {"MinorGC", TRACE_CATEGORY_GC},
+  {"GCEvent", TRACE_CATEGORY_GC},
+  {"V8.GCScavenger", TRACE_CATEGORY_GC},
+  {"V8.GCIncrementalMarking", TRACE_CATEGORY_GC},
+  {"V8.GCFinalizeMC", TRACE_CATEGORY_GC}
+};
+
+static const char * TRACE_CATEGORY_NAMES[TRACE_CATEGORY_COUNT] = {
+  "scripting", "parseHTML", "parseCSS", "layout", "paint", "gc", "other"
+};
+
+/*-----------------------------------------------------------------------------
+  Map a trace event name to the main-thread bucket it belongs to
+-----------------------------------------------------------------------------*/
+static int CategorizeEvent(const CStringA& name) {
+  int category = TRACE_CATEGORY_NONE;
+  for (size_t i = 0; i < _countof(TRACE_EVENT_CATEGORIES) &&
+                  category == TRACE_CATEGORY_NONE; i++) {
+    if (!name.Compare(TRACE_EVENT_CATEGORIES[i].name))
+      category = TRACE_EVENT_CATEGORIES[i].category;
+  }
+  return category;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+TraceThread::TraceThread(void):busy_time_(0) {
+  for (int i = 0; i < TRACE_CATEGORY_COUNT; i++)
+    category_times_[i] = 0;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+TraceAnalyzer::TraceAnalyzer(void):stream_(*this) {
+  Reset();
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+TraceAnalyzer::~TraceAnalyzer(void) {
+  Reset();
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void TraceAnalyzer::Reset(void) {
+  stream_.Reset();
+  depth_ = 0;
+  event_depth_ = 0;
+  in_event_ = false;
+  root_is_array_ = false;
+  in_container_ = false;
+  event_count_ = 0;
+  first_ts_ = 0;
+  last_ts_ = 0;
+  navigation_start_ = 0;
+  dom_content_loaded_ = 0;
+  POSITION pos = threads_.GetStartPosition();
+  while (pos) {
+    ULONGLONG key;
+    TraceThread * thread = NULL;
+    threads_.GetNextAssoc(pos, key, thread);
+    if (thread)
+      delete thread;
+  }
+  threads_.RemoveAll();
+}
+
+/*-----------------------------------------------------------------------------
+  Feed the next fragment of the trace.  Fragments do not need to line up
+  with event boundaries.
+-----------------------------------------------------------------------------*/
+void TraceAnalyzer::AddData(const char * data, DWORD len) {
+  if (data && len && !stream_.Failed()) {
+    if (!stream_.Parse(data, len))
+      WptTrace(loglevel::kWarning,
+               _T("[wpthook] - TraceAnalyzer: malformed trace data\n"));
+  }
+}
+
+/*-----------------------------------------------------------------------------
+  Events are the objects at the top level, inside of a top-level array or
+  inside of the "traceEvents" array of a trace container object.
+-----------------------------------------------------------------------------*/
+void TraceAnalyzer::OnStartObject(void) {
+  if (!in_event_ && (depth_ == 0 || (depth_ == 1 && root_is_array_) ||
+                     (depth_ == 2 && in_container_))) {
+    depth_++;
+    StartEvent();
+  } else {
+    depth_++;
+    int level = depth_ - event_depth_;
+    if (in_event_ && level < KEY_DEPTH)
+      keys_[level][0] = 0;
+  }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void TraceAnalyzer::OnEndObject(void) {
+  if (in_event_ && depth_ == event_depth_) {
+    in_event_ = false;
+    ProcessEvent();
+  }
+  depth_--;
+  if (!depth_)
+    in_container_ = false;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void TraceAnalyzer::OnStartArray(void) {
+  if (!depth_)
+    root_is_array_ = true;
+  depth_++;
+  int level = depth_ - event_depth_;
+  if (in_event_ && level < KEY_DEPTH)
+    keys_[level][0] = 0;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void TraceAnalyzer::OnEndArray(void) {
+  depth_--;
+  if (!depth_)
+    root_is_array_ = false;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void TraceAnalyzer::OnKey(const char * key, DWORD len) {
+  if (in_event_) {
+    int level = depth_ - event_depth_;
+    if (level == 0 && len == 11 && !memcmp(key, "traceEvents", 11)) {
+      // this is the container object, not an event
+      in_event_ = false;
+      in_container_ = true;
+    } else if (level < KEY_DEPTH) {
+      len = min(len, (DWORD)KEY_LENGTH - 1);
+      memcpy(keys_[level], key, len);
+      keys_[level][len] = 0;
+    }
+  }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void TraceAnalyzer::OnString(const char * value, DWORD len) {
+  if (in_event_) {
+    int level = depth_ - event_depth_;
+    if (level == 0) {
+      const char * key = Key(0);
+      if (!strcmp(key, "name"))
+        name_.SetString(value, len);
+      else if (!strcmp(key, "cat"))
+        cat_.SetString(value, len);
+      else if (!strcmp(key, "ph") && len)
+        ph_ = value[0];
+    } else if (level == 1 && !strcmp(Key(0), "args") &&
+               !strcmp(Key(1), "name")) {
+      thread_name_.SetString(value, len);
+    } else if (level == 2 && url_.IsEmpty() && !strcmp(Key(0), "args") &&
+               !strcmp(Key(1), "data") &&
+               (!strcmp(Key(2), "url") || !strcmp(Key(2), "scriptName"))) {
+      url_.SetString(value, len);
+    }
+  }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void TraceAnalyzer::OnNumber(double value) {
+  if (in_event_ && depth_ == event_depth_) {
+    const char * key = Key(0);
+    if (!strcmp(key, "ts"))
+      ts_ = value;
+    else if (!strcmp(key, "dur"))
+      dur_ = value;
+    else if (!strcmp(key, "pid"))
+      pid_ = (DWORD)value;
+    else if (!strcmp(key, "tid"))
+      tid_ = (DWORD)value;
+  }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+const char * TraceAnalyzer::Key(int level) const {
+  return keys_[level];
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void TraceAnalyzer::StartEvent(void) {
+  in_event_ = true;
+  event_depth_ = depth_;
+  for (int i = 0; i < KEY_DEPTH; i++)
+    keys_[i][0] = 0;
+  name_.Empty();
+  cat_.Empty();
+  url_.Empty();
+  thread_name_.Empty();
+  ph_ = 0;
+  ts_ = 0;
+  dur_ = -1;
+  pid_ = 0;
+  tid_ = 0;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+TraceThread * TraceAnalyzer::GetThread(void) {
+  TraceThread * thread = NULL;
+  ULONGLONG key = ((ULONGLONG)pid_ << 32) | tid_;
+  if (!threads_.Lookup(key, thread) || !thread) {
+    thread = new TraceThread;
+    threads_.SetAt(key, thread);
+  }
+  return thread;
+}
+
+/*-----------------------------------------------------------------------------
+  Chrome records complete (X) events when they start so the events for a
+  given thread arrive in start order.  That lets us keep a stack of the
+  events that are still in scope and convert inclusive durations into self
+  times without holding on to the events themselves.
+-----------------------------------------------------------------------------*/
+void TraceAnalyzer::ProcessEvent(void) {
+  event_count_++;
+  if (ph_ == 'M') {
+    if (name_ == "thread_name" && !thread_name_.IsEmpty())
+      GetThread()->name_ = thread_name_;
+    return;
+  }
+  if (ts_ <= 0)
+    return;
+  if (!first_ts_ || ts_ < first_ts_)
+    first_ts_ = ts_;
+  if (ts_ > last_ts_)
+    last_ts_ = ts_;
+  if (cat_.Find("blink.user_timing") >= 0) {
+    if (!navigation_start_ && name_ == "navigationStart")
+      navigation_start_ = ts_;
+    else if (!dom_content_loaded_ && name_ == "domContentLoadedEventEnd")
+      dom_content_loaded_ = ts_;
+  }
+
+  if (ph_ != 'X' && ph_ != 'B' && ph_ != 'E')
+    return;
+
+  TraceThread * thread = GetThread();
+
+  // pop anything that finished before this event started
+  while (!thread->stack_.IsEmpty()) {
+    TraceOpenEvent& top = thread->stack_[thread->stack_.GetCount() - 1];
+    if (top.open_ || top.end_ > ts_)
+      break;
+    thread->stack_.RemoveAt(thread->stack_.GetCount() - 1);
+  }
+
+  if (ph_ == 'E') {
+    // close out the most recent B event on this thread
+    for (size_t i = thread->stack_.GetCount(); i > 0; i--) {
+      if (thread->stack_[i - 1].open_) {
+        TraceOpenEvent event = thread->stack_[i - 1];
+        event.open_ = false;
+        event.end_ = max(ts_, event.start_);
+        TraceOpenEvent parent;
+        bool has_parent = i > 1;
+        if (has_parent)
+          parent = thread->stack_[i - 2];
+        thread->stack_.RemoveAt(i - 1, thread->stack_.GetCount() - i + 1);
+        CloseEvent(thread, event, has_parent ? &parent : NULL);
+        break;
+      }
+    }
+    return;
+  }
+
+  TraceOpenEvent event;
+  event.start_ = ts_;
+  event.open_ = ph_ == 'B';
+  event.end_ = event.open_ ? ts_ : ts_ + max(dur_, 0.0);
+  event.category_ = CategorizeEvent(name_);
+  event.url_ = url_;
+  TraceOpenEvent * parent = NULL;
+  if (!thread->stack_.IsEmpty())
+    parent = &thread->stack_[thread->stack_.GetCount() - 1];
+  if (parent) {
+    if (event.category_ == TRACE_CATEGORY_NONE)
+      event.category_ = parent->category_;
+    if (event.url_.IsEmpty())
+      event.url_ = parent->url_;
+    if (!parent->open_ && event.end_ > parent->end_)
+      event.end_ = parent->end_;
+  } else if (event.category_ == TRACE_CATEGORY_NONE &&
+             cat_.Find("toplevel") >= 0) {
+    event.category_ = TRACE_CATEGORY_OTHER;
+  }
+  if (!event.open_)
+    CloseEvent(thread, event, parent);
+
+  if (thread->stack_.GetCount() < MAX_STACK_DEPTH)
+    thread->stack_.Add(event);
+}
+
+/*-----------------------------------------------------------------------------
+  Account for an event once its duration is known.  The full duration is
+  credited to the event's bucket and removed from the enclosing event's
+  bucket which leaves self times.  Top-level events count as tasks.
+-----------------------------------------------------------------------------*/
+void TraceAnalyzer::CloseEvent(TraceThread * thread,
+                               const TraceOpenEvent& event,
+                               const TraceOpenEvent * parent) {
+  double duration = event.end_ - event.start_;
+  if (duration <= 0)
+    return;
+  AddTime(thread, event.category_, event.url_, duration);
+  if (parent) {
+    AddTime(thread, parent->category_, parent->url_, -duration);
+  } else {
+    thread->busy_time_ += duration;
+    if (duration >= LONG_TASK_THRESHOLD &&
+        thread->long_tasks_.GetCount() < MAX_LONG_TASKS)
+      thread->long_tasks_.Add(TraceLongTask(event.start_, duration));
+  }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void TraceAnalyzer::AddTime(TraceThread * thread, int category,
+                            const CStringA& url, double duration) {
+  if (category != TRACE_CATEGORY_NONE) {
+    thread->category_times_[category] += duration;
+    if (category == TRACE_CATEGORY_SCRIPTING && !url.IsEmpty()) {
+      double script_time = 0;
+      thread->script_times_.Lookup(url, script_time);
+      thread->script_times_.SetAt(url, script_time + duration);
+    }
+  }
+}
+
+/*-----------------------------------------------------------------------------
+  Pick the busiest renderer main thread (falling back to the busiest
+  thread if the metadata events never arrived).
+-----------------------------------------------------------------------------*/
+TraceThread * TraceAnalyzer::FindMainThread(void) {
+  TraceThread * main_thread = NULL;
+  TraceThread * busiest = NULL;
+  POSITION pos = threads_.GetStartPosition();
+  while (pos) {
+    ULONGLONG key;
+    TraceThread * thread = NULL;
+    threads_.GetNextAssoc(pos, key, thread);
+    if (thread) {
+      if (thread->name_ == MAIN_THREAD_NAME &&
+          (!main_thread || thread->busy_time_ > main_thread->busy_time_))
+        main_thread = thread;
+      if (!busiest || thread->busy_time_ > busiest->busy_time_)
+        busiest = thread;
+    }
+  }
+  return main_thread ? main_thread : busiest;
+}
+
+/*-----------------------------------------------------------------------------
+  Time-to-interactive style metric: the end of the last long task before
+  the first 5 second window (after DOM content loaded) with no long tasks.
+-----------------------------------------------------------------------------*/
+double TraceAnalyzer::GetTimeToInteractive(TraceThread * thread,
+                                           double start) {
+  double interactive = max(start, dom_content_loaded_);
+  size_t count = thread->long_tasks_.GetCount();
+  for (size_t i = 0; i < count; i++) {
+    const TraceLongTask& task = thread->long_tasks_[i];
+    double task_end = task.start_ + task.duration_;
+    if (task_end > interactive) {
+      if (task.start_ - interactive >= INTERACTIVE_WINDOW)
+        break;
+      interactive = task_end;
+    }
+  }
+  return interactive;
+}
+
+/*-----------------------------------------------------------------------------
+  Times in the summary are in milliseconds relative to navigation start
+  (or the first event if the navigation start mark was not recorded).
+-----------------------------------------------------------------------------*/
+CStringA TraceAnalyzer::GetSummaryJSON(void) {
+  CStringA json;
+  TraceThread * thread = FindMainThread();
+  if (thread && event_count_) {
+    double start = navigation_start_ ? navigation_start_ : first_ts_;
+    CStringA buff;
+    json = "{\"mainThread\":{";
+    for (int i = 0; i < TRACE_CATEGORY_COUNT; i++) {
+      buff.Format("%s\"%s\":%0.3f", i ? "," : "", TRACE_CATEGORY_NAMES[i],
+                  max(thread->category_times_[i], 0.0) / 1000.0);
+      json += buff;
+    }
+    buff.Format("},\"busyTime\":%0.3f,\"longTasks\":[",
+                thread->busy_time_ / 1000.0);
+    json += buff;
+    size_t count = thread->long_tasks_.GetCount();
+    for (size_t i = 0; i < count; i++) {
+      const TraceLongTask& task = thread->long_tasks_[i];
+      buff.Format("%s[%0.3f,%0.3f]", i ? "," : "",
+                  (task.start_ - start) / 1000.0, task.duration_ / 1000.0);
+      json += buff;
+    }
+    json += "],\"scripts\":{";
+    bool first = true;
+    POSITION pos = thread->script_times_.GetStartPosition();
+    while (pos) {
+      CStringA url;
+      double script_time = 0;
+      thread->script_times_.GetNextAssoc(pos, url, script_time);
+      if (script_time > 0) {
+        buff.Format("%s\"%s\":%0.3f", first ? "" : ",",
+                    (LPCSTR)JSONEscapeA(url), script_time / 1000.0);
+        json += buff;
+        first = false;
+      }
+    }
+    buff.Format("},\"timeToInteractive\":%0.3f,\"traceDuration\":%0.3f}",
+                (GetTimeToInteractive(thread, start) - start) / 1000.0,
+                (last_ts_ - start) / 1000.0);
+    json += buff;
+  }
+  return json;
+}
@@ -0,0 +1,159 @@
+/******************************************************************************
+Copyright (c) 2014, Google Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+    * Neither the name of the <ORGANIZATION> nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+#pragma once
+#include "json_stream.h"
+
+// main-thread time buckets
+const int TRACE_CATEGORY_NONE = -1;
+const int TRACE_CATEGORY_SCRIPTING = 0;
+const int TRACE_CATEGORY_PARSE_HTML = 1;
+const int TRACE_CATEGORY_PARSE_CSS = 2;
+const int TRACE_CATEGORY_LAYOUT = 3;
+const int TRACE_CATEGORY_PAINT = 4;
+const int TRACE_CATEGORY_GC = 5;
+const int TRACE_CATEGORY_OTHER = 6;
+const int TRACE_CATEGORY_COUNT = 7;
+
+class TraceLongTask {
+public:
+  TraceLongTask(void):start_(0),duration_(0){}
+  TraceLongTask(double start, double duration):
+    start_(start),duration_(duration){}
+  TraceLongTask(const TraceLongTask& src){*this = src;}
+  ~TraceLongTask(void){}
+  const TraceLongTask& operator =(const TraceLongTask& src) {
+    start_ = src.start_;
+    duration_ = src.duration_;
+    return src;
+  }
+
+  double start_;     // microseconds (trace clock)
+  double duration_;  // microseconds
+};
+
+// An event that is still in scope on a thread (used to compute self times)
+class TraceOpenEvent {
+public:
+  TraceOpenEvent(void):start_(0),end_(0),category_(TRACE_CATEGORY_NONE),
+    open_(false){}
+  TraceOpenEvent(const TraceOpenEvent& src){*this = src;}
+  ~TraceOpenEvent(void){}
+  const TraceOpenEvent& operator =(const TraceOpenEvent& src) {
+    start_ = src.start_;
+    end_ = src.end_;
+    category_ = src.category_;
+    open_ = src.open_;
+    url_ = src.url_;
+    return src;
+  }
+
+  double    start_;
+  double    end_;
+  int       category_;
+  bool      open_;      // B event still waiting for the matching E
+  CStringA  url_;
+};
+
+class TraceThread {
+public:
+  TraceThread(void);
+  ~TraceThread(void){}
+
+  CStringA  name_;
+  double    category_times_[TRACE_CATEGORY_COUNT];
+  double    busy_time_;
+  CAtlArray<TraceOpenEvent> stack_;
+  CAtlArray<TraceLongTask>  long_tasks_;
+  CAtlMap<CStringA, double> script_times_;
+};
+
+/*-----------------------------------------------------------------------------
+  Incrementally digests the Chrome trace event stream as it is posted by
+  the extension and keeps just enough state to produce a main-thread
+  breakdown (self time per category), the long tasks, per-script CPU time
+  and a time-to-interactive estimate.
+-----------------------------------------------------------------------------*/
+class TraceAnalyzer : public JsonStreamHandler {
+public:
+  TraceAnalyzer(void);
+  ~TraceAnalyzer(void);
+
+  void Reset(void);
+  void AddData(const char * data, DWORD len);
+  CStringA GetSummaryJSON(void);
+
+  // JsonStreamHandler
+  virtual void OnStartObject(void);
+  virtual void OnEndObject(void);
+  virtual void OnStartArray(void);
+  virtual void OnEndArray(void);
+  virtual void OnKey(const char * key, DWORD len);
+  virtual void OnString(const char * value, DWORD len);
+  virtual void OnNumber(double value);
+
+private:
+  static const int KEY_DEPTH = 4;
+  static const int KEY_LENGTH = 32;
+
+  void StartEvent(void);
+  void ProcessEvent(void);
+  void CloseEvent(TraceThread * thread, const TraceOpenEvent& event,
+                  const TraceOpenEvent * parent);
+  void AddTime(TraceThread * thread, int category, const CStringA& url,
+               double duration);
+  TraceThread * GetThread(void);
+  TraceThread * FindMainThread(void);
+  double GetTimeToInteractive(TraceThread * thread, double start);
+  const char * Key(int level) const;
+
+  JsonStream  stream_;
+  int         depth_;
+  int         event_depth_;
+  bool        in_event_;
+  bool        root_is_array_;
+  bool        in_container_;
+  char        keys_[KEY_DEPTH][KEY_LENGTH];
+  DWORD       event_count_;
+
+  // fields of the event currently being parsed
+  CStringA  name_;
+  CStringA  cat_;
+  CStringA  url_;
+  CStringA  thread_name_;
+  char      ph_;
+  double    ts_;
+  double    dur_;
+  DWORD     pid_;
+  DWORD     tid_;
+
+  double    first_ts_;
+  double    last_ts_;
+  double    navigation_start_;
+  double    dom_content_loaded_;
+  CAtlMap<ULONGLONG, TraceThread *> threads_;
+};
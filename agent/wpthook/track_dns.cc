@@ -37,6 +37,8 @@ TrackDns::TrackDns(TestState& test_state, WptTest& test):
   _test_state(test_state)
   , _test(test) {
   _dns_lookups.InitHashTable(257);
+  _host_lookups.InitHashTable(257);
+  _host_addresses.InitHashTable(257);
   InitializeCriticalSection(&cs);
 }
 
@@ -67,6 +69,13 @@ void * TrackDns::LookupStart(CString& name) {
     EnterCriticalSection(&cs);
     info->_tracked = true;
     _dns_lookups.SetAt(info, info);
+    _lookup_timeline.Add(info->_start.QuadPart, info);
+    DnsTimeline * lookups = NULL;
+    if (!_host_lookups.Lookup(name, lookups) || !lookups) {
+      lookups = new DnsTimeline;
+      _host_lookups.SetAt(name, lookups);
+    }
+    lookups->Add(info->_start.QuadPart, info);
     LeaveCriticalSection(&cs);
   }
 
@@ -145,10 +154,22 @@ void TrackDns::Reset() {
   }
   _dns_lookups.RemoveAll();
   _dns_hosts.RemoveAll();
+  _lookup_timeline.RemoveAll();
+  pos = _host_lookups.GetStartPosition();
+  while (pos) {
+    CString host;
+    DnsTimeline * lookups = NULL;
+    _host_lookups.GetNextAssoc(pos, host, lookups);
+    if (lookups)
+      delete lookups;
+  }
+  _host_lookups.RemoveAll();
   LeaveCriticalSection(&cs);
 }
 
 /*-----------------------------------------------------------------------------
+  Claim every unclaimed lookup for the host that completed before the
+  request started (duplicates included) and report the latest one.
   For undecoded SPDY sessions (all of them), claim with IP instead of host.
 -----------------------------------------------------------------------------*/
 bool TrackDns::Claim(CString name, ULONG addr, LARGE_INTEGER before,
@@ -157,19 +178,21 @@ bool TrackDns::Claim(CString name, ULONG addr, LARGE_INTEGER before,
   if (!name.GetLength())
     name = GetHost(addr);
   EnterCriticalSection(&cs);
-  POSITION pos = _dns_lookups.GetStartPosition();
-  while (pos) {
-    DnsInfo * info = NULL;
-    void * key = NULL;
-    _dns_lookups.GetNextAssoc(pos, key, info);
-    if (info && !info->_accounted_for && info->_success &&
-        info->_start.QuadPart <= before.QuadPart &&
-        info->_end.QuadPart <= before.QuadPart &&
-        name == info->_name) {
-      info->_accounted_for = true;
-      is_claimed = true;
-      start = info->_start;
-      end = info->_end;
+  DnsTimeline * lookups = NULL;
+  if (_host_lookups.Lookup(name, lookups) && lookups) {
+    size_t index = lookups->UpperBound(before.QuadPart);
+    while (index > 0) {
+      index--;
+      DnsInfo * info = lookups->GetAt(index);
+      if (info && !info->_accounted_for && info->_success &&
+          info->_end.QuadPart <= before.QuadPart) {
+        info->_accounted_for = true;
+        if (!is_claimed) {
+          is_claimed = true;
+          start = info->_start;
+          end = info->_end;
+        }
+      }
     }
   }
   LeaveCriticalSection(&cs);
@@ -200,27 +223,23 @@ bool TrackDns::Find(CString name, DNSAddressList &addresses,
   bool found = false;
   addresses.RemoveAll();
   EnterCriticalSection(&cs);
-  POSITION pos = _dns_lookups.GetStartPosition();
-  while (pos && !found) {
-    DnsInfo * info = NULL;
-    void * key = NULL;
-    _dns_lookups.GetNextAssoc(pos, key, info);
-    if (info && info->_success && name == info->_name) {
-      found = true;
-      start = info->_start;
-      end = info->_end;
+  DnsTimeline * lookups = NULL;
+  if (_host_lookups.Lookup(name, lookups) && lookups) {
+    size_t count = lookups->GetCount();
+    for (size_t index = 0; index < count && !found; index++) {
+      DnsInfo * info = lookups->GetAt(index);
+      if (info && info->_success) {
+        found = true;
+        start = info->_start;
+        end = info->_end;
+      }
     }
   }
   if (found) {
-    pos = _host_addresses.GetHeadPosition();
-    bool done = false;
-    while (pos && !done) {
-      DnsHostAddresses& host_addresses = _host_addresses.GetNext(pos);
-      if (host_addresses.name_ == name) {
-        addresses.AddTailList(&host_addresses.addresses_);
-        done = true;
-      }
-    }
+    CAtlMap<CString, DnsHostAddresses>::CPair * host_addresses =
+        _host_addresses.Lookup(name);
+    if (host_addresses)
+      addresses.AddTailList(&host_addresses->m_value.addresses_);
   }
   LeaveCriticalSection(&cs);
   return found;
@@ -232,17 +251,9 @@ bool TrackDns::Find(CString name, DNSAddressList &addresses,
 LONGLONG TrackDns::GetEarliest(LONGLONG& after) {
   LONGLONG earliest = 0;
   EnterCriticalSection(&cs);
-  POSITION pos = _dns_lookups.GetStartPosition();
-  while (pos) {
-    DnsInfo * info = NULL;
-    void * key = NULL;
-    _dns_lookups.GetNextAssoc(pos, key, info);
-    if (info && info->_start.QuadPart &&
-        info->_start.QuadPart >= after && 
-        (!earliest || info->_start.QuadPart <= earliest)) {
-      earliest = info->_start.QuadPart;
-    }
-  }
+  size_t index = _lookup_timeline.LowerBound(after);
+  if (index < _lookup_timeline.GetCount())
+    earliest = _lookup_timeline.GetStart(index);
   LeaveCriticalSection(&cs);
   return earliest;
 }
@@ -261,22 +272,17 @@ CString TrackDns::GetHost(ULONG addr) {
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
 void TrackDns::AddAddress(CString host, DWORD address) {
-  bool found = false;
   EnterCriticalSection(&cs);
-  POSITION pos = _host_addresses.GetHeadPosition();
-  while (pos && !found) {
-    DnsHostAddresses& host_addresses = _host_addresses.GetNext(pos);
-    if (host_addresses.name_ == host) {
-      host_addresses.AddAddress(address);
-      found = true;
-    }
-  }
-  if (!found) {
-    DnsHostAddresses host_addresses;
-    host_addresses.name_ = host;
-    host_addresses.AddAddress(address);
-    _host_addresses.AddTail(host_addresses);
+  CAtlMap<CString, DnsHostAddresses>::CPair * host_addresses =
+      _host_addresses.Lookup(host);
+  if (!host_addresses) {
+    DnsHostAddresses new_host;
+    new_host.name_ = host;
+    _host_addresses.SetAt(host, new_host);
+    host_addresses = _host_addresses.Lookup(host);
   }
+  if (host_addresses)
+    host_addresses->m_value.AddAddress(address);
   LeaveCriticalSection(&cs);
 }
 
@@ -284,16 +290,11 @@ void TrackDns::AddAddress(CString host, DWORD address) {
 -----------------------------------------------------------------------------*/
 int TrackDns::GetAddressCount(CString host) {
   int count = 0;
-  bool found = false;
   EnterCriticalSection(&cs);
-  POSITION pos = _host_addresses.GetHeadPosition();
-  while (pos && !found) {
-    DnsHostAddresses& host_addresses = _host_addresses.GetNext(pos);
-    if (host_addresses.name_ == host) {
-      count = host_addresses.addresses_.GetCount();
-      found = true;
-    }
-  }
+  CAtlMap<CString, DnsHostAddresses>::CPair * host_addresses =
+      _host_addresses.Lookup(host);
+  if (host_addresses)
+    count = (int)host_addresses->m_value.addresses_.GetCount();
   LeaveCriticalSection(&cs);
   return count;
 }
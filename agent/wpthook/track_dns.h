@@ -27,6 +27,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ******************************************************************************/
 
 #pragma once
+#include "timeline_index.h"
 
 class TestState;
 class WptTest;
@@ -127,10 +128,15 @@ public:
   CRITICAL_SECTION            cs;
   TestState&                  _test_state;
   WptTest&                    _test;
-  CAtlList<DnsHostAddresses>  _host_addresses;
+  CAtlMap<CString, DnsHostAddresses>  _host_addresses;
   CAtlList<CDNEntry>          _cdn_hosts;
 
 private:
+  typedef TimelineIndex<DnsInfo> DnsTimeline;
+
+  DnsTimeline                       _lookup_timeline;  // all lookups
+  CAtlMap<CString, DnsTimeline *>   _host_lookups;     // lookups by host
+
   void CheckCDN(CString host, CString name);
   CString GetHost(ULONG addr);
 };
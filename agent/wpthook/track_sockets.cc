@@ -103,7 +103,10 @@ void TrackSockets::Connect(SOCKET s, const struct sockaddr FAR * name,
     EnterCriticalSection(&cs);
     SocketInfo* info = GetSocketInfo(s, false);
     memcpy(&info->_addr, ip_name, sizeof(struct sockaddr_in));
+    bool indexed = info->_connect_start.QuadPart != 0;
     QueryPerformanceCounter(&info->_connect_start);
+    if (!indexed)
+      connect_timeline_.Add(info->_connect_start.QuadPart, info);
     localhost = info->IsLocalhost();
     LeaveCriticalSection(&cs);
 
@@ -230,6 +233,7 @@ void TrackSockets::DataIn(SOCKET s, DataChunk& chunk, bool is_unencrypted) {
 -----------------------------------------------------------------------------*/
 void TrackSockets::Reset() {
   EnterCriticalSection(&cs);
+  connect_timeline_.RemoveAll();
   POSITION pos = _socketInfo.GetStartPosition();
   while (pos) {
     DWORD id = 0;
@@ -496,17 +500,9 @@ SocketInfo* TrackSockets::GetSocketInfoById(DWORD socket_id) {
 LONGLONG TrackSockets::GetEarliest(LONGLONG& after) {
   LONGLONG earliest = 0;
   EnterCriticalSection(&cs);
-  POSITION pos = _socketInfo.GetStartPosition();
-  while (pos) {
-    SocketInfo * info = NULL;
-    DWORD key = 0;
-    _socketInfo.GetNextAssoc(pos, key, info);
-    if (info && info->_connect_start.QuadPart && 
-        info->_connect_start.QuadPart >= after && 
-        (!earliest || info->_connect_start.QuadPart <= earliest)) {
-      earliest = info->_connect_start.QuadPart;
-    }
-  }
+  size_t index = connect_timeline_.LowerBound(after);
+  if (index < connect_timeline_.GetCount())
+    earliest = connect_timeline_.GetStart(index);
   LeaveCriticalSection(&cs);
   return earliest;
 }
@@ -0,0 +1,226 @@
+/******************************************************************************
+Copyright (c) 2014, Google Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+    * Neither the name of the <ORGANIZATION> nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+#include "StdAfx.h"
+#include "traffic_shaper.h"
+
+static const DWORD PACKET_SIZE = 1460;
+static const double BURST_BYTES = PACKET_SIZE * 2;
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+TrafficShaper::TrafficShaper(void):
+  enabled_(false)
+  ,latency_in_(0)
+  ,latency_out_(0)
+  ,plr_(0)
+  ,random_(1) {
+  InitializeCriticalSection(&cs_);
+  connections_.InitHashTable(257);
+  QueryPerformanceFrequency(&frequency_);
+  QueryPerformanceCounter(&start_);
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+TrafficShaper::~TrafficShaper(void) {
+  DeleteCriticalSection(&cs_);
+}
+
+/*-----------------------------------------------------------------------------
+  Bandwidth in Kbps, latency (round trip) in ms and packet loss in percent,
+  the same as the dummynet settings.
+-----------------------------------------------------------------------------*/
+void TrafficShaper::Configure(DWORD bw_in, DWORD bw_out, DWORD latency,
+                              double plr, DWORD seed) {
+  EnterCriticalSection(&cs_);
+  in_.Reset(bw_in);
+  out_.Reset(bw_out);
+  // split the latency across directions (odd values go to the outbound)
+  latency_in_ = (double)(latency / 2);
+  latency_out_ = (double)(latency - latency / 2);
+  plr_ = plr > 0 && plr <= 100 ? plr / 100.0 : 0;
+  random_ = seed ? seed : 1;
+  connections_.RemoveAll();
+  enabled_ = bw_in || bw_out || latency || plr_ > 0;
+  LeaveCriticalSection(&cs_);
+  if (enabled_)
+    WptTrace(loglevel::kProcess,
+      _T("[wpthook] - TrafficShaper: %d Kbps in, %d Kbps out, ")
+      _T("%d ms latency, %0.2f plr\n"), bw_in, bw_out, latency, plr);
+}
+
+/*-----------------------------------------------------------------------------
+  The handshake costs a round trip
+-----------------------------------------------------------------------------*/
+void TrafficShaper::Connect(SOCKET s, const struct sockaddr FAR * name,
+                            int namelen) {
+  if (enabled_ && IsLoopback(name, namelen)) {
+    // never shaped, even if the socket handle was re-used
+    Close(s);
+  } else if (enabled_) {
+    double now = Now();
+    double release = Schedule(s, kOut, 0, now);
+    release = Schedule(s, kIn, 0, release);
+    WaitUntil(release);
+  }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void TrafficShaper::Send(SOCKET s, DWORD bytes) {
+  if (enabled_)
+    WaitUntil(Schedule(s, kOut, bytes, Now()));
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void TrafficShaper::Receive(SOCKET s, DWORD bytes) {
+  if (enabled_)
+    WaitUntil(Schedule(s, kIn, bytes, Now()));
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void TrafficShaper::Close(SOCKET s) {
+  if (enabled_) {
+    EnterCriticalSection(&cs_);
+    connections_.RemoveKey(s);
+    LeaveCriticalSection(&cs_);
+  }
+}
+
+/*-----------------------------------------------------------------------------
+  Figure out when the data that showed up at "now" (ms) gets released.
+  Data on sockets that were never connected through the hooks (the ones
+  accepted by the agent's own local servers) passes straight through.
+-----------------------------------------------------------------------------*/
+double TrafficShaper::Schedule(SOCKET s, Direction direction, DWORD bytes,
+                               double now) {
+  EnterCriticalSection(&cs_);
+  Direction last = kNone;
+  bool connected = connections_.Lookup(s, last);
+  double latency = direction == kIn ? latency_in_ : latency_out_;
+  double release = now;
+  if (connected || !bytes) {
+    if (direction != last)
+      release += latency;
+    connections_.SetAt(s, direction);
+    if (bytes) {
+      // the data only starts to use the link once the latency is paid
+      Bucket &bucket = direction == kIn ? in_ : out_;
+      double available = bucket.Take(bytes, release);
+      if (available > release)
+        release = available;
+      DWORD lost = Lost(bytes);
+      if (lost)
+        release += (latency_in_ + latency_out_) * lost;
+    }
+  }
+  LeaveCriticalSection(&cs_);
+  return release;
+}
+
+/*-----------------------------------------------------------------------------
+  127.0.0.0/8 or ::1
+-----------------------------------------------------------------------------*/
+bool TrafficShaper::IsLoopback(const struct sockaddr FAR * name,
+                               int namelen) const {
+  bool loopback = false;
+  if (name && namelen >= sizeof(struct sockaddr_in) &&
+      name->sa_family == AF_INET) {
+    const struct sockaddr_in * ip_name = (const struct sockaddr_in *)name;
+    loopback = (ntohl(ip_name->sin_addr.s_addr) >> 24) == 127;
+  } else if (name && namelen >= sizeof(struct sockaddr_in6) &&
+             name->sa_family == AF_INET6) {
+    loopback = IN6_IS_ADDR_LOOPBACK(
+        &((const struct sockaddr_in6 *)name)->sin6_addr) != FALSE;
+  }
+  return loopback;
+}
+
+/*-----------------------------------------------------------------------------
+  Number of packets (out of the ones needed for the data) that get dropped
+-----------------------------------------------------------------------------*/
+DWORD TrafficShaper::Lost(DWORD bytes) {
+  DWORD lost = 0;
+  if (plr_ > 0) {
+    DWORD packets = (bytes + PACKET_SIZE - 1) / PACKET_SIZE;
+    for (DWORD i = 0; i < packets; i++) {
+      random_ = random_ * 1103515245 + 12345;
+      if ((double)((random_ >> 16) & 0x7FFF) / 32768.0 < plr_)
+        lost++;
+    }
+  }
+  return lost;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+double TrafficShaper::Now(void) {
+  LARGE_INTEGER now;
+  QueryPerformanceCounter(&now);
+  return (double)(now.QuadPart - start_.QuadPart) * 1000.0 /
+         (double)frequency_.QuadPart;
+}
+
+/*-----------------------------------------------------------------------------
+  Sleep() has 1ms resolution while the test is running (timeBeginPeriod)
+-----------------------------------------------------------------------------*/
+void TrafficShaper::WaitUntil(double release) {
+  double now = Now();
+  while (release - now >= 1.0) {
+    Sleep((DWORD)(release - now));
+    now = Now();
+  }
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+void TrafficShaper::Bucket::Reset(DWORD kbps) {
+  rate_ = (double)kbps / 8.0;   // 1 Kbps is 1 bit per ms
+  tokens_ = BURST_BYTES;
+  last_ = 0;
+}
+
+/*-----------------------------------------------------------------------------
+  Take the bytes out of the bucket and return the time when they are
+  available.  The bucket goes into debt so later data waits its turn.
+-----------------------------------------------------------------------------*/
+double TrafficShaper::Bucket::Take(DWORD bytes, double now) {
+  double release = now;
+  if (rate_ > 0) {
+    if (now > last_) {
+      tokens_ = min(BURST_BYTES, tokens_ + (now - last_) * rate_);
+      last_ = now;
+    }
+    tokens_ -= bytes;
+    if (tokens_ < 0)
+      release = last_ + (-tokens_ / rate_);
+  }
+  return release;
+}
@@ -0,0 +1,109 @@
+/******************************************************************************
+Copyright (c) 2014, Google Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+    * Neither the name of the <ORGANIZATION> nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+#pragma once
+
+/*-----------------------------------------------------------------------------
+  In-process traffic shaping for when the dummynet driver isn't available.
+
+  The shaping is applied in the winsock hooks (so it sees the bytes that go
+  over the wire, including TLS) by holding the calling thread until the data
+  would have made it across the emulated link:
+
+  - Bandwidth is a token bucket per direction, shared by all connections
+    like the dummynet pipes.  Tokens can go negative so callers queue up
+    behind each other.
+  - Latency is split across the directions and is paid when a connection
+    turns around (request -> response and back) and for the connect
+    handshake, not on every read, so back-to-back reads don't stack it.
+  - Packet loss costs a retransmission (one round trip) for each emulated
+    packet that is dropped.  The drops come from a generator seeded with
+    the run number so repeated runs see the same pattern.
+
+  Only connections made through the hooks are shaped so the sockets that
+  the agent's own local servers accept (the replay server) aren't counted
+  twice.  Connections to a loopback address (the extension talking to the
+  hook on 127.0.0.1:8888) aren't shaped either.  The address checked is
+  the one the browser asked for, before any replay redirect, so replayed
+  traffic is still shaped like the network it stands in for.
+
+  All of the timing decisions are made by Schedule() from the time passed
+  in so the model itself is deterministic.  Connections that share a
+  network thread are delayed one after another which matches a shared link
+  for bandwidth but over-states latency so the driver only uses it when the
+  agent is configured for it (browser_shaping in wptdriver.ini).
+-----------------------------------------------------------------------------*/
+class TrafficShaper {
+public:
+  TrafficShaper(void);
+  ~TrafficShaper(void);
+
+  void Configure(DWORD bw_in, DWORD bw_out, DWORD latency, double plr,
+                 DWORD seed);
+  bool Enabled(void) const {return enabled_;}
+
+  // hook interface (blocks until the data is released)
+  void Connect(SOCKET s, const struct sockaddr FAR * name, int namelen);
+  void Send(SOCKET s, DWORD bytes);
+  void Receive(SOCKET s, DWORD bytes);
+  void Close(SOCKET s);
+
+  enum Direction {
+    kNone,
+    kIn,
+    kOut
+  };
+  double Schedule(SOCKET s, Direction direction, DWORD bytes, double now);
+
+private:
+  class Bucket {
+  public:
+    Bucket():rate_(0),tokens_(0),last_(0){}
+    void Reset(DWORD kbps);
+    double Take(DWORD bytes, double now);
+    double  rate_;    // bytes per ms (0 = unlimited)
+    double  tokens_;
+    double  last_;
+  };
+
+  bool IsLoopback(const struct sockaddr FAR * name, int namelen) const;
+  DWORD Lost(DWORD bytes);
+  double Now(void);
+  void WaitUntil(double release);
+
+  CRITICAL_SECTION  cs_;
+  bool              enabled_;
+  Bucket            in_;
+  Bucket            out_;
+  double            latency_in_;
+  double            latency_out_;
+  double            plr_;
+  DWORD             random_;
+  LARGE_INTEGER     start_;
+  LARGE_INTEGER     frequency_;
+  CAtlMap<SOCKET, Direction>  connections_;
+};
@@ -36,6 +36,8 @@ void WptTestHook::LoadFromFile() {
             _clear_cache = shared_cleared_cache;
             _run = shared_current_run;
             has_gpu_ = shared_has_gpu;
+            shape_traffic_ = shared_shape_traffic;
+            replay_mode_ = shared_replay_mode;
             BuildScript();
           }
         }
@@ -60,10 +62,7 @@ bool WptTestHook::ProcessCommand(ScriptCommand& command, bool &consumed) {
   if (!consumed) {
     consumed = true;
 
-    CString cmd = command.command;
-    cmd.MakeLower();
-
-    if (cmd == _T("resizeresponsive")) {
+    if (command.op == SCRIPT_RESIZE_RESPONSIVE) {
       test_state_.ResizeBrowserForResponsiveTest();
       continue_processing = false;
       consumed = true;
@@ -33,6 +33,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "shared_mem.h"
 #include "wpthook.h"
 #include "window_messages.h"
+#include "../wptdriver/trace_ring.h"
 
 WptHook * global_hook = NULL;
 extern HINSTANCE global_dll_handle;
@@ -42,6 +43,7 @@ static const UINT_PTR TIMER_FORCE_REPORT = 2;
 static const DWORD TIMER_DONE_INTERVAL = 100;
 static const DWORD INIT_TIMEOUT = 30000;
 static const DWORD TIMER_FORCE_REPORT_INTERVAL = 10000;
+static const TCHAR * TRACE_RING_FILE = _T("_wpthook_trace.dat");
 
 /*-----------------------------------------------------------------------------
 -----------------------------------------------------------------------------*/
@@ -50,7 +52,7 @@ WptHook::WptHook(void):
   ,background_thread_started_(NULL)
   ,message_window_(NULL)
   ,test_state_(results_, screen_capture_, test_, dev_tools_, trace_)
-  ,winsock_hook_(dns_, sockets_, test_state_)
+  ,winsock_hook_(dns_, sockets_, test_state_, shaper_, replay_server_)
   ,nspr_hook_(sockets_, test_state_, test_)
   ,schannel_hook_(sockets_, test_state_, test_)
   ,wininet_hook_(sockets_, test_state_, test_)
@@ -116,6 +118,16 @@ void WptHook::Init(){
   //MessageBox(NULL, L"Attach Debugger", L"Attach Debugger", MB_OK);
 #endif
   test_.LoadFromFile();
+  TraceRingEnable(shared_debug_level, file_base_ + TRACE_RING_FILE);
+  if (test_.shape_traffic_)
+    shaper_.Configure(test_._bwIn, test_._bwOut, test_._latency, test_._plr,
+                      test_._run);
+  if (test_.replay_mode_ == REPLAY_PLAY) {
+    CString directory = file_base_;
+    int separator = directory.ReverseFind(_T('\\'));
+    if (separator > 0)
+      replay_server_.Start(directory.Left(separator + 1) + REPLAY_DIRECTORY);
+  }
   if (!test_state_.gdi_only_) {
     winsock_hook_.Init();
     nspr_hook_.Init();
@@ -197,7 +209,9 @@ void WptHook::OnReport() {
     test_.CollectDataDone();
     if (test_.Done()) {
       test_server_.Stop();
+      replay_server_.Stop();
       results_.Save();
+      TraceRingFlush();
       done_ = true;
       if (test_state_._frame_window) {
         WptTrace(loglevel::kTrace, 
@@ -207,6 +221,8 @@ void WptHook::OnReport() {
     }
   }
   test_.Unlock();
+  if (!done_)
+    test_server_.TaskAvailable();
 }
 
 /*-----------------------------------------------------------------------------
@@ -309,6 +325,7 @@ void WptHook::BackgroundThread() {
   }
 
   test_server_.Stop();
+  replay_server_.Stop();
   WptTrace(loglevel::kFunction, _T("[wpthook] BackgroundThread() Stopped\n"));
 }
 
@@ -42,6 +42,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "wpt_test_hook.h"
 #include "dev_tools.h"
 #include "trace.h"
+#include "traffic_shaper.h"
+#include "replay_server.h"
 
 extern HINSTANCE global_dll_handle; // DLL handle
 
@@ -95,4 +97,6 @@ private:
   WptTestHook   test_;
   DevTools      dev_tools_;
   Trace         trace_;
+  TrafficShaper shaper_;
+  ReplayServer  replay_server_;
 };
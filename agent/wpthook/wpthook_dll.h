@@ -45,4 +45,7 @@ _import void WINAPI SetDebugLevel(int level, const WCHAR * log_file);
 _import int  WINAPI GetCPUUtilization();
 _import void WINAPI SetCPUUtilization(int utilization);
 _import void WINAPI SetHasGPU(bool has_gpu);
+_import void WINAPI SetShapeTraffic(bool shape_traffic);
+_import void WINAPI SetReplayMode(int mode);
+_import void WINAPI SetResultStream(const WCHAR * id);
 }
@@ -0,0 +1,205 @@
+/******************************************************************************
+Copyright (c) 2014, Google Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+    * Neither the name of the <ORGANIZATION> nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+/******************************************************************************
+  wptrecords - converts the binary request records (<test>_requests.bin)
+  back to the tab-separated request report and raw headers for anything
+  that still reads the text formats:
+
+    wptrecords.exe <test>_requests.bin <report.txt> [headers.txt]
+
+  or round-trips 10,000 generated rows through the binary format and
+  times it against formatting and parsing the text report:
+
+    wptrecords.exe -benchmark
+******************************************************************************/
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <stdio.h>
+#include <tchar.h>
+#include <time.h>
+#include <atlstr.h>
+#include <atlcoll.h>
+#include "../wpthook/request_records.h"
+
+static const int BENCHMARK_ROWS = 10000;
+static const TCHAR * BENCHMARK_FILE = _T("wptrecords_benchmark.bin");
+
+static const char * HOSTS[] = {"www.example.com", "static.example.com",
+                               "cdn.example.net", "ads.example.org"};
+static const char * TYPES[] = {"text/html", "text/css",
+                               "application/javascript", "image/png"};
+
+/*-----------------------------------------------------------------------------
+  Build a plausible row (times increase through the page load)
+-----------------------------------------------------------------------------*/
+static void GenerateRecord(int index, RequestRecord& record) {
+  int * values = record.values_;
+  values[RECORD_IP_ADDRESS] = 0x0A000001 + index % 4;
+  values[RECORD_RESULT] = index % 17 ? 200 : 304;
+  values[RECORD_START] = 100 + index * 7;
+  values[RECORD_FIRST_BYTE] = values[RECORD_START] + 40 + index % 13;
+  values[RECORD_END] = values[RECORD_FIRST_BYTE] + 5 + index % 29;
+  values[RECORD_BYTES_OUT] = 400 + index % 50;
+  values[RECORD_BYTES_IN] = 1000 + (index * 37) % 90000;
+  values[RECORD_OBJECT_SIZE] = values[RECORD_BYTES_IN] - 300;
+  values[RECORD_SOCKET_ID] = 1 + index % 6;
+  values[RECORD_INDEX] = index + 1;
+  values[RECORD_CACHE_SCORE] = index % 3 ? 100 : 50;
+  values[RECORD_STATIC_CDN_SCORE] = -1;
+  values[RECORD_GZIP_SCORE] = 100;
+  values[RECORD_KEEP_ALIVE_SCORE] = 100;
+  values[RECORD_COMBINE_SCORE] = -1;
+  values[RECORD_IMAGE_COMPRESSION_SCORE] = -1;
+  values[RECORD_MINIFY_SCORE] = index % 5 ? 100 : 80;
+  values[RECORD_MINIFY_TOTAL] = values[RECORD_OBJECT_SIZE];
+  values[RECORD_MINIFY_SAVINGS] =
+      index % 5 ? 0 : values[RECORD_OBJECT_SIZE] / 5;
+  values[RECORD_CACHE_TIME] = 86400;
+  values[RECORD_DNS_START] = index % 4 ? -1 : values[RECORD_START] - 30;
+  values[RECORD_DNS_END] = index % 4 ? -1 : values[RECORD_START] - 10;
+  values[RECORD_SERVER_COUNT] = 1;
+  values[RECORD_LOCAL_PORT] = 50000 + index % 6;
+  record.strings_[RECORD_DATE] = "10/18/2026";
+  record.strings_[RECORD_TIME] = "18:08:33";
+  record.strings_[RECORD_METHOD] = "GET";
+  record.strings_[RECORD_HOST] = HOSTS[index % _countof(HOSTS)];
+  CStringA url;
+  url.Format("/assets/%d/file%d.js?v=%d", index % 20, index, index * 13);
+  record.strings_[RECORD_URL] = url;
+  record.strings_[RECORD_CONTENT_TYPE] = TYPES[index % _countof(TYPES)];
+  record.strings_[RECORD_CACHE_CONTROL] = "max-age=86400";
+  record.strings_[RECORD_REQUEST_HEADERS] =
+      CStringA("GET ") + url + " HTTP/1.1\r\nHost: " +
+      record.strings_[RECORD_HOST] + "\r\nAccept: */*\r\n";
+  record.strings_[RECORD_RESPONSE_HEADERS] =
+      "HTTP/1.1 200 OK\r\nContent-Type: " +
+      record.strings_[RECORD_CONTENT_TYPE] + "\r\n";
+}
+
+/*-----------------------------------------------------------------------------
+  What the server does with each line of the text report
+-----------------------------------------------------------------------------*/
+static int ParseText(const CStringA& text) {
+  int fields = 0;
+  int position = 0;
+  while (position >= 0) {
+    CStringA field = text.Tokenize("\t\r\n", position);
+    if (position >= 0) {
+      atoi(field);
+      fields++;
+    }
+  }
+  return fields;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+static double Seconds(clock_t start) {
+  return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+/*-----------------------------------------------------------------------------
+  Write the rows as two blocks (two steps) and make sure reading them back
+  regenerates the same report, then time text vs binary
+-----------------------------------------------------------------------------*/
+static bool Benchmark(void) {
+  CAtlArray<RequestRecord> records;
+  CStringA text;
+  clock_t start = clock();
+  for (int i = 0; i < BENCHMARK_ROWS; i++) {
+    RequestRecord record;
+    GenerateRecord(i, record);
+    records.Add(record);
+    text += record.FormatText();
+    text += record.FormatHeaders();
+  }
+  double format_time = Seconds(start);
+
+  start = clock();
+  int fields = ParseText(text);
+  double parse_time = Seconds(start);
+
+  DeleteFile(BENCHMARK_FILE);
+  start = clock();
+  RequestRecordsWriter first_step, second_step;
+  for (size_t i = 0; i < records.GetCount(); i++) {
+    if (i < records.GetCount() / 2)
+      first_step.Add(records[i]);
+    else
+      second_step.Add(records[i]);
+  }
+  bool ok = first_step.Append(BENCHMARK_FILE) &&
+            second_step.Append(BENCHMARK_FILE);
+  double write_time = Seconds(start);
+
+  start = clock();
+  RequestRecordsReader reader;
+  ok = ok && reader.Load(BENCHMARK_FILE);
+  double read_time = Seconds(start);
+
+  ok = ok && reader.records_.GetCount() == records.GetCount();
+  for (size_t i = 0; ok && i < records.GetCount(); i++)
+    ok = reader.records_[i].FormatText() == records[i].FormatText() &&
+         reader.records_[i].FormatHeaders() == records[i].FormatHeaders();
+
+  DWORD binary_size = 0;
+  WIN32_FILE_ATTRIBUTE_DATA attributes;
+  if (GetFileAttributesEx(BENCHMARK_FILE, GetFileExInfoStandard,
+                          &attributes))
+    binary_size = attributes.nFileSizeLow;
+  DeleteFile(BENCHMARK_FILE);
+
+  _tprintf(_T("%d rows (%d text fields), round trip %s\n"), BENCHMARK_ROWS,
+           fields, ok ? _T("OK") : _T("FAILED"));
+  _tprintf(_T("  text:   %8d bytes, format %.3fs, parse %.3fs\n"),
+           text.GetLength(), format_time, parse_time);
+  _tprintf(_T("  binary: %8d bytes, write  %.3fs, read  %.3fs\n"),
+           binary_size, write_time, read_time);
+  return ok;
+}
+
+/*-----------------------------------------------------------------------------
+-----------------------------------------------------------------------------*/
+int _tmain(int argc, _TCHAR* argv[]) {
+  bool ok = false;
+  if (argc == 2 && !lstrcmpi(argv[1], _T("-benchmark"))) {
+    ok = Benchmark();
+  } else if (argc == 3 || argc == 4) {
+    RequestRecordsReader reader;
+    ok = reader.Load(argv[1]) &&
+         reader.ConvertToText(argv[2], argc > 3 ? argv[3] : _T(""));
+    _tprintf(_T("%s converting %s\n"), ok ? _T("OK") : _T("FAILED"),
+             argv[1]);
+  } else {
+    _tprintf(_T("Usage: wptrecords <test>_requests.bin <report.txt> ")
+             _T("[headers.txt]\n       wptrecords -benchmark\n"));
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,170 @@
+<?php
+/*
+*   Decode a binary trace ring file from the agent (wptdriver_trace.dat or
+*   a run's _wpthook_trace.dat) into text, one event per line sorted by time:
+*
+*   <ms> <thread id> <level> <message>
+*/
+if( count($_SERVER["argv"]) > 1 )
+{
+    $events = DecodeTrace(trim($_SERVER["argv"][1]));
+    if( $events === false )
+        echo "Invalid trace file\n";
+    else
+    {
+        foreach( $events as $event )
+            echo sprintf("%0.3f %d %d %s\n", $event['ms'], $event['thread'], $event['level'], $event['message']);
+    }
+}
+else
+    echo "usage: php decode_trace.php <trace file>\n";
+
+/**
+* Read the trace file and format all of the events
+* 
+* @param mixed $file
+*/
+function DecodeTrace($file)
+{
+    $data = file_get_contents($file);
+    if( $data === false || strlen($data) < 24 || substr($data, 0, 4) != 'WPTT' )
+        return false;
+    $header = unpack('Vversion/Vpointer/Vargs', substr($data, 4, 12));
+    if( $header['version'] != 1 )
+        return false;
+    $pointer = $header['pointer'];
+    $argCount = $header['args'];
+    $tick = unpack('d', substr($data, 16, 8));
+    $ticksPerMs = $tick[1];
+    $pos = 24;
+
+    $formats = array();
+    $count = ReadDword($data, $pos);
+    for( $i = 0; $i < $count; $i++ )
+    {
+        $id = ReadDword($data, $pos);
+        $len = ReadDword($data, $pos);
+        $formats[$id] = substr($data, $pos, $len);
+        $pos += $len;
+    }
+
+    $events = array();
+    $first = null;
+    $threads = ReadDword($data, $pos);
+    for( $t = 0; $t < $threads && $pos < strlen($data); $t++ )
+    {
+        $thread = ReadDword($data, $pos);
+        $count = ReadDword($data, $pos);
+        for( $i = 0; $i < $count && $pos < strlen($data); $i++ )
+        {
+            $counter = ReadQword($data, $pos);
+            $id = ReadDword($data, $pos);
+            $level = ReadDword($data, $pos);
+            $args = substr($data, $pos, $pointer * $argCount);
+            $pos += $pointer * $argCount;
+            if( !isset($first) || $counter < $first )
+                $first = $counter;
+            $format = isset($formats[$id]) ? $formats[$id] : '';
+            $events[] = array('counter' => $counter, 'thread' => $thread, 'level' => $level,
+                              'message' => rtrim(FormatEvent($format, $args, $pointer)));
+        }
+    }
+
+    foreach( $events as &$event )
+        $event['ms'] = $ticksPerMs > 0 ? ($event['counter'] - $first) / $ticksPerMs : 0;
+    unset($event);
+    usort($events, 'CompareEvents');
+    return $events;
+}
+
+/**
+* Fill in the format string from the raw argument words (strings were only
+* recorded as pointers)
+* 
+* @param mixed $format
+* @param mixed $args
+* @param mixed $pointer
+*/
+function FormatEvent($format, $args, $pointer)
+{
+    $message = '';
+    $offset = 0;
+    $len = strlen($format);
+    for( $i = 0; $i < $len; $i++ )
+    {
+        $c = $format[$i];
+        if( $c != '%' )
+            $message .= $c;
+        elseif( $i + 1 < $len && $format[$i + 1] == '%' )
+        {
+            $message .= '%';
+            $i++;
+        }
+        elseif( preg_match('/^%([-+ #0]*)(\d*)(\.\d+)?(I64|I32|ll|l|h|I)?([a-zA-Z])/', substr($format, $i), $matches) )
+        {
+            $i += strlen($matches[0]) - 1;
+            $size = $matches[4];
+            $type = $matches[5];
+            $wide = ($size == 'I64' || $size == 'll' || ($size == 'I' && $pointer == 8) ||
+                     (($type == 'f' || $type == 'g' || $type == 'e') && $pointer == 4));
+            $bytes = $wide ? 8 : $pointer;
+            $words = max(1, $bytes / $pointer);
+            if( $offset + $bytes <= strlen($args) )
+            {
+                $raw = substr($args, $offset, $bytes);
+                if( $type == 's' || $type == 'S' || $type == 'p' )
+                    $message .= '<0x' . bin2hex(strrev($raw)) . '>';
+                elseif( $type == 'f' || $type == 'g' || $type == 'e' )
+                {
+                    $value = unpack('d', $raw);
+                    $message .= sprintf("%{$matches[3]}f", $value[1]);
+                }
+                else
+                {
+                    $start = 0;
+                    $value = $bytes == 8 ? ReadQword($raw, $start) : ReadDword($raw, $start);
+                    if( $type == 'd' || $type == 'i' )
+                    {
+                        if( $bytes == 4 && $value >= 0x80000000 )
+                            $value -= 0x100000000;
+                        $message .= sprintf('%d', $value);
+                    }
+                    elseif( $type == 'x' || $type == 'X' )
+                        $message .= sprintf("%{$matches[1]}{$matches[2]}$type", $value);
+                    elseif( $type == 'c' || $type == 'C' )
+                        $message .= chr($value & 0xFF);
+                    else
+                        $message .= sprintf('%u', $value);
+                }
+            }
+            else
+                $message .= '?';
+            $offset += $words * $pointer;
+        }
+        else
+            $message .= $c;
+    }
+    return $message;
+}
+
+function ReadDword(&$data, &$pos)
+{
+    $value = unpack('V', substr($data, $pos, 4));
+    $pos += 4;
+    return $value[1];
+}
+
+function ReadQword(&$data, &$pos)
+{
+    $value = unpack('Vlow/Vhigh', substr($data, $pos, 8));
+    $pos += 8;
+    return $value['high'] * 4294967296 + $value['low'];
+}
+
+function CompareEvents($a, $b)
+{
+    if( $a['counter'] == $b['counter'] )
+        return 0;
+    return $a['counter'] < $b['counter'] ? -1 : 1;
+}
+?>
@@ -43,6 +43,10 @@ if (!array_key_exists('freedisk', $_GET) || (float)$_GET['freedisk'] > 0.1) {
     $is_done = GetVideoJob();
   if (!$is_done)
     $is_done = GetJob();
+  if (!$is_done && array_key_exists('wait', $_GET) &&
+      isset($settings['long_poll']) && (int)$settings['long_poll'] > 0)
+    $is_done = WaitForJob(min((int)$_GET['wait'],
+                              (int)$settings['long_poll']));
 }
 
 // kick off any cron work we need to do asynchronously
@@ -208,6 +212,42 @@ function GetJob() {
     return $is_done;
 }
 
+/**
+* Long-poll: hold the request open (up to 30 seconds, capped by the long_poll
+* setting) and hand out a job as soon as one is queued for the location.  It
+* is off by default because every held request ties up a PHP worker.  The
+* job directory only changes when jobs are added or removed so that is all
+* we check every second (with a full check every 5 seconds to cover changes
+* within the mtime resolution).
+*/
+function WaitForJob($wait) {
+    global $location;
+    $is_done = false;
+    $wait = min(max($wait, 0), 30);
+    $workDir = "./work/jobs/$location";
+    if ($wait &&
+        strpos($location, '..') === false &&
+        strpos($location, '\\') === false &&
+        strpos($location, '/') === false &&
+        is_dir($workDir)) {
+        $end = time() + $wait;
+        clearstatcache();
+        $modified = filemtime($workDir);
+        $next_check = time() + 5;
+        while (!$is_done && time() < $end && !connection_aborted()) {
+            sleep(1);
+            clearstatcache();
+            $now_modified = filemtime($workDir);
+            if ($now_modified !== $modified || time() >= $next_check) {
+                $modified = $now_modified;
+                $next_check = time() + 5;
+                $is_done = GetJob();
+            }
+        }
+    }
+    return $is_done;
+}
+
 /**
 * See if there is a video rendering job that needs to be done
 * 